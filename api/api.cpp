@@ -8,19 +8,25 @@
  */
 #include "api.h"
 #include "base64.h"
+#include "common/profiler.h"
+#include "common/trace.h"
 #include "common/utils.h"
 #include "db/DB.h"
+#include "import/importer.h"
 #include "requestData.h"
 #include "tasklistContent.h"
 #include <algorithm>
 #include <chrono>
 #include <ctime>
+#include <future>
 #include <iostream>
 #include <iterator>
 #include <jwt/jwt.hpp>
 #include <memory>
 #include <mutex>
+#include <sstream>
 #include <nlohmann/json_fwd.hpp>
+#include <thread>
 #include <utility>
 
 #define API_REQ() __api_req_x92k_no_conflict
@@ -32,9 +38,24 @@
 
 #define API_ADD_HTTP_HANDLER(server, path, method, func)                       \
   do {                                                                         \
-    (server)->method((path), [this](const httplib::Request &API_REQ(),         \
-                                    httplib::Response &API_RES()) {            \
+    const bool needs_ready = std::string(path).compare(0, 4, "/v1/") == 0;     \
+    (server)->method((path), [this, needs_ready](                              \
+                                 const httplib::Request &API_REQ(),            \
+                                 httplib::Response &API_RES()) {               \
+      TRACE_SCOPE("Api", #func);                                               \
+      if (needs_ready && !ready) {                                             \
+        API_RETURN_HTTP_RESP(503, "msg", "failed service not ready");          \
+      }                                                                        \
+      DB::resetRequestStats();                                                 \
       this->func(API_REQ(), API_RES());                                        \
+      if (debug) {                                                             \
+        API_RES().set_header(                                                  \
+            "X-Debug-DB-Queries",                                              \
+            std::to_string(DB::requestStats().queries));                       \
+        API_RES().set_header(                                                  \
+            "X-Debug-DB-Connections",                                          \
+            std::to_string(DB::requestStats().connections));                   \
+      }                                                                        \
     });                                                                        \
   } while (false)
 
@@ -94,6 +115,7 @@ inline void BuildHttpRespBody(nlohmann::json *js, const std::string &field,
   ({                                                                           \
     nlohmann::json json_body;                                                  \
     try {                                                                      \
+      TRACE_SCOPE("Api", "json.parse");                                        \
       json_body = nlohmann::json::parse((API_REQ()).body);                     \
     } catch (...) {                                                            \
       if ((ret))                                                               \
@@ -180,6 +202,7 @@ EncodeTokenFromEmail(const std::string &email,
 static inline std::string
 DecodeEmailFromToken(const std::string &token,
                      const std::string &secret_key) noexcept {
+  TRACE_SCOPE("Api", "jwt.decode");
 
   std::error_code err;
   const auto jwt_obj = jwt::decode(
@@ -260,7 +283,49 @@ Api::Api(std::shared_ptr<Users> _users,
   }
 }
 
-Api::~Api() { Stop(); }
+Api::~Api() {
+  Stop();
+  if (startup_thread.joinable()) {
+    startup_thread.join();
+  }
+}
+
+void Api::AddStartupTask(std::function<bool()> task) {
+  startup_tasks.push_back(std::move(task));
+}
+
+void Api::RunStartupTasks() {
+  std::vector<std::future<bool>> results;
+  for (auto &task : startup_tasks) {
+    results.push_back(std::async(std::launch::async, [this, &task]() {
+      for (int backoff_ms = 100;; backoff_ms = std::min(backoff_ms * 2, 5000)) {
+        try {
+          if (task()) {
+            return true;
+          }
+        } catch (std::exception &e) {
+          if (print) {
+            std::cout << "startup task failed: " << e.what() << std::endl;
+          }
+        }
+        std::unique_lock<std::mutex> lock(startup_lock);
+        if (startup_cv.wait_for(lock, std::chrono::milliseconds(backoff_ms),
+                                [this]() { return stopping; })) {
+          return false;
+        }
+      }
+    }));
+  }
+
+  bool succeeded = true;
+  for (auto &result : results) {
+    succeeded = result.get() && succeeded;
+  }
+  ready = succeeded;
+  if (print && succeeded) {
+    std::cout << "service ready" << std::endl;
+  }
+}
 
 API_DEFINE_HTTP_HANDLER(UsersRegister) {
   std::string user_name;
@@ -337,13 +402,29 @@ API_DEFINE_HTTP_HANDLER(UsersLogout) {
   API_RETURN_HTTP_RESP(200, "msg", "success");
 }
 
+/* Task counts of a task list as returned by TaskListsAll and TaskListsGet */
+static inline nlohmann::json StatsJson(const DBTaskListStats &stats) {
+  return {{"total", stats.total},
+          {"status",
+           {{"To Do", stats.status[0]},
+            {"Doing", stats.status[1]},
+            {"Done", stats.status[2]}}},
+          {"priority",
+           {{"none", stats.priority[0]},
+            {"1", stats.priority[1]},
+            {"2", stats.priority[2]},
+            {"3", stats.priority[3]}}},
+          {"overdue", stats.overdue}};
+}
+
 API_DEFINE_HTTP_HANDLER(TaskListsAll) {
   std::string token;
   std::string share;
   RequestData tasklist_req;
-  std::vector<std::string> out_names;
   std::vector<shareInfo> out_share_info;
+  std::map<std::string, DBTaskListStats> out_stats;
   nlohmann::json data;
+  nlohmann::json stats = nlohmann::json::object();
 
   API_CHECK_REQUEST_TOKEN(tasklist_req.user_key, token);
   API_GET_PARAM_OPTIONAL(share, share);
@@ -362,13 +443,17 @@ API_DEFINE_HTTP_HANDLER(TaskListsAll) {
                          {"list", info.task_list_name}};
                    });
   } else {
-    /* Get all task lists */
-    if (tasklists_worker->GetAllTasklist(tasklist_req, out_names) !=
+    /* Get all task lists, along with their task counts */
+    if (tasklists_worker->Stats(tasklist_req, out_stats) !=
         returnCode::SUCCESS) {
       API_RETURN_HTTP_RESP(500, "msg", "failed get all task lists");
     }
-    std::for_each(out_names.cbegin(), out_names.cend(),
-                  [&data](auto &name) { data.push_back(std::move(name)); });
+    for (const auto &it : out_stats) {
+      data.push_back(it.first);
+      stats[it.first] = StatsJson(it.second);
+    }
+    API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data),
+                         "stats", std::move(stats));
   }
 
   API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data));
@@ -378,20 +463,22 @@ API_DEFINE_HTTP_HANDLER(TaskListsGet) {
   std::string token;
   RequestData tasklist_req;
   TasklistContent tasklist_content;
+  DBTaskListStats out_stats;
   nlohmann::json data;
 
   API_CHECK_REQUEST_TOKEN(tasklist_req.user_key, token);
 
-  /* Get one certain task list */
+  /* Get one certain task list, with its task counts */
   API_GET_PARAM_OPTIONAL(tasklist_req.other_user_key, other);
   tasklist_req.tasklist_key = API_REQ().matches[1];
-  if (tasklists_worker->Query(tasklist_req, tasklist_content) !=
-      returnCode::SUCCESS) {
+  if (tasklists_worker->QueryWithStats(tasklist_req, tasklist_content,
+                                       out_stats) != returnCode::SUCCESS) {
     API_RETURN_HTTP_RESP(500, "msg", "failed get task list info");
   }
   data = {{"name", std::move(tasklist_content.name)},
           {"content", std::move(tasklist_content.content)},
-          {"visibility", std::move(tasklist_content.visibility)}};
+          {"visibility", std::move(tasklist_content.visibility)},
+          {"stats", StatsJson(out_stats)}};
   API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data));
 }
 
@@ -464,16 +551,60 @@ API_DEFINE_HTTP_HANDLER(TaskListsCreate) {
   API_RETURN_HTTP_RESP(200, "msg", "success", "name", out_tasklist_name);
 }
 
+API_DEFINE_HTTP_HANDLER(TaskListsClone) {
+  std::string token;
+  std::string name;
+  std::string out_tasklist_name;
+  std::vector<std::string> out_tasks;
+  RequestData tasklist_req;
+  nlohmann::json json_body;
+
+  API_CHECK_REQUEST_TOKEN(tasklist_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(tasklist_req.other_user_key, other);
+
+  tasklist_req.tasklist_key = API_REQ().matches[1];
+
+  /* {"name": ...}, the body may be left out to keep the source name */
+  json_body = API_PARSE_REQ_BODY(false);
+  API_GET_JSON_OPTIONAL(json_body, name, name);
+
+  returnCode ret =
+      tasklists_worker->Clone(tasklist_req, name, out_tasklist_name, out_tasks);
+  if (ret == returnCode::ERR_RFIELD) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed need a tasklist name");
+  } else if (ret != returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed clone tasklist");
+  }
+
+  API_RETURN_HTTP_RESP(200, "msg", "success", "name", out_tasklist_name,
+                       "tasks", out_tasks.size());
+}
+
 API_DEFINE_HTTP_HANDLER(TasksAll) {
   std::string token;
+  std::string archived;
   RequestData task_req;
   std::vector<std::string> out_names;
 
   API_CHECK_REQUEST_TOKEN(task_req.user_key, token);
   API_GET_PARAM_OPTIONAL(task_req.other_user_key, other);
+  API_GET_PARAM_OPTIONAL(archived, archived);
 
   task_req.tasklist_key = API_REQ().matches[1];
 
+  /* Get the archived tasks instead, the last archived first. */
+  if (archived == "true") {
+    std::vector<TaskContent> out_tasks;
+    if (tasks_worker->Archived(task_req, out_tasks) != returnCode::SUCCESS) {
+      API_RETURN_HTTP_RESP(500, "msg", "failed get archived tasks name");
+    }
+    nlohmann::json data = nlohmann::json::array();
+    for (const TaskContent &task : out_tasks) {
+      data.push_back(task.name);
+    }
+    API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data));
+  }
+
   /* Get all tasks. */
   if (tasks_worker->GetAllTasksName(task_req, out_names) !=
       returnCode::SUCCESS) {
@@ -487,12 +618,14 @@ API_DEFINE_HTTP_HANDLER(TasksAll) {
 
 API_DEFINE_HTTP_HANDLER(TasksGet) {
   std::string token;
+  std::string archived;
   RequestData task_req;
   TaskContent task_content;
   nlohmann::json data;
 
   API_CHECK_REQUEST_TOKEN(task_req.user_key, token);
   API_GET_PARAM_OPTIONAL(task_req.other_user_key, other);
+  API_GET_PARAM_OPTIONAL(archived, archived);
 
   task_req.tasklist_key = API_REQ().matches[1];
   task_req.task_key = API_REQ().matches[2];
@@ -501,8 +634,17 @@ API_DEFINE_HTTP_HANDLER(TasksGet) {
     API_RETURN_HTTP_RESP(400, "msg", "failed need tasklist name");
   }
 
-  /* Get one certain task. */
-  if (tasks_worker->Query(task_req, task_content) != returnCode::SUCCESS) {
+  if (archived == "true") {
+    /* Get the last archived task of that name. */
+    std::vector<TaskContent> out_tasks;
+    if (tasks_worker->Archived(task_req, out_tasks) != returnCode::SUCCESS ||
+        out_tasks.empty()) {
+      API_RETURN_HTTP_RESP(500, "msg", "failed get archived task info");
+    }
+    task_content = std::move(out_tasks.front());
+  } else if (tasks_worker->Query(task_req, task_content) !=
+             returnCode::SUCCESS) {
+    /* Get one certain task. */
     API_RETURN_HTTP_RESP(500, "msg", "failed get task info");
   }
   data = {{"name", std::move(task_content.name)},
@@ -511,7 +653,8 @@ API_DEFINE_HTTP_HANDLER(TasksGet) {
           {"start_date", std::move(task_content.startDate)},
           {"end_date", std::move(task_content.endDate)},
           {"priority", task_content.priority},
-          {"status", std::move(task_content.status)}};
+          {"status", std::move(task_content.status)},
+          {"recurrence", std::move(task_content.recurrence)}};
   API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data));
 }
 
@@ -545,6 +688,7 @@ API_DEFINE_HTTP_HANDLER(TasksUpdate) {
   API_GET_JSON_OPTIONAL(json_body, task_content.endDate, end_date);
   API_GET_JSON_OPTIONAL(json_body, task_content.priority, priority);
   API_GET_JSON_OPTIONAL(json_body, task_content.status, status);
+  API_GET_JSON_OPTIONAL(json_body, task_content.recurrence, recurrence);
 
   if (tasks_worker->Revise(task_req, task_content) != returnCode::SUCCESS) {
     API_RETURN_HTTP_RESP(500, "msg", "failed update task");
@@ -574,6 +718,185 @@ API_DEFINE_HTTP_HANDLER(TasksDelete) {
   API_RETURN_HTTP_RESP(200, "msg", "success");
 }
 
+API_DEFINE_HTTP_HANDLER(TasksMove) {
+  std::string token;
+  std::string out_task_name;
+  RequestData task_req;
+  RequestData target_req;
+  nlohmann::json json_body;
+
+  API_CHECK_REQUEST_TOKEN(task_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(task_req.other_user_key, other);
+
+  task_req.task_key = API_REQ().matches[2];
+  task_req.tasklist_key = API_REQ().matches[1];
+
+  /* {"list": ..., "other": ...}, other is the owner of the target list */
+  json_body = API_PARSE_REQ_BODY(true);
+  API_GET_JSON_REQUIRED(json_body, target_req.tasklist_key, list);
+  API_GET_JSON_OPTIONAL(json_body, target_req.other_user_key, other);
+
+  returnCode ret = tasks_worker->Move(task_req, target_req, out_task_name);
+  if (ret == returnCode::ERR_RFIELD) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed need tasklist names");
+  } else if (ret != returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed move task");
+  }
+
+  API_RETURN_HTTP_RESP(200, "msg", "success", "name", out_task_name);
+}
+
+API_DEFINE_HTTP_HANDLER(TasksReorder) {
+  std::string token;
+  std::string after;
+  std::string before;
+  std::string out_position;
+  RequestData task_req;
+  nlohmann::json json_body;
+
+  API_CHECK_REQUEST_TOKEN(task_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(task_req.other_user_key, other);
+
+  task_req.task_key = API_REQ().matches[2];
+  task_req.tasklist_key = API_REQ().matches[1];
+
+  /* {"after": ...} or {"before": ...}, the task to put it next to */
+  json_body = API_PARSE_REQ_BODY(true);
+  API_GET_JSON_OPTIONAL(json_body, after, after);
+  API_GET_JSON_OPTIONAL(json_body, before, before);
+  if (after.empty() == before.empty()) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed need one of after or before");
+  }
+
+  returnCode ret = tasks_worker->Reorder(
+      task_req, after.empty() ? before : after, !after.empty(), out_position);
+  if (ret == returnCode::ERR_RFIELD) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed need task names");
+  } else if (ret != returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed reorder task");
+  }
+
+  API_RETURN_HTTP_RESP(200, "msg", "success", "position", out_position);
+}
+
+API_DEFINE_HTTP_HANDLER(TasksComplete) {
+  std::string token;
+  std::string date;
+  std::string out_task_name;
+  RequestData task_req;
+  nlohmann::json json_body;
+
+  API_CHECK_REQUEST_TOKEN(task_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(task_req.other_user_key, other);
+
+  task_req.task_key = API_REQ().matches[2];
+  task_req.tasklist_key = API_REQ().matches[1];
+
+  /* {"date": ...}, the day of the occurrence */
+  json_body = API_PARSE_REQ_BODY(true);
+  API_GET_JSON_REQUIRED(json_body, date, date);
+
+  returnCode ret = tasks_worker->Complete(task_req, date, out_task_name);
+  if (ret == returnCode::ERR_RFIELD) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed need task names and a date");
+  } else if (ret == returnCode::ERR_FORMAT) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed task does not repeat that day");
+  } else if (ret != returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed complete task");
+  }
+
+  API_RETURN_HTTP_RESP(200, "msg", "success", "name", out_task_name);
+}
+
+API_DEFINE_HTTP_HANDLER(TasksDependsOnAdd) {
+  std::string token;
+  std::string on;
+  RequestData task_req;
+  nlohmann::json json_body;
+
+  API_CHECK_REQUEST_TOKEN(task_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(task_req.other_user_key, other);
+
+  task_req.task_key = API_REQ().matches[2];
+  task_req.tasklist_key = API_REQ().matches[1];
+
+  /* {"task": ...}, the task of the same list it depends on */
+  json_body = API_PARSE_REQ_BODY(true);
+  API_GET_JSON_REQUIRED(json_body, on, task);
+
+  returnCode ret = tasks_worker->AddDependency(task_req, on);
+  if (ret == returnCode::ERR_RFIELD) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed need task names");
+  } else if (ret == returnCode::ERR_FORMAT) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed dependency would form a cycle");
+  } else if (ret != returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed add dependency");
+  }
+
+  API_RETURN_HTTP_RESP(200, "msg", "success");
+}
+
+API_DEFINE_HTTP_HANDLER(TasksDependsOnDelete) {
+  std::string token;
+  std::string on;
+  RequestData task_req;
+  nlohmann::json json_body;
+
+  API_CHECK_REQUEST_TOKEN(task_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(task_req.other_user_key, other);
+
+  task_req.task_key = API_REQ().matches[2];
+  task_req.tasklist_key = API_REQ().matches[1];
+
+  /* {"task": ...}, the task of the same list it depends on */
+  json_body = API_PARSE_REQ_BODY(true);
+  API_GET_JSON_REQUIRED(json_body, on, task);
+
+  returnCode ret = tasks_worker->RemoveDependency(task_req, on);
+  if (ret == returnCode::ERR_RFIELD) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed need task names");
+  } else if (ret != returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed remove dependency");
+  }
+
+  API_RETURN_HTTP_RESP(200, "msg", "success");
+}
+
+API_DEFINE_HTTP_HANDLER(OrderGet) {
+  std::string token;
+  std::vector<std::string> out_names;
+  RequestData task_req;
+
+  API_CHECK_REQUEST_TOKEN(task_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(task_req.other_user_key, other);
+
+  task_req.tasklist_key = API_REQ().matches[1];
+
+  if (tasks_worker->Order(task_req, out_names) != returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed get task order");
+  }
+  API_RETURN_HTTP_RESP(200, "msg", "success", "tasks", out_names);
+}
+
+API_DEFINE_HTTP_HANDLER(CriticalPathGet) {
+  std::string token;
+  std::vector<std::string> out_names;
+  long out_days = 0;
+  RequestData task_req;
+
+  API_CHECK_REQUEST_TOKEN(task_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(task_req.other_user_key, other);
+
+  task_req.tasklist_key = API_REQ().matches[1];
+
+  if (tasks_worker->CriticalPath(task_req, out_names, out_days) !=
+      returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed get critical path");
+  }
+  API_RETURN_HTTP_RESP(200, "msg", "success", "tasks", out_names, "days",
+                       out_days);
+}
+
 API_DEFINE_HTTP_HANDLER(TasksCreate) {
   std::string token;
   std::string out_task_name;
@@ -595,6 +918,7 @@ API_DEFINE_HTTP_HANDLER(TasksCreate) {
   API_GET_JSON_OPTIONAL(json_body, task_content.endDate, end_date);
   API_GET_JSON_OPTIONAL(json_body, task_content.priority, priority);
   API_GET_JSON_OPTIONAL(json_body, task_content.status, status);
+  API_GET_JSON_OPTIONAL(json_body, task_content.recurrence, recurrence);
 
   if (tasks_worker->Create(task_req, task_content, out_task_name) !=
       returnCode::SUCCESS) {
@@ -604,6 +928,387 @@ API_DEFINE_HTTP_HANDLER(TasksCreate) {
   API_RETURN_HTTP_RESP(200, "msg", "success", "name", out_task_name);
 }
 
+/* Tasks read by one multi_get request at most */
+static const size_t kMultiGetMaxTasks = 1000;
+
+API_DEFINE_HTTP_HANDLER(TasksMultiGet) {
+  std::string token;
+  std::string user_email;
+  nlohmann::json json_body;
+  std::vector<RequestData> task_reqs;
+  std::vector<returnCode> results;
+  std::vector<TaskContent> task_contents;
+  nlohmann::json data = nlohmann::json::array();
+
+  API_CHECK_REQUEST_TOKEN(user_email, token);
+
+  json_body = API_PARSE_REQ_BODY(true);
+  if (!json_body.is_object() || !json_body.contains("tasks") ||
+      !json_body.at("tasks").is_array()) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed need an array of tasks");
+  }
+  if (json_body.at("tasks").size() > kMultiGetMaxTasks) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed too many tasks");
+  }
+
+  /* {"list": ..., "task": ..., "other": ...}, other is optional */
+  for (const auto &key : json_body.at("tasks")) {
+    RequestData task_req;
+    task_req.user_key = user_email;
+    if (key.is_object()) {
+      for (const char *field : {"list", "task", "other"}) {
+        if (key.contains(field) && !key.at(field).is_string()) {
+          API_RETURN_HTTP_RESP(400, "msg", "failed task keys are strings");
+        }
+      }
+      task_req.tasklist_key = key.value("list", "");
+      task_req.task_key = key.value("task", "");
+      task_req.other_user_key = key.value("other", "");
+    }
+    task_reqs.push_back(std::move(task_req));
+  }
+  if (task_reqs.empty()) {
+    API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data));
+  }
+
+  /* Get all the tasks in one go, answers in the order of the request. */
+  if (tasks_worker->QueryMany(task_reqs, results, task_contents) !=
+      returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed get tasks info");
+  }
+  for (size_t i = 0; i < task_reqs.size(); i++) {
+    TaskContent &task_content = task_contents[i];
+    if (results[i] != returnCode::SUCCESS) {
+      data.push_back({{"list", std::move(task_reqs[i].tasklist_key)},
+                      {"task", std::move(task_reqs[i].task_key)},
+                      {"msg", results[i] == returnCode::ERR_ACCESS
+                                  ? "failed no access"
+                                  : "failed get task info"}});
+      continue;
+    }
+    data.push_back({{"list", std::move(task_reqs[i].tasklist_key)},
+                    {"task", std::move(task_reqs[i].task_key)},
+                    {"msg", "success"},
+                    {"name", std::move(task_content.name)},
+                    {"content", std::move(task_content.content)},
+                    {"date", std::move(task_content.date)},
+                    {"start_date", std::move(task_content.startDate)},
+                    {"end_date", std::move(task_content.endDate)},
+                    {"priority", task_content.priority},
+                    {"status", std::move(task_content.status)},
+                    {"recurrence", std::move(task_content.recurrence)}});
+  }
+  API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data));
+}
+
+/* A non negative integer query parameter, no larger than max */
+static inline bool ParseCount(const std::string &str, size_t max,
+                              size_t &out) {
+  if (str.empty() || str.size() > 9 ||
+      str.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  out = std::stoul(str);
+  return out <= max;
+}
+
+/* A change version query parameter */
+static inline bool ParseVersion(const std::string &str, long long &out) {
+  if (str.empty() || str.size() > 18 ||
+      str.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  out = std::stoll(str);
+  return true;
+}
+
+/* Tasks per agenda page, by default and at most */
+static const size_t kAgendaDefaultLimit = 100;
+static const size_t kAgendaMaxLimit = 500;
+
+API_DEFINE_HTTP_HANDLER(AgendaGet) {
+  std::string token;
+  RequestData agenda_req;
+  std::string from;
+  std::string to;
+  std::string limit_str;
+  std::string cursor;
+  size_t limit = kAgendaDefaultLimit;
+  std::vector<std::pair<RequestData, TaskContent>> tasks;
+  nlohmann::json data = nlohmann::json::array();
+
+  API_CHECK_REQUEST_TOKEN(agenda_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(from, from);
+  API_GET_PARAM_OPTIONAL(to, to);
+  API_GET_PARAM_OPTIONAL(limit_str, limit);
+  API_GET_PARAM_OPTIONAL(cursor, cursor);
+
+  if (!limit_str.empty() &&
+      (!ParseCount(limit_str, kAgendaMaxLimit, limit) || limit == 0)) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed limit must be 1 to 500");
+  }
+
+  returnCode ret =
+      tasks_worker->Agenda(agenda_req, from, to, limit, cursor, tasks);
+  if (ret == returnCode::ERR_RFIELD) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed need from and to dates");
+  } else if (ret == returnCode::ERR_FORMAT) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed bad dates or cursor");
+  } else if (ret != returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed get agenda");
+  }
+
+  for (auto &task : tasks) {
+    TaskContent &task_content = task.second;
+    data.push_back({{"list", std::move(task.first.tasklist_key)},
+                    {"other", std::move(task.first.other_user_key)},
+                    {"name", std::move(task_content.name)},
+                    {"content", std::move(task_content.content)},
+                    {"date", std::move(task_content.date)},
+                    {"start_date", std::move(task_content.startDate)},
+                    {"end_date", std::move(task_content.endDate)},
+                    {"priority", task_content.priority},
+                    {"status", std::move(task_content.status)},
+                    {"recurrence", std::move(task_content.recurrence)}});
+  }
+  API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data),
+                       "cursor", std::move(cursor));
+}
+
+/* Tasks per board column, by default and at most */
+static const size_t kBoardDefaultLimit = 20;
+static const size_t kBoardMaxLimit = 200;
+
+API_DEFINE_HTTP_HANDLER(BoardGet) {
+  std::string token;
+  RequestData board_req;
+  std::string status;
+  std::string offset_str;
+  std::string limit_str;
+  size_t offset = 0;
+  size_t limit = kBoardDefaultLimit;
+  std::vector<BoardColumn> columns;
+  nlohmann::json data = nlohmann::json::array();
+
+  API_CHECK_REQUEST_TOKEN(board_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(board_req.other_user_key, other);
+  API_GET_PARAM_OPTIONAL(status, status);
+  API_GET_PARAM_OPTIONAL(offset_str, offset);
+  API_GET_PARAM_OPTIONAL(limit_str, limit);
+
+  board_req.tasklist_key = API_REQ().matches[1];
+
+  if (!offset_str.empty() && !ParseCount(offset_str, 1000000000, offset)) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed bad offset");
+  }
+  if (!limit_str.empty() &&
+      (!ParseCount(limit_str, kBoardMaxLimit, limit) || limit == 0)) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed limit must be 1 to 200");
+  }
+
+  /* Columns To Do, Doing and Done, a page of each. */
+  returnCode ret =
+      tasks_worker->Board(board_req, status, offset, limit, columns);
+  if (ret == returnCode::ERR_FORMAT) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed unknown status");
+  } else if (ret != returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed get board");
+  }
+
+  for (BoardColumn &column : columns) {
+    nlohmann::json tasks = nlohmann::json::array();
+    for (TaskContent &task_content : column.tasks) {
+      tasks.push_back({{"name", std::move(task_content.name)},
+                       {"content", std::move(task_content.content)},
+                       {"date", std::move(task_content.date)},
+                       {"start_date", std::move(task_content.startDate)},
+                       {"end_date", std::move(task_content.endDate)},
+                       {"priority", task_content.priority},
+                       {"status", std::move(task_content.status)},
+                       {"recurrence", std::move(task_content.recurrence)}});
+    }
+    data.push_back({{"status", std::move(column.status)},
+                    {"total", column.total},
+                    {"tasks", std::move(tasks)}});
+  }
+  API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data));
+}
+
+/* Revisions per history page, by default and at most */
+static const size_t kHistoryDefaultLimit = 50;
+static const size_t kHistoryMaxLimit = 500;
+
+/* The fields of a revision, named as in the task */
+static nlohmann::json
+RevisionFields(std::map<std::string, std::string> &fields) {
+  nlohmann::json out = nlohmann::json::object();
+  for (auto &field : fields) {
+    if (field.first == "due") {
+      // the end date in another form
+      continue;
+    } else if (field.first == "startDate") {
+      out["start_date"] = std::move(field.second);
+    } else if (field.first == "endDate") {
+      out["end_date"] = std::move(field.second);
+    } else if (field.first == "priority") {
+      out["priority"] = field.second.empty()
+                            ? (int)NULL_PRIORITY
+                            : std::atoi(field.second.c_str());
+    } else {
+      out[field.first] = std::move(field.second);
+    }
+  }
+  return out;
+}
+
+API_DEFINE_HTTP_HANDLER(TasksHistoryGet) {
+  std::string token;
+  RequestData task_req;
+  std::string version_str;
+  std::string cursor;
+  std::string limit_str;
+  long long before = 0;
+  size_t limit = kHistoryDefaultLimit;
+  std::vector<DBTaskRevision> revisions;
+  nlohmann::json data = nlohmann::json::array();
+
+  API_CHECK_REQUEST_TOKEN(task_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(task_req.other_user_key, other);
+  API_GET_PARAM_OPTIONAL(version_str, version);
+  API_GET_PARAM_OPTIONAL(cursor, cursor);
+  API_GET_PARAM_OPTIONAL(limit_str, limit);
+
+  task_req.tasklist_key = API_REQ().matches[1];
+  task_req.task_key = API_REQ().matches[2];
+
+  /* The task as it was at a version. */
+  if (!version_str.empty()) {
+    long long version = 0;
+    TaskContent task_content;
+    if (!ParseVersion(version_str, version)) {
+      API_RETURN_HTTP_RESP(400, "msg", "failed version must be a version");
+    }
+    if (tasks_worker->AtVersion(task_req, version, task_content) !=
+        returnCode::SUCCESS) {
+      API_RETURN_HTTP_RESP(500, "msg", "failed get task at version");
+    }
+    data = {{"name", std::move(task_content.name)},
+            {"content", std::move(task_content.content)},
+            {"date", std::move(task_content.date)},
+            {"start_date", std::move(task_content.startDate)},
+            {"end_date", std::move(task_content.endDate)},
+            {"priority", task_content.priority},
+            {"status", std::move(task_content.status)},
+            {"recurrence", std::move(task_content.recurrence)}};
+    API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data));
+  }
+
+  if (!cursor.empty() && (!ParseVersion(cursor, before) || before == 0)) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed bad cursor");
+  }
+  if (!limit_str.empty() &&
+      (!ParseCount(limit_str, kHistoryMaxLimit, limit) || limit == 0)) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed limit must be 1 to 500");
+  }
+
+  /* The revisions of the task, the last first, a page at a time. */
+  if (tasks_worker->History(task_req, before, limit, revisions) !=
+      returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed get task history");
+  }
+  for (DBTaskRevision &revision : revisions) {
+    data.push_back({{"version", revision.version},
+                    {"before", RevisionFields(revision.before)},
+                    {"after", RevisionFields(revision.after)}});
+  }
+  cursor = revisions.size() == limit
+               ? std::to_string(revisions.back().version)
+               : "";
+  API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data),
+                       "cursor", std::move(cursor));
+}
+
+static const size_t kSearchDefaultLimit = 20;
+static const size_t kSearchMaxLimit = 100;
+
+API_DEFINE_HTTP_HANDLER(SearchGet) {
+  std::string token;
+  RequestData search_req;
+  std::string query;
+  std::string k_str;
+  size_t k = kSearchDefaultLimit;
+  std::vector<std::pair<RequestData, double>> hits;
+  nlohmann::json data = nlohmann::json::array();
+
+  API_CHECK_REQUEST_TOKEN(search_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(query, q);
+  API_GET_PARAM_OPTIONAL(k_str, k);
+
+  if (!k_str.empty() && (!ParseCount(k_str, kSearchMaxLimit, k) || k == 0)) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed k must be 1 to 100");
+  }
+
+  returnCode ret = tasks_worker->Search(search_req, query, k, hits);
+  if (ret == returnCode::ERR_RFIELD) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed need words to search for");
+  } else if (ret != returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed search");
+  }
+
+  for (auto &hit : hits) {
+    data.push_back({{"list", std::move(hit.first.tasklist_key)},
+                    {"other", std::move(hit.first.other_user_key)},
+                    {"task", std::move(hit.first.task_key)},
+                    {"score", hit.second}});
+  }
+  API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data));
+}
+
+static const size_t kAutocompleteDefaultLimit = 10;
+
+API_DEFINE_HTTP_HANDLER(AutocompleteGet) {
+  std::string token;
+  RequestData names_req;
+  std::string prefix;
+  std::string kind;
+  std::string k_str;
+  size_t k = kAutocompleteDefaultLimit;
+  int kinds = NameTrie::ALL;
+  std::vector<RequestData> names;
+  nlohmann::json data = nlohmann::json::array();
+
+  API_CHECK_REQUEST_TOKEN(names_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(prefix, prefix);
+  API_GET_PARAM_OPTIONAL(kind, kind);
+  API_GET_PARAM_OPTIONAL(k_str, k);
+
+  if (!k_str.empty() && (!ParseCount(k_str, kSearchMaxLimit, k) || k == 0)) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed k must be 1 to 100");
+  }
+  if (kind == "list") {
+    kinds = NameTrie::LISTS;
+  } else if (kind == "task") {
+    kinds = NameTrie::TASKS;
+  } else if (!kind.empty()) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed kind must be list or task");
+  }
+
+  returnCode ret =
+      tasklists_worker->Autocomplete(names_req, prefix, kinds, k, names);
+  if (ret == returnCode::ERR_RFIELD) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed need a prefix");
+  } else if (ret != returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed autocomplete");
+  }
+
+  for (auto &name : names) {
+    data.push_back({{"list", std::move(name.tasklist_key)},
+                    {"other", std::move(name.other_user_key)},
+                    {"task", std::move(name.task_key)}});
+  }
+  API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data));
+}
+
 API_DEFINE_HTTP_HANDLER(ShareGet) {
   std::string token;
   RequestData share_info_req;
@@ -733,6 +1438,149 @@ API_DEFINE_HTTP_HANDLER(PublicGet) {
   API_RETURN_HTTP_RESP(200, "msg", "success", "data", std::move(data));
 }
 
+API_DEFINE_HTTP_HANDLER(SyncGet) {
+  std::string token;
+  std::string since_str;
+  long long since = 0;
+  long long version = 0;
+  RequestData sync_req;
+  std::vector<DBChange> changes;
+  nlohmann::json lists = nlohmann::json::array();
+  nlohmann::json tasks = nlohmann::json::array();
+  nlohmann::json deleted = nlohmann::json::array();
+
+  API_CHECK_REQUEST_TOKEN(sync_req.user_key, token);
+  API_GET_PARAM_OPTIONAL(since_str, since);
+
+  if (!since_str.empty() && !ParseVersion(since_str, since)) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed since must be a version");
+  }
+
+  if (tasklists_worker->Sync(sync_req, since, version, changes) !=
+      returnCode::SUCCESS) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed sync");
+  }
+
+  for (DBChange &change : changes) {
+    auto &info = change.info;
+    if (change.deleted) {
+      deleted.push_back({{"list", std::move(change.list)},
+                         {"task", std::move(change.task)},
+                         {"version", change.version}});
+    } else if (change.task.empty()) {
+      lists.push_back({{"name", std::move(change.list)},
+                       {"content", std::move(info["content"])},
+                       {"visibility", std::move(info["visibility"])},
+                       {"version", change.version}});
+    } else {
+      tasks.push_back(
+          {{"list", std::move(change.list)},
+           {"name", std::move(change.task)},
+           {"content", std::move(info["content"])},
+           {"date", std::move(info["date"])},
+           {"start_date", std::move(info["startDate"])},
+           {"end_date", std::move(info["endDate"])},
+           {"priority", info["priority"].empty()
+                            ? (int)NULL_PRIORITY
+                            : std::atoi(info["priority"].c_str())},
+           {"status", std::move(info["status"])},
+           {"recurrence", std::move(info["recurrence"])},
+           {"version", change.version}});
+    }
+  }
+
+  API_RETURN_HTTP_RESP(200, "msg", "success", "version", version, "lists",
+                       std::move(lists), "tasks", std::move(tasks),
+                       "deleted", std::move(deleted));
+}
+
+API_DEFINE_HTTP_HANDLER(ExportGet) {
+  std::string token;
+  RequestData export_req;
+
+  API_CHECK_REQUEST_TOKEN(export_req.user_key, token);
+
+  // The export runs while the response is written, one line per node, so
+  // neither side holds the whole data set. Once the first line is out the
+  // status cannot change anymore, a failure is reported as a last line.
+  API_RES().status = 200;
+  API_RES().set_header("Access-Control-Allow-Origin", "*");
+  API_RES().set_chunked_content_provider(
+      "application/x-ndjson",
+      [worker = tasklists_worker, export_req](size_t, httplib::DataSink &sink) {
+        bool writable = true;
+        auto write_line = [&sink, &writable](const nlohmann::json &line) {
+          const std::string out = line.dump() + "\n";
+          writable = writable && sink.write(out.data(), out.size());
+          return writable;
+        };
+        returnCode ret = worker->Export(
+            export_req,
+            [&write_line](const std::string &list, const std::string &task,
+                          const std::map<std::string, std::string> &info) {
+              if (list.empty()) {
+                return write_line({{"type", "user"}, {"data", info}});
+              }
+              if (task.empty()) {
+                return write_line({{"type", "list"}, {"data", info}});
+              }
+              return write_line(
+                  {{"type", "task"}, {"list", list}, {"data", info}});
+            },
+            [&write_line](const std::string &list, const std::string &to,
+                          bool read_write) {
+              return write_line({{"type", "grant"},
+                                 {"list", list},
+                                 {"to", to},
+                                 {"read_write", read_write}});
+            });
+        if (ret != returnCode::SUCCESS) {
+          write_line({{"type", "error"}, {"msg", "failed export"}});
+        }
+        if (writable) {
+          sink.done();
+        }
+        return writable;
+      });
+}
+
+API_DEFINE_HTTP_HANDLER(ImportPost) {
+  std::string token;
+  std::string user_email;
+  ImportStats stats;
+
+  API_CHECK_REQUEST_TOKEN(user_email, token);
+
+  // Same format as the export, everything is imported for the caller
+  std::istringstream body(API_REQ().body);
+  Importer importer(db, import_batch_size, import_writers);
+  importer.SetOwner(user_email);
+  std::shared_ptr<ReminderScheduler> reminders = tasks_worker->Reminders();
+  importer.SetOnTask([reminders](const DBImportRecord &task) {
+    auto name = task.info.find("name");
+    if (name != task.info.end()) {
+      reminders->Update(task.user, task.list, name->second, task.info);
+    }
+  });
+  const int code = importer.Run(body, stats) == returnCode::SUCCESS ? 200 : 500;
+  API_RETURN_HTTP_RESP(code, "msg", code == 200 ? "success" : "failed import",
+                       "lines", stats.lines, "created", stats.created,
+                       "duplicates", stats.duplicates, "failed", stats.failed,
+                       "skipped", stats.skipped, "errors",
+                       std::move(stats.errors));
+}
+
+API_DEFINE_HTTP_HANDLER(HealthLive) {
+  API_RETURN_HTTP_RESP(200, "msg", "success");
+}
+
+API_DEFINE_HTTP_HANDLER(HealthReady) {
+  if (!ready) {
+    API_RETURN_HTTP_RESP(503, "msg", "failed not ready");
+  }
+  API_RETURN_HTTP_RESP(200, "msg", "success");
+}
+
 API_DEFINE_HTTP_HANDLER(Health) {
   try {
     std::string numbers = API_REQ().matches[1];
@@ -742,6 +1590,63 @@ API_DEFINE_HTTP_HANDLER(Health) {
   }
 }
 
+static inline int DebugSeconds(const httplib::Request &req) {
+  try {
+    int seconds = std::stoi(req.get_param_value("seconds"));
+    return (seconds >= 1 && seconds <= 60) ? seconds : 0;
+  } catch (...) {
+    return req.has_param("seconds") ? 0 : 1;
+  }
+}
+
+API_DEFINE_HTTP_HANDLER(DebugTrace) {
+  const int seconds = DebugSeconds(API_REQ());
+  if (!seconds) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed seconds should be in [1, 60]");
+  }
+
+  bool idle = false;
+  if (!tracing.compare_exchange_strong(idle, true)) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed trace in progress");
+  }
+  const uint64_t since_us = Trace::NowUs();
+  Trace::Enable(true);
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+  Trace::Enable(false);
+  tracing = false;
+
+  // chrome trace event format, "X" is a complete event
+  nlohmann::json events = nlohmann::json::array();
+  for (const Trace::Event &event : Trace::Collect(since_us)) {
+    events.push_back({{"name", std::string(event.cat) + "::" + event.name},
+                      {"cat", event.cat},
+                      {"ph", "X"},
+                      {"ts", event.start_us},
+                      {"dur", event.dur_us},
+                      {"pid", 1},
+                      {"tid", event.tid}});
+  }
+  API_RETURN_HTTP_RESP(200, "msg", "success", "traceEvents", std::move(events),
+                       "displayTimeUnit", "ms");
+}
+
+API_DEFINE_HTTP_HANDLER(DebugProfile) {
+  const int seconds = DebugSeconds(API_REQ());
+  if (!seconds) {
+    API_RETURN_HTTP_RESP(400, "msg", "failed seconds should be in [1, 60]");
+  }
+
+  if (!Profiler::Start()) {
+    API_RETURN_HTTP_RESP(500, "msg", "failed profile in progress");
+  }
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+
+  // collapsed stacks go out as they are, for flamegraph.pl
+  API_RES().status = 200;
+  API_RES().set_header("Access-Control-Allow-Origin", "*");
+  API_RES().set_content(Profiler::Stop(), "text/plain");
+}
+
 void Api::Run(const std::string &host, uint32_t port) {
   API_ADD_HTTP_HANDLER(svr, "/v1/users/register", Post, UsersRegister);
   API_ADD_HTTP_HANDLER(svr, "/v1/users/login", Post, UsersLogin);
@@ -752,6 +1657,8 @@ void Api::Run(const std::string &host, uint32_t port) {
   API_ADD_HTTP_HANDLER(svr, R"(/v1/task_lists/([^\/]+))", Put, TaskListsUpdate);
   API_ADD_HTTP_HANDLER(svr, R"(/v1/task_lists/([^\/]+))", Delete,
                        TaskListsDelete);
+  API_ADD_HTTP_HANDLER(svr, R"(/v1/task_lists/([^\/]+)/clone)", Post,
+                       TaskListsClone);
   API_ADD_HTTP_HANDLER(svr, R"(/v1/task_lists/([^\/]+)/tasks)", Get, TasksAll);
   API_ADD_HTTP_HANDLER(svr, R"(/v1/task_lists/([^\/]+)/tasks/([^\/]+))", Get,
                        TasksGet);
@@ -761,17 +1668,61 @@ void Api::Run(const std::string &host, uint32_t port) {
                        TasksUpdate);
   API_ADD_HTTP_HANDLER(svr, R"(/v1/task_lists/([^\/]+)/tasks/([^\/]+))", Delete,
                        TasksDelete);
+  API_ADD_HTTP_HANDLER(svr, R"(/v1/task_lists/([^\/]+)/tasks/([^\/]+)/move)",
+                       Post, TasksMove);
+  API_ADD_HTTP_HANDLER(svr, R"(/v1/task_lists/([^\/]+)/tasks/([^\/]+)/reorder)",
+                       Post, TasksReorder);
+  API_ADD_HTTP_HANDLER(svr,
+                       R"(/v1/task_lists/([^\/]+)/tasks/([^\/]+)/complete)",
+                       Post, TasksComplete);
+  API_ADD_HTTP_HANDLER(svr,
+                       R"(/v1/task_lists/([^\/]+)/tasks/([^\/]+)/depends_on)",
+                       Post, TasksDependsOnAdd);
+  API_ADD_HTTP_HANDLER(svr,
+                       R"(/v1/task_lists/([^\/]+)/tasks/([^\/]+)/depends_on)",
+                       Delete, TasksDependsOnDelete);
+  API_ADD_HTTP_HANDLER(svr,
+                       R"(/v1/task_lists/([^\/]+)/tasks/([^\/]+)/history)",
+                       Get, TasksHistoryGet);
+  API_ADD_HTTP_HANDLER(svr, R"(/v1/task_lists/([^\/]+)/order)", Get, OrderGet);
+  API_ADD_HTTP_HANDLER(svr, R"(/v1/task_lists/([^\/]+)/critical_path)", Get,
+                       CriticalPathGet);
+  API_ADD_HTTP_HANDLER(svr, "/v1/tasks/multi_get", Post, TasksMultiGet);
+  API_ADD_HTTP_HANDLER(svr, R"(/v1/task_lists/([^\/]+)/board)", Get, BoardGet);
+  API_ADD_HTTP_HANDLER(svr, "/v1/agenda", Get, AgendaGet);
+  API_ADD_HTTP_HANDLER(svr, "/v1/search", Get, SearchGet);
+  API_ADD_HTTP_HANDLER(svr, "/v1/autocomplete", Get, AutocompleteGet);
   API_ADD_HTTP_HANDLER(svr, R"(/v1/share/([^\/]+))", Get, ShareGet);
   API_ADD_HTTP_HANDLER(svr, R"(/v1/share/([^\/]+))", Post, ShareCreate);
   API_ADD_HTTP_HANDLER(svr, R"(/v1/share/([^\/]+))", Delete, ShareDelete);
   API_ADD_HTTP_HANDLER(svr, "/v1/public/all", Get, PublicGet);
+  API_ADD_HTTP_HANDLER(svr, "/v1/sync", Get, SyncGet);
+  API_ADD_HTTP_HANDLER(svr, "/v1/export", Get, ExportGet);
+  API_ADD_HTTP_HANDLER(svr, "/v1/import", Post, ImportPost);
   API_ADD_HTTP_HANDLER(svr, R"(/health/(\d+))", Get, Health);
+  API_ADD_HTTP_HANDLER(svr, "/health/live", Get, HealthLive);
+  API_ADD_HTTP_HANDLER(svr, "/health/ready", Get, HealthReady);
+  if (debug) {
+    API_ADD_HTTP_HANDLER(svr, "/debug/trace", Get, DebugTrace);
+    API_ADD_HTTP_HANDLER(svr, "/debug/profile", Get, DebugProfile);
+  }
 
   API_ADD_HTTP_OPTIONS_HANDLER(svr, R"(/.*)");
+
+  // listen right away, startup tasks finish in the background
+  if (!startup_tasks.empty() && !startup_thread.joinable()) {
+    ready = false;
+    startup_thread = std::thread(&Api::RunStartupTasks, this);
+  }
   svr->listen(host, port);
 }
 
 void Api::Stop() {
+  {
+    std::lock_guard<std::mutex> guard(startup_lock);
+    stopping = true;
+  }
+  startup_cv.notify_all();
   if (svr && svr->is_running()) {
     svr->stop();
   }
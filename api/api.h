@@ -19,10 +19,15 @@
 #include "tasklists/tasklistsWorker.h"
 #include "tasks/tasksWorker.h"
 #include "users/users.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <httplib.h>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <unordered_set>
+#include <vector>
 
 /* Declare a function that would be called to handle an http request of a
    certain route. The function name should be corresponding to the http
@@ -62,8 +67,38 @@ public:
 
   virtual void Stop();
 
+  /**
+   * @brief Add a task to run in the background once Run starts listening,
+   * e.g. DB::Initialize. All tasks run concurrently and each is retried with
+   * backoff until it returns true; /health/ready and the /v1 routes answer 503
+   * until all of them have succeeded. Call it before Run.
+   *
+   * @param task Returns true on success, false or an exception to retry.
+   */
+  virtual void AddStartupTask(std::function<bool()> task);
+
   virtual void set_print(bool _print) { print = _print; }
 
+  /**
+   * @brief Report the number of neo4j queries and connections of each request
+   * in the X-Debug-DB-Queries and X-Debug-DB-Connections response headers,
+   * and serve the /debug endpoints. Call it before Run.
+   *
+   * @param _debug True to enable the debug headers.
+   */
+  virtual void set_debug(bool _debug) { debug = _debug; }
+
+  /**
+   * @brief Tune /v1/import, see Importer.
+   *
+   * @param batch_size records per statement
+   * @param writers threads writing batches concurrently
+   */
+  virtual void set_import(size_t batch_size, size_t writers) {
+    import_batch_size = batch_size;
+    import_writers = writers;
+  }
+
 protected:
   API_DECLARE_HTTP_HANDLER(UsersRegister);
 
@@ -81,8 +116,13 @@ protected:
 
   API_DECLARE_HTTP_HANDLER(TaskListsCreate);
 
+  /* A copy of a readable task list and its tasks, body {"name"}, at once */
+  API_DECLARE_HTTP_HANDLER(TaskListsClone);
+
+  /* Task names of a task list, ?archived=true for the archived ones */
   API_DECLARE_HTTP_HANDLER(TasksAll);
 
+  /* A task, ?archived=true for the last archived task of that name */
   API_DECLARE_HTTP_HANDLER(TasksGet);
 
   API_DECLARE_HTTP_HANDLER(TasksUpdate);
@@ -91,6 +131,45 @@ protected:
 
   API_DECLARE_HTTP_HANDLER(TasksCreate);
 
+  /* A task into another task list, body {"list", "other"}, in one statement */
+  API_DECLARE_HTTP_HANDLER(TasksMove);
+
+  /* A task next to another of its list, body {"after"} or {"before"} */
+  API_DECLARE_HTTP_HANDLER(TasksReorder);
+
+  /* One occurrence of a repeating task, body {"date"}, as a task of its own */
+  API_DECLARE_HTTP_HANDLER(TasksComplete);
+
+  /* A task depends on another of its list, body {"task"}, no cycles */
+  API_DECLARE_HTTP_HANDLER(TasksDependsOnAdd);
+
+  /* A task no longer depends on another of its list, body {"task"} */
+  API_DECLARE_HTTP_HANDLER(TasksDependsOnDelete);
+
+  /* Tasks of a task list, each after the ones it depends on */
+  API_DECLARE_HTTP_HANDLER(OrderGet);
+
+  /* Longest chain of dependent tasks of a task list, by their dates */
+  API_DECLARE_HTTP_HANDLER(CriticalPathGet);
+
+  /* Many tasks, of any task lists readable by the caller, in one request */
+  API_DECLARE_HTTP_HANDLER(TasksMultiGet);
+
+  /* Tasks due between ?from and ?to across readable lists, paginated */
+  API_DECLARE_HTTP_HANDLER(AgendaGet);
+
+  /* Tasks of a task list grouped by status, a page per column */
+  API_DECLARE_HTTP_HANDLER(BoardGet);
+
+  /* Revisions of a task, paginated, or ?version for the task at a version */
+  API_DECLARE_HTTP_HANDLER(TasksHistoryGet);
+
+  /* Readable tasks containing every word of ?q, the best ?k first */
+  API_DECLARE_HTTP_HANDLER(SearchGet);
+
+  /* Readable task list, or ?kind=list|task, names starting with ?prefix */
+  API_DECLARE_HTTP_HANDLER(AutocompleteGet);
+
   API_DECLARE_HTTP_HANDLER(ShareGet);
 
   API_DECLARE_HTTP_HANDLER(ShareCreate);
@@ -99,9 +178,30 @@ protected:
 
   API_DECLARE_HTTP_HANDLER(PublicGet);
 
+  /* Task lists and tasks changed since ?since=N, deletions as tombstones */
+  API_DECLARE_HTTP_HANDLER(SyncGet);
+
+  /* Everything the user owns as newline delimited json, streamed */
+  API_DECLARE_HTTP_HANDLER(ExportGet);
+
+  /* Load newline delimited json in the export format for the caller */
+  API_DECLARE_HTTP_HANDLER(ImportPost);
+
   API_DECLARE_HTTP_HANDLER(Health);
 
+  API_DECLARE_HTTP_HANDLER(HealthLive);
+
+  API_DECLARE_HTTP_HANDLER(HealthReady);
+
+  /* Record spans for ?seconds=N and return them as chrome trace events */
+  API_DECLARE_HTTP_HANDLER(DebugTrace);
+
+  /* Sample cpu stacks for ?seconds=N and return them as collapsed stacks */
+  API_DECLARE_HTTP_HANDLER(DebugProfile);
+
 private:
+  void RunStartupTasks();
+
   std::shared_ptr<Users> users;
   std::shared_ptr<TaskListsWorker> tasklists_worker;
   std::shared_ptr<TasksWorker> tasks_worker;
@@ -113,6 +213,17 @@ private:
       invalid_tokens; /* Not a good method, refactor it later */
   std::mutex invalid_tokens_lock;
   bool print = false;
+  bool debug = false;
+  std::atomic<bool> tracing{false};
+  size_t import_batch_size = 1000;
+  size_t import_writers = 4;
+
+  std::vector<std::function<bool()>> startup_tasks;
+  std::thread startup_thread;
+  std::atomic<bool> ready{true};
+  std::mutex startup_lock;
+  std::condition_variable startup_cv;
+  bool stopping = false; /* guarded by startup_lock */
 };
 
 #undef API_DECLARE_HTTP_HANDLER
@@ -1,9 +1,11 @@
 #pragma once
 
+#include "common/recurrence.h"
 #include "common/utils.h"
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 /*
  * @brief This is a structure that uses as either input/output for taskWorker
@@ -51,6 +53,11 @@ struct TaskContent {
    * @brief Task progress: To do, Doing or Done
    */
   std::string status;
+  /*
+   * @brief Recurrence rule, see Common::Recurrence, of a task repeating from
+   * its end date on
+   */
+  std::string recurrence;
 
   /* methods */
   /*
@@ -87,7 +94,7 @@ struct TaskContent {
    */
   bool IsEmpty() {
     return name == "" && content == "" && startDate == "" && endDate == "" &&
-           priority == NULL_PRIORITY && status == "";
+           priority == NULL_PRIORITY && status == "" && recurrence == "";
   }
 
   /*
@@ -100,6 +107,7 @@ struct TaskContent {
     endDate = "";
     priority = NULL_PRIORITY;
     status = "";
+    recurrence = "";
   }
 
   /**
@@ -164,7 +172,29 @@ struct TaskContent {
     if (!status.empty() && status != "To Do" && status != "Doing" &&
         status != "Done")
       return false;
+    // check recurrence format
+    Common::Recurrence rule;
+    if (!recurrence.empty() && !rule.Parse(recurrence))
+      return false;
     // pass all checks
     return true;
   }
 };
+
+/*
+ * @brief Tasks of one status of a task list, a column of its board
+ */
+struct BoardColumn {
+  /*
+   * @brief To Do, Doing or Done
+   */
+  std::string status;
+  /*
+   * @brief Number of tasks in the column, over all pages
+   */
+  long long total = 0;
+  /*
+   * @brief Tasks of the requested page
+   */
+  std::vector<TaskContent> tasks;
+};
@@ -39,3 +39,10 @@ if [ "$1" == "run" ]; then
     sleep 30
     cd build && (./lqxx > output.log &)
 fi
+
+if [ "$1" == "loadtest" ]; then
+    # Extra arguments are passed to the load generator, e.g.
+    # ./build.sh loadtest --mode=open --rate=500 --concurrency=32
+    rm -rf build && mkdir build && cd build && cmake .. -DLQXX_TESTS=ON && make loadgen
+    ./test/load-test/loadgen "${@:2}"
+fi
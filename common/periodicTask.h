@@ -0,0 +1,61 @@
+/**
+ * @file periodicTask.h
+ * @brief Background task running at a fixed interval for lqxx project.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Common {
+
+/**
+ * @brief Run a function on a thread of its own every interval, until the
+ * object is destroyed. The first run is one interval after construction.
+ *
+ */
+class PeriodicTask {
+public:
+  PeriodicTask(std::chrono::milliseconds _interval, std::function<void()> _task)
+      : interval(_interval), task(std::move(_task)),
+        thread([this]() { Loop(); }) {}
+
+  /* wakes the thread up and waits for a run in progress to finish */
+  ~PeriodicTask() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stopping = true;
+    }
+    cv.notify_all();
+    thread.join();
+  }
+
+  PeriodicTask(const PeriodicTask &) = delete;
+  PeriodicTask &operator=(const PeriodicTask &) = delete;
+
+private:
+  void Loop() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (!cv.wait_for(guard, interval, [this]() { return stopping; })) {
+      guard.unlock();
+      task();
+      guard.lock();
+    }
+  }
+
+  const std::chrono::milliseconds interval;
+  const std::function<void()> task;
+  std::mutex lock;
+  std::condition_variable cv;
+  bool stopping = false;
+  /* last, so that it starts after everything Loop uses */
+  std::thread thread;
+};
+
+} // namespace Common
@@ -0,0 +1,208 @@
+/**
+ * @file profiler.h
+ * @brief Sampling CPU profiler for lqxx project.
+ *
+ * While a profile is running, ITIMER_PROF delivers SIGPROF for every interval
+ * of CPU time the process consumes, and the handler stores the stack of the
+ * interrupted thread into a buffer allocated up front. Nothing is installed
+ * while no profile is running, so an idle profiler costs nothing. Stacks are
+ * symbolized after sampling stops and returned as collapsed stacks, one
+ * "root;caller;callee count" line per distinct stack, which flamegraph.pl and
+ * speedscope read directly. Link the executable with ENABLE_EXPORTS so that
+ * dladdr can name its own functions.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <sys/time.h>
+#include <thread>
+#include <unordered_map>
+
+namespace Profiler {
+
+/* frames kept per sample, deeper stacks are truncated at the root */
+static constexpr int kMaxDepth = 48;
+/* samples kept per profile, later samples are dropped */
+static constexpr uint32_t kMaxSamples = 1 << 15;
+/* the handler frame and the signal trampoline */
+static constexpr int kSkipFrames = 2;
+
+struct __Sample {
+  std::atomic<int> depth{0};
+  void *frames[kMaxDepth];
+};
+
+struct __State {
+  std::atomic<bool> busy{false}; /* one profile at a time */
+  std::unique_ptr<__Sample[]> samples;
+  std::atomic<uint32_t> next{0};
+  std::atomic<bool> sampling{false};
+  struct sigaction old_action;
+  int interval_us = 0;
+};
+
+inline __State &__GetState() {
+  static __State state;
+  return state;
+}
+
+/* Only async-signal-safe work: an atomic add and backtrace, which was warmed
+   up before the handler got installed */
+inline void __OnSigprof(int, siginfo_t *, void *) {
+  __State &state = __GetState();
+  if (!state.sampling.load(std::memory_order_relaxed))
+    return;
+  const int saved_errno = errno;
+  const uint32_t index = state.next.fetch_add(1, std::memory_order_relaxed);
+  if (index < kMaxSamples) {
+    __Sample &sample = state.samples[index];
+    const int depth = backtrace(sample.frames, kMaxDepth);
+    sample.depth.store(depth, std::memory_order_release);
+  }
+  errno = saved_errno;
+}
+
+inline std::string __Symbolize(void *address) {
+  Dl_info info;
+  if (dladdr(address, &info) == 0)
+    return "??";
+  if (info.dli_sname != nullptr) {
+    int status = 0;
+    char *demangled =
+        abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    std::string name = status == 0 ? demangled : info.dli_sname;
+    free(demangled);
+    return name;
+  }
+  // no exported symbol, name it by module and offset
+  std::string module = info.dli_fname ? info.dli_fname : "??";
+  module = module.substr(module.find_last_of('/') + 1);
+  char offset[32];
+  snprintf(offset, sizeof(offset), "+0x%lx",
+           (unsigned long)((char *)address - (char *)info.dli_fbase));
+  return module + offset;
+}
+
+/**
+ * @brief Whether a profile is running.
+ *
+ */
+inline bool Running() {
+  return __GetState().sampling.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Start sampling the stacks of all threads.
+ *
+ * @param hz samples per second of CPU time
+ * @return true if sampling started, false if a profile is already running or
+ * the timer cannot be set up
+ */
+inline bool Start(int hz = 99) {
+  __State &state = __GetState();
+  bool idle = false;
+  if (hz <= 0 || hz > 1000)
+    return false;
+  if (!state.busy.compare_exchange_strong(idle, true))
+    return false;
+
+  // the first backtrace loads libgcc, which must not happen in the handler
+  void *warm_up[kMaxDepth];
+  backtrace(warm_up, kMaxDepth);
+
+  state.samples.reset(new __Sample[kMaxSamples]);
+  state.next = 0;
+  state.interval_us = 1000000 / hz;
+
+  struct sigaction action = {};
+  action.sa_sigaction = __OnSigprof;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, &state.old_action) != 0) {
+    state.samples.reset();
+    state.busy = false;
+    return false;
+  }
+
+  state.sampling = true;
+  struct itimerval timer = {};
+  timer.it_interval.tv_sec = state.interval_us / 1000000;
+  timer.it_interval.tv_usec = state.interval_us % 1000000;
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    state.sampling = false;
+    sigaction(SIGPROF, &state.old_action, nullptr);
+    state.samples.reset();
+    state.busy = false;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Stop the running profile and uninstall the signal handler.
+ *
+ * @return std::string collapsed stacks, empty if no profile was running
+ */
+inline std::string Stop() {
+  __State &state = __GetState();
+  if (!state.sampling.load())
+    return {};
+
+  struct itimerval timer = {};
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  state.sampling = false;
+  // let signals that are already pending land on our handler, not on the
+  // default action which would terminate the process
+  std::this_thread::sleep_for(
+      std::chrono::microseconds(2 * state.interval_us));
+  sigaction(SIGPROF, &state.old_action, nullptr);
+
+  const uint32_t count = std::min(state.next.load(), kMaxSamples);
+  std::map<std::string, uint64_t> stacks;
+  std::unordered_map<void *, std::string> names;
+  for (uint32_t i = 0; i < count; i++) {
+    const __Sample &sample = state.samples[i];
+    const int depth = sample.depth.load(std::memory_order_acquire);
+    std::string stack;
+    // backtrace lists the innermost frame first, collapsed stacks root first
+    for (int frame = depth - 1; frame >= kSkipFrames; frame--) {
+      void *address = sample.frames[frame];
+      auto name = names.find(address);
+      if (name == names.end())
+        name = names.emplace(address, __Symbolize(address)).first;
+      if (!stack.empty())
+        stack += ';';
+      stack += name->second;
+    }
+    if (!stack.empty())
+      stacks[stack]++;
+  }
+
+  state.samples.reset();
+  state.busy = false;
+
+  std::string collapsed;
+  for (auto &stack : stacks) {
+    collapsed += stack.first + " " + std::to_string(stack.second) + "\n";
+  }
+  return collapsed;
+}
+
+} // namespace Profiler
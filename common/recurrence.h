@@ -0,0 +1,288 @@
+/**
+ * @file recurrence.h
+ * @brief Recurrence rules of repeating tasks for lqxx project.
+ *
+ * A repeating task is stored once, as a template whose due date is its first
+ * occurrence, and its occurrences are only computed for the window a client
+ * asks about.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace Common {
+
+/**
+ * @brief Days since 1970-01-01 of a civil date, proleptic Gregorian.
+ *
+ */
+inline long DaysFromCivil(long y, int m, int d) {
+  y -= m <= 2;
+  const long era = (y >= 0 ? y : y - 399) / 400;
+  const long yoe = y - era * 400;
+  const long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+/**
+ * @brief The civil date of a number of days since 1970-01-01.
+ *
+ */
+inline void CivilFromDays(long z, long &y, int &m, int &d) {
+  z += 719468;
+  const long era = (z >= 0 ? z : z - 146096) / 146097;
+  const long doe = z - era * 146097;
+  const long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const long mp = (5 * doy + 2) / 153;
+  d = (int)(doy - (153 * mp + 2) / 5 + 1);
+  m = (int)(mp < 10 ? mp + 3 : mp - 9);
+  y = yoe + era * 400 + (m <= 2);
+}
+
+inline int DaysInMonth(long y, int m) {
+  static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  const bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+  return m == 2 && leap ? 29 : days[m - 1];
+}
+
+/**
+ * @brief Days since 1970-01-01 of a date in the form DateKey returns.
+ *
+ * @return false if the string is not such a date
+ */
+inline bool DaysFromKey(const std::string &key, long &days) {
+  int y, m, d, n = 0;
+  if (key.size() != 10 ||
+      sscanf(key.c_str(), "%4d-%2d-%2d%n", &y, &m, &d, &n) != 3 || n != 10 ||
+      m < 1 || m > 12 || d < 1 || d > DaysInMonth(y, m))
+    return false;
+  days = DaysFromCivil(y, m, d);
+  return true;
+}
+
+/**
+ * @brief The date in the form DateKey returns of a number of days since
+ * 1970-01-01.
+ *
+ */
+inline std::string KeyFromDays(long days) {
+  long y;
+  int m, d;
+  CivilFromDays(days, y, m, d);
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%04ld-%02d-%02d", y, m, d);
+  return buf;
+}
+
+/**
+ * @brief A date in the form DateKey returns, in the form of TaskContent dates.
+ *
+ * @return "MM/DD/YYYY"
+ */
+inline std::string DateFromKey(const std::string &key) {
+  if (key.size() != 10)
+    return "";
+  return key.substr(5, 2) + "/" + key.substr(8, 2) + "/" + key.substr(0, 4);
+}
+
+/**
+ * @brief A recurrence rule: the subset of RFC 5545 RRULE made of FREQ
+ * (DAILY, WEEKLY, MONTHLY or YEARLY), INTERVAL, COUNT or UNTIL, and BYDAY
+ * with plain weekdays for weekly rules, e.g.
+ * "FREQ=WEEKLY;INTERVAL=2;BYDAY=MO,TH;UNTIL=20231231". Monthly and yearly
+ * rules repeat the day of the first occurrence and, as in RFC 5545, skip the
+ * months that do not have it.
+ *
+ */
+struct Recurrence {
+  enum Freq { DAILY, WEEKLY, MONTHLY, YEARLY };
+  Freq freq = DAILY;
+  long interval = 1;
+  /**
+   * @brief occurrences at most, 0 for no limit
+   *
+   */
+  long count = 0;
+  /**
+   * @brief last day as "YYYY-MM-DD", empty for no limit
+   *
+   */
+  std::string until;
+  /**
+   * @brief weekdays of a weekly rule, bit 0 for Monday, 0 for the weekday of
+   * the first occurrence
+   *
+   */
+  int byday = 0;
+
+  /**
+   * @brief Parse a rule, an optional "RRULE:" prefix is ignored.
+   *
+   * @return false if the rule is not in the supported subset
+   */
+  bool Parse(const std::string &rule) {
+    static const char *const weekdays[] = {"MO", "TU", "WE", "TH",
+                                           "FR", "SA", "SU"};
+    *this = Recurrence();
+    std::string text = rule;
+    if (text.compare(0, 6, "RRULE:") == 0)
+      text.erase(0, 6);
+    bool has_freq = false;
+    std::vector<std::string> seen;
+    size_t pos = 0;
+    while (pos <= text.size()) {
+      size_t end = text.find(';', pos);
+      if (end == std::string::npos)
+        end = text.size();
+      const std::string part = text.substr(pos, end - pos);
+      pos = end + 1;
+      const size_t eq = part.find('=');
+      if (eq == std::string::npos)
+        return false;
+      const std::string name = part.substr(0, eq);
+      const std::string value = part.substr(eq + 1);
+      if (std::find(seen.begin(), seen.end(), name) != seen.end())
+        return false;
+      seen.push_back(name);
+      if (name == "FREQ") {
+        static const char *const freqs[] = {"DAILY", "WEEKLY", "MONTHLY",
+                                            "YEARLY"};
+        auto it = std::find(std::begin(freqs), std::end(freqs), value);
+        if (it == std::end(freqs))
+          return false;
+        freq = (Freq)(it - std::begin(freqs));
+        has_freq = true;
+      } else if (name == "INTERVAL" || name == "COUNT") {
+        if (value.empty() || value.size() > 4 ||
+            value.find_first_not_of("0123456789") != std::string::npos)
+          return false;
+        const long number = std::stol(value);
+        if (number == 0)
+          return false;
+        (name == "INTERVAL" ? interval : count) = number;
+      } else if (name == "UNTIL") {
+        // a date, or a date and time of which only the date counts
+        long days;
+        const std::string date = value.substr(0, 8);
+        if (date.size() != 8 ||
+            date.find_first_not_of("0123456789") != std::string::npos ||
+            (value.size() > 8 && value[8] != 'T'))
+          return false;
+        until = date.substr(0, 4) + "-" + date.substr(4, 2) + "-" +
+                date.substr(6, 2);
+        if (!DaysFromKey(until, days))
+          return false;
+      } else if (name == "BYDAY") {
+        size_t day = 0;
+        while (day <= value.size()) {
+          size_t comma = value.find(',', day);
+          if (comma == std::string::npos)
+            comma = value.size();
+          auto it = std::find(std::begin(weekdays), std::end(weekdays),
+                              value.substr(day, comma - day));
+          if (it == std::end(weekdays))
+            return false;
+          byday |= 1 << (it - std::begin(weekdays));
+          day = comma + 1;
+        }
+      } else {
+        return false;
+      }
+    }
+    // RFC 5545 forbids COUNT with UNTIL
+    return has_freq && !(count && !until.empty()) &&
+           (byday == 0 || freq == WEEKLY);
+  }
+
+  /**
+   * @brief Occurrences between two days, in order, of a rule whose first
+   * occurrence is on a given day. The days before the window are skipped
+   * without being walked through for daily and weekly rules.
+   *
+   * @param first day of the first occurrence, "YYYY-MM-DD"
+   * @param from first day of the window, "YYYY-MM-DD"
+   * @param to last day of the window, "YYYY-MM-DD"
+   * @param limit occurrences to return at most
+   * @return std::vector<std::string> days of the occurrences, "YYYY-MM-DD"
+   */
+  std::vector<std::string> Occurrences(const std::string &first,
+                                       const std::string &from,
+                                       const std::string &to,
+                                       size_t limit) const {
+    std::vector<std::string> days;
+    long start, lo, hi, last;
+    if (!DaysFromKey(first, start) || !DaysFromKey(from, lo) ||
+        !DaysFromKey(to, hi) || limit == 0)
+      return days;
+    if (!until.empty() && DaysFromKey(until, last))
+      hi = std::min(hi, last);
+    lo = std::max(lo, start);
+    if (lo > hi)
+      return days;
+
+    // occurrences so far, for COUNT
+    long seen = 0;
+    auto emit = [&](long day) {
+      if ((count && seen >= count) || day > hi)
+        return false;
+      seen++;
+      if (day >= lo)
+        days.push_back(KeyFromDays(day));
+      return days.size() < limit;
+    };
+
+    if (freq == DAILY || (freq == WEEKLY && byday == 0)) {
+      const long step = interval * (freq == DAILY ? 1 : 7);
+      long period = (lo - start) / step;
+      seen = period;
+      while (emit(start + period * step))
+        period++;
+    } else if (freq == WEEKLY) {
+      // weeks start on Monday, 1970-01-01 was a Thursday
+      const long weekday = ((start + 3) % 7 + 7) % 7;
+      const long monday = start - weekday;
+      const long step = interval * 7;
+      int per_week = 0, first_week = 0;
+      for (int day = 0; day < 7; day++) {
+        if (byday & (1 << day)) {
+          per_week++;
+          first_week += day >= weekday;
+        }
+      }
+      long period = (lo - monday) / step;
+      seen = period == 0 ? 0 : first_week + (period - 1) * per_week;
+      for (bool more = true; more; period++) {
+        for (int day = 0; day < 7 && more; day++) {
+          const long date = monday + period * step + day;
+          if ((byday & (1 << day)) && date >= start)
+            more = emit(date);
+        }
+      }
+    } else {
+      long y;
+      int m, d;
+      CivilFromDays(start, y, m, d);
+      const long step = interval * (freq == MONTHLY ? 1 : 12);
+      for (long period = 0;; period++) {
+        const long month = m - 1 + period * step;
+        const long year = y + month / 12;
+        if (DaysFromCivil(year, month % 12 + 1, 1) > hi)
+          break;
+        if (d <= DaysInMonth(year, month % 12 + 1) &&
+            !emit(DaysFromCivil(year, month % 12 + 1, d)))
+          break;
+      }
+    }
+    return days;
+  }
+};
+
+} // namespace Common
@@ -0,0 +1,224 @@
+/**
+ * @file trace.h
+ * @brief Lightweight in-process tracing for lqxx project.
+ *
+ * Spans are recorded into a fixed size ring buffer owned by the thread that
+ * records them, so recording takes no lock. Readers copy the rings without
+ * stopping the writers and drop the slots that were overwritten while they
+ * were being copied. Recording is off unless Trace::Enable is called, and then
+ * a span costs two clock reads and four relaxed stores.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Trace {
+
+/**
+ * @brief A finished span, as returned by Collect. cat and name point to
+ * string literals or function names and are never freed.
+ *
+ */
+struct Event {
+  const char *cat;
+  const char *name;
+  uint32_t tid;
+  uint64_t start_us;
+  uint64_t dur_us;
+};
+
+/**
+ * @brief Microseconds on the steady clock, the time base of all spans.
+ *
+ */
+inline uint64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief Convert a steady clock time point to the time base of all spans.
+ *
+ */
+inline uint64_t ToUs(std::chrono::steady_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+/* Single writer ring of spans, one per recording thread */
+class __Ring {
+public:
+  static constexpr uint64_t kCapacity = 1 << 14;
+
+  explicit __Ring(uint32_t _tid) : tid(_tid) {}
+
+  void Push(const char *cat, const char *name, uint64_t start_us,
+            uint64_t dur_us) {
+    const uint64_t pos = head.load(std::memory_order_relaxed);
+    // announce the overwrite before touching the slot
+    claimed.store(pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot &slot = slots[pos % kCapacity];
+    slot.cat.store(cat, std::memory_order_relaxed);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start_us.store(start_us, std::memory_order_relaxed);
+    slot.dur_us.store(dur_us, std::memory_order_relaxed);
+    head.store(pos + 1, std::memory_order_release);
+  }
+
+  void CopyTo(uint64_t since_us, std::vector<Event> &out) const {
+    const uint64_t end = head.load(std::memory_order_acquire);
+    const uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+    std::vector<Event> copied;
+    for (uint64_t pos = begin; pos < end; pos++) {
+      const Slot &slot = slots[pos % kCapacity];
+      copied.push_back({slot.cat.load(std::memory_order_relaxed),
+                        slot.name.load(std::memory_order_relaxed), tid,
+                        slot.start_us.load(std::memory_order_relaxed),
+                        slot.dur_us.load(std::memory_order_relaxed)});
+    }
+    // drop the slots the writer started to overwrite while they were copied
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t now = claimed.load(std::memory_order_relaxed);
+    const uint64_t valid = now > kCapacity ? now - kCapacity : 0;
+    for (uint64_t pos = std::max(begin, valid); pos < end; pos++) {
+      const Event &event = copied[pos - begin];
+      if (event.start_us >= since_us)
+        out.push_back(event);
+    }
+  }
+
+private:
+  struct Slot {
+    std::atomic<const char *> cat{nullptr};
+    std::atomic<const char *> name{nullptr};
+    std::atomic<uint64_t> start_us{0};
+    std::atomic<uint64_t> dur_us{0};
+  };
+
+  const uint32_t tid;
+  std::atomic<uint64_t> head{0};
+  std::atomic<uint64_t> claimed{0};
+  Slot slots[kCapacity];
+};
+
+/* All rings ever created, they live as long as the process */
+struct __Registry {
+  std::mutex lock;
+  std::vector<std::shared_ptr<__Ring>> rings;
+  std::atomic<bool> enabled{false};
+};
+
+inline __Registry &__GetRegistry() {
+  static __Registry registry;
+  return registry;
+}
+
+inline __Ring &__GetRing() {
+  static thread_local std::shared_ptr<__Ring> ring = []() {
+    __Registry &registry = __GetRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    registry.rings.push_back(
+        std::make_shared<__Ring>((uint32_t)registry.rings.size() + 1));
+    return registry.rings.back();
+  }();
+  return *ring;
+}
+
+/**
+ * @brief Whether spans are being recorded.
+ *
+ */
+inline bool Enabled() {
+  return __GetRegistry().enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Start or stop recording spans.
+ *
+ */
+inline void Enable(bool enabled) {
+  __GetRegistry().enabled.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Record a finished span of the calling thread.
+ *
+ * @param cat category, e.g. the class name
+ * @param name span name, e.g. the method name
+ * @param start_us start time, see NowUs
+ * @param dur_us duration in microseconds
+ */
+inline void Record(const char *cat, const char *name, uint64_t start_us,
+                   uint64_t dur_us) {
+  if (Enabled())
+    __GetRing().Push(cat, name, start_us, dur_us);
+}
+
+/**
+ * @brief Collect the spans of all threads that started at or after a time.
+ *
+ * @param since_us start time, see NowUs
+ * @return std::vector<Event> spans still held by the ring buffers
+ */
+inline std::vector<Event> Collect(uint64_t since_us) {
+  __Registry &registry = __GetRegistry();
+  std::vector<std::shared_ptr<__Ring>> rings;
+  {
+    std::lock_guard<std::mutex> guard(registry.lock);
+    rings = registry.rings;
+  }
+  std::vector<Event> events;
+  for (auto &ring : rings) {
+    ring->CopyTo(since_us, events);
+  }
+  return events;
+}
+
+/**
+ * @brief Record the lifetime of a scope as a span.
+ *
+ */
+class Span {
+public:
+  Span(const char *_cat, const char *_name)
+      : cat(_cat), name(Enabled() ? _name : nullptr),
+        start_us(name ? NowUs() : 0) {}
+
+  ~Span() {
+    if (name)
+      Record(cat, name, start_us, NowUs() - start_us);
+  }
+
+  Span(const Span &) = delete;
+  Span &operator=(const Span &) = delete;
+
+private:
+  const char *cat;
+  const char *name;
+  const uint64_t start_us;
+};
+
+} // namespace Trace
+
+#define __TRACE_CONCAT_INNER(a, b) a##b
+#define __TRACE_CONCAT(a, b) __TRACE_CONCAT_INNER(a, b)
+
+/**
+ * @brief Record the rest of the enclosing scope as a span, e.g.
+ * TRACE_SCOPE("DB", __func__). Both arguments must outlive the process, so
+ * pass string literals or __func__.
+ */
+#define TRACE_SCOPE(cat, name)                                                 \
+  Trace::Span __TRACE_CONCAT(__trace_span_, __LINE__)((cat), (name))
@@ -15,7 +15,9 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <exception>
 #include <initializer_list>
@@ -250,6 +252,38 @@ inline bool IsDate(const std::string &str) {
   return false;
 }
 
+/**
+ * @brief Sortable form of a date in the format IsDate accepts
+ *
+ * @param str The date
+ * @return "YYYY-MM-DD", empty if the string is not a date
+ */
+inline std::string DateKey(const std::string &str) {
+  if (!IsDate(str))
+    return "";
+  std::istringstream iss(str);
+  int d, m, y;
+  char delimiter;
+  iss >> m >> delimiter >> d >> delimiter >> y;
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%04d-%02d-%02d", y, m, d);
+  return buf;
+}
+
+/**
+ * @brief Today's date in the form DateKey returns, local time
+ *
+ * @return "YYYY-MM-DD"
+ */
+inline std::string Today() {
+  time_t now = time(nullptr);
+  struct tm t;
+  localtime_r(&now, &t);
+  char buf[16];
+  strftime(buf, sizeof(buf), "%Y-%m-%d", &t);
+  return buf;
+}
+
 /**
  * @brief Check if the input is in email format
  *
@@ -276,4 +310,49 @@ inline std::string Rename(const std::string &name, int suffix) {
   return name + "(" + std::to_string(suffix) + ")";
 }
 
+/* Digits of the task positions, in increasing byte order */
+static const char kPositionDigits[] =
+    "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+/**
+ * @brief A position strictly between two others, for ordering tasks by hand.
+ * Positions are strings of kPositionDigits compared byte by byte, and never
+ * end with '0', so that there is always room between two of them: only the
+ * moved task gets a new position, its neighbours keep theirs.
+ *
+ * @param [in] lo position to come after, empty for none
+ * @param [in] hi position to come before, empty for none
+ * @return string of the shortest such position, or empty if lo is not
+ * before hi
+ */
+inline std::string PositionBetween(const std::string &lo,
+                                   const std::string &hi) {
+  const size_t base = sizeof(kPositionDigits) - 1;
+  auto digit = [](char c) {
+    const char *found = std::strchr(kPositionDigits, c);
+    return c != 0 && found ? size_t(found - kPositionDigits) : 0;
+  };
+  if (!hi.empty() && lo >= hi)
+    return "";
+
+  // keep the common prefix, missing digits of lo count as '0'
+  std::string key;
+  size_t i = 0;
+  while (i < hi.size() && (i < lo.size() ? lo[i] : '0') == hi[i]) {
+    key += hi[i++];
+  }
+  // hi is lo followed by '0's, nothing in between
+  if (!hi.empty() && i == hi.size())
+    return "";
+  const size_t low = i < lo.size() ? digit(lo[i]) : 0;
+  const size_t high = hi.empty() ? base : digit(hi[i]);
+  if (high - low > 1)
+    return key + kPositionDigits[(low + high) / 2];
+  // adjacent digits, hi cut short still comes after lo
+  if (i + 1 < hi.size())
+    return key + hi[i];
+  key += kPositionDigits[low];
+  return key + PositionBetween(i < lo.size() ? lo.substr(i + 1) : "", "");
+}
+
 } // namespace Common
@@ -1,52 +1,323 @@
 #include "DB.h"
 #include "common/errorCode.h"
+#include "common/trace.h"
+#include "common/utils.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <ctime>
+#include <future>
+#include <regex>
+#include <set>
+#include <thread>
+
+static thread_local DBRequestStats request_stats;
+
+/* The statement of the calling thread whose records are still being read */
+struct PendingQuery {
+  const char *caller = nullptr;
+  std::string query;
+  std::chrono::steady_clock::time_point start;
+  unsigned long rows = 0;
+};
+
+static thread_local PendingQuery pending_query;
+
+/* Replace every quoted literal with '?' so the log holds no user data */
+static std::string redactLiterals(const std::string &query) {
+  std::string redacted;
+  char quote = 0;
+  for (size_t i = 0; i < query.size(); i++) {
+    char c = query[i];
+    if (quote) {
+      if (c == '\\') {
+        i++;
+      } else if (c == quote) {
+        redacted += '?';
+        redacted += c;
+        quote = 0;
+      }
+    } else {
+      redacted += c;
+      if (c == '\'' || c == '"')
+        quote = c;
+    }
+  }
+  return redacted;
+}
 
-DB::DB(std::string host) {
-  this->host_ = host; // hardcode
+/* A statement is read only if it has none of the updating clauses outside
+   of its literals, nor a procedure call; CALL { } subqueries are read only
+   if what they hold is */
+static bool isReadOnly(const std::string &query) {
+  static const std::regex updating(
+      "\\b(CREATE|MERGE|SET|DELETE|REMOVE)\\b|\\bCALL\\s*[^\\s{]",
+      std::regex::icase);
+  return !std::regex_search(redactLiterals(query), updating);
+}
 
-  // For unit test
-  if (host == "testhost") {
+/* Local time for the slow query log */
+static std::string logTime() {
+  std::time_t time =
+      std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+  std::string time_str = std::ctime(&time);
+  time_str.pop_back();
+  return time_str;
+}
+
+/* Slow statements waiting for the profiling thread at most, the others are
+   not profiled */
+static const size_t kMaxPendingProfiles = 16;
+
+static void appendPlanStep(const struct neo4j_statement_execution_step *step,
+                           int depth, std::string &out) {
+  if (step == NULL)
     return;
+  out += std::string(2 * depth, ' ') + step->operator_type;
+  out += " rows=" + std::to_string(step->rows);
+  out += " estimated=" + std::to_string((long long)step->estimated_rows);
+  out += " db_hits=" + std::to_string(step->db_hits);
+  if (step->nidentifiers > 0) {
+    out += " [";
+    for (unsigned int i = 0; i < step->nidentifiers; i++) {
+      out += (i ? ", " : "") + std::string(step->identifiers[i]);
+    }
+    out += "]";
+  }
+  out += "\n";
+  for (unsigned int i = 0; i < step->nsources; i++) {
+    appendPlanStep(step->sources[i], depth + 1, out);
   }
+}
 
-  // Called before neo4j client driver is used.
-  neo4j_client_init();
-  // Test the connection.
-  // Copied from https://neo4j-client.net/
-  {
-    neo4j_connection_t *connection = connectDB();
-    if (connection == NULL) {
-      throw std::runtime_error(get_Neo4jC_error());
-    }
+/* A string as it is, any other value as neo4j_tostring renders it, whatever
+   the length */
+static std::string valueToString(neo4j_value_t value) {
+  if (neo4j_type(value) == NEO4J_STRING) {
+    return std::string(neo4j_ustring_value(value),
+                       neo4j_string_length(value));
+  }
+  // the buffer is only for the common short values
+  char buf[1024];
+  const size_t length = neo4j_ntostring(value, buf, sizeof(buf));
+  if (length < sizeof(buf)) {
+    return buf;
+  }
+  std::string rendered(length + 1, '\0');
+  neo4j_ntostring(value, &rendered[0], rendered.size());
+  rendered.resize(length);
+  return rendered;
+}
 
-    neo4j_result_stream_t *results =
-        neo4j_run(connection, "RETURN 'hello world'", neo4j_null);
-    if (!results) {
-      closeDB(connection);
-      throw std::runtime_error(get_Neo4jC_error());
+/* All properties of a node */
+static std::map<std::string, std::string> nodeProperties(neo4j_value_t node) {
+  std::map<std::string, std::string> properties;
+  neo4j_value_t value = neo4j_node_properties(node);
+  for (unsigned int i = 0; i < neo4j_map_size(value); i++) {
+    const neo4j_map_entry_t *kv = neo4j_map_getentry(value, i);
+    properties[valueToString(kv->key)] = valueToString(kv->value);
+  }
+  return properties;
+}
+
+/* Increment the change version of a user, binding the user to owner so that
+   the rest of the statement can stamp owner.version */
+static std::string bumpVersion(const std::string &user_pkey) {
+  return "MATCH (owner:User {email: '" + user_pkey +
+         "'}) SET owner.version = coalesce(owner.version, 0) + 1 ";
+}
+
+/* A quoted string literal, for values that may contain quotes */
+static std::string cypherString(const std::string &value) {
+  std::string literal = "'";
+  for (char c : value) {
+    if (c == '\\' || c == '\'') {
+      literal += '\\';
     }
+    literal += c;
+  }
+  return literal + "'";
+}
 
-    neo4j_result_t *result = neo4j_fetch_next(results);
-    if (result == NULL) {
-      neo4j_close_results(results);
-      closeDB(connection);
-      throw std::runtime_error(get_Neo4jC_error());
+/* What a task adds to the counts property of its task list, in the order of
+   DBTaskListStats: total, To Do, Doing, Done, no priority, 1, 2, 3 */
+static std::string taskCounts(const std::string &task) {
+  const std::string status = "coalesce(" + task + ".status, '')";
+  const std::string priority = "coalesce(" + task + ".priority, '')";
+  auto one = [](const std::string &condition) {
+    return "CASE WHEN " + condition + " THEN 1 ELSE 0 END";
+  };
+  return "[1, " + one("NOT " + status + " IN ['Doing', 'Done']") + ", " +
+         one(status + " = 'Doing'") + ", " + one(status + " = 'Done'") +
+         ", " + one("NOT " + priority + " IN ['1', '2', '3']") + ", " +
+         one(priority + " = '1'") + ", " + one(priority + " = '2'") + ", " +
+         one(priority + " = '3'") + "]";
+}
+
+/* Add a task to the counts of its task list, or take it out, in the same
+   statement as the write. Nothing happens if the task list is null */
+static std::string countTask(const std::string &list, const std::string &task,
+                             bool add) {
+  return "SET " + list + ".counts = [i IN range(0, 7) | coalesce(" + list +
+         ".counts[i], 0) " + (add ? "+ " : "- ") + taskCounts(task) +
+         "[i]] ";
+}
+
+/* Matches the overdue tasks of a task list as t, for count(t). Unlike the
+   counts the task writes keep, overdue depends on the day, so it is counted
+   when read, from the tasks due before today only */
+static std::string countOverdue(const std::string &list,
+                                const std::string &today) {
+  return "OPTIONAL MATCH (t:Task) WHERE t.user = " + list +
+         ".user AND t.due < " + cypherString(today) + " AND t.list = " +
+         list + ".name AND coalesce(t.status, '') <> 'Done' AND " +
+         "t.recurrence IS NULL ";
+}
+
+/* Fills stats from the counts of a task list node and its overdue count */
+static void readTaskListStats(neo4j_value_t counts, neo4j_value_t overdue,
+                              DBTaskListStats &stats) {
+  long long values[8] = {};
+  for (unsigned int i = 0; i < neo4j_list_length(counts) && i < 8; i++) {
+    values[i] = neo4j_int_value(neo4j_list_get(counts, i));
+  }
+  stats.total = values[0];
+  std::copy(values + 1, values + 4, stats.status);
+  std::copy(values + 4, values + 8, stats.priority);
+  stats.overdue = neo4j_int_value(overdue);
+}
+
+/* Keep the day a task became Done in doneAt, for archiveDoneTasks, and drop
+   it once the task is reopened */
+static std::string stampDone(const std::string &task) {
+  return "SET " + task + ".doneAt = CASE WHEN " + task +
+         ".status = 'Done' THEN coalesce(" + task +
+         ".doneAt, toString(date())) END ";
+}
+
+/* A position after last, for a task appended to its task list: the first
+   digit of last that is not the highest one, raised. '1' for the first task */
+static std::string appendPosition(const std::string &last) {
+  const std::string digits = std::string("'") + Common::kPositionDigits + "'";
+  return "CASE WHEN " + last + " IS NULL THEN '1' ELSE coalesce(head([j IN " +
+         "range(0, size(" + last + ") - 1) WHERE substring(" + last +
+         ", j, 1) <> 'z' | left(" + last + ", j) + substring(" + digits +
+         ", size(split(" + digits + ", substring(" + last + ", j, 1))[0]) + " +
+         "1, 1)]), " + last + " + 'V') END";
+}
+
+/* Evenly spaced positions for the tasks of a task list, in their order, tasks
+   without one last. Stamped with a new version, as clients sort by them */
+static std::string rebalancePositions(const std::string &user_pkey,
+                                      const std::string &task_list_pkey) {
+  return "MATCH (owner:User {email: " + cypherString(user_pkey) +
+         "}) MATCH (t:Task {user: " + cypherString(user_pkey) +
+         ", list: " + cypherString(task_list_pkey) +
+         "}) WITH owner, t ORDER BY t.position, t.name " +
+         "WITH owner, collect(t) AS tasks " +
+         "SET owner.version = coalesce(owner.version, 0) + 1 " +
+         "WITH owner, tasks UNWIND range(0, size(tasks) - 1) AS i " +
+         "WITH owner, tasks[i] AS t, i " +
+         "SET t.position = right('0000000' + toString(i + 1), 7) + 'V', " +
+         "t.version = owner.version";
+}
+
+/* Whether a field name can be used as a property key without quoting */
+static bool isIdentifier(const std::string &name) {
+  return !name.empty() && !isdigit((unsigned char)name[0]) &&
+         std::all_of(name.begin(), name.end(), [](char c) {
+           return isalnum((unsigned char)c) || c == '_';
+         });
+}
+
+/* Empty: return all fields / Not empty: return specified fields */
+static void projectFields(const std::map<std::string, std::string> &properties,
+                          std::map<std::string, std::string> &info) {
+  if (info.empty()) {
+    info = properties;
+    return;
+  }
+  for (auto it = info.begin(); it != info.end(); it++) {
+    auto property = properties.find(it->first);
+    it->second = property == properties.end() ? "" : property->second;
+  }
+}
+
+/* Invalidates cache entries when a write method returns, by whichever path,
+   so that a read racing with the write cannot put the old value back */
+class CacheInvalidation {
+public:
+  explicit CacheInvalidation(DBCache *_cache) : cache(_cache) {}
+
+  ~CacheInvalidation() {
+    if (cache == nullptr)
+      return;
+    for (auto &key : keys) {
+      cache->Erase(key.first, key.second);
+    }
+    for (auto &prefix : prefixes) {
+      cache->ErasePrefix(prefix.first, prefix.second);
     }
+  }
 
-    neo4j_close_results(results);
-    closeDB(connection);
+  void Key(DBCache::Kind kind, const std::string &key) {
+    keys.push_back({kind, key});
   }
 
-  ensureConstraints();
+  void Prefix(DBCache::Kind kind, const std::string &prefix) {
+    prefixes.push_back({kind, prefix});
+  }
+
+private:
+  DBCache *cache;
+  std::vector<std::pair<DBCache::Kind, std::string>> keys;
+  std::vector<std::pair<DBCache::Kind, std::string>> prefixes;
+};
+
+DB::DB(std::string host) : DB(host, Deferred()) {
+  // For unit test
+  if (host == "testhost") {
+    return;
+  }
+
+  std::string error;
+  if (Initialize(error) != SUCCESS) {
+    throw std::runtime_error(error);
+  }
+}
+
+DB::DB(std::string host, Deferred) {
+  this->host_ = host; // hardcode
+
+  // For unit test
+  if (host == "testhost") {
+    return;
+  }
+
+  // Called before neo4j client driver is used.
+  neo4j_client_init();
 }
 
 DB::~DB() {
   // closeDB();
+  if (profile_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(slow_log_lock_);
+      profile_stopping_ = true;
+    }
+    profile_cv_.notify_all();
+    profile_thread_.join();
+  }
   neo4j_client_cleanup();
 }
 
+DBRequestStats &DB::requestStats() { return request_stats; }
+
+void DB::resetRequestStats() { request_stats = DBRequestStats(); }
+
 returnCode
 DB::createUserNode(const std::map<std::string, std::string> &user_info) {
+  TRACE_SCOPE("DB", __func__);
   // Check Primary Key - user_pkey
   if (user_info.find("email") == user_info.end()) {
     return ERR_KEY;
@@ -90,6 +361,9 @@ DB::createUserNode(const std::map<std::string, std::string> &user_info) {
 returnCode DB::createTaskListNode(
     const std::string &user_pkey,
     const std::map<std::string, std::string> &task_list_info) {
+  TRACE_SCOPE("DB", __func__);
+  CacheInvalidation invalidate(cache_.get());
+  invalidate.Key(DBCache::PUBLIC, "");
   // Check Primary Key - task_list_pkey exists
   if (task_list_info.find("name") == task_list_info.end()) {
     return ERR_KEY;
@@ -106,7 +380,7 @@ returnCode DB::createTaskListNode(
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  if (neo4j_fetch_next(results) == NULL) {
+  if (fetchNext(results) == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
     return ERR_NO_NODE;
@@ -119,13 +393,11 @@ returnCode DB::createTaskListNode(
   if (task_list_info.find("visibility") == task_list_info.end()) {
     revised_info["visibility"] = "private";
   }
-  query = "CREATE (n:TaskList {";
+  query = bumpVersion(user_pkey) + "CREATE (n:TaskList {";
   for (auto it = revised_info.begin(); it != revised_info.end(); it++) {
     query += it->first + ": '" + it->second + "', ";
   }
-  query.pop_back();
-  query.pop_back();
-  query += "})";
+  query += "version: owner.version})";
   results = executeQuery(query, connection);
 
   // Check result
@@ -165,6 +437,7 @@ returnCode
 DB::createTaskNode(const std::string &user_pkey,
                    const std::string &task_list_pkey,
                    const std::map<std::string, std::string> &task_info) {
+  TRACE_SCOPE("DB", __func__);
   // Check Primary Key - task_pkey exists
   if (task_info.find("name") == task_info.end()) {
     return ERR_KEY;
@@ -180,7 +453,7 @@ DB::createTaskNode(const std::string &user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  if (neo4j_fetch_next(results) == NULL) {
+  if (fetchNext(results) == NULL) {
     closeDB(connection);
     return ERR_NO_NODE;
   }
@@ -193,7 +466,7 @@ DB::createTaskNode(const std::string &user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  if (neo4j_fetch_next(results) == NULL) {
+  if (fetchNext(results) == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
     return ERR_NO_NODE;
@@ -204,13 +477,14 @@ DB::createTaskNode(const std::string &user_pkey,
   revised_info["list"] = task_list_pkey;
   revised_info["user"] = user_pkey;
   // Create node Task
-  query = "CREATE (n:Task {";
+  query = bumpVersion(user_pkey) + "WITH owner OPTIONAL MATCH (o:Task {user: " +
+          cypherString(user_pkey) + ", list: " + cypherString(task_list_pkey) +
+          "}) WITH owner, max(o.position) AS last CREATE (n:Task {";
   for (auto it = revised_info.begin(); it != revised_info.end(); it++) {
     query += it->first + ": '" + it->second + "', ";
   }
-  query.pop_back();
-  query.pop_back();
-  query += "})";
+  query += "position: " + appendPosition("last") +
+           ", version: owner.version}) " + stampDone("n");
   results = executeQuery(query, connection);
 
   // Check result
@@ -232,8 +506,8 @@ DB::createTaskNode(const std::string &user_pkey,
   std::string task_node = "(b:Task {name: '" + revised_info["name"] +
                           "', list: '" + task_list_pkey + "', user: '" +
                           user_pkey + "'})";
-  query =
-      "MATCH " + list_node + ", " + task_node + " MERGE (a)-[r:Contains]->(b)";
+  query = "MATCH " + list_node + ", " + task_node +
+          " MERGE (a)-[r:Contains]->(b) ON CREATE " + countTask("a", "b", true);
   results = executeQuery(query, connection);
 
   // Check result
@@ -252,6 +526,9 @@ DB::createTaskNode(const std::string &user_pkey,
 returnCode
 DB::reviseUserNode(const std::string &user_pkey,
                    const std::map<std::string, std::string> &user_info) {
+  TRACE_SCOPE("DB", __func__);
+  CacheInvalidation invalidate(cache_.get());
+  invalidate.Key(DBCache::USER, DBCache::Key({user_pkey}));
   // Check Primary Key unmodified - user_pkey
   if (user_info.find("email") != user_info.end()) {
     return ERR_KEY;
@@ -279,7 +556,7 @@ DB::reviseUserNode(const std::string &user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  if (neo4j_fetch_next(results) == NULL) {
+  if (fetchNext(results) == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
     return ERR_NO_NODE;
@@ -294,6 +571,11 @@ DB::reviseUserNode(const std::string &user_pkey,
 returnCode DB::reviseTaskListNode(
     const std::string &user_pkey, const std::string &task_list_pkey,
     const std::map<std::string, std::string> &task_list_info) {
+  TRACE_SCOPE("DB", __func__);
+  CacheInvalidation invalidate(cache_.get());
+  invalidate.Key(DBCache::TASKLIST, DBCache::Key({user_pkey, task_list_pkey}));
+  invalidate.Prefix(DBCache::ACCESS, DBCache::Key({user_pkey, task_list_pkey}));
+  invalidate.Key(DBCache::PUBLIC, "");
   // Check Primary Key unmodified - task_list_pkey
   if (task_list_info.find("name") != task_list_info.end()) {
     return ERR_KEY;
@@ -307,13 +589,12 @@ returnCode DB::reviseTaskListNode(
 
   // Modify node TaskList
   std::string query = "MATCH (n:TaskList {name: '" + task_list_pkey +
-                      "', user: '" + user_pkey + "'}) SET ";
+                      "', user: '" + user_pkey + "'}) " +
+                      bumpVersion(user_pkey) + "SET ";
   for (auto it = task_list_info.begin(); it != task_list_info.end(); it++) {
     query += "n." + it->first + " = '" + it->second + "', ";
   }
-  query.pop_back();
-  query.pop_back();
-  query += " RETURN n";
+  query += "n.version = owner.version RETURN n";
   neo4j_result_stream_t *results = executeQuery(query, connection);
 
   // Check result
@@ -322,7 +603,7 @@ returnCode DB::reviseTaskListNode(
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  if (neo4j_fetch_next(results) == NULL) {
+  if (fetchNext(results) == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
     return ERR_NO_NODE;
@@ -338,7 +619,9 @@ returnCode
 DB::reviseTaskNode(const std::string &user_pkey,
                    const std::string &task_list_pkey,
                    const std::string &task_pkey,
-                   const std::map<std::string, std::string> &task_info) {
+                   const std::map<std::string, std::string> &task_info,
+                   std::map<std::string, std::string> *revised) {
+  TRACE_SCOPE("DB", __func__);
   // Check Primary Key unmodified - task_pkey
   if (task_info.find("name") != task_info.end()) {
     return ERR_KEY;
@@ -350,15 +633,45 @@ DB::reviseTaskNode(const std::string &user_pkey,
 
   neo4j_connection_t *connection = connectDB();
 
-  // Modify node Task
+  // Modify node Task, moving it between the counts of its task list when
+  // the status or the priority changes
+  const bool counted =
+      task_info.count("status") > 0 || task_info.count("priority") > 0;
   std::string query = "MATCH (n:Task {name: '" + task_pkey + "', list: '" +
-                      task_list_pkey + "', user: '" + user_pkey + "'}) SET ";
+                      task_list_pkey + "', user: '" + user_pkey + "'}) ";
+  if (counted) {
+    query += "OPTIONAL MATCH (l:TaskList)-[:Contains]->(n) ";
+  }
+  query += bumpVersion(user_pkey);
+  if (counted) {
+    query += countTask("l", "n", false);
+  }
+  // Append the fields whose value changes to the revisions of the task,
+  // with the values they had
+  std::string changes;
+  for (auto it = task_info.begin(); it != task_info.end(); it++) {
+    changes += (changes.empty() ? "[" : ", [") + cypherString(it->first) +
+               ", " + cypherString(it->second) + "]";
+  }
+  query += "WITH n, owner" + std::string(counted ? ", l" : "") + ", [c IN [" +
+           changes + "] WHERE coalesce(n[c[0]], '') <> c[1]] AS delta " +
+           "FOREACH (_ IN CASE WHEN size(delta) > 0 THEN [1] ELSE [] END | " +
+           "CREATE (n)-[:Revised]->(:Revision {version: owner.version, " +
+           "fields: [c IN delta | c[0]], " +
+           "before: [c IN delta | coalesce(n[c[0]], '')], " +
+           "after: [c IN delta | c[1]]})) ";
+  query += "SET ";
   for (auto it = task_info.begin(); it != task_info.end(); it++) {
     query += "n." + it->first + " = '" + it->second + "', ";
   }
-  query.pop_back();
-  query.pop_back();
-  query += " RETURN n";
+  query += "n.version = owner.version ";
+  if (task_info.count("status") > 0) {
+    query += stampDone("n");
+  }
+  if (counted) {
+    query += countTask("l", "n", true);
+  }
+  query += "RETURN n";
   neo4j_result_stream_t *results = executeQuery(query, connection);
 
   // Check result
@@ -367,11 +680,18 @@ DB::reviseTaskNode(const std::string &user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  if (neo4j_fetch_next(results) == NULL) {
+  neo4j_result_t *result = fetchNext(results);
+  if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
     return ERR_NO_NODE;
   }
+  if (revised != nullptr) {
+    *revised = nodeProperties(neo4j_result_field(result, 0));
+    revised->erase("user");
+    revised->erase("list");
+    revised->erase("version");
+  }
 
   // Success
   neo4j_close_results(results);
@@ -380,12 +700,20 @@ DB::reviseTaskNode(const std::string &user_pkey,
 }
 
 returnCode DB::deleteUserNode(const std::string &user_pkey) {
+  TRACE_SCOPE("DB", __func__);
+  // access checks of every list the user was granted go with the user
+  CacheInvalidation invalidate(cache_.get());
+  invalidate.Key(DBCache::USER, DBCache::Key({user_pkey}));
+  invalidate.Prefix(DBCache::TASKLIST, DBCache::Key({user_pkey}));
+  invalidate.Prefix(DBCache::ACCESS, "");
+  invalidate.Key(DBCache::PUBLIC, "");
   neo4j_connection_t *connection = connectDB();
 
   // Delete node User
-  std::string query =
-      "MATCH (a:User {email: '" + user_pkey +
-      "'})-[r:Owns]->(b:TaskList)-[s:Contains]->(c:Task) DETACH DELETE s, c";
+  std::string query = "MATCH (a:User {email: '" + user_pkey +
+                      "'})-[r:Owns]->(b:TaskList)-[s:Contains|Archives]->(c) "
+                      "OPTIONAL MATCH (c)-[:Revised]->(v) "
+                      "DETACH DELETE s, c, v";
   neo4j_result_stream_t *results = executeQuery(query, connection);
   if (neo4j_check_failure(results)) {
     neo4j_close_results(results);
@@ -400,7 +728,9 @@ returnCode DB::deleteUserNode(const std::string &user_pkey) {
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  query = "MATCH (a:User {email: '" + user_pkey + "'}) DETACH DELETE a";
+  query = "MATCH (a:User {email: '" + user_pkey +
+          "'}) OPTIONAL MATCH (t:Tombstone {user: '" + user_pkey +
+          "'}) DETACH DELETE a, t";
   results = executeQuery(query, connection);
   if (neo4j_check_failure(results)) {
     neo4j_close_results(results);
@@ -416,12 +746,19 @@ returnCode DB::deleteUserNode(const std::string &user_pkey) {
 
 returnCode DB::deleteTaskListNode(const std::string &user_pkey,
                                   const std::string &task_list_pkey) {
+  TRACE_SCOPE("DB", __func__);
+  CacheInvalidation invalidate(cache_.get());
+  invalidate.Key(DBCache::TASKLIST, DBCache::Key({user_pkey, task_list_pkey}));
+  invalidate.Prefix(DBCache::ACCESS, DBCache::Key({user_pkey, task_list_pkey}));
+  invalidate.Key(DBCache::PUBLIC, "");
   neo4j_connection_t *connection = connectDB();
 
   // Delete node TaskList
   std::string query = "MATCH (a:TaskList {name: '" + task_list_pkey +
                       "', user: '" + user_pkey +
-                      "'})-[r:Contains]->(b:Task) DETACH DELETE r, b";
+                      "'})-[r:Contains|Archives]->(b) "
+                      "OPTIONAL MATCH (b)-[:Revised]->(v) "
+                      "DETACH DELETE r, b, v";
   neo4j_result_stream_t *results = executeQuery(query, connection);
   if (neo4j_check_failure(results)) {
     neo4j_close_results(results);
@@ -429,7 +766,10 @@ returnCode DB::deleteTaskListNode(const std::string &user_pkey,
     return ERR_UNKNOWN;
   }
   query = "MATCH (a:TaskList {name: '" + task_list_pkey + "', user: '" +
-          user_pkey + "'}) DETACH DELETE a";
+          user_pkey + "'}) " + bumpVersion(user_pkey) +
+          "CREATE (:Tombstone {user: '" + user_pkey + "', list: '" +
+          task_list_pkey + "', task: '', version: owner.version}) " +
+          "DETACH DELETE a";
   results = executeQuery(query, connection);
   if (neo4j_check_failure(results)) {
     neo4j_close_results(results);
@@ -446,12 +786,254 @@ returnCode DB::deleteTaskListNode(const std::string &user_pkey,
 returnCode DB::deleteTaskNode(const std::string &user_pkey,
                               const std::string &task_list_pkey,
                               const std::string &task_pkey) {
+  TRACE_SCOPE("DB", __func__);
   neo4j_connection_t *connection = connectDB();
 
   // Delete node Task
   std::string query = "MATCH (a:Task {name: '" + task_pkey + "', list: '" +
-                      task_list_pkey + "', user: '" + user_pkey +
-                      "'}) DETACH DELETE a";
+                      task_list_pkey + "', user: '" + user_pkey + "'}) " +
+                      "OPTIONAL MATCH (l:TaskList)-[:Contains]->(a) " +
+                      bumpVersion(user_pkey) + countTask("l", "a", false) +
+                      "CREATE (:Tombstone {user: '" +
+                      user_pkey + "', list: '" + task_list_pkey +
+                      "', task: '" + task_pkey +
+                      "', version: owner.version}) WITH a "
+                      "OPTIONAL MATCH (a)-[:Revised]->(v) "
+                      "DETACH DELETE a, v";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::moveTaskNode(const std::string &user_pkey,
+                            const std::string &task_list_pkey,
+                            const std::string &task_pkey,
+                            const std::string &dst_user_pkey,
+                            const std::string &dst_task_list_pkey,
+                            const std::string &dst_task_pkey,
+                            std::map<std::string, std::string> &task_info) {
+  TRACE_SCOPE("DB", __func__);
+  neo4j_connection_t *connection = connectDB();
+
+  // Leave a tombstone in the change feed of the source, then re-point
+  // Contains and stamp the task with the version of the target owner. The
+  // uniqueness of (name, list, user) rolls all of it back on a clash.
+  std::string query =
+      "MATCH (a:TaskList {name: " + cypherString(task_list_pkey) +
+      ", user: " + cypherString(user_pkey) +
+      "})-[r:Contains]->(t:Task {name: " + cypherString(task_pkey) +
+      ", list: " + cypherString(task_list_pkey) +
+      ", user: " + cypherString(user_pkey) + "}) " +
+      "MATCH (b:TaskList {name: " + cypherString(dst_task_list_pkey) +
+      ", user: " + cypherString(dst_user_pkey) + "}) " +
+      "MATCH (source:User {email: " + cypherString(user_pkey) + "}) " +
+      "SET source.version = coalesce(source.version, 0) + 1 " +
+      "CREATE (:Tombstone {user: " + cypherString(user_pkey) +
+      ", list: " + cypherString(task_list_pkey) +
+      ", task: " + cypherString(task_pkey) +
+      ", version: source.version}) " + countTask("a", "t", false) +
+      "DELETE r WITH b, t OPTIONAL MATCH (t)-[d:DependsOn]-() DELETE d "
+      "WITH DISTINCT b, t OPTIONAL MATCH (o:Task {user: " +
+      cypherString(dst_user_pkey) +
+      ", list: " + cypherString(dst_task_list_pkey) +
+      "}) WITH b, t, max(o.position) AS last " +
+      "MATCH (owner:User {email: " + cypherString(dst_user_pkey) +
+      "}) SET owner.version = coalesce(owner.version, 0) + 1 " +
+      "SET t.position = " + appendPosition("last") +
+      ", t.name = " + cypherString(dst_task_pkey) +
+      ", t.list = " + cypherString(dst_task_list_pkey) +
+      ", t.user = " + cypherString(dst_user_pkey) +
+      ", t.version = owner.version CREATE (b)-[:Contains]->(t) " +
+      countTask("b", "t", true) + "RETURN t";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+
+  // Check result
+  if (neo4j_check_failure(results)) {
+    const bool dup = error_code_of_dup == neo4j_error_code(results);
+    neo4j_close_results(results);
+    closeDB(connection);
+    return dup ? ERR_DUP_NODE : ERR_UNKNOWN;
+  }
+  neo4j_result_t *result = fetchNext(results);
+  if (result == NULL) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_NO_NODE;
+  }
+  task_info = nodeProperties(neo4j_result_field(result, 0));
+  task_info.erase("user");
+  task_info.erase("list");
+  task_info.erase("version");
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::cloneTaskListNode(const std::string &user_pkey,
+                                 const std::string &task_list_pkey,
+                                 const std::string &dst_user_pkey,
+                                 const std::string &dst_task_list_pkey,
+                                 std::string &out_task_list_pkey,
+                                 std::vector<std::string> &task_pkeys) {
+  TRACE_SCOPE("DB", __func__);
+  out_task_list_pkey = "";
+  task_pkeys.clear();
+  neo4j_connection_t *connection = connectDB();
+
+  // The first of name, name(1), name(2)... not taken, there are no more
+  // taken names than that, then the task list and every task copied at once
+  const std::string name = cypherString(dst_task_list_pkey);
+  std::string query =
+      "MATCH (a:TaskList {name: " + cypherString(task_list_pkey) +
+      ", user: " + cypherString(user_pkey) + "}) " +
+      "MATCH (owner:User {email: " + cypherString(dst_user_pkey) + "}) " +
+      "OPTIONAL MATCH (x:TaskList {user: " + cypherString(dst_user_pkey) +
+      "}) WHERE x.name = " + name + " OR x.name STARTS WITH " + name +
+      " + '(' WITH a, owner, collect(x.name) AS taken " +
+      "WITH a, owner, head([n IN [i IN range(0, size(taken)) | CASE i " +
+      "WHEN 0 THEN " + name + " ELSE " + name +
+      " + '(' + toString(i) + ')' END] WHERE NOT n IN taken]) AS free " +
+      "SET owner.version = coalesce(owner.version, 0) + 1 " +
+      "CREATE (owner)-[:Owns]->(b:TaskList) SET b = properties(a), " +
+      "b.name = free, b.user = owner.email, b.visibility = 'private', " +
+      "b.version = owner.version " +
+      "WITH a, b, owner OPTIONAL MATCH (a)-[:Contains]->(t:Task) " +
+      "WITH b, owner, collect(t) AS tasks " +
+      "FOREACH (t IN tasks | CREATE (b)-[:Contains]->(c:Task) " +
+      "SET c = properties(t), c.list = b.name, c.user = b.user, " +
+      "c.version = owner.version) "
+      // the dependencies, between the copies of their ends
+      "WITH b, tasks CALL { WITH b, tasks UNWIND tasks AS t "
+      "MATCH (t)-[:DependsOn]->(d:Task) "
+      "MATCH (b)-[:Contains]->(ct:Task {name: t.name}) "
+      "MATCH (b)-[:Contains]->(cd:Task {name: d.name}) "
+      "CREATE (ct)-[:DependsOn]->(cd) RETURN count(*) AS dependencies } "
+      "RETURN b.name, [t IN tasks | t.name]";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+
+  // Check result
+  if (neo4j_check_failure(results)) {
+    const bool dup = error_code_of_dup == neo4j_error_code(results);
+    neo4j_close_results(results);
+    closeDB(connection);
+    return dup ? ERR_DUP_NODE : ERR_UNKNOWN;
+  }
+  neo4j_result_t *result = fetchNext(results);
+  if (result == NULL) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_NO_NODE;
+  }
+  out_task_list_pkey = valueToString(neo4j_result_field(result, 0));
+  neo4j_value_t names = neo4j_result_field(result, 1);
+  for (unsigned int i = 0; i < neo4j_list_length(names); i++) {
+    task_pkeys.push_back(valueToString(neo4j_list_get(names, i)));
+  }
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::addDependency(const std::string &user_pkey,
+                             const std::string &task_list_pkey,
+                             const std::string &task_pkey,
+                             const std::string &on_task_pkey) {
+  TRACE_SCOPE("DB", __func__);
+  neo4j_connection_t *connection = connectDB();
+
+  // a path back from the other task to this one would become a cycle
+  const std::string user = cypherString(user_pkey);
+  const std::string list = cypherString(task_list_pkey);
+  std::string query =
+      "MATCH (t:Task {user: " + user + ", list: " + list +
+      ", name: " + cypherString(task_pkey) + "}) " +
+      "MATCH (d:Task {user: " + user + ", list: " + list +
+      ", name: " + cypherString(on_task_pkey) + "}) " +
+      "WITH t, d, t = d OR exists((d)-[:DependsOn*]->(t)) AS cycle "
+      "FOREACH (x IN CASE WHEN cycle THEN [] ELSE [1] END | "
+      "MERGE (t)-[:DependsOn]->(d)) RETURN cycle";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+
+  // Check result
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+  neo4j_result_t *result = fetchNext(results);
+  if (result == NULL) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_NO_NODE;
+  }
+  const bool cycle = neo4j_bool_value(neo4j_result_field(result, 0));
+
+  neo4j_close_results(results);
+  closeDB(connection);
+  return cycle ? ERR_FORMAT : SUCCESS;
+}
+
+returnCode DB::removeDependency(const std::string &user_pkey,
+                                const std::string &task_list_pkey,
+                                const std::string &task_pkey,
+                                const std::string &on_task_pkey) {
+  TRACE_SCOPE("DB", __func__);
+  neo4j_connection_t *connection = connectDB();
+
+  const std::string user = cypherString(user_pkey);
+  const std::string list = cypherString(task_list_pkey);
+  std::string query = "MATCH (:Task {user: " + user + ", list: " + list +
+                      ", name: " + cypherString(task_pkey) +
+                      "})-[r:DependsOn]->(:Task {user: " + user +
+                      ", list: " + list +
+                      ", name: " + cypherString(on_task_pkey) +
+                      "}) DELETE r RETURN 1";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+
+  // Check result
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+  if (fetchNext(results) == NULL) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_NO_NODE;
+  }
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::getTaskGraph(const std::string &user_pkey,
+                            const std::string &task_list_pkey,
+                            std::vector<DBGraphTask> &tasks) {
+  TRACE_SCOPE("DB", __func__);
+  tasks.clear();
+  neo4j_connection_t *connection = connectDB();
+
+  std::string query =
+      "MATCH (t:Task {user: " + cypherString(user_pkey) +
+      ", list: " + cypherString(task_list_pkey) +
+      "}) OPTIONAL MATCH (t)-[:DependsOn]->(d:Task) "
+      "WITH t, collect(d.name) AS depends_on "
+      "RETURN t.name, coalesce(t.startDate, ''), coalesce(t.endDate, ''), "
+      "depends_on ORDER BY t.position, t.name";
   neo4j_result_stream_t *results = executeQuery(query, connection);
   if (neo4j_check_failure(results)) {
     neo4j_close_results(results);
@@ -459,6 +1041,193 @@ returnCode DB::deleteTaskNode(const std::string &user_pkey,
     return ERR_UNKNOWN;
   }
 
+  neo4j_result_t *result;
+  while ((result = fetchNext(results)) != NULL) {
+    DBGraphTask task;
+    task.task = valueToString(neo4j_result_field(result, 0));
+    task.startDate = valueToString(neo4j_result_field(result, 1));
+    task.endDate = valueToString(neo4j_result_field(result, 2));
+    neo4j_value_t depends_on = neo4j_result_field(result, 3);
+    for (unsigned int i = 0; i < neo4j_list_length(depends_on); i++) {
+      task.depends_on.push_back(valueToString(neo4j_list_get(depends_on, i)));
+    }
+    tasks.push_back(std::move(task));
+  }
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::reorderTaskNode(const std::string &user_pkey,
+                               const std::string &task_list_pkey,
+                               const std::string &task_pkey,
+                               const std::string &anchor_pkey, bool after,
+                               std::string &position) {
+  TRACE_SCOPE("DB", __func__);
+  position = "";
+  neo4j_connection_t *connection = connectDB();
+
+  // The anchor and its neighbour on that side, in (position, name) order
+  const std::string user = cypherString(user_pkey);
+  const std::string list = cypherString(task_list_pkey);
+  const std::string side = after ? ">" : "<";
+  const std::string order = after ? "" : " DESC";
+  const std::string neighbour =
+      "MATCH (t:Task {user: " + user + ", list: " + list +
+      ", name: " + cypherString(task_pkey) + "}) " +
+      "MATCH (a:Task {user: " + user + ", list: " + list +
+      ", name: " + cypherString(anchor_pkey) + "}) " +
+      "OPTIONAL MATCH (n:Task {user: " + user + ", list: " + list +
+      "}) WHERE n <> t AND n <> a AND (n.position " + side +
+      " a.position OR n.position = a.position AND n.name " + side +
+      " a.name) WITH a, n ORDER BY n.position" + order + ", n.name" + order +
+      " LIMIT 1 RETURN a.position, n.position";
+  for (int attempt = 0;; attempt++) {
+    neo4j_result_stream_t *results = executeQuery(neighbour, connection);
+    if (neo4j_check_failure(results)) {
+      neo4j_close_results(results);
+      closeDB(connection);
+      return ERR_UNKNOWN;
+    }
+    neo4j_result_t *result = fetchNext(results);
+    if (result == NULL) {
+      neo4j_close_results(results);
+      closeDB(connection);
+      return ERR_NO_NODE;
+    }
+    neo4j_value_t anchor = neo4j_result_field(result, 0);
+    neo4j_value_t next = neo4j_result_field(result, 1);
+    if (!neo4j_is_null(anchor)) {
+      const std::string near = valueToString(anchor);
+      const std::string far = neo4j_is_null(next) ? "" : valueToString(next);
+      position = after ? Common::PositionBetween(near, far)
+                       : Common::PositionBetween(far, near);
+    }
+    neo4j_close_results(results);
+    if (!position.empty())
+      break;
+
+    // the anchor has no position yet, or shares it with its neighbour
+    if (attempt > 0) {
+      closeDB(connection);
+      return ERR_UNKNOWN;
+    }
+    results = executeQuery(rebalancePositions(user_pkey, task_list_pkey),
+                           connection);
+    const bool failed = neo4j_check_failure(results);
+    neo4j_close_results(results);
+    if (failed) {
+      closeDB(connection);
+      return ERR_UNKNOWN;
+    }
+  }
+
+  std::string query = bumpVersion(user_pkey) + "WITH owner MATCH (t:Task " +
+                      "{user: " + user + ", list: " + list +
+                      ", name: " + cypherString(task_pkey) +
+                      "}) SET t.position = " + cypherString(position) +
+                      ", t.version = owner.version RETURN t";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+
+  // Check result
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    position = "";
+    return ERR_UNKNOWN;
+  }
+  if (fetchNext(results) == NULL) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    position = "";
+    return ERR_NO_NODE;
+  }
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::rebalanceTaskPositions(size_t max_length, size_t limit,
+                                      size_t &rebalanced) {
+  TRACE_SCOPE("DB", __func__);
+  rebalanced = 0;
+  neo4j_connection_t *connection = connectDB();
+
+  std::string query = "MATCH (t:Task) WHERE t.position IS NULL OR " +
+                      std::string("size(t.position) > ") +
+                      std::to_string(max_length) +
+                      " RETURN DISTINCT t.user, t.list LIMIT " +
+                      std::to_string(limit);
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+  std::vector<std::pair<std::string, std::string>> lists;
+  neo4j_result_t *result;
+  while ((result = fetchNext(results)) != NULL) {
+    lists.emplace_back(valueToString(neo4j_result_field(result, 0)),
+                       valueToString(neo4j_result_field(result, 1)));
+  }
+  neo4j_close_results(results);
+
+  // one statement per task list, so that each is rebalanced as a whole
+  for (const auto &list : lists) {
+    results =
+        executeQuery(rebalancePositions(list.first, list.second), connection);
+    const bool failed = neo4j_check_failure(results);
+    neo4j_close_results(results);
+    if (failed) {
+      closeDB(connection);
+      return ERR_UNKNOWN;
+    }
+    rebalanced++;
+  }
+
+  // Success
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::archiveDoneTasks(const std::string &before, size_t limit,
+                                size_t &archived) {
+  TRACE_SCOPE("DB", __func__);
+  archived = 0;
+  neo4j_connection_t *connection = connectDB();
+
+  // Out of the counts, the dependencies and the change feed like a deleted
+  // task, then relabeled and kept apart from Contains, so that neither the
+  // Task indexes nor the traversals of task lists come across it. Completed
+  // occurrences of repeating tasks stay: the agenda reads them as done
+  std::string query =
+      "MATCH (t:Task) WHERE t.status = 'Done' AND t.doneAt <= " +
+      cypherString(before) + " AND t.occurrence_of IS NULL WITH t LIMIT " +
+      std::to_string(limit) +
+      " MATCH (l:TaskList)-[r:Contains]->(t) " +
+      "MATCH (owner:User {email: t.user}) " +
+      "SET owner.version = coalesce(owner.version, 0) + 1 " +
+      "CREATE (:Tombstone {user: t.user, list: t.list, task: t.name, " +
+      "version: owner.version}) " + countTask("l", "t", false) +
+      "DELETE r WITH l, t OPTIONAL MATCH (t)-[d:DependsOn]-() DELETE d " +
+      "WITH DISTINCT l, t REMOVE t:Task SET t:ArchivedTask, " +
+      "t.archivedAt = toString(datetime()) CREATE (l)-[:Archives]->(t) " +
+      "RETURN count(t)";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+  neo4j_result_t *result = fetchNext(results);
+  if (result != NULL) {
+    archived = (size_t)neo4j_int_value(neo4j_result_field(result, 0));
+  }
+
   // Success
   neo4j_close_results(results);
   closeDB(connection);
@@ -467,6 +1236,23 @@ returnCode DB::deleteTaskNode(const std::string &user_pkey,
 
 returnCode DB::getUserNode(const std::string &user_pkey,
                            std::map<std::string, std::string> &user_info) {
+  TRACE_SCOPE("DB", __func__);
+  const std::string cache_key = DBCache::Key({user_pkey});
+  std::string cached;
+  // an entry loaded from a snapshot has no password
+  const bool wants_passwd = user_info.empty() || user_info.count("passwd");
+  if (cache_ && cache_->Get(DBCache::USER, cache_key, cached)) {
+    std::map<std::string, std::string> properties;
+    for (auto &pair : DBCache::Decode(cached)) {
+      properties.insert(std::move(pair));
+    }
+    if (!wants_passwd || properties.count("passwd")) {
+      projectFields(properties, user_info);
+      user_info.erase("version");
+      return SUCCESS;
+    }
+  }
+  const uint64_t generation = cache_ ? cache_->Generation() : 0;
   neo4j_connection_t *connection = connectDB();
 
   // Get node User
@@ -477,7 +1263,7 @@ returnCode DB::getUserNode(const std::string &user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  neo4j_result_t *result = neo4j_fetch_next(results);
+  neo4j_result_t *result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
@@ -485,39 +1271,14 @@ returnCode DB::getUserNode(const std::string &user_pkey,
   }
 
   // Extract node info
-  neo4j_value_t node = neo4j_result_field(result, 0);
-  neo4j_value_t value = neo4j_node_properties(node);
-  char buf[1024];
-  // Empty: return all fields / Not empty: return specified fields
-  if (user_info.empty()) {
-    for (int i = 0; i < neo4j_map_size(value); i++) {
-      const neo4j_map_entry_t *kv = neo4j_map_getentry(value, i);
-      neo4j_value_t key = kv->key;
-      neo4j_value_t val = kv->value;
-      neo4j_tostring(key, buf, 1024);
-      std::string key_str(buf);
-      key_str.pop_back();
-      key_str.erase(0, 1);
-      neo4j_tostring(val, buf, 1024);
-      std::string val_str(buf);
-      val_str.pop_back();
-      val_str.erase(0, 1);
-      user_info[key_str] = val_str;
-    }
-  } else {
-    for (auto it = user_info.begin(); it != user_info.end(); it++) {
-      neo4j_value_t field_value = neo4j_map_get(value, it->first.c_str());
-      if (neo4j_is_null(field_value)) {
-        it->second = "";
-      } else {
-        neo4j_tostring(field_value, buf, sizeof(buf));
-        std::string value_str(buf);
-        value_str.pop_back();
-        value_str.erase(0, 1);
-        it->second = value_str;
-      }
-    }
+  auto properties = nodeProperties(neo4j_result_field(result, 0));
+  if (cache_) {
+    cache_->Put(DBCache::USER, cache_key,
+                DBCache::Encode({properties.begin(), properties.end()}),
+                generation);
   }
+  projectFields(properties, user_info);
+  user_info.erase("version");
 
   // Success
   neo4j_close_results(results);
@@ -529,6 +1290,18 @@ returnCode
 DB::getTaskListNode(const std::string &user_pkey,
                     const std::string &task_list_pkey,
                     std::map<std::string, std::string> &task_list_info) {
+  TRACE_SCOPE("DB", __func__);
+  const std::string cache_key = DBCache::Key({user_pkey, task_list_pkey});
+  std::string cached;
+  if (cache_ && cache_->Get(DBCache::TASKLIST, cache_key, cached)) {
+    auto pairs = DBCache::Decode(cached);
+    projectFields({pairs.begin(), pairs.end()}, task_list_info);
+    task_list_info.erase("user");
+    task_list_info.erase("version");
+    task_list_info.erase("counts");
+    return SUCCESS;
+  }
+  const uint64_t generation = cache_ ? cache_->Generation() : 0;
   neo4j_connection_t *connection = connectDB();
 
   // Get node TaskList
@@ -540,48 +1313,67 @@ DB::getTaskListNode(const std::string &user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  neo4j_result_t *result = neo4j_fetch_next(results);
+  neo4j_result_t *result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
     return ERR_NO_NODE;
   }
   // Extract node info
-  neo4j_value_t node = neo4j_result_field(result, 0);
-  neo4j_value_t value = neo4j_node_properties(node);
-  char buf[1024];
-  // Empty: return all fields / Not empty: return specified fields
-  if (task_list_info.empty()) {
-    for (int i = 0; i < neo4j_map_size(value); i++) {
-      const neo4j_map_entry_t *kv = neo4j_map_getentry(value, i);
-      neo4j_value_t key = kv->key;
-      neo4j_value_t val = kv->value;
-      neo4j_tostring(key, buf, 1024);
-      std::string key_str(buf);
-      key_str.pop_back();
-      key_str.erase(0, 1);
-      neo4j_tostring(val, buf, 1024);
-      std::string val_str(buf);
-      val_str.pop_back();
-      val_str.erase(0, 1);
-      task_list_info[key_str] = val_str;
-    }
-  } else {
-    for (auto it = task_list_info.begin(); it != task_list_info.end(); it++) {
-      neo4j_value_t field_value = neo4j_map_get(value, it->first.c_str());
-      if (neo4j_is_null(field_value)) {
-        it->second = "";
-      } else {
-        neo4j_tostring(field_value, buf, sizeof(buf));
-        std::string value_str(buf);
-        value_str.pop_back();
-        value_str.erase(0, 1);
-        it->second = value_str;
-      }
-    }
+  auto properties = nodeProperties(neo4j_result_field(result, 0));
+  if (cache_) {
+    cache_->Put(DBCache::TASKLIST, cache_key,
+                DBCache::Encode({properties.begin(), properties.end()}),
+                generation);
+  }
+  projectFields(properties, task_list_info);
+  // Delete user, version and counts field
+  task_list_info.erase("user");
+  task_list_info.erase("version");
+  task_list_info.erase("counts");
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode
+DB::getTaskListNodeWithStats(const std::string &user_pkey,
+                             const std::string &task_list_pkey,
+                             const std::string &today,
+                             std::map<std::string, std::string> &task_list_info,
+                             DBTaskListStats &stats) {
+  TRACE_SCOPE("DB", __func__);
+  stats = DBTaskListStats();
+  neo4j_connection_t *connection = connectDB();
+
+  // Not through the cache, the overdue count changes with the tasks
+  std::string query = "MATCH (l:TaskList {name: " +
+                      cypherString(task_list_pkey) +
+                      ", user: " + cypherString(user_pkey) + "}) " +
+                      countOverdue("l", today) +
+                      "RETURN l, coalesce(l.counts, []), count(t)";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
   }
-  // Delete user field
+  neo4j_result_t *result = fetchNext(results);
+  if (result == NULL) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_NO_NODE;
+  }
+
+  // Extract node info and counts
+  projectFields(nodeProperties(neo4j_result_field(result, 0)), task_list_info);
   task_list_info.erase("user");
+  task_list_info.erase("version");
+  task_list_info.erase("counts");
+  readTaskListStats(neo4j_result_field(result, 1),
+                    neo4j_result_field(result, 2), stats);
 
   // Success
   neo4j_close_results(results);
@@ -593,6 +1385,7 @@ returnCode DB::getTaskNode(const std::string &user_pkey,
                            const std::string &task_list_pkey,
                            const std::string &task_pkey,
                            std::map<std::string, std::string> &task_info) {
+  TRACE_SCOPE("DB", __func__);
   neo4j_connection_t *connection = connectDB();
 
   // Get node Task
@@ -605,57 +1398,354 @@ returnCode DB::getTaskNode(const std::string &user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  neo4j_result_t *result = neo4j_fetch_next(results);
+  neo4j_result_t *result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
-    return ERR_NO_NODE;
-  }
-  // Extract node info
-  neo4j_value_t node = neo4j_result_field(result, 0);
-  neo4j_value_t value = neo4j_node_properties(node);
-  char buf[1024];
-  // Empty: return all fields / Not empty: return specified fields
-  if (task_info.empty()) {
-    for (int i = 0; i < neo4j_map_size(value); i++) {
-      const neo4j_map_entry_t *kv = neo4j_map_getentry(value, i);
-      neo4j_value_t key = kv->key;
-      neo4j_value_t val = kv->value;
-      neo4j_tostring(key, buf, 1024);
-      std::string key_str(buf);
-      key_str.pop_back();
-      key_str.erase(0, 1);
-      neo4j_tostring(val, buf, 1024);
-      std::string val_str(buf);
-      val_str.pop_back();
-      val_str.erase(0, 1);
-      task_info[key_str] = val_str;
-    }
-  } else {
-    for (auto it = task_info.begin(); it != task_info.end(); it++) {
-      neo4j_value_t field_value = neo4j_map_get(value, it->first.c_str());
-      if (neo4j_is_null(field_value)) {
-        it->second = "";
-      } else {
-        neo4j_tostring(field_value, buf, sizeof(buf));
-        std::string value_str(buf);
-        value_str.pop_back();
-        value_str.erase(0, 1);
-        it->second = value_str;
-      }
-    }
+    return ERR_NO_NODE;
+  }
+  // Extract node info
+  projectFields(nodeProperties(neo4j_result_field(result, 0)), task_info);
+  // Delete user, list and version field
+  task_info.erase("user");
+  task_info.erase("list");
+  task_info.erase("version");
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::getTaskNodes(
+    const std::string &dst_user_pkey, const std::vector<DBTaskKey> &keys,
+    std::vector<returnCode> &results,
+    std::vector<std::map<std::string, std::string>> &task_infos) {
+  TRACE_SCOPE("DB", __func__);
+  results.assign(keys.size(), ERR_NO_NODE);
+  task_infos.assign(keys.size(), std::map<std::string, std::string>());
+  if (keys.empty()) {
+    return SUCCESS;
+  }
+
+  // One row per distinct task list, carrying the position of its keys
+  std::map<std::pair<std::string, std::string>, std::vector<size_t>> lists;
+  for (size_t i = 0; i < keys.size(); i++) {
+    lists[{std::get<0>(keys[i]), std::get<1>(keys[i])}].push_back(i);
+  }
+  std::string rows;
+  for (auto &list : lists) {
+    rows += rows.empty() ? "{user: " : ", {user: ";
+    rows += cypherString(list.first.first) +
+            ", list: " + cypherString(list.first.second) + ", tasks: [";
+    for (size_t j = 0; j < list.second.size(); j++) {
+      const size_t i = list.second[j];
+      rows += j ? ", {i: " : "{i: ";
+      rows += std::to_string(i) +
+              ", name: " + cypherString(std::get<2>(keys[i])) + "}";
+    }
+    rows += "]}";
+  }
+
+  // status, as queryAccess decides: 0 readable, 1 no such task list, 2 no
+  // access. The tasks are only looked up in the readable task lists.
+  neo4j_connection_t *connection = connectDB();
+  const std::string dst = cypherString(dst_user_pkey);
+  std::string query =
+      "UNWIND [" + rows +
+      "] AS k OPTIONAL MATCH (l:TaskList {name: k.list, user: k.user}) "
+      "OPTIONAL MATCH (:User {email: " +
+      dst +
+      "})-[a:Access]->(l) WITH k, CASE WHEN k.user = " + dst +
+      " THEN 0 WHEN l IS NULL THEN 1 WHEN l.visibility = 'private' THEN 2 "
+      "WHEN l.visibility = 'public' OR a IS NOT NULL THEN 0 ELSE 2 END "
+      "AS status UNWIND k.tasks AS task OPTIONAL MATCH (t:Task {name: "
+      "task.name, list: k.list, user: k.user}) WHERE status = 0 "
+      "RETURN task.i, status, t";
+  neo4j_result_stream_t *results_stream = executeQuery(query, connection);
+  if (neo4j_check_failure(results_stream)) {
+    neo4j_close_results(results_stream);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+
+  neo4j_result_t *result;
+  while ((result = fetchNext(results_stream)) != NULL) {
+    long long i = neo4j_int_value(neo4j_result_field(result, 0));
+    long long status = neo4j_int_value(neo4j_result_field(result, 1));
+    neo4j_value_t task = neo4j_result_field(result, 2);
+    if (i < 0 || i >= (long long)keys.size()) {
+      continue;
+    }
+    if (status == 2) {
+      results[i] = ERR_ACCESS;
+    } else if (status == 0 && !neo4j_is_null(task)) {
+      results[i] = SUCCESS;
+      task_infos[i] = nodeProperties(task);
+      // Delete user, list and version field
+      task_infos[i].erase("user");
+      task_infos[i].erase("list");
+      task_infos[i].erase("version");
+    }
+  }
+
+  // Success
+  neo4j_close_results(results_stream);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::getAgenda(const std::string &user_pkey,
+                         const std::string &from, const std::string &to,
+                         const DBAgendaTask *after, size_t limit,
+                         std::vector<DBAgendaTask> &tasks,
+                         std::vector<DBRecurringTask> &repeating) {
+  TRACE_SCOPE("DB", __func__);
+  tasks.clear();
+  repeating.clear();
+  if (limit == 0) {
+    return SUCCESS;
+  }
+
+  // Resume strictly after the sort key of the last task returned
+  std::string resume;
+  if (after != nullptr) {
+    const std::pair<std::string, std::string> key[] = {
+        {"t.due", cypherString(after->due)},
+        {"rank", std::to_string(after->rank)},
+        {"t.user", cypherString(after->user)},
+        {"t.list", cypherString(after->list)}};
+    resume = "t.name > " + cypherString(after->task);
+    for (int i = 3; i >= 0; i--) {
+      resume = key[i].first + " > " + key[i].second + " OR (" + key[i].first +
+               " = " + key[i].second + " AND (" + resume + "))";
+    }
+    resume = "WHERE " + resume + " ";
+  }
+
+  // The tasks of the user and those shared with it that match a condition
+  const std::string user = cypherString(user_pkey);
+  auto matching = [&user](const std::string &condition) {
+    return "CALL { MATCH (t:Task) WHERE t.user = " + user + " AND " +
+           condition + " RETURN t UNION MATCH (:User {email: " + user +
+           "})-[:Access]->(l:TaskList)-[:Contains]->(t:Task) WHERE "
+           "l.visibility <> 'private' AND " +
+           condition + " RETURN t } ";
+  };
+  const std::string rank =
+      "CASE WHEN priority > 0 THEN priority ELSE 4 END AS rank ";
+
+  // A page of the dated tasks, then every repeating task with its
+  // completed occurrences, which are tasks of their own named after the day
+  neo4j_connection_t *connection = connectDB();
+  const std::string window = "t.due >= " + cypherString(from) +
+                             " AND t.due <= " + cypherString(to);
+  std::string query =
+      "CALL { " + matching(window + " AND t.recurrence IS NULL") +
+      "WITH t, coalesce(toInteger(t.priority), 0) AS priority WITH t, " +
+      rank + resume +
+      "RETURN t, rank, null AS done ORDER BY t.due, rank, t.user, t.list, "
+      "t.name LIMIT " +
+      std::to_string(limit) + " UNION ALL " +
+      matching("t.recurrence IS NOT NULL AND t.due <= " + cypherString(to)) +
+      "OPTIONAL MATCH (c:Task) WHERE c.user = t.user AND c.due >= " +
+      cypherString(from) + " AND c.due <= " + cypherString(to) +
+      " AND c.list = t.list AND c.occurrence_of = t.name "
+      "WITH t, collect(c.due) AS done "
+      "WITH t, done, coalesce(toInteger(t.priority), 0) AS priority "
+      "RETURN t, " +
+      rank +
+      ", done } RETURN t, rank, done "
+      "ORDER BY t.due, rank, t.user, t.list, t.name";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+
+  neo4j_result_t *result;
+  while ((result = fetchNext(results)) != NULL) {
+    DBRecurringTask task;
+    task.info = nodeProperties(neo4j_result_field(result, 0));
+    task.rank = (int)neo4j_int_value(neo4j_result_field(result, 1));
+    neo4j_value_t done = neo4j_result_field(result, 2);
+    task.user = task.info["user"];
+    task.list = task.info["list"];
+    task.task = task.info["name"];
+    task.due = task.info["due"];
+    // Delete user, list and version field
+    task.info.erase("user");
+    task.info.erase("list");
+    task.info.erase("version");
+    if (neo4j_is_null(done)) {
+      tasks.push_back(std::move(task));
+      continue;
+    }
+    for (unsigned int i = 0; i < neo4j_list_length(done); i++) {
+      task.done.push_back(valueToString(neo4j_list_get(done, i)));
+    }
+    repeating.push_back(std::move(task));
+  }
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::getOpenDueTasks(const std::string &from,
+                               const DBAgendaTask *after, size_t limit,
+                               std::vector<DBAgendaTask> &tasks) {
+  TRACE_SCOPE("DB", __func__);
+  tasks.clear();
+  if (limit == 0) {
+    return SUCCESS;
+  }
+
+  // Resume strictly after the sort key of the last task returned
+  std::string resume;
+  if (after != nullptr) {
+    const std::pair<std::string, std::string> key[] = {
+        {"t.due", cypherString(after->due)},
+        {"t.user", cypherString(after->user)},
+        {"t.list", cypherString(after->list)}};
+    resume = "t.name > " + cypherString(after->task);
+    for (int i = 2; i >= 0; i--) {
+      resume = key[i].first + " > " + key[i].second + " OR (" + key[i].first +
+               " = " + key[i].second + " AND (" + resume + "))";
+    }
+    resume = " AND (" + resume + ")";
+  }
+
+  neo4j_connection_t *connection = connectDB();
+  std::string query =
+      "MATCH (t:Task) WHERE t.due >= " + cypherString(from) +
+      " AND t.recurrence IS NULL AND coalesce(t.status, '') <> 'Done'" +
+      resume +
+      " RETURN t.user, t.list, t.name, t.due "
+      "ORDER BY t.due, t.user, t.list, t.name LIMIT " +
+      std::to_string(limit);
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+
+  neo4j_result_t *result;
+  while ((result = fetchNext(results)) != NULL) {
+    DBAgendaTask task;
+    task.user = valueToString(neo4j_result_field(result, 0));
+    task.list = valueToString(neo4j_result_field(result, 1));
+    task.task = valueToString(neo4j_result_field(result, 2));
+    task.due = valueToString(neo4j_result_field(result, 3));
+    tasks.push_back(std::move(task));
+  }
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::getBoard(const std::string &user_pkey,
+                        const std::string &task_list_pkey,
+                        const std::string &status, size_t offset, size_t limit,
+                        std::vector<DBBoardColumn> &columns) {
+  TRACE_SCOPE("DB", __func__);
+  columns.clear();
+  neo4j_connection_t *connection = connectDB();
+
+  // Sort, group and count in one pass, only the page of each group is sent
+  std::string query =
+      "MATCH (:TaskList {name: " + cypherString(task_list_pkey) +
+      ", user: " + cypherString(user_pkey) +
+      "})-[:Contains]->(t:Task) WITH t, CASE WHEN t.status IN ['Doing', "
+      "'Done'] THEN t.status ELSE 'To Do' END AS status, "
+      "coalesce(toInteger(t.priority), 0) AS priority ";
+  if (!status.empty()) {
+    query += "WHERE status = " + cypherString(status) + " ";
+  }
+  query += "WITH t, status, CASE WHEN priority > 0 THEN priority ELSE 4 END "
+           "AS rank ORDER BY rank, t.name WITH status, count(t) AS total, "
+           "collect(t) AS tasks RETURN status, total, tasks[" +
+           std::to_string(offset) + ".." + std::to_string(offset + limit) +
+           "]";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+
+  neo4j_result_t *result;
+  while ((result = fetchNext(results)) != NULL) {
+    DBBoardColumn column;
+    column.status = valueToString(neo4j_result_field(result, 0));
+    column.total = neo4j_int_value(neo4j_result_field(result, 1));
+    neo4j_value_t tasks = neo4j_result_field(result, 2);
+    for (unsigned int i = 0; i < neo4j_list_length(tasks); i++) {
+      std::map<std::string, std::string> info =
+          nodeProperties(neo4j_list_get(tasks, i));
+      // Delete user, list and version field
+      info.erase("user");
+      info.erase("list");
+      info.erase("version");
+      column.tasks.push_back(std::move(info));
+    }
+    columns.push_back(std::move(column));
+  }
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode
+DB::getTaskListStats(const std::string &user_pkey,
+                     const std::string &task_list_pkey,
+                     const std::string &today,
+                     std::map<std::string, DBTaskListStats> &stats) {
+  TRACE_SCOPE("DB", __func__);
+  stats.clear();
+  neo4j_connection_t *connection = connectDB();
+
+  std::string query =
+      "MATCH (l:TaskList) WHERE l.user = " + cypherString(user_pkey);
+  if (!task_list_pkey.empty()) {
+    query += " AND l.name = " + cypherString(task_list_pkey);
+  }
+  query += " " + countOverdue("l", today) +
+           "RETURN l.name, coalesce(l.counts, []), count(t)";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+
+  neo4j_result_t *result;
+  while ((result = fetchNext(results)) != NULL) {
+    readTaskListStats(neo4j_result_field(result, 1),
+                      neo4j_result_field(result, 2),
+                      stats[valueToString(neo4j_result_field(result, 0))]);
+  }
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
   }
-  // Delete user and list field
-  task_info.erase("user");
-  task_info.erase("list");
 
   // Success
   neo4j_close_results(results);
   closeDB(connection);
-  return SUCCESS;
+  return stats.empty() && !task_list_pkey.empty() ? ERR_NO_NODE : SUCCESS;
 }
 
 returnCode DB::getAllUserNodes(std::vector<std::string> &user_info) {
+  TRACE_SCOPE("DB", __func__);
   neo4j_connection_t *connection = connectDB();
 
   // Clear vector
@@ -672,7 +1762,7 @@ returnCode DB::getAllUserNodes(std::vector<std::string> &user_info) {
 
   // Extract returned info
   neo4j_result_t *result;
-  while ((result = neo4j_fetch_next(results)) != NULL) {
+  while ((result = fetchNext(results)) != NULL) {
     neo4j_value_t node = neo4j_result_field(result, 0);
     neo4j_value_t value = neo4j_node_properties(node);
     char buf[1024];
@@ -692,6 +1782,7 @@ returnCode DB::getAllUserNodes(std::vector<std::string> &user_info) {
 
 returnCode DB::getAllTaskListNodes(const std::string &user_pkey,
                                    std::vector<std::string> &task_list_info) {
+  TRACE_SCOPE("DB", __func__);
   neo4j_connection_t *connection = connectDB();
 
   // Clear vector
@@ -705,7 +1796,7 @@ returnCode DB::getAllTaskListNodes(const std::string &user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  neo4j_result_t *result = neo4j_fetch_next(results);
+  neo4j_result_t *result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
@@ -722,7 +1813,7 @@ returnCode DB::getAllTaskListNodes(const std::string &user_pkey,
   }
 
   // Extract returned info
-  while ((result = neo4j_fetch_next(results)) != NULL) {
+  while ((result = fetchNext(results)) != NULL) {
     neo4j_value_t node = neo4j_result_field(result, 0);
     neo4j_value_t value = neo4j_node_properties(node);
     char buf[1024];
@@ -743,6 +1834,7 @@ returnCode DB::getAllTaskListNodes(const std::string &user_pkey,
 returnCode DB::getAllTaskNodes(const std::string &user_pkey,
                                const std::string &task_list_pkey,
                                std::vector<std::string> &task_info) {
+  TRACE_SCOPE("DB", __func__);
   neo4j_connection_t *connection = connectDB();
 
   // Clear vector
@@ -756,7 +1848,7 @@ returnCode DB::getAllTaskNodes(const std::string &user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  neo4j_result_t *result = neo4j_fetch_next(results);
+  neo4j_result_t *result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
@@ -771,16 +1863,17 @@ returnCode DB::getAllTaskNodes(const std::string &user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  result = neo4j_fetch_next(results);
+  result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
     return ERR_NO_NODE;
   }
 
-  // Get all nodes Task
-  query = "MATCH (n:TaskList {name: '" + task_list_pkey + "', user: '" +
-          user_pkey + "'})-[:Contains]->(m) RETURN m";
+  // Get all nodes Task, in order from the position index
+  query = "MATCH (m:Task {user: " + cypherString(user_pkey) +
+          ", list: " + cypherString(task_list_pkey) +
+          "}) RETURN m ORDER BY m.position, m.name";
   results = executeQuery(query, connection);
   if (neo4j_check_failure(results)) {
     neo4j_close_results(results);
@@ -789,7 +1882,7 @@ returnCode DB::getAllTaskNodes(const std::string &user_pkey,
   }
 
   // Extract returned info
-  while ((result = neo4j_fetch_next(results)) != NULL) {
+  while ((result = fetchNext(results)) != NULL) {
     neo4j_value_t node = neo4j_result_field(result, 0);
     neo4j_value_t value = neo4j_node_properties(node);
     char buf[1024];
@@ -807,10 +1900,117 @@ returnCode DB::getAllTaskNodes(const std::string &user_pkey,
   return SUCCESS;
 }
 
+returnCode DB::getArchivedTaskNodes(
+    const std::string &user_pkey, const std::string &task_list_pkey,
+    const std::string &task_pkey,
+    std::vector<std::map<std::string, std::string>> &task_infos) {
+  TRACE_SCOPE("DB", __func__);
+  task_infos.clear();
+  neo4j_connection_t *connection = connectDB();
+
+  std::string query = "MATCH (t:ArchivedTask {user: " +
+                      cypherString(user_pkey) +
+                      ", list: " + cypherString(task_list_pkey) + "}) ";
+  if (!task_pkey.empty()) {
+    query += "WHERE t.name = " + cypherString(task_pkey) + " ";
+  }
+  query += "RETURN t ORDER BY t.archivedAt DESC, t.name";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+
+  neo4j_result_t *result;
+  while ((result = fetchNext(results)) != NULL) {
+    std::map<std::string, std::string> info =
+        nodeProperties(neo4j_result_field(result, 0));
+    info.erase("user");
+    info.erase("list");
+    info.erase("version");
+    task_infos.push_back(std::move(info));
+  }
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::getTaskRevisions(
+    const std::string &user_pkey, const std::string &task_list_pkey,
+    const std::string &task_pkey, long long after, long long before,
+    size_t limit, std::map<std::string, std::string> &task_info,
+    std::vector<DBTaskRevision> &revisions) {
+  TRACE_SCOPE("DB", __func__);
+  task_info.clear();
+  revisions.clear();
+  neo4j_connection_t *connection = connectDB();
+
+  // A row per revision, or a single one with a null revision
+  std::string query = "MATCH (n:Task {name: " + cypherString(task_pkey) +
+                      ", list: " + cypherString(task_list_pkey) +
+                      ", user: " + cypherString(user_pkey) +
+                      "}) OPTIONAL MATCH (n)-[:Revised]->(r:Revision) " +
+                      "WHERE r.version > " + std::to_string(after) + " ";
+  if (before > 0) {
+    query += "AND r.version < " + std::to_string(before) + " ";
+  }
+  query += "WITH n, r ORDER BY r.version DESC ";
+  if (limit > 0) {
+    query += "LIMIT " + std::to_string(limit) + " ";
+  }
+  query += "RETURN n, r.version, r.fields, r.before, r.after";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+
+  neo4j_result_t *result = fetchNext(results);
+  if (result == NULL) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_NO_NODE;
+  }
+  task_info = nodeProperties(neo4j_result_field(result, 0));
+  task_info.erase("user");
+  task_info.erase("list");
+  task_info.erase("version");
+  for (; result != NULL; result = fetchNext(results)) {
+    neo4j_value_t version = neo4j_result_field(result, 1);
+    if (neo4j_is_null(version))
+      break;
+    DBTaskRevision revision;
+    revision.version = neo4j_int_value(version);
+    neo4j_value_t fields = neo4j_result_field(result, 2);
+    neo4j_value_t values_before = neo4j_result_field(result, 3);
+    neo4j_value_t values_after = neo4j_result_field(result, 4);
+    for (unsigned int i = 0; i < neo4j_list_length(fields); i++) {
+      const std::string field = valueToString(neo4j_list_get(fields, i));
+      revision.before[field] =
+          valueToString(neo4j_list_get(values_before, i));
+      revision.after[field] = valueToString(neo4j_list_get(values_after, i));
+    }
+    revisions.push_back(std::move(revision));
+  }
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
 returnCode DB::addAccess(const std::string &src_user_pkey,
                          const std::string &dst_user_pkey,
                          const std::string &task_list_pkey,
                          const bool read_write) {
+  TRACE_SCOPE("DB", __func__);
+  CacheInvalidation invalidate(cache_.get());
+  invalidate.Key(DBCache::ACCESS,
+                 DBCache::Key({src_user_pkey, task_list_pkey, dst_user_pkey}));
   neo4j_connection_t *connection = connectDB();
 
   // Check User node exists - src
@@ -822,7 +2022,7 @@ returnCode DB::addAccess(const std::string &src_user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  neo4j_result_t *result = neo4j_fetch_next(results);
+  neo4j_result_t *result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
@@ -836,7 +2036,7 @@ returnCode DB::addAccess(const std::string &src_user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  result = neo4j_fetch_next(results);
+  result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
@@ -851,7 +2051,7 @@ returnCode DB::addAccess(const std::string &src_user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  result = neo4j_fetch_next(results);
+  result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
@@ -892,11 +2092,40 @@ returnCode DB::checkAccess(const std::string &src_user_pkey,
                            const std::string &dst_user_pkey,
                            const std::string &task_list_pkey,
                            bool &read_write) {
+  TRACE_SCOPE("DB", __func__);
   if (src_user_pkey == dst_user_pkey) {
     read_write = true;
     return SUCCESS;
   }
+  if (!cache_) {
+    return queryAccess(src_user_pkey, dst_user_pkey, task_list_pkey,
+                       read_write);
+  }
+
+  // value: the returnCode and read_write
+  const std::string cache_key =
+      DBCache::Key({src_user_pkey, task_list_pkey, dst_user_pkey});
+  std::string cached;
+  if (cache_->Get(DBCache::ACCESS, cache_key, cached) && cached.size() == 2) {
+    read_write = cached[1] == '1';
+    return (returnCode)cached[0];
+  }
+  const uint64_t generation = cache_->Generation();
+  returnCode ret =
+      queryAccess(src_user_pkey, dst_user_pkey, task_list_pkey, read_write);
+  // only the answers, not the missing nodes or failures
+  if (ret == SUCCESS || ret == ERR_ACCESS) {
+    cache_->Put(DBCache::ACCESS, cache_key,
+                {(char)ret, ret == SUCCESS && read_write ? '1' : '0'},
+                generation);
+  }
+  return ret;
+}
 
+returnCode DB::queryAccess(const std::string &src_user_pkey,
+                           const std::string &dst_user_pkey,
+                           const std::string &task_list_pkey,
+                           bool &read_write) {
   neo4j_connection_t *connection = connectDB();
 
   // Check User node exists - src
@@ -908,7 +2137,7 @@ returnCode DB::checkAccess(const std::string &src_user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  neo4j_result_t *result = neo4j_fetch_next(results);
+  neo4j_result_t *result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
@@ -922,7 +2151,7 @@ returnCode DB::checkAccess(const std::string &src_user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  result = neo4j_fetch_next(results);
+  result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
@@ -937,7 +2166,7 @@ returnCode DB::checkAccess(const std::string &src_user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  result = neo4j_fetch_next(results);
+  result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
@@ -971,7 +2200,7 @@ returnCode DB::checkAccess(const std::string &src_user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  result = neo4j_fetch_next(results);
+  result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
@@ -987,9 +2216,346 @@ returnCode DB::checkAccess(const std::string &src_user_pkey,
   return SUCCESS;
 }
 
+returnCode DB::getChangesSince(const std::string &user_pkey, long long since,
+                                long long &version,
+                                std::vector<DBChange> &changes) {
+  TRACE_SCOPE("DB", __func__);
+  neo4j_connection_t *connection = connectDB();
+
+  // Clear vector
+  changes.clear();
+
+  // The user row carries the current version, and tells a user without
+  // changes apart from a missing user
+  const std::string user = "'" + user_pkey + "'";
+  const std::string after = std::to_string(since);
+  std::string query =
+      "MATCH (n:User {email: " + user +
+      "}) RETURN 'user' AS kind, n AS node, coalesce(n.version, 0) AS version "
+      "UNION ALL MATCH (n:TaskList) WHERE n.user = " + user +
+      " AND n.version > " + after +
+      " RETURN 'list' AS kind, n AS node, n.version AS version "
+      "UNION ALL MATCH (n:Task) WHERE n.user = " + user +
+      " AND n.version > " + after +
+      " RETURN 'task' AS kind, n AS node, n.version AS version "
+      "UNION ALL MATCH (n:Tombstone) WHERE n.user = " + user +
+      " AND n.version > " + after +
+      " RETURN 'deleted' AS kind, n AS node, n.version AS version";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+
+  // Extract returned info
+  bool user_exists = false;
+  neo4j_result_t *result;
+  while ((result = fetchNext(results)) != NULL) {
+    std::string kind = valueToString(neo4j_result_field(result, 0));
+    long long node_version = neo4j_int_value(neo4j_result_field(result, 2));
+    if (kind == "user") {
+      user_exists = true;
+      version = node_version;
+      continue;
+    }
+    std::map<std::string, std::string> info =
+        nodeProperties(neo4j_result_field(result, 1));
+    DBChange change;
+    change.version = node_version;
+    if (kind == "list") {
+      change.list = info["name"];
+    } else {
+      change.list = info["list"];
+      change.task = kind == "task" ? info["name"] : info["task"];
+      change.deleted = kind == "deleted";
+    }
+    if (!change.deleted) {
+      info.erase("user");
+      info.erase("list");
+      info.erase("version");
+      info.erase("counts");
+      change.info = std::move(info);
+    }
+    changes.push_back(std::move(change));
+  }
+  if (!user_exists) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_NO_NODE;
+  }
+  std::sort(changes.begin(), changes.end(),
+            [](const DBChange &a, const DBChange &b) {
+              return a.version < b.version;
+            });
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::exportUser(const std::string &user_pkey,
+                          const DBExportCallback &emit) {
+  TRACE_SCOPE("DB", __func__);
+  neo4j_connection_t *connection = connectDB();
+
+  // One traversal, the user comes back with every row, a task list with
+  // every one of its tasks, and a task list without tasks once with a null
+  std::string query = "MATCH (u:User {email: '" + user_pkey +
+                      "'}) OPTIONAL MATCH (u)-[:Owns]->(l:TaskList) "
+                      "OPTIONAL MATCH (l)-[:Contains]->(t:Task) RETURN u, l, t";
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+
+  // Hand records over as they stream in, only the task list names are kept
+  bool user_exists = false;
+  bool more = true;
+  std::set<std::string> lists;
+  neo4j_result_t *result;
+  while (more && (result = fetchNext(results)) != NULL) {
+    if (!user_exists) {
+      user_exists = true;
+      std::map<std::string, std::string> info =
+          nodeProperties(neo4j_result_field(result, 0));
+      info.erase("passwd");
+      info.erase("version");
+      more = emit("", "", info);
+    }
+    neo4j_value_t list = neo4j_result_field(result, 1);
+    if (!more || neo4j_is_null(list)) {
+      continue;
+    }
+    std::map<std::string, std::string> info = nodeProperties(list);
+    const std::string list_name = info["name"];
+    if (lists.insert(list_name).second) {
+      info.erase("user");
+      info.erase("version");
+      info.erase("counts");
+      more = emit(list_name, "", info);
+    }
+    neo4j_value_t task = neo4j_result_field(result, 2);
+    if (!more || neo4j_is_null(task)) {
+      continue;
+    }
+    info = nodeProperties(task);
+    info.erase("user");
+    info.erase("list");
+    info.erase("version");
+    more = emit(list_name, info["name"], info);
+  }
+  if (!user_exists) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_NO_NODE;
+  }
+
+  // Success, also when the caller stopped early
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
+returnCode DB::importBatch(std::vector<DBImportRecord> &records) {
+  TRACE_SCOPE("DB", __func__);
+  CacheInvalidation invalidate(cache_.get());
+  if (records.empty()) {
+    return SUCCESS;
+  }
+  const DBImportRecord::Kind kind = records.front().kind;
+
+  // Check every record as the create methods would, and turn the valid ones
+  // into rows of a list literal, numbered to match the results back
+  std::set<std::vector<std::string>> keys;
+  std::string rows;
+  for (size_t i = 0; i < records.size(); i++) {
+    DBImportRecord &record = records[i];
+    if (record.kind != kind) {
+      return ERR_FORMAT;
+    }
+    std::map<std::string, std::string> info = record.info;
+    std::vector<std::string> key;
+    record.result = SUCCESS;
+    switch (kind) {
+    case DBImportRecord::USER:
+      info.erase("version");
+      if (info.find("email") == info.end()) {
+        record.result = ERR_KEY;
+      } else if (info.find("passwd") == info.end()) {
+        record.result = ERR_RFIELD;
+      }
+      key = {info["email"]};
+      break;
+    case DBImportRecord::TASKLIST:
+      info.erase("user");
+      info.erase("version");
+      info.erase("counts");
+      if (info.find("name") == info.end()) {
+        record.result = ERR_KEY;
+      } else if (record.user.empty()) {
+        record.result = ERR_RFIELD;
+      }
+      if (info.find("visibility") == info.end()) {
+        info["visibility"] = "private";
+      }
+      key = {record.user, info["name"]};
+      break;
+    case DBImportRecord::TASK:
+      info.erase("user");
+      info.erase("list");
+      info.erase("version");
+      if (info.find("name") == info.end()) {
+        record.result = ERR_KEY;
+      } else if (record.user.empty() || record.list.empty()) {
+        record.result = ERR_RFIELD;
+      }
+      key = {record.user, record.list, info["name"]};
+      break;
+    case DBImportRecord::ACCESS:
+      if (record.user.empty() || record.list.empty() ||
+          record.dst_user.empty()) {
+        record.result = ERR_RFIELD;
+      }
+      invalidate.Key(DBCache::ACCESS, DBCache::Key({record.user, record.list,
+                                                    record.dst_user}));
+      break;
+    }
+    for (auto it = info.begin(); it != info.end() && record.result == SUCCESS;
+         it++) {
+      if (!isIdentifier(it->first)) {
+        record.result = ERR_FORMAT;
+      }
+    }
+    // the constraints would reject the whole statement
+    if (record.result == SUCCESS && !key.empty() && !keys.insert(key).second) {
+      record.result = ERR_DUP_NODE;
+    }
+    if (record.result != SUCCESS) {
+      continue;
+    }
+
+    std::string props;
+    for (auto it = info.begin(); it != info.end(); it++) {
+      props += (props.empty() ? "" : ", ") + it->first + ": " +
+               cypherString(it->second);
+    }
+    rows += rows.empty() ? "[" : ", ";
+    rows += "{i: " + std::to_string(i) +
+            ", user: " + cypherString(record.user) +
+            ", list: " + cypherString(record.list) +
+            ", dst: " + cypherString(record.dst_user) +
+            ", read_write: " + std::to_string(record.read_write) +
+            ", props: {" + props + "}}";
+  }
+  if (rows.empty()) {
+    return SUCCESS;
+  }
+  rows += "]";
+  if (kind == DBImportRecord::TASKLIST) {
+    invalidate.Key(DBCache::PUBLIC, "");
+  }
+
+  // Every row reports 0: created, 1: no parent, 2: duplicate, 3: private list.
+  // Task lists and tasks take one change version per owner and statement.
+  std::string query = "UNWIND " + rows + " AS row ";
+  switch (kind) {
+  case DBImportRecord::USER:
+    query += "OPTIONAL MATCH (e:User {email: row.props.email}) "
+             "FOREACH (_ IN CASE WHEN e IS NULL THEN [1] ELSE [] END | "
+             "CREATE (n:User) SET n = row.props) "
+             "RETURN row.i, CASE WHEN e IS NULL THEN 0 ELSE 2 END";
+    break;
+  case DBImportRecord::TASKLIST:
+    query += "WITH row.user AS user, collect(row) AS rows "
+             "OPTIONAL MATCH (owner:User {email: user}) "
+             "SET owner.version = coalesce(owner.version, 0) + 1 "
+             "WITH owner, rows UNWIND rows AS row "
+             "OPTIONAL MATCH (e:TaskList {name: row.props.name, user: "
+             "row.user}) "
+             "FOREACH (_ IN CASE WHEN owner IS NOT NULL AND e IS NULL THEN [1] "
+             "ELSE [] END | CREATE (owner)-[:Owns]->(n:TaskList) "
+             "SET n = row.props, n.user = row.user, n.version = owner.version) "
+             "RETURN row.i, CASE WHEN owner IS NULL THEN 1 "
+             "WHEN e IS NOT NULL THEN 2 ELSE 0 END";
+    break;
+  case DBImportRecord::TASK:
+    // appended to their task list in the order of the rows, as
+    // createTaskNode would one by one
+    query += "WITH row.user AS user, collect(row) AS rows "
+             "OPTIONAL MATCH (owner:User {email: user}) "
+             "SET owner.version = coalesce(owner.version, 0) + 1 "
+             "WITH owner, user, rows UNWIND rows AS row "
+             "WITH owner, user, row.list AS list, collect(row) AS rows "
+             "OPTIONAL MATCH (o:Task {user: user, list: list}) "
+             "WITH owner, rows, max(o.position) AS last "
+             "WITH owner, rows, reduce(ps = [], row IN rows | ps + [" +
+             appendPosition("coalesce(ps[-1], last)") + "]) AS positions "
+             "UNWIND range(0, size(rows) - 1) AS k "
+             "WITH owner, rows[k] AS row, positions[k] AS position "
+             "OPTIONAL MATCH (l:TaskList {name: row.list, user: row.user}) "
+             "OPTIONAL MATCH (e:Task {name: row.props.name, list: row.list, "
+             "user: row.user}) "
+             "FOREACH (_ IN CASE WHEN l IS NOT NULL AND e IS NULL THEN [1] "
+             "ELSE [] END | CREATE (l)-[:Contains]->(n:Task) "
+             "SET n = row.props, n.list = row.list, n.user = row.user, "
+             "n.position = position, n.version = owner.version " +
+             stampDone("n") + countTask("l", "n", true) + ") "
+             "RETURN row.i, CASE WHEN l IS NULL THEN 1 "
+             "WHEN e IS NOT NULL THEN 2 ELSE 0 END";
+    break;
+  case DBImportRecord::ACCESS:
+    query += "OPTIONAL MATCH (m:TaskList {name: row.list, user: row.user}) "
+             "OPTIONAL MATCH (n:User {email: row.dst}) "
+             "WITH row, m, n, CASE WHEN m IS NULL OR n IS NULL THEN 1 "
+             "WHEN m.visibility = 'private' THEN 3 ELSE 0 END AS status "
+             "FOREACH (_ IN CASE WHEN status = 0 THEN [1] ELSE [] END | "
+             "MERGE (n)-[r:Access]->(m) SET r.read_write = row.read_write) "
+             "RETURN row.i, status";
+    break;
+  }
+
+  neo4j_connection_t *connection = connectDB();
+  neo4j_result_stream_t *results = executeQuery(query, connection);
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+
+  // Extract returned info
+  static const returnCode statuses[] = {SUCCESS, ERR_NO_NODE, ERR_DUP_NODE,
+                                        ERR_ACCESS};
+  neo4j_result_t *result;
+  while ((result = fetchNext(results)) != NULL) {
+    long long i = neo4j_int_value(neo4j_result_field(result, 0));
+    long long status = neo4j_int_value(neo4j_result_field(result, 1));
+    if (i >= 0 && i < (long long)records.size() && status >= 0 && status < 4) {
+      records[i].result = statuses[status];
+    }
+  }
+  if (neo4j_check_failure(results)) {
+    neo4j_close_results(results);
+    closeDB(connection);
+    return ERR_UNKNOWN;
+  }
+
+  // Success
+  neo4j_close_results(results);
+  closeDB(connection);
+  return SUCCESS;
+}
+
 returnCode DB::removeAccess(const std::string &src_user_pkey,
                             const std::string &dst_user_pkey,
                             const std::string &task_list_pkey) {
+  TRACE_SCOPE("DB", __func__);
+  CacheInvalidation invalidate(cache_.get());
+  invalidate.Key(DBCache::ACCESS,
+                 DBCache::Key({src_user_pkey, task_list_pkey, dst_user_pkey}));
   neo4j_connection_t *connection = connectDB();
 
   // Remove access relationship
@@ -1012,6 +2578,7 @@ returnCode DB::removeAccess(const std::string &src_user_pkey,
 returnCode DB::allAccess(
     const std::string &dst_user_pkey,
     std::map<std::pair<std::string, std::string>, bool> &list_accesses) {
+  TRACE_SCOPE("DB", __func__);
   neo4j_connection_t *connection = connectDB();
 
   // clear map
@@ -1026,7 +2593,7 @@ returnCode DB::allAccess(
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  neo4j_result_t *result = neo4j_fetch_next(results);
+  neo4j_result_t *result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
@@ -1043,7 +2610,7 @@ returnCode DB::allAccess(
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  while ((result = neo4j_fetch_next(results)) != NULL) {
+  while ((result = fetchNext(results)) != NULL) {
     // Check TaskList visibility
     neo4j_value_t value = neo4j_result_field(result, 2);
     char buf[1024];
@@ -1080,6 +2647,7 @@ returnCode DB::allAccess(
 returnCode DB::allGrant(const std::string &src_user_pkey,
                         const std::string &task_list_pkey,
                         std::map<std::string, bool> &list_grants) {
+  TRACE_SCOPE("DB", __func__);
   neo4j_connection_t *connection = connectDB();
 
   // clear map
@@ -1094,7 +2662,7 @@ returnCode DB::allGrant(const std::string &src_user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  neo4j_result_t *result = neo4j_fetch_next(results);
+  neo4j_result_t *result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
@@ -1109,7 +2677,7 @@ returnCode DB::allGrant(const std::string &src_user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  result = neo4j_fetch_next(results);
+  result = fetchNext(results);
   if (result == NULL) {
     neo4j_close_results(results);
     closeDB(connection);
@@ -1137,7 +2705,7 @@ returnCode DB::allGrant(const std::string &src_user_pkey,
     closeDB(connection);
     return ERR_UNKNOWN;
   }
-  while ((result = neo4j_fetch_next(results)) != NULL) {
+  while ((result = fetchNext(results)) != NULL) {
     // Check access relationship
     neo4j_value_t value = neo4j_result_field(result, 0);
     char buf[1024];
@@ -1159,6 +2727,26 @@ returnCode DB::allGrant(const std::string &src_user_pkey,
 
 returnCode
 DB::getAllPublic(std::vector<std::pair<std::string, std::string>> &user_list) {
+  TRACE_SCOPE("DB", __func__);
+  if (!cache_) {
+    return queryAllPublic(user_list);
+  }
+
+  std::string cached;
+  if (cache_->Get(DBCache::PUBLIC, "", cached)) {
+    user_list = DBCache::Decode(cached);
+    return SUCCESS;
+  }
+  const uint64_t generation = cache_->Generation();
+  returnCode ret = queryAllPublic(user_list);
+  if (ret == SUCCESS) {
+    cache_->Put(DBCache::PUBLIC, "", DBCache::Encode(user_list), generation);
+  }
+  return ret;
+}
+
+returnCode DB::queryAllPublic(
+    std::vector<std::pair<std::string, std::string>> &user_list) {
   neo4j_connection_t *connection = connectDB();
 
   // clear vector
@@ -1174,7 +2762,7 @@ DB::getAllPublic(std::vector<std::pair<std::string, std::string>> &user_list) {
     return ERR_UNKNOWN;
   }
   neo4j_result_t *result;
-  while ((result = neo4j_fetch_next(results)) != NULL) {
+  while ((result = fetchNext(results)) != NULL) {
     // Get TaskList info
     neo4j_value_t value = neo4j_result_field(result, 0);
     char buf[1024];
@@ -1197,6 +2785,12 @@ DB::getAllPublic(std::vector<std::pair<std::string, std::string>> &user_list) {
 }
 
 returnCode DB::deleteEverything(void) {
+  TRACE_SCOPE("DB", __func__);
+  CacheInvalidation invalidate(cache_.get());
+  invalidate.Prefix(DBCache::USER, "");
+  invalidate.Prefix(DBCache::TASKLIST, "");
+  invalidate.Prefix(DBCache::ACCESS, "");
+  invalidate.Key(DBCache::PUBLIC, "");
   neo4j_connection_t *connection = connectDB();
   std::string query = "MATCH (n) DETACH DELETE n";
 
@@ -1214,6 +2808,7 @@ returnCode DB::deleteEverything(void) {
 }
 
 neo4j_connection_t *DB::connectDB() {
+  request_stats.connections++;
   neo4j_connection_t *connection =
       neo4j_connect(host_.c_str(), NULL, NEO4J_INSECURE);
   if (!connection) {
@@ -1222,44 +2817,291 @@ neo4j_connection_t *DB::connectDB() {
   return connection;
 }
 
-void DB::closeDB(neo4j_connection_t *connection) { neo4j_close(connection); }
+void DB::closeDB(neo4j_connection_t *connection) {
+  finishQuery();
+  neo4j_close(connection);
+}
 
 neo4j_result_stream_t *DB::executeQuery(const std::string &query,
-                                        neo4j_connection_t *connection) {
+                                        neo4j_connection_t *connection,
+                                        const char *caller) {
+  finishQuery();
+  request_stats.queries++;
+  if (slow_query_ms_ >= 0 || Trace::Enabled()) {
+    pending_query.caller = caller;
+    pending_query.query = query;
+    pending_query.rows = 0;
+    pending_query.start = std::chrono::steady_clock::now();
+  }
   // Execute the query
   neo4j_result_stream_t *results =
       neo4j_run(connection, query.c_str(), neo4j_null);
   return results;
 }
 
-void DB::ensureConstraints() {
-  // Create constraints for User_pkey
-  std::string query = "CREATE CONSTRAINT User_pkey IF NOT EXISTS FOR (n:User) "
-                      "REQUIRE n.email IS UNIQUE";
-  neo4j_connection_t *connection = connectDB();
-  neo4j_result_stream_t *results = executeQuery(query, connection);
-  if (neo4j_check_failure(results)) {
-    closeDB(connection);
-    throw std::runtime_error(get_Neo4jC_error());
+neo4j_result_t *DB::fetchNext(neo4j_result_stream_t *results) {
+  neo4j_result_t *result = neo4j_fetch_next(results);
+  if (result != NULL)
+    pending_query.rows++;
+  return result;
+}
+
+void DB::finishQuery() {
+  if (pending_query.caller == nullptr)
+    return;
+  const char *caller = pending_query.caller;
+  pending_query.caller = nullptr;
+
+  auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - pending_query.start)
+                        .count();
+  Trace::Record("neo4j", caller, Trace::ToUs(pending_query.start), elapsed_us);
+
+  auto elapsed = elapsed_us / 1000;
+  if (slow_query_ms_ < 0 || elapsed < slow_query_ms_)
+    return;
+
+  const std::string time_str = logTime();
+  std::lock_guard<std::mutex> guard(slow_log_lock_);
+  *slow_log_ << "[" << time_str << "] " << elapsed << " ms rows "
+             << pending_query.rows << " DB::" << caller << " "
+             << redactLiterals(pending_query.query) << "\n";
+  slow_log_->flush();
+
+  // profiling is another round trip, left to the profiling thread
+  slow_query_count_++;
+  if (profile_every_ > 0 && slow_query_count_ % profile_every_ == 0 &&
+      profile_queue_.size() < kMaxPendingProfiles &&
+      isReadOnly(pending_query.query)) {
+    profile_queue_.emplace_back(caller, pending_query.query);
+    profile_cv_.notify_one();
   }
-  // Create constraints for TaskList_pkey
-  query = "CREATE CONSTRAINT TaskList_pkey IF NOT EXISTS FOR (n:TaskList) "
-          "REQUIRE (n.name, n.user) IS UNIQUE";
-  results = executeQuery(query, connection);
-  if (neo4j_check_failure(results)) {
-    closeDB(connection);
-    throw std::runtime_error(get_Neo4jC_error());
+}
+
+void DB::profileLoop() {
+  std::unique_lock<std::mutex> guard(slow_log_lock_);
+  for (;;) {
+    profile_cv_.wait(guard, [this]() {
+      return profile_stopping_ || !profile_queue_.empty();
+    });
+    if (profile_stopping_)
+      return;
+    std::pair<const char *, std::string> next =
+        std::move(profile_queue_.front());
+    profile_queue_.pop_front();
+
+    guard.unlock();
+    std::string plan = profileQuery(next.second);
+    const std::string time_str = logTime();
+    guard.lock();
+    *slow_log_ << "[" << time_str << "] PROFILE DB::" << next.first << " "
+               << redactLiterals(next.second) << "\n"
+               << plan;
+    slow_log_->flush();
   }
-  // Create constraints for Task_pkey
-  query = "CREATE CONSTRAINT Task_pkey IF NOT EXISTS FOR (n:Task) "
-          "REQUIRE (n.name, n.list, n.user) IS UNIQUE";
-  results = executeQuery(query, connection);
-  if (neo4j_check_failure(results)) {
-    closeDB(connection);
-    throw std::runtime_error(get_Neo4jC_error());
+}
+
+std::string DB::profileQuery(const std::string &query) {
+  // not through connectDB, so that profiling is not counted for the request
+  neo4j_connection_t *connection =
+      neo4j_connect(host_.c_str(), NULL, NEO4J_INSECURE);
+  if (connection == NULL)
+    return {};
+
+  std::string plan_text;
+  std::string profile = "PROFILE " + query;
+  neo4j_result_stream_t *results =
+      neo4j_run(connection, profile.c_str(), neo4j_null);
+  if (results != NULL && !neo4j_check_failure(results)) {
+    // the plan is only available once all records are consumed
+    while (neo4j_fetch_next(results) != NULL) {
+    }
+    struct neo4j_statement_plan *plan = neo4j_statement_plan(results);
+    if (plan != NULL) {
+      appendPlanStep(plan->output_step, 1, plan_text);
+      neo4j_statement_plan_release(plan);
+    }
   }
-  closeDB(connection);
-  neo4j_close_results(results);
+  if (results != NULL)
+    neo4j_close_results(results);
+  neo4j_close(connection);
+  return plan_text;
+}
+
+returnCode DB::setSlowQueryLog(const std::string &path, int threshold_ms,
+                               int profile_every) {
+  std::unique_ptr<std::ofstream> log =
+      std::make_unique<std::ofstream>(path, std::ios::app);
+  if (!log->is_open()) {
+    return ERR_UNKNOWN;
+  }
+
+  std::lock_guard<std::mutex> guard(slow_log_lock_);
+  slow_log_ = std::move(log);
+  slow_query_ms_ = threshold_ms;
+  profile_every_ = profile_every;
+  if (profile_every > 0 && !profile_thread_.joinable()) {
+    profile_thread_ = std::thread(&DB::profileLoop, this);
+  }
+  return SUCCESS;
+}
+
+void DB::enableCache(size_t capacity) {
+  // a snapshot is only loaded into the cache of the host it was taken from,
+  // hashed to keep the credentials in the host out of the file
+  cache_ = std::make_unique<DBCache>(
+      capacity, std::to_string(std::hash<std::string>()(host_)));
+}
+
+returnCode DB::saveCacheSnapshot(const std::string &path) {
+  if (!cache_) {
+    return ERR_UNKNOWN;
+  }
+  return cache_->Save(path);
+}
+
+returnCode DB::loadCacheSnapshot(const std::string &path) {
+  if (!cache_) {
+    return ERR_UNKNOWN;
+  }
+  return cache_->Load(path);
+}
+
+size_t DB::revalidateCache(std::chrono::milliseconds pause) {
+  if (!cache_) {
+    return 0;
+  }
+  auto keys = cache_->TakeUnverified();
+  for (auto &key : keys) {
+    // drop the entry and read it again through the cache
+    cache_->Erase(key.first, key.second);
+    std::vector<std::string> parts = DBCache::SplitKey(key.second);
+    std::map<std::string, std::string> info;
+    std::vector<std::pair<std::string, std::string>> user_list;
+    try {
+      if (key.first == DBCache::USER && parts.size() == 1) {
+        getUserNode(parts[0], info);
+      } else if (key.first == DBCache::TASKLIST && parts.size() == 2) {
+        getTaskListNode(parts[0], parts[1], info);
+      } else if (key.first == DBCache::PUBLIC) {
+        getAllPublic(user_list);
+      }
+      // access checks are not in snapshots and stay dropped
+    } catch (const std::runtime_error &) {
+      // neo4j went away, the entry stays dropped
+    }
+    std::this_thread::sleep_for(pause);
+  }
+  return keys.size();
+}
+
+/* Constraints and indexes, all idempotent and independent of each other */
+static const std::string schema_statements[] = {
+    "CREATE CONSTRAINT User_pkey IF NOT EXISTS FOR (n:User) "
+    "REQUIRE n.email IS UNIQUE",
+    "CREATE CONSTRAINT TaskList_pkey IF NOT EXISTS FOR (n:TaskList) "
+    "REQUIRE (n.name, n.user) IS UNIQUE",
+    "CREATE CONSTRAINT Task_pkey IF NOT EXISTS FOR (n:Task) "
+    "REQUIRE (n.name, n.list, n.user) IS UNIQUE",
+    "CREATE INDEX TaskList_version IF NOT EXISTS FOR (n:TaskList) "
+    "ON (n.user, n.version)",
+    "CREATE INDEX Task_version IF NOT EXISTS FOR (n:Task) "
+    "ON (n.user, n.version)",
+    "CREATE INDEX Tombstone_version IF NOT EXISTS FOR (n:Tombstone) "
+    "ON (n.user, n.version)",
+    "CREATE INDEX Task_due IF NOT EXISTS FOR (n:Task) ON (n.user, n.due)",
+    "CREATE INDEX Task_position IF NOT EXISTS FOR (n:Task) "
+    "ON (n.user, n.list, n.position)",
+    "CREATE INDEX Task_recurrence IF NOT EXISTS FOR (n:Task) "
+    "ON (n.user, n.recurrence)",
+    // the due tasks of all users, for the reminders
+    "CREATE INDEX Task_reminder IF NOT EXISTS FOR (n:Task) ON (n.due)",
+    // the done tasks to archive, and the archived tasks of a task list
+    "CREATE INDEX Task_done IF NOT EXISTS FOR (n:Task) ON (n.status, n.doneAt)",
+    "CREATE INDEX ArchivedTask_list IF NOT EXISTS FOR (n:ArchivedTask) "
+    "ON (n.user, n.list)",
+};
+
+/* Properties the nodes written by older versions lack, each statement
+   idempotent and committing a batch of nodes at a time */
+static const std::string backfill_statements[] = {
+    // the sortable end date of the tasks written before it was kept
+    "MATCH (n:Task) WHERE n.due IS NULL AND n.endDate =~ "
+    "'\\\\d{1,2}([/.-])\\\\d{1,2}\\\\1\\\\d{4}' "
+    "CALL { WITH n "
+    "WITH n, split(replace(replace(n.endDate, '-', '/'), '.', '/'), '/') AS d "
+    "SET n.due = d[2] + '-' + right('0' + d[0], 2) + '-' + "
+    "right('0' + d[1], 2) } IN TRANSACTIONS OF 1000 ROWS",
+    // the done tasks written before the day they were done was kept count
+    // from now on
+    "MATCH (n:Task) WHERE n.status = 'Done' AND n.doneAt IS NULL "
+    "CALL { WITH n SET n.doneAt = toString(date()) } "
+    "IN TRANSACTIONS OF 1000 ROWS",
+    // the counts of the task lists written before they were kept
+    "MATCH (l:TaskList) WHERE l.counts IS NULL "
+    "CALL { WITH l OPTIONAL MATCH (l)-[:Contains]->(t:Task) "
+    "WITH l, collect(t) AS tasks "
+    "SET l.counts = reduce(c = [0, 0, 0, 0, 0, 0, 0, 0], t IN tasks | "
+    "[i IN range(0, 7) | c[i] + " + taskCounts("t") + "[i]]) } "
+    "IN TRANSACTIONS OF 1000 ROWS",
+};
+
+std::string DB::runStartupStatement(const std::string &query) {
+  // Not through connectDB, which throws and counts for the request
+  neo4j_connection_t *connection =
+      neo4j_connect(host_.c_str(), NULL, NEO4J_INSECURE);
+  if (connection == NULL) {
+    return "Connection failed: " + get_Neo4jC_error();
+  }
+
+  std::string error;
+  neo4j_result_stream_t *results =
+      neo4j_run(connection, query.c_str(), neo4j_null);
+  if (results == NULL) {
+    error = get_Neo4jC_error();
+  } else {
+    if (neo4j_check_failure(results)) {
+      const char *message = neo4j_error_message(results);
+      error = message != NULL ? message : get_Neo4jC_error();
+    }
+    neo4j_close_results(results);
+  }
+  neo4j_close(connection);
+  return error;
+}
+
+returnCode DB::Initialize(std::string &error) {
+  // Every statement gets its own connection so that a slow server costs one
+  // round trip instead of one per statement
+  std::vector<std::future<std::string>> results;
+  results.push_back(std::async(std::launch::async, [this]() {
+    return runStartupStatement("RETURN 'hello world'");
+  }));
+  for (const std::string &statement : schema_statements) {
+    results.push_back(std::async(std::launch::async, [this, &statement]() {
+      return runStartupStatement(statement);
+    }));
+  }
+
+  error.clear();
+  for (auto &result : results) {
+    std::string statement_error = result.get();
+    if (error.empty())
+      error = statement_error;
+  }
+  return error.empty() ? SUCCESS : ERR_UNKNOWN;
+}
+
+returnCode DB::backfill(std::string &error) {
+  // One after the other, every batch a transaction of its own, so that the
+  // requests served meanwhile only ever wait for one batch
+  error.clear();
+  for (const std::string &statement : backfill_statements) {
+    std::string statement_error = runStartupStatement(statement);
+    if (error.empty())
+      error = statement_error;
+  }
+  return error.empty() ? SUCCESS : ERR_UNKNOWN;
 }
 
 std::string DB::get_Neo4jC_error() {
@@ -1,15 +1,258 @@
 #pragma once
 
 #include "common/errorCode.h"
+#include "dbCache.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <errno.h>
+#include <fstream>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <utility>
 #include <vector>
 // third party library
 #include "neo4j-client.h"
 
+/**
+ * @brief Round trips to neo4j made while serving the current request.
+ *
+ */
+struct DBRequestStats {
+  /**
+   * @brief number of statements sent to neo4j
+   *
+   */
+  int queries = 0;
+  /**
+   * @brief number of connections opened to neo4j
+   *
+   */
+  int connections = 0;
+};
+
+/**
+ * @brief A task list or task of a user that was created, updated or deleted.
+ *
+ */
+struct DBChange {
+  /**
+   * @brief task list name
+   *
+   */
+  std::string list;
+  /**
+   * @brief task name, empty when the change is to the task list itself
+   *
+   */
+  std::string task;
+  /**
+   * @brief true for a tombstone, deleting a task list also deletes its tasks
+   *
+   */
+  bool deleted = false;
+  /**
+   * @brief change version of the owner, see getChangesSince
+   *
+   */
+  long long version = 0;
+  /**
+   * @brief all fields of the task list or task, empty for a tombstone
+   *
+   */
+  std::map<std::string, std::string> info;
+};
+
+/**
+ * @brief Receives the nodes read by DB::exportUser: the task list name (empty
+ * for the user), the task name (empty for the user and task lists) and the
+ * fields of the node. Returns false to stop the export.
+ *
+ */
+using DBExportCallback = std::function<bool(
+    const std::string &list, const std::string &task,
+    const std::map<std::string, std::string> &info)>;
+
+/**
+ * @brief Primary key of a task: owner, task list and task name, see
+ * DB::getTaskNodes.
+ *
+ */
+using DBTaskKey = std::tuple<std::string, std::string, std::string>;
+
+/**
+ * @brief A task due in the window of DB::getAgenda. Tasks sort by due day,
+ * then priority rank, then owner, task list and task name.
+ *
+ */
+struct DBAgendaTask {
+  /**
+   * @brief owner of the task list
+   *
+   */
+  std::string user;
+  std::string list;
+  std::string task;
+  /**
+   * @brief end date as "YYYY-MM-DD"
+   *
+   */
+  std::string due;
+  /**
+   * @brief priority, 4 for tasks without one so that they come last
+   *
+   */
+  int rank = 0;
+  /**
+   * @brief all fields of the task
+   *
+   */
+  std::map<std::string, std::string> info;
+};
+
+/**
+ * @brief A repeating task, see DB::getAgenda. due is the day of its first
+ * occurrence.
+ *
+ */
+struct DBRecurringTask : DBAgendaTask {
+  /**
+   * @brief days of the occurrences completed in the window, "YYYY-MM-DD"
+   *
+   */
+  std::vector<std::string> done;
+};
+
+/**
+ * @brief Tasks of a task list in one status, see DB::getBoard.
+ *
+ */
+struct DBBoardColumn {
+  /**
+   * @brief "To Do", "Doing" or "Done", tasks without a status are to do
+   *
+   */
+  std::string status;
+  /**
+   * @brief number of tasks in the column, over all pages
+   *
+   */
+  long long total = 0;
+  /**
+   * @brief all fields of the tasks of the page, by priority then name
+   *
+   */
+  std::vector<std::map<std::string, std::string>> tasks;
+};
+
+/**
+ * @brief A task of a task list with the tasks of the list it depends on, see
+ * DB::getTaskGraph.
+ *
+ */
+struct DBGraphTask {
+  std::string task;
+  /**
+   * @brief dates in the format of TaskContent dates, empty if not set
+   *
+   */
+  std::string startDate;
+  std::string endDate;
+  /**
+   * @brief names of the tasks it depends on
+   *
+   */
+  std::vector<std::string> depends_on;
+};
+
+/**
+ * @brief A write of reviseTaskNode to a task: the fields it changed, with
+ * their values before and after, see DB::getTaskRevisions. A field that was
+ * not set is "".
+ *
+ */
+struct DBTaskRevision {
+  /**
+   * @brief change version of the owner the write stamped on the task
+   *
+   */
+  long long version = 0;
+  std::map<std::string, std::string> before;
+  std::map<std::string, std::string> after;
+};
+
+/**
+ * @brief Task counts of a task list, see DB::getTaskListStats. All but
+ * overdue are kept up to date by the task writes.
+ *
+ */
+struct DBTaskListStats {
+  /**
+   * @brief tasks in the task list
+   *
+   */
+  long long total = 0;
+  /**
+   * @brief tasks per status: To Do, Doing, Done. Tasks without a status are
+   * to do
+   *
+   */
+  long long status[3] = {};
+  /**
+   * @brief tasks per priority: none, 1, 2, 3
+   *
+   */
+  long long priority[4] = {};
+  /**
+   * @brief tasks not done whose end date is before today, repeating tasks
+   * left out: their end date ends the repetition
+   *
+   */
+  long long overdue = 0;
+};
+
+/**
+ * @brief A user, task list, task or access grant to create in bulk, see
+ * DB::importBatch.
+ *
+ */
+struct DBImportRecord {
+  enum Kind { USER, TASKLIST, TASK, ACCESS };
+  Kind kind = USER;
+  /**
+   * @brief owner of the task list or task, user that grants access
+   *
+   */
+  std::string user;
+  /**
+   * @brief task list of the task or grant
+   *
+   */
+  std::string list;
+  /**
+   * @brief user that is granted access
+   *
+   */
+  std::string dst_user;
+  bool read_write = false;
+  /**
+   * @brief fields of the node, the primary key included
+   *
+   */
+  std::map<std::string, std::string> info;
+  /**
+   * @brief outcome, set by importBatch
+   *
+   */
+  returnCode result = SUCCESS;
+};
+
 /**
  * @brief This class connect and interact with neo4j DB.
  *
@@ -46,18 +289,103 @@ private:
    * @param query
    * @return neo4j_result_stream_t *: a pointer to a list of results
    */
-  neo4j_result_stream_t *executeQuery(const std::string &query,
-                                      neo4j_connection_t *connection);
+  neo4j_result_stream_t *
+  executeQuery(const std::string &query, neo4j_connection_t *connection,
+               const char *caller = __builtin_FUNCTION());
+  /**
+   * @brief Fetch the next record of a result stream, counting it for the slow
+   * query log.
+   *
+   * @param results result stream returned by executeQuery
+   * @return neo4j_result_t* the next record, NULL if there are no more
+   */
+  neo4j_result_t *fetchNext(neo4j_result_stream_t *results);
+  /**
+   * @brief Stop timing the last statement of the calling thread and log it if
+   * it is slower than the threshold. A statement is timed from executeQuery
+   * until the next executeQuery or closeDB, since neo4j streams the records
+   * lazily while the caller reads them.
+   *
+   */
+  void finishQuery();
+  /**
+   * @brief Run PROFILE for a read only statement on a separate connection.
+   *
+   * @param query the statement to profile
+   * @return std::string the rendered plan, empty on failure
+   */
+  std::string profileQuery(const std::string &query);
+  /**
+   * @brief Body of profile_thread_: profile the queued statements one at a
+   * time and append their plans to the slow query log.
+   *
+   */
+  void profileLoop();
   /**
    * @brief Get Neo4j Client Error Message
    *
    */
   std::string get_Neo4jC_error();
   /**
-   * @brief Ensure to create database constraints
+   * @brief Run a statement at startup on a connection of its own.
    *
+   * @param query the statement to run
+   * @return std::string error message, empty on success
    */
-  void ensureConstraints();
+  std::string runStartupStatement(const std::string &query);
+
+  /**
+   * @brief statements taking at least this many milliseconds are written to
+   * the slow query log, negative when the log is disabled
+   *
+   */
+  int slow_query_ms_ = -1;
+  /**
+   * @brief log the PROFILE plan of every n-th slow read only statement, 0 to
+   * never profile
+   *
+   */
+  int profile_every_ = 0;
+  /**
+   * @brief number of slow statements seen so far
+   *
+   */
+  unsigned long slow_query_count_ = 0;
+  /**
+   * @brief slow query log file
+   *
+   */
+  std::unique_ptr<std::ofstream> slow_log_;
+  /**
+   * @brief statements to profile, as calling DB method and Cypher text, so
+   * that the request that ran them does not wait for the plan
+   *
+   */
+  std::deque<std::pair<const char *, std::string>> profile_queue_;
+  bool profile_stopping_ = false;
+  /* guards the slow query log and the profile queue */
+  std::mutex slow_log_lock_;
+  std::condition_variable profile_cv_;
+  std::thread profile_thread_;
+  /**
+   * @brief read through cache, null unless enableCache was called
+   *
+   */
+  std::unique_ptr<DBCache> cache_;
+
+  /**
+   * @brief The access check behind checkAccess, without the cache.
+   *
+   */
+  returnCode queryAccess(const std::string &src_user_pkey,
+                         const std::string &dst_user_pkey,
+                         const std::string &task_list_pkey, bool &read_write);
+  /**
+   * @brief The query behind getAllPublic, without the cache.
+   *
+   */
+  returnCode
+  queryAllPublic(std::vector<std::pair<std::string, std::string>> &user_list);
 
 public:
   DB() {}
@@ -68,12 +396,115 @@ public:
    * @param host The host address of neo4j DB.
    */
   DB(std::string host);
+
+  /**
+   * @brief Tag of the constructor that does not connect, see
+   * DB(std::string, Deferred).
+   *
+   */
+  struct Deferred {};
+
+  /**
+   * @brief Construct a new DB object without connecting to neo4j DB. Call
+   * Initialize before relying on the constraints.
+   *
+   * @param host The host address of neo4j DB.
+   */
+  DB(std::string host, Deferred);
+
+  /**
+   * @brief Check the connection and create the constraints and indexes. All
+   * statements run concurrently and every one of them is idempotent, so a
+   * failed Initialize can simply be called again.
+   *
+   * @param [out] error the first error, empty on success
+   * @return returnCode SUCCESS or ERR_UNKNOWN
+   */
+  returnCode Initialize(std::string &error);
+  /**
+   * @brief Fill in the properties that nodes written by older versions lack,
+   * e.g. the sortable end date of the tasks, a batch of nodes per
+   * transaction. Call it once Initialize succeeded, the constraints and
+   * indexes being there then, without holding back requests: every
+   * statement is idempotent and nodes written meanwhile already have them.
+   *
+   * @param [out] error the first error, empty on success
+   * @return returnCode SUCCESS or ERR_UNKNOWN
+   */
+  returnCode backfill(std::string &error);
   /**
    * @brief Destroy the DB object: disconnect from neo4j DB.
    *
    */
   ~DB();
 
+  /**
+   * @brief Round trip counters of the calling thread. The http server serves
+   * a request on a single thread, so they act as a per-request context.
+   *
+   * @return DBRequestStats& counters of the calling thread
+   */
+  static DBRequestStats &requestStats();
+  /**
+   * @brief Reset the round trip counters of the calling thread, called at the
+   * start of each request.
+   *
+   */
+  static void resetRequestStats();
+
+  /**
+   * @brief Append statements slower than a threshold to a slow query log, with
+   * the calling DB method, the Cypher text with literals redacted, the number
+   * of records and the wall time. Call it before serving requests.
+   *
+   * @param path file the slow query log is appended to
+   * @param threshold_ms statements taking at least this many milliseconds are
+   * logged
+   * @param profile_every also log the PROFILE plan of every n-th slow read
+   * only statement, 0 to never profile. Plans are made on a thread of their
+   * own and logged after the statement, on a line starting with PROFILE.
+   * @return returnCode ERR_UNKNOWN if the log file cannot be opened
+   */
+  returnCode setSlowQueryLog(const std::string &path, int threshold_ms,
+                             int profile_every = 0);
+
+  /**
+   * @brief Cache users, task list metadata, access checks and the public
+   * directory in memory. Every write through this object invalidates the
+   * entries it affects, so only enable it when this process is the only
+   * writer. Call it before serving requests.
+   *
+   * @param capacity maximum number of cached entries
+   */
+  void enableCache(size_t capacity);
+  /**
+   * @brief Write the cache to a snapshot file.
+   *
+   * @param path snapshot file
+   * @return returnCode ERR_UNKNOWN if the cache is disabled or the file cannot
+   * be written
+   */
+  returnCode saveCacheSnapshot(const std::string &path);
+  /**
+   * @brief Fill the cache from a snapshot file written by saveCacheSnapshot,
+   * so that a restarted server does not start cold. The entries are served
+   * right away, call revalidateCache once neo4j is reachable to refresh them.
+   *
+   * @param path snapshot file
+   * @return returnCode ERR_NO_NODE if there is no snapshot, ERR_FORMAT if it is
+   * corrupt or was written for another host, ERR_UNKNOWN if the cache is
+   * disabled
+   */
+  returnCode loadCacheSnapshot(const std::string &path);
+  /**
+   * @brief Re-read every entry loaded from a snapshot from neo4j, most
+   * recently used first. Entries that cannot be re-read are dropped.
+   *
+   * @param pause time to wait between two entries, to spread the load
+   * @return size_t number of entries revalidated
+   */
+  size_t revalidateCache(std::chrono::milliseconds pause);
+
   /*
    * All parameters are passed by reference. Therefore, the caller should
    * allocate them even if it is a return value. (Except for the return code)
@@ -131,19 +562,22 @@ public:
                      const std::string &task_list_pkey,
                      const std::map<std::string, std::string> &task_list_info);
   /**
-   * @brief Revise a task node.
+   * @brief Revise a task node. The fields it changes are appended to the
+   * revisions of the task in the same statement, see getTaskRevisions.
    *
    * @param [in] user_pkey user primary key
    * @param [in] task_list_pkey task list primary key
    * @param [in] task_pkey task primary key
    * @param [in] task_info key: field name, value: field value
+   * @param [out] revised if not null, all fields of the task once revised
    * @return returnCode error message
    */
   virtual returnCode
   reviseTaskNode(const std::string &user_pkey,
                  const std::string &task_list_pkey,
                  const std::string &task_pkey,
-                 const std::map<std::string, std::string> &task_info);
+                 const std::map<std::string, std::string> &task_info,
+                 std::map<std::string, std::string> *revised = nullptr);
   /**
    * @brief Delete a user node.
    *
@@ -171,6 +605,145 @@ public:
   virtual returnCode deleteTaskNode(const std::string &user_pkey,
                                     const std::string &task_list_pkey,
                                     const std::string &task_pkey);
+  /**
+   * @brief Move a task node to another task list, possibly of another user,
+   * in one statement: the task keeps its fields, leaves a tombstone behind and
+   * moves between the counts of the task lists. Its dependencies, both ways,
+   * stay behind.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] task_list_pkey task list primary key
+   * @param [in] task_pkey task primary key
+   * @param [in] dst_user_pkey user primary key of the target task list
+   * @param [in] dst_task_list_pkey target task list primary key
+   * @param [in] dst_task_pkey task primary key in the target task list
+   * @param [out] task_info all fields of the moved task
+   * @return returnCode ERR_NO_NODE if the task or the target task list does
+   * not exist, ERR_DUP_NODE if the target task list has a task of that name
+   */
+  virtual returnCode
+  moveTaskNode(const std::string &user_pkey, const std::string &task_list_pkey,
+               const std::string &task_pkey, const std::string &dst_user_pkey,
+               const std::string &dst_task_list_pkey,
+               const std::string &dst_task_pkey,
+               std::map<std::string, std::string> &task_info);
+  /**
+   * @brief Copy a task list node and all its task nodes, with the
+   * dependencies between them, into a new private task list, possibly of
+   * another user, in one statement. The new task list is named like
+   * Common::Rename does after the first free suffix.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] task_list_pkey task list primary key
+   * @param [in] dst_user_pkey user primary key of the copy
+   * @param [in] dst_task_list_pkey name wanted for the copy
+   * @param [out] out_task_list_pkey name of the copy
+   * @param [out] task_pkeys names of the tasks copied
+   * @return returnCode ERR_NO_NODE if the task list or the user does not
+   * exist, ERR_DUP_NODE if another write took the name meanwhile
+   */
+  virtual returnCode
+  cloneTaskListNode(const std::string &user_pkey,
+                    const std::string &task_list_pkey,
+                    const std::string &dst_user_pkey,
+                    const std::string &dst_task_list_pkey,
+                    std::string &out_task_list_pkey,
+                    std::vector<std::string> &task_pkeys);
+
+  /**
+   * @brief Make a task depend on another task of its task list, unless the
+   * other task already depends on it, directly or not, which is checked in
+   * the same statement. Adding a dependency twice changes nothing.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] task_list_pkey task list primary key
+   * @param [in] task_pkey task primary key
+   * @param [in] on_task_pkey task it depends on
+   * @return returnCode ERR_NO_NODE if either task does not exist, ERR_FORMAT
+   * if the dependency would close a cycle, a task depending on itself
+   * included
+   */
+  virtual returnCode addDependency(const std::string &user_pkey,
+                                   const std::string &task_list_pkey,
+                                   const std::string &task_pkey,
+                                   const std::string &on_task_pkey);
+  /**
+   * @brief Remove the dependency of a task on another one.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] task_list_pkey task list primary key
+   * @param [in] task_pkey task primary key
+   * @param [in] on_task_pkey task it depends on
+   * @return returnCode ERR_NO_NODE if there is no such dependency
+   */
+  virtual returnCode removeDependency(const std::string &user_pkey,
+                                      const std::string &task_list_pkey,
+                                      const std::string &task_pkey,
+                                      const std::string &on_task_pkey);
+  /**
+   * @brief Get the tasks of a task list with their dates and dependencies in
+   * one query, in the order of getAllTaskNodes.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] task_list_pkey task list primary key
+   * @param [out] tasks
+   * @return returnCode error message
+   */
+  virtual returnCode getTaskGraph(const std::string &user_pkey,
+                                  const std::string &task_list_pkey,
+                                  std::vector<DBGraphTask> &tasks);
+
+  /**
+   * @brief Put a task right after, or right before, another task of its task
+   * list by giving it a position between the anchor and the anchor's
+   * neighbour, see Common::PositionBetween. Only the task is written, unless
+   * the task list has to be rebalanced first because the two share a
+   * position.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] task_list_pkey task list primary key
+   * @param [in] task_pkey task primary key
+   * @param [in] anchor_pkey task to put it next to
+   * @param [in] after after the anchor, otherwise before it
+   * @param [out] position new position of the task
+   * @return returnCode ERR_NO_NODE if either task does not exist
+   */
+  virtual returnCode reorderTaskNode(const std::string &user_pkey,
+                                     const std::string &task_list_pkey,
+                                     const std::string &task_pkey,
+                                     const std::string &anchor_pkey,
+                                     bool after, std::string &position);
+
+  /**
+   * @brief Give the tasks of the task lists with positions missing or longer
+   * than max_length evenly spaced positions, in the order they had. Repeated
+   * reorders at one place lengthen positions, this brings them back; meant to
+   * run in the background.
+   *
+   * @param [in] max_length longest position left alone
+   * @param [in] limit task lists to rebalance at most
+   * @param [out] rebalanced task lists rebalanced
+   * @return returnCode
+   */
+  virtual returnCode rebalanceTaskPositions(size_t max_length, size_t limit,
+                                            size_t &rebalanced);
+
+  /**
+   * @brief Archive the tasks done on or before a day, of all users: they
+   * lose the Task label for ArchivedTask, so that every query of tasks and
+   * their indexes leave them out, and drop out of the counts, the
+   * dependencies and the change feed of their task list, with a tombstone.
+   * A task is done on the day its status became Done, as kept in doneAt;
+   * meant to run in the background. Completed occurrences of repeating
+   * tasks are not archived, see getAgenda.
+   *
+   * @param [in] before "YYYY-MM-DD"
+   * @param [in] limit tasks to archive at most
+   * @param [out] archived tasks archived
+   * @return returnCode
+   */
+  virtual returnCode archiveDoneTasks(const std::string &before, size_t limit,
+                                      size_t &archived);
   /**
    * @brief Get a user node.
    *
@@ -194,6 +767,24 @@ public:
   getTaskListNode(const std::string &user_pkey,
                   const std::string &task_list_pkey,
                   std::map<std::string, std::string> &task_list_info);
+  /**
+   * @brief getTaskListNode with the task counts of the task list, see
+   * getTaskListStats, in the same statement. Never served from the cache.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] task_list_pkey task list primary key
+   * @param [in] today "YYYY-MM-DD", tasks due before it are overdue
+   * @param [in, out] task_list_info key: field name to request, value: field
+   * value to be filled
+   * @param [out] stats counts of the task list
+   * @return returnCode error message
+   */
+  virtual returnCode
+  getTaskListNodeWithStats(const std::string &user_pkey,
+                           const std::string &task_list_pkey,
+                           const std::string &today,
+                           std::map<std::string, std::string> &task_list_info,
+                           DBTaskListStats &stats);
   /**
    * @brief Get a task node.
    *
@@ -208,6 +799,98 @@ public:
                                  const std::string &task_list_pkey,
                                  const std::string &task_pkey,
                                  std::map<std::string, std::string> &task_info);
+  /**
+   * @brief Get many task nodes, of any owners, in a single statement. The
+   * access of the requesting user is decided once per distinct task list in
+   * the same statement, with the rules of checkAccess.
+   *
+   * @param [in] dst_user_pkey user that reads the tasks
+   * @param [in] keys tasks to read
+   * @param [out] results one per key: SUCCESS, ERR_NO_NODE if the task or
+   * task list does not exist, ERR_ACCESS if the task list is not readable
+   * @param [out] task_infos one per key, all fields of the task, empty unless
+   * the result is SUCCESS
+   * @return returnCode error message
+   */
+  virtual returnCode
+  getTaskNodes(const std::string &dst_user_pkey,
+               const std::vector<DBTaskKey> &keys,
+               std::vector<returnCode> &results,
+               std::vector<std::map<std::string, std::string>> &task_infos);
+  /**
+   * @brief Get the tasks due in a window, of the task lists a user owns and
+   * of the task lists shared with it, sorted as DBAgendaTask describes, and
+   * in the same statement the repeating tasks, those with a recurrence,
+   * whose first occurrence is on or before the last day of the window, with
+   * the occurrences of each that were completed in the window. Owned tasks
+   * are found through the (user, due) index, shared ones through the Access
+   * relationships of the user. Repeating tasks are not paged, their
+   * occurrences are computed by the caller.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] from first day, "YYYY-MM-DD"
+   * @param [in] to last day, "YYYY-MM-DD"
+   * @param [in] after null for the first page, otherwise the last task of
+   * the previous page, only the sort key is used
+   * @param [in] limit tasks to return at most, repeating ones aside
+   * @param [out] tasks tasks that do not repeat
+   * @param [out] repeating
+   * @return returnCode error message
+   */
+  virtual returnCode getAgenda(const std::string &user_pkey,
+                               const std::string &from, const std::string &to,
+                               const DBAgendaTask *after, size_t limit,
+                               std::vector<DBAgendaTask> &tasks,
+                               std::vector<DBRecurringTask> &repeating);
+  /**
+   * @brief Get the open tasks of all users due on or after a day, those
+   * whose status is not Done and that do not repeat, by due day, owner, task
+   * list and task name, through the due index. Only user, list, task and due
+   * are read.
+   *
+   * @param [in] from first day, "YYYY-MM-DD"
+   * @param [in] after null for the first page, otherwise the last task of
+   * the previous page
+   * @param [in] limit tasks to return at most
+   * @param [out] tasks
+   * @return returnCode error message
+   */
+  virtual returnCode getOpenDueTasks(const std::string &from,
+                                     const DBAgendaTask *after, size_t limit,
+                                     std::vector<DBAgendaTask> &tasks);
+  /**
+   * @brief Get the tasks of a task list grouped by status, with the size of
+   * each group, in a single aggregation. Only the statuses that have tasks
+   * are returned.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] task_list_pkey task list primary key
+   * @param [in] status only this column, empty for all of them
+   * @param [in] offset tasks to skip in each column
+   * @param [in] limit tasks to return at most in each column
+   * @param [out] columns
+   * @return returnCode error message
+   */
+  virtual returnCode
+  getBoard(const std::string &user_pkey, const std::string &task_list_pkey,
+           const std::string &status, size_t offset, size_t limit,
+           std::vector<DBBoardColumn> &columns);
+  /**
+   * @brief Get the task counts of a task list, or of all the task lists of a
+   * user, those without tasks included. The counts are read from the task
+   * list nodes, only overdue tasks are counted, through the end date index.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] task_list_pkey task list primary key, empty for all of them
+   * @param [in] today "YYYY-MM-DD", tasks due before it are overdue
+   * @param [out] stats counts by task list name
+   * @return returnCode error message, ERR_NO_NODE if the task list asked for
+   * does not exist
+   */
+  virtual returnCode
+  getTaskListStats(const std::string &user_pkey,
+                   const std::string &task_list_pkey, const std::string &today,
+                   std::map<std::string, DBTaskListStats> &stats);
   /**
    * @brief Get all user nodes.
    *
@@ -226,7 +909,7 @@ public:
   getAllTaskListNodes(const std::string &user_pkey,
                       std::vector<std::string> &task_list_info);
   /**
-   * @brief Get all task nodes.
+   * @brief Get all task nodes, ordered by position, then by name.
    *
    * @param [in] user_pkey user primary key
    * @param [in] task_list_pkey task list primary key
@@ -236,6 +919,85 @@ public:
   virtual returnCode getAllTaskNodes(const std::string &user_pkey,
                                      const std::string &task_list_pkey,
                                      std::vector<std::string> &task_info);
+  /**
+   * @brief Get the archived tasks of a task list, see archiveDoneTasks, the
+   * last archived first. A name can come back more than once when tasks of
+   * that name were archived again.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] task_list_pkey task list primary key
+   * @param [in] task_pkey only the tasks of that name, empty for all
+   * @param [out] task_infos all fields of each task, archivedAt included
+   * @return returnCode error message
+   */
+  virtual returnCode getArchivedTaskNodes(
+      const std::string &user_pkey, const std::string &task_list_pkey,
+      const std::string &task_pkey,
+      std::vector<std::map<std::string, std::string>> &task_infos);
+  /**
+   * @brief Get a task with its revisions between two versions, the last
+   * first. The revisions are kept on Revision nodes of the task, one per
+   * reviseTaskNode that changed a field, and go with the task when it is
+   * moved or deleted; the other writes are not revisions.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] task_list_pkey task list primary key
+   * @param [in] task_pkey task primary key
+   * @param [in] after only the revisions after this version, 0 for all
+   * @param [in] before only the revisions before this version, 0 for all
+   * @param [in] limit revisions to return at most, 0 for all
+   * @param [out] task_info all fields of the task as it is now
+   * @param [out] revisions
+   * @return returnCode ERR_NO_NODE if there is no such task
+   */
+  virtual returnCode getTaskRevisions(
+      const std::string &user_pkey, const std::string &task_list_pkey,
+      const std::string &task_pkey, long long after, long long before,
+      size_t limit, std::map<std::string, std::string> &task_info,
+      std::vector<DBTaskRevision> &revisions);
+  /**
+   * @brief Get the task lists and tasks of a user that changed after a
+   * version. Every write to a task list or task increments the change version
+   * of its owner in the same statement and stamps it on the node, deletions
+   * leave a tombstone carrying the version.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] since version the caller is up to date with, 0 for everything
+   * @param [out] version current version of the user
+   * @param [out] changes changes after since, oldest first
+   * @return returnCode error message
+   */
+  virtual returnCode getChangesSince(const std::string &user_pkey,
+                                     long long since, long long &version,
+                                     std::vector<DBChange> &changes);
+  /**
+   * @brief Read a user, its task lists and their tasks in a single traversal,
+   * handing every node to a callback as soon as it is read, so that memory
+   * does not grow with the number of tasks. The user comes first and each
+   * task list before its tasks. Password and bookkeeping fields are left out.
+   *
+   * @param [in] user_pkey user primary key
+   * @param [in] emit called once per node
+   * @return returnCode error message
+   */
+  virtual returnCode exportUser(const std::string &user_pkey,
+                                const DBExportCallback &emit);
+  /**
+   * @brief Create many nodes or access grants of the same kind in a single
+   * UNWIND statement. Every record gets the result the matching create method
+   * or addAccess would have returned: ERR_KEY, ERR_RFIELD, ERR_NO_NODE,
+   * ERR_DUP_NODE, ERR_ACCESS, or ERR_FORMAT for a field name that is not an
+   * identifier. Task lists and tasks bump the change version of their owner
+   * once per statement, and tasks are appended to their task list in the
+   * order of the records. The fields are written as given, check them as
+   * the workers do first, see Importer.
+   *
+   * @param [in, out] records records of one kind, result is filled
+   * @return returnCode ERR_FORMAT if the kinds differ, ERR_UNKNOWN if the
+   * statement failed, e.g. on a duplicate created concurrently, in which case
+   * no record was written
+   */
+  virtual returnCode importBatch(std::vector<DBImportRecord> &records);
   /**
    * @brief Create or Revise access relationship between a user and a task list.
    *
@@ -0,0 +1,317 @@
+#include "dbCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Snapshot layout, all integers in host byte order:
+   magic[8] version:u32 source_len:u32 source count:u64 checksum:u64
+   then count entries of kind:u8 key_len:u32 key value_len:u32 value.
+   The checksum covers the entries. */
+static const char snapshot_magic[8] = {'L', 'Q', 'X', 'X', 'S', 'N', 'A', 'P'};
+static const uint32_t snapshot_version = 1;
+
+static uint64_t fnv1a(const char *data, size_t size) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static void appendU32(std::string &out, uint32_t value) {
+  out.append((const char *)&value, sizeof(value));
+}
+
+static void appendU64(std::string &out, uint64_t value) {
+  out.append((const char *)&value, sizeof(value));
+}
+
+static void appendString(std::string &out, const std::string &value) {
+  appendU32(out, (uint32_t)value.size());
+  out += value;
+}
+
+/* Bounds checked reader over a mapped snapshot or an encoded value */
+class Reader {
+public:
+  Reader(const char *_data, size_t _size) : data(_data), size(_size) {}
+
+  bool U8(uint8_t &value) { return Raw(&value, sizeof(value)); }
+  bool U32(uint32_t &value) { return Raw(&value, sizeof(value)); }
+  bool U64(uint64_t &value) { return Raw(&value, sizeof(value)); }
+
+  bool String(std::string &value) {
+    uint32_t length = 0;
+    if (!U32(length) || size - pos < length)
+      return false;
+    value.assign(data + pos, length);
+    pos += length;
+    return true;
+  }
+
+  bool Raw(void *out, size_t length) {
+    if (size - pos < length)
+      return false;
+    memcpy(out, data + pos, length);
+    pos += length;
+    return true;
+  }
+
+  size_t Pos() const { return pos; }
+  bool Done() const { return pos == size; }
+
+private:
+  const char *data;
+  size_t size;
+  size_t pos = 0;
+};
+
+DBCache::DBCache(size_t _capacity, const std::string &_source)
+    : capacity(_capacity), source(_source) {}
+
+bool DBCache::Get(Kind kind, const std::string &key, std::string &value) {
+  std::lock_guard<std::mutex> guard(lock);
+  auto it = index.find(Id(kind, key));
+  if (it == index.end())
+    return false;
+  entries.splice(entries.begin(), entries, it->second);
+  value = it->second->value;
+  return true;
+}
+
+uint64_t DBCache::Generation() {
+  std::lock_guard<std::mutex> guard(lock);
+  return generation;
+}
+
+void DBCache::Put(Kind kind, const std::string &key, const std::string &value,
+                  uint64_t _generation) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (_generation == generation)
+    PutLocked(kind, key, value);
+}
+
+void DBCache::PutLocked(Kind kind, const std::string &key,
+                        const std::string &value) {
+  const std::string id = Id(kind, key);
+  auto it = index.find(id);
+  if (it != index.end()) {
+    it->second->value = value;
+    entries.splice(entries.begin(), entries, it->second);
+    return;
+  }
+  entries.push_front({kind, key, value});
+  index[id] = entries.begin();
+  while (entries.size() > capacity) {
+    index.erase(Id(entries.back().kind, entries.back().key));
+    entries.pop_back();
+  }
+}
+
+void DBCache::Erase(Kind kind, const std::string &key) {
+  std::lock_guard<std::mutex> guard(lock);
+  generation++;
+  auto it = index.find(Id(kind, key));
+  if (it != index.end()) {
+    entries.erase(it->second);
+    index.erase(it);
+  }
+}
+
+void DBCache::ErasePrefix(Kind kind, const std::string &prefix) {
+  std::lock_guard<std::mutex> guard(lock);
+  generation++;
+  const std::string id = Id(kind, prefix);
+  auto it = index.lower_bound(id);
+  while (it != index.end() && it->first.compare(0, id.size(), id) == 0) {
+    entries.erase(it->second);
+    it = index.erase(it);
+  }
+}
+
+void DBCache::Clear() {
+  std::lock_guard<std::mutex> guard(lock);
+  generation++;
+  entries.clear();
+  index.clear();
+  unverified.clear();
+}
+
+size_t DBCache::Size() {
+  std::lock_guard<std::mutex> guard(lock);
+  return entries.size();
+}
+
+/* An encoded user without its password, which must not reach the disk */
+static std::string WithoutPassword(const std::string &value) {
+  auto pairs = DBCache::Decode(value);
+  auto passwd = std::find_if(pairs.begin(), pairs.end(), [](const auto &pair) {
+    return pair.first == "passwd";
+  });
+  if (passwd == pairs.end())
+    return value;
+  pairs.erase(passwd);
+  return DBCache::Encode(pairs);
+}
+
+returnCode DBCache::Save(const std::string &path) {
+  std::string payload;
+  uint64_t count = 0;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    for (const Entry &entry : entries) {
+      // a grant revoked meanwhile would be served until revalidated
+      if (entry.kind == ACCESS)
+        continue;
+      payload += (char)entry.kind;
+      appendString(payload, entry.key);
+      appendString(payload, entry.kind == USER ? WithoutPassword(entry.value)
+                                               : entry.value);
+      count++;
+    }
+  }
+
+  std::string header(snapshot_magic, sizeof(snapshot_magic));
+  appendU32(header, snapshot_version);
+  appendString(header, source);
+  appendU64(header, count);
+  appendU64(header, fnv1a(payload.data(), payload.size()));
+  const size_t size = header.size() + payload.size();
+
+  const std::string tmp_path = path + ".tmp";
+  int fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0)
+    return ERR_UNKNOWN;
+  if (ftruncate(fd, size) != 0) {
+    close(fd);
+    unlink(tmp_path.c_str());
+    return ERR_UNKNOWN;
+  }
+  void *map = mmap(nullptr, size, PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    close(fd);
+    unlink(tmp_path.c_str());
+    return ERR_UNKNOWN;
+  }
+  memcpy(map, header.data(), header.size());
+  memcpy((char *)map + header.size(), payload.data(), payload.size());
+  bool synced = msync(map, size, MS_SYNC) == 0;
+  munmap(map, size);
+  close(fd);
+
+  if (!synced || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    unlink(tmp_path.c_str());
+    return ERR_UNKNOWN;
+  }
+  return SUCCESS;
+}
+
+returnCode DBCache::Load(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return ERR_NO_NODE;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return ERR_FORMAT;
+  }
+  const size_t size = st.st_size;
+  void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return ERR_UNKNOWN;
+
+  Reader reader((const char *)map, size);
+  char magic[sizeof(snapshot_magic)];
+  uint32_t version = 0;
+  std::string snapshot_source;
+  uint64_t count = 0;
+  uint64_t checksum = 0;
+  bool valid = reader.Raw(magic, sizeof(magic)) &&
+               memcmp(magic, snapshot_magic, sizeof(magic)) == 0 &&
+               reader.U32(version) && version == snapshot_version &&
+               reader.String(snapshot_source) && snapshot_source == source &&
+               reader.U64(count) && reader.U64(checksum) &&
+               fnv1a((const char *)map + reader.Pos(), size - reader.Pos()) ==
+                   checksum;
+
+  std::vector<Entry> loaded;
+  for (uint64_t i = 0; valid && i < count; i++) {
+    uint8_t kind = 0;
+    Entry entry;
+    valid = reader.U8(kind) && kind >= USER && kind <= PUBLIC &&
+            reader.String(entry.key) && reader.String(entry.value);
+    entry.kind = (Kind)kind;
+    loaded.push_back(std::move(entry));
+  }
+  valid = valid && reader.Done();
+  munmap(map, size);
+  if (!valid)
+    return ERR_FORMAT;
+
+  std::lock_guard<std::mutex> guard(lock);
+  // saved most recently used first, insert in reverse to keep that order
+  for (auto it = loaded.rbegin(); it != loaded.rend(); it++) {
+    if (index.count(Id(it->kind, it->key)))
+      continue; // already refreshed from the database
+    PutLocked(it->kind, it->key, it->value);
+    unverified.push_back({it->kind, it->key});
+  }
+  return SUCCESS;
+}
+
+std::vector<std::pair<DBCache::Kind, std::string>> DBCache::TakeUnverified() {
+  std::lock_guard<std::mutex> guard(lock);
+  std::vector<std::pair<Kind, std::string>> keys;
+  keys.swap(unverified);
+  // revalidate the most recently used entries first
+  std::reverse(keys.begin(), keys.end());
+  return keys;
+}
+
+std::string DBCache::Key(const std::vector<std::string> &parts) {
+  std::string key;
+  for (const std::string &part : parts) {
+    key += part;
+    key += '\0';
+  }
+  return key;
+}
+
+std::vector<std::string> DBCache::SplitKey(const std::string &key) {
+  std::vector<std::string> parts;
+  size_t pos = 0;
+  size_t next;
+  while ((next = key.find('\0', pos)) != std::string::npos) {
+    parts.push_back(key.substr(pos, next - pos));
+    pos = next + 1;
+  }
+  return parts;
+}
+
+std::string
+DBCache::Encode(const std::vector<std::pair<std::string, std::string>> &pairs) {
+  std::string value;
+  for (auto &pair : pairs) {
+    appendString(value, pair.first);
+    appendString(value, pair.second);
+  }
+  return value;
+}
+
+std::vector<std::pair<std::string, std::string>>
+DBCache::Decode(const std::string &value) {
+  std::vector<std::pair<std::string, std::string>> pairs;
+  Reader reader(value.data(), value.size());
+  std::string first;
+  std::string second;
+  while (!reader.Done() && reader.String(first) && reader.String(second)) {
+    pairs.push_back({first, second});
+  }
+  return pairs;
+}
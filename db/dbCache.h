@@ -0,0 +1,159 @@
+#pragma once
+
+#include "common/errorCode.h"
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief LRU cache of DB reads that are hot and rarely written: users, task
+ * list metadata, access checks and the public directory. Values are kept
+ * encoded so that the whole cache can be written to and read back from a
+ * snapshot file.
+ *
+ */
+class DBCache {
+public:
+  /**
+   * @brief What a cache entry holds, also stored in snapshots so the values
+   * must never change. Load accepts up to the last one.
+   *
+   */
+  enum Kind : uint8_t {
+    USER = 1,     // key: user, value: encoded user properties, saved
+                  // without the password
+    TASKLIST = 2, // key: user, list, value: encoded task list properties
+    ACCESS = 3,   // key: owner, list, user, value: returnCode and read_write,
+                  // never saved
+    PUBLIC = 4,   // key: empty, value: encoded (user, list) pairs
+  };
+
+  /**
+   * @brief Construct a new DBCache object
+   *
+   * @param _capacity maximum number of entries, the least recently used ones
+   * are evicted beyond it
+   * @param _source identifies the database the entries come from, a snapshot
+   * of another source is never loaded
+   */
+  DBCache(size_t _capacity, const std::string &_source);
+
+  /**
+   * @brief Look an entry up.
+   *
+   * @param [in] kind entry kind
+   * @param [in] key entry key, see Key
+   * @param [out] value encoded value
+   * @return true on a hit
+   */
+  bool Get(Kind kind, const std::string &key, std::string &value);
+
+  /**
+   * @brief Current generation, bumped by every Erase, ErasePrefix and Clear.
+   * Read it before querying the database for a value to Put.
+   *
+   */
+  uint64_t Generation();
+
+  /**
+   * @brief Insert or replace an entry, unless something was invalidated since
+   * the value was read, in which case the value may already be stale.
+   *
+   * @param generation Generation before the value was read
+   */
+  void Put(Kind kind, const std::string &key, const std::string &value,
+           uint64_t generation);
+
+  /**
+   * @brief Drop an entry.
+   *
+   */
+  void Erase(Kind kind, const std::string &key);
+
+  /**
+   * @brief Drop all entries of a kind whose key starts with a prefix.
+   *
+   */
+  void ErasePrefix(Kind kind, const std::string &prefix);
+
+  /**
+   * @brief Drop everything.
+   *
+   */
+  void Clear();
+
+  /**
+   * @brief Number of entries.
+   *
+   */
+  size_t Size();
+
+  /**
+   * @brief Write all entries, most recently used first, to a snapshot file.
+   * Access checks are left out, so that a grant revoked after the snapshot
+   * is never served from it, and so are the passwords of the users, which
+   * have no business on disk. The file is written to a temporary name
+   * through a shared memory mapping and renamed over the old snapshot, so
+   * readers never see a partial file.
+   *
+   * @param path snapshot file
+   * @return returnCode ERR_UNKNOWN if the file cannot be written
+   */
+  returnCode Save(const std::string &path);
+
+  /**
+   * @brief Load the entries of a snapshot file. They are served right away
+   * and listed by TakeUnverified until they have been checked against the
+   * database.
+   *
+   * @param path snapshot file
+   * @return returnCode ERR_NO_NODE if there is no snapshot, ERR_FORMAT if it
+   * is corrupt or of another format version or source
+   */
+  returnCode Load(const std::string &path);
+
+  /**
+   * @brief Take the keys of the loaded entries that still need to be
+   * revalidated.
+   *
+   * @return std::vector<std::pair<Kind, std::string>> (kind, key) pairs
+   */
+  std::vector<std::pair<Kind, std::string>> TakeUnverified();
+
+  /* Helpers to build keys and values */
+
+  static std::string Key(const std::vector<std::string> &parts);
+  static std::vector<std::string> SplitKey(const std::string &key);
+  static std::string
+  Encode(const std::vector<std::pair<std::string, std::string>> &pairs);
+  static std::vector<std::pair<std::string, std::string>>
+  Decode(const std::string &value);
+
+private:
+  struct Entry {
+    Kind kind;
+    std::string key;
+    std::string value;
+  };
+
+  static std::string Id(Kind kind, const std::string &key) {
+    return std::string(1, (char)kind) + key;
+  }
+
+  void PutLocked(Kind kind, const std::string &key, const std::string &value);
+
+  const size_t capacity;
+  const std::string source;
+
+  std::mutex lock;
+  /* most recently used first */
+  std::list<Entry> entries;
+  /* ordered, so that ErasePrefix is a range */
+  std::map<std::string, std::list<Entry>::iterator> index;
+  std::vector<std::pair<Kind, std::string>> unverified;
+  uint64_t generation = 0;
+};
@@ -0,0 +1,305 @@
+#include "importer.h"
+#include "common/trace.h"
+#include "tasklists/tasklistsWorker.h"
+#include "tasks/tasksWorker.h"
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+/* Field values as strings, the way the DB stores them */
+static std::map<std::string, std::string> Fields(const nlohmann::json &data) {
+  std::map<std::string, std::string> fields;
+  for (auto it = data.begin(); it != data.end(); ++it) {
+    fields[it.key()] =
+        it.value().is_string() ? it.value().get<std::string>() : it->dump();
+  }
+  return fields;
+}
+
+/* The fields of a task line as TasksWorker::Create would write them, with
+   the sortable end date, false if it would reject them. Whatever TaskContent
+   does not hold is left out, e.g. the positions and counts the export
+   carries along */
+static bool TaskFields(std::map<std::string, std::string> &info) {
+  auto priority = info.find("priority");
+  if (priority != info.end() &&
+      (priority->second.size() != 1 || priority->second[0] < '0' ||
+       priority->second[0] > '0' + NORMAL))
+    return false;
+  TaskContent task;
+  TasksWorker::Map2TaskStruct(info, task);
+  if (!task.IsValid() || (!task.recurrence.empty() && task.endDate.empty()))
+    return false;
+  info.clear();
+  TasksWorker::TaskStruct2Map(task, info);
+  return true;
+}
+
+/* The fields of a list line as TaskListsWorker::Create would write them */
+static bool TaskListFields(std::map<std::string, std::string> &info) {
+  TasklistContent list;
+  TaskListsWorker::Map2Content(info, list);
+  if (!list.IsValid())
+    return false;
+  info.clear();
+  TaskListsWorker::Content2Map(list, info);
+  return true;
+}
+
+static std::string Describe(const DBImportRecord &record) {
+  switch (record.result) {
+  case ERR_DUP_NODE:
+    return "duplicate";
+  case ERR_NO_NODE:
+    return record.kind == DBImportRecord::ACCESS ? "no such task list or user"
+           : record.kind == DBImportRecord::TASK ? "no such task list"
+                                                 : "no such user";
+  case ERR_KEY:
+    return "missing primary key";
+  case ERR_RFIELD:
+    return "missing required field";
+  case ERR_ACCESS:
+    return "task list is private";
+  case ERR_FORMAT:
+    return "invalid field name";
+  default:
+    return "database error";
+  }
+}
+
+Importer::Importer(std::shared_ptr<DB> _db, size_t _batch_size,
+                   size_t _writers)
+    : db(_db), batch_size(std::max<size_t>(_batch_size, 1)),
+      writers(std::max<size_t>(_writers, 1)) {}
+
+returnCode Importer::Run(std::istream &in, ImportStats &_stats) {
+  TRACE_SCOPE("Importer", __func__);
+  _stats = ImportStats();
+  stats = &_stats;
+  done = false;
+  db_error = false;
+  last_user.clear();
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < writers; i++) {
+    threads.emplace_back(&Importer::WriterLoop, this);
+  }
+
+  std::string line;
+  size_t line_no = 0;
+  while (std::getline(in, line)) {
+    line_no++;
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    DBImportRecord record;
+    bool skip = false;
+    std::string reason;
+    bool parsed = Parse(line, record, skip, reason);
+    std::unique_lock<std::mutex> guard(lock);
+    stats->lines++;
+    if (!parsed) {
+      stats->failed++;
+      Report(line_no, reason);
+    } else if (skip) {
+      stats->skipped++;
+    } else {
+      Add(std::move(record), line_no, guard);
+    }
+  }
+
+  // write what is left in dependency order, then wait for the writers
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    Flush(DBImportRecord::ACCESS, guard);
+    done = true;
+  }
+  cv.notify_all();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  stats = nullptr;
+  return db_error ? ERR_UNKNOWN : SUCCESS;
+}
+
+bool Importer::Parse(const std::string &line, DBImportRecord &record,
+                     bool &skip, std::string &reason) {
+  nlohmann::json object = nlohmann::json::parse(line, nullptr, false);
+  if (!object.is_object()) {
+    reason = "not a json object";
+    return false;
+  }
+  const std::string type = object.value("type", "");
+  nlohmann::json data = object.value("data", nlohmann::json::object());
+  if (!data.is_object()) {
+    reason = "data is not an object";
+    return false;
+  }
+
+  if (type == "user") {
+    record.kind = DBImportRecord::USER;
+    record.info = Fields(data);
+    // bookkeeping is never imported
+    record.info.erase("version");
+    auto email = record.info.find("email");
+    last_user = email == record.info.end() ? "" : email->second;
+    skip = !owner.empty();
+    // the export leaves the password out, such a line only names a user
+    // that already exists
+    if (!skip && email != record.info.end() && !record.info.count("passwd")) {
+      std::map<std::string, std::string> user_info;
+      skip = db->getUserNode(email->second, user_info) == SUCCESS;
+    }
+    return true;
+  }
+
+  // everything else belongs to a user
+  record.user = owner;
+  if (record.user.empty()) {
+    record.user = object.value("user", last_user);
+  }
+  if (type == "list") {
+    record.kind = DBImportRecord::TASKLIST;
+    record.info = Fields(data);
+    if (!TaskListFields(record.info)) {
+      reason = "invalid task list";
+      return false;
+    }
+  } else if (type == "task") {
+    record.kind = DBImportRecord::TASK;
+    record.list = object.value("list", "");
+    record.info = Fields(data);
+    if (!TaskFields(record.info)) {
+      reason = "invalid task";
+      return false;
+    }
+  } else if (type == "grant") {
+    record.kind = DBImportRecord::ACCESS;
+    record.list = object.value("list", "");
+    record.dst_user = object.value("to", "");
+    record.read_write = object.value("read_write", false);
+  } else if (type == "error") {
+    reason = "the export was incomplete";
+    return false;
+  } else {
+    reason = "unknown type '" + type + "'";
+    return false;
+  }
+  return true;
+}
+
+void Importer::Add(DBImportRecord &&record, size_t line,
+                   std::unique_lock<std::mutex> &guard) {
+  Batch &batch = pending[record.kind];
+  batch.kind = record.kind;
+  batch.records.push_back(std::move(record));
+  batch.lines.push_back(line);
+  if (batch.records.size() >= batch_size) {
+    Flush(batch.kind, guard);
+  }
+}
+
+/* Queues the pending batch of a kind after the pending batches of the kinds
+   it depends on, each once the batches of the kinds before it are written */
+void Importer::Flush(DBImportRecord::Kind kind,
+                     std::unique_lock<std::mutex> &guard) {
+  for (int lower = DBImportRecord::USER; lower <= kind; lower++) {
+    Batch &batch = pending[lower];
+    if (batch.records.empty()) {
+      continue;
+    }
+    cv.wait(guard, [this, lower]() {
+      if (queue.size() >= writers) {
+        return false;
+      }
+      for (int dependency = DBImportRecord::USER; dependency < lower;
+           dependency++) {
+        if (in_flight[dependency]) {
+          return false;
+        }
+      }
+      return true;
+    });
+    in_flight[lower]++;
+    queue.push_back(std::move(batch));
+    batch = Batch();
+    cv.notify_all();
+  }
+}
+
+void Importer::WriterLoop() {
+  std::unique_lock<std::mutex> guard(lock);
+  for (;;) {
+    cv.wait(guard, [this]() { return done || !queue.empty(); });
+    if (queue.empty()) {
+      return;
+    }
+    Batch batch = std::move(queue.front());
+    queue.pop_front();
+    cv.notify_all();
+
+    guard.unlock();
+    Write(batch);
+    if (on_task && batch.kind == DBImportRecord::TASK) {
+      for (const DBImportRecord &record : batch.records) {
+        if (record.result == SUCCESS) {
+          on_task(record);
+        }
+      }
+    }
+    guard.lock();
+
+    for (size_t i = 0; i < batch.records.size(); i++) {
+      const DBImportRecord &record = batch.records[i];
+      if (record.result == SUCCESS) {
+        stats->created++;
+      } else if (record.result == ERR_DUP_NODE) {
+        stats->duplicates++;
+        Report(batch.lines[i], Describe(record));
+      } else {
+        stats->failed++;
+        db_error = db_error || record.result == ERR_UNKNOWN;
+        Report(batch.lines[i], Describe(record));
+      }
+    }
+    in_flight[batch.kind]--;
+    cv.notify_all();
+  }
+}
+
+void Importer::Write(Batch &batch) {
+  TRACE_SCOPE("Importer", __func__);
+  if (db->importBatch(batch.records) == SUCCESS) {
+    return;
+  }
+
+  // Nothing of the batch was written, fall back to the create methods for
+  // the records that passed the checks, they tell duplicates apart
+  for (DBImportRecord &record : batch.records) {
+    if (record.result != SUCCESS) {
+      continue;
+    }
+    switch (record.kind) {
+    case DBImportRecord::USER:
+      record.result = db->createUserNode(record.info);
+      break;
+    case DBImportRecord::TASKLIST:
+      record.result = db->createTaskListNode(record.user, record.info);
+      break;
+    case DBImportRecord::TASK:
+      record.result =
+          db->createTaskNode(record.user, record.list, record.info);
+      break;
+    case DBImportRecord::ACCESS:
+      record.result = db->addAccess(record.user, record.dst_user, record.list,
+                                    record.read_write);
+      break;
+    }
+  }
+}
+
+/* Called with lock held */
+void Importer::Report(size_t line, const std::string &reason) {
+  if (stats->errors.size() < kMaxErrors) {
+    stats->errors.push_back("line " + std::to_string(line) + ": " + reason);
+  }
+}
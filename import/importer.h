@@ -0,0 +1,160 @@
+#pragma once
+
+#include "common/errorCode.h"
+#include "db/DB.h"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Outcome of an import, see Importer::Run.
+ *
+ */
+struct ImportStats {
+  /**
+   * @brief non empty lines read
+   *
+   */
+  size_t lines = 0;
+  /**
+   * @brief users, task lists, tasks and grants written
+   *
+   */
+  size_t created = 0;
+  /**
+   * @brief records whose primary key already existed, left unchanged
+   *
+   */
+  size_t duplicates = 0;
+  /**
+   * @brief malformed or invalid lines and records the DB rejected
+   *
+   */
+  size_t failed = 0;
+  /**
+   * @brief lines left out on purpose, e.g. user lines when importing for one
+   * user or without a password for a user that exists
+   *
+   */
+  size_t skipped = 0;
+  /**
+   * @brief the first duplicates and failures, as "line N: reason"
+   *
+   */
+  std::vector<std::string> errors;
+};
+
+/**
+ * @brief Loads newline delimited json, in the format of the export endpoint,
+ * through DB::importBatch. One line per object:
+ *
+ *   {"type": "user", "data": {"email": ..., "passwd": ...}}
+ *   {"type": "list", "data": {"name": ...}}
+ *   {"type": "task", "list": ..., "data": {"name": ...}}
+ *   {"type": "grant", "list": ..., "to": ..., "read_write": true}
+ *
+ * Task lists, tasks and grants belong to the "user" field of the line, or
+ * to the last user line before them. Task lists and tasks are checked and
+ * written as the workers' Create would, without the positions and counts
+ * of the export, and appended to their task list in input order;
+ * the lines they would reject fail. The export leaves passwords out: a user
+ * line without one is skipped if the user exists, and fails otherwise.
+ * Records are batched per type and the batches are written by a pool of
+ * threads, a batch only being written once every batch of the types it
+ * depends on read before it is done. A batch the DB rejects as a whole,
+ * e.g. because another writer created one of its keys concurrently, is
+ * written again one record at a time through the regular create methods.
+ * Memory is bounded by the batch size and the number of writers, not by the
+ * input.
+ *
+ */
+class Importer {
+public:
+  /**
+   * @brief Construct a new Importer object
+   *
+   * @param _db DB to write to
+   * @param _batch_size records per statement
+   * @param _writers threads writing batches concurrently
+   */
+  Importer(std::shared_ptr<DB> _db, size_t _batch_size = 1000,
+           size_t _writers = 4);
+
+  /**
+   * @brief Import everything for one user: task lists, tasks and grants all
+   * belong to it whatever the lines say, and user lines are skipped.
+   *
+   * @param user primary key of the user
+   */
+  void SetOwner(const std::string &user) { owner = user; }
+
+  /**
+   * @brief Call a function for each task written, from the writer threads,
+   * e.g. to set its reminder.
+   *
+   */
+  void SetOnTask(std::function<void(const DBImportRecord &)> callback) {
+    on_task = std::move(callback);
+  }
+
+  /**
+   * @brief Read the whole stream and write it to the DB.
+   *
+   * @param [in] in newline delimited json
+   * @param [out] stats counts and the first errors
+   * @return returnCode ERR_UNKNOWN if some record could not be written
+   * because of a DB error, SUCCESS otherwise, duplicates and malformed lines
+   * included
+   */
+  returnCode Run(std::istream &in, ImportStats &stats);
+
+  /* errors kept in ImportStats::errors */
+  static constexpr size_t kMaxErrors = 100;
+
+private:
+  struct Batch {
+    DBImportRecord::Kind kind = DBImportRecord::USER;
+    std::vector<DBImportRecord> records;
+    /* input line of each record, for the error messages */
+    std::vector<size_t> lines;
+  };
+
+  /* Parse one line into a record, false with a reason if it is malformed */
+  bool Parse(const std::string &line, DBImportRecord &record, bool &skip,
+             std::string &reason);
+  /* Add and Flush are called by the reading thread with lock held */
+  void Add(DBImportRecord &&record, size_t line,
+           std::unique_lock<std::mutex> &guard);
+  void Flush(DBImportRecord::Kind kind, std::unique_lock<std::mutex> &guard);
+  void WriterLoop();
+  void Write(Batch &batch);
+  /* Called with lock held */
+  void Report(size_t line, const std::string &reason);
+
+  std::shared_ptr<DB> db;
+  const size_t batch_size;
+  const size_t writers;
+  std::string owner;
+  std::function<void(const DBImportRecord &)> on_task;
+  /* owner of the records that do not name one, the last user line */
+  std::string last_user;
+
+  /* records read but not handed to a writer yet, one batch per kind */
+  Batch pending[DBImportRecord::ACCESS + 1];
+
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<Batch> queue;
+  /* batches queued or being written, per kind */
+  size_t in_flight[DBImportRecord::ACCESS + 1] = {};
+  bool done = false;
+  bool db_error = false;
+  ImportStats *stats = nullptr;
+};
@@ -0,0 +1,258 @@
+#include "reminderScheduler.h"
+#include "common/trace.h"
+#include "db/DB.h"
+#include "db/dbCache.h"
+#include <cstdio>
+#include <ctime>
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+
+LogReminderSink::LogReminderSink(const std::string &path)
+    : log(path, std::ios::app) {}
+
+void LogReminderSink::Send(const std::vector<Reminder> &reminders) {
+  std::time_t time =
+      std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+  std::string time_str = std::ctime(&time);
+  time_str.pop_back();
+  for (const Reminder &reminder : reminders) {
+    log << "[" << time_str << "] due " << reminder.due << " "
+        << reminder.user << " " << reminder.list << " " << reminder.task
+        << "\n";
+  }
+  log.flush();
+}
+
+WebhookReminderSink::WebhookReminderSink(const std::string &_url) {
+  // split "http://host:port/path" after the authority
+  const size_t authority = _url.find("://");
+  const size_t slash =
+      _url.find('/', authority == std::string::npos ? 0 : authority + 3);
+  origin = _url.substr(0, slash);
+  path = slash == std::string::npos ? "/" : _url.substr(slash);
+}
+
+void WebhookReminderSink::Send(const std::vector<Reminder> &reminders) {
+  nlohmann::json body = nlohmann::json::array();
+  for (const Reminder &reminder : reminders) {
+    body.push_back({{"user", reminder.user},
+                    {"list", reminder.list},
+                    {"task", reminder.task},
+                    {"due", reminder.due}});
+  }
+  httplib::Client client(origin);
+  client.set_connection_timeout(1);
+  client.set_read_timeout(5);
+  client.Post(path.c_str(), body.dump(), "application/json");
+}
+
+/* "YYYY-MM-DD" of a time, local time */
+static std::string DayOf(uint64_t seconds) {
+  const std::time_t time = (std::time_t)seconds;
+  struct tm t;
+  localtime_r(&time, &t);
+  char buf[16];
+  strftime(buf, sizeof(buf), "%Y-%m-%d", &t);
+  return buf;
+}
+
+/* End date of a task that is open and not repeating */
+static bool DueOf(const std::map<std::string, std::string> &task_info,
+                  std::string &due) {
+  auto status = task_info.find("status");
+  auto it = task_info.find("due");
+  if (task_info.count("recurrence") ||
+      (status != task_info.end() && status->second == "Done") ||
+      it == task_info.end())
+    return false;
+  due = it->second;
+  return true;
+}
+
+ReminderScheduler::ReminderScheduler(std::shared_ptr<DB> _db)
+    : db(_db), wheel((uint64_t)std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count()) {}
+
+bool ReminderScheduler::DayStart(const std::string &due, uint64_t &seconds) {
+  int y, m, d, n = 0;
+  if (due.size() != 10 ||
+      sscanf(due.c_str(), "%4d-%2d-%2d%n", &y, &m, &d, &n) != 3 || n != 10)
+    return false;
+  struct tm t = {};
+  t.tm_year = y - 1900;
+  t.tm_mon = m - 1;
+  t.tm_mday = d;
+  t.tm_isdst = -1;
+  const std::time_t start = mktime(&t);
+  if (start == (std::time_t)-1 || t.tm_mday != d || start < 0)
+    return false;
+  seconds = (uint64_t)start;
+  return true;
+}
+
+void ReminderScheduler::Set(const std::string &user, const std::string &list,
+                            const std::string &task, const std::string &due) {
+  uint64_t when;
+  if (!DayStart(due, when)) {
+    Cancel(user, list, task);
+    return;
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  wheel.Schedule(DBCache::Key({user, list, task}), when);
+}
+
+void ReminderScheduler::Cancel(const std::string &user,
+                               const std::string &list,
+                               const std::string &task) {
+  std::lock_guard<std::mutex> guard(lock);
+  wheel.Cancel(DBCache::Key({user, list, task}));
+}
+
+void ReminderScheduler::Update(
+    const std::string &user, const std::string &list, const std::string &task,
+    const std::map<std::string, std::string> &task_info) {
+  std::string due;
+  if (!DueOf(task_info, due)) {
+    Cancel(user, list, task);
+    return;
+  }
+  Set(user, list, task, due);
+}
+
+void ReminderScheduler::CancelAll(const std::string &user,
+                                  const std::string &list) {
+  std::lock_guard<std::mutex> guard(lock);
+  wheel.CancelPrefix(list.empty() ? DBCache::Key({user})
+                                  : DBCache::Key({user, list}));
+}
+
+void ReminderScheduler::Copy(const std::string &user, const std::string &list,
+                             const std::string &to_user,
+                             const std::string &to_list,
+                             const std::vector<std::string> &tasks) {
+  uint64_t when;
+  std::lock_guard<std::mutex> guard(lock);
+  for (const std::string &task : tasks) {
+    if (wheel.When(DBCache::Key({user, list, task}), when))
+      wheel.Schedule(DBCache::Key({to_user, to_list, task}), when);
+  }
+}
+
+bool ReminderScheduler::Due(const std::string &user, const std::string &list,
+                            const std::string &task, std::string &due) {
+  uint64_t when;
+  std::lock_guard<std::mutex> guard(lock);
+  if (!wheel.When(DBCache::Key({user, list, task}), when))
+    return false;
+  due = DayOf(when);
+  return true;
+}
+
+size_t ReminderScheduler::Pending() {
+  std::lock_guard<std::mutex> guard(lock);
+  return wheel.Size();
+}
+
+returnCode ReminderScheduler::Load(DB &db, const std::string &from,
+                                   size_t page) {
+  TRACE_SCOPE("ReminderScheduler", __func__);
+  std::vector<DBAgendaTask> tasks;
+  returnCode ret = db.getOpenDueTasks(from, nullptr, page, tasks);
+  while (ret == SUCCESS && !tasks.empty()) {
+    for (const DBAgendaTask &task : tasks) {
+      Set(task.user, task.list, task.task, task.due);
+    }
+    if (tasks.size() < page)
+      break;
+    const DBAgendaTask last = tasks.back();
+    ret = db.getOpenDueTasks(from, &last, page, tasks);
+  }
+  return ret;
+}
+
+void ReminderScheduler::Fire(uint64_t now) {
+  std::vector<std::pair<std::string, uint64_t>> fired;
+  std::shared_ptr<ReminderSink> to;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    wheel.Advance(now + lead.count(), fired);
+    to = sink;
+  }
+  if (fired.empty() || !to)
+    return;
+
+  std::vector<Reminder> reminders;
+  for (auto &timer : fired) {
+    std::vector<std::string> parts = DBCache::SplitKey(timer.first);
+    if (parts.size() != 3)
+      continue;
+    Reminder reminder;
+    reminder.user = std::move(parts[0]);
+    reminder.list = std::move(parts[1]);
+    reminder.task = std::move(parts[2]);
+    reminder.due = DayOf(timer.second);
+    reminders.push_back(std::move(reminder));
+  }
+  if (db)
+    Check(reminders);
+  if (!reminders.empty())
+    to->Send(reminders);
+}
+
+/* A statement per owner. The reminders of tasks now due on another day are
+   set again for that day */
+void ReminderScheduler::Check(std::vector<Reminder> &reminders) {
+  TRACE_SCOPE("ReminderScheduler", __func__);
+  std::map<std::string, std::vector<size_t>> owners;
+  for (size_t i = 0; i < reminders.size(); i++)
+    owners[reminders[i].user].push_back(i);
+
+  std::vector<bool> keep(reminders.size(), true);
+  for (auto &owner : owners) {
+    std::vector<DBTaskKey> keys;
+    for (size_t i : owner.second)
+      keys.emplace_back(reminders[i].user, reminders[i].list,
+                        reminders[i].task);
+    std::vector<returnCode> results;
+    std::vector<std::map<std::string, std::string>> task_infos;
+    // a DB that cannot be read does not hold the reminders back
+    if (db->getTaskNodes(owner.first, keys, results, task_infos) != SUCCESS)
+      continue;
+    for (size_t k = 0; k < keys.size(); k++) {
+      const Reminder &reminder = reminders[owner.second[k]];
+      std::string due;
+      if (results[k] == SUCCESS && DueOf(task_infos[k], due) &&
+          due == reminder.due)
+        continue;
+      keep[owner.second[k]] = false;
+      if (results[k] == SUCCESS)
+        Update(reminder.user, reminder.list, reminder.task, task_infos[k]);
+    }
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < reminders.size(); i++) {
+    if (!keep[i])
+      continue;
+    if (kept != i)
+      reminders[kept] = std::move(reminders[i]);
+    kept++;
+  }
+  reminders.resize(kept);
+}
+
+void ReminderScheduler::Start(std::shared_ptr<ReminderSink> _sink,
+                              std::chrono::seconds _lead,
+                              std::chrono::milliseconds interval) {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    sink = std::move(_sink);
+    lead = _lead;
+  }
+  ticker = std::make_unique<Common::PeriodicTask>(interval, [this]() {
+    Fire((uint64_t)std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+             .count());
+  });
+}
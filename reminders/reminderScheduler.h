@@ -0,0 +1,209 @@
+#pragma once
+
+#include "common/errorCode.h"
+#include "common/periodicTask.h"
+#include "reminders/timerWheel.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class DB; // forward definition
+
+/**
+ * @brief A task whose due day came, see ReminderScheduler.
+ *
+ */
+struct Reminder {
+  /**
+   * @brief owner of the task list
+   *
+   */
+  std::string user;
+  std::string list;
+  std::string task;
+  /**
+   * @brief end date as "YYYY-MM-DD"
+   *
+   */
+  std::string due;
+};
+
+/**
+ * @brief Where ReminderScheduler sends the reminders that fire, a batch per
+ * tick, from the thread of the scheduler.
+ *
+ */
+class ReminderSink {
+public:
+  virtual ~ReminderSink() {}
+  virtual void Send(const std::vector<Reminder> &reminders) = 0;
+};
+
+/**
+ * @brief Appends a line per reminder to a file.
+ *
+ */
+class LogReminderSink : public ReminderSink {
+public:
+  /**
+   * @brief Construct a new Log Reminder Sink object
+   *
+   * @param path file to append to, see IsOpen
+   */
+  explicit LogReminderSink(const std::string &path);
+  bool IsOpen() const { return log.is_open(); }
+  void Send(const std::vector<Reminder> &reminders) override;
+
+private:
+  std::ofstream log;
+};
+
+/**
+ * @brief POSTs each batch as a JSON array of {"user", "list", "task", "due"}
+ * to a URL, giving up on a batch the endpoint does not take.
+ *
+ */
+class WebhookReminderSink : public ReminderSink {
+public:
+  /**
+   * @brief Construct a new Webhook Reminder Sink object
+   *
+   * @param _url "http://host[:port]/path"
+   */
+  explicit WebhookReminderSink(const std::string &_url);
+  void Send(const std::vector<Reminder> &reminders) override;
+
+private:
+  std::string origin;
+  std::string path;
+};
+
+/**
+ * @brief Fires a reminder when the due day of a task comes, in local time,
+ * ahead by a lead time.
+ *
+ * The pending reminders are timers of a TimerWheel ticking once a second,
+ * keyed by owner, task list and task name, so that setting or cancelling one
+ * is O(1) and no thread is spent per reminder. Load reads the open tasks due
+ * from a day on through the due index; the workers then keep them up to
+ * date with their own writes. Tasks that are done or repeating have none.
+ * Before sending, Fire reads the tasks whose reminder fired again, so that
+ * the reminders of tasks deleted, done or moved to another day meanwhile,
+ * by any process, are dropped or set again. The tasks other processes
+ * create, and a task reopened without a new end date, show up on the next
+ * Load.
+ *
+ */
+class ReminderScheduler {
+public:
+  /**
+   * @brief Construct a new Reminder Scheduler object
+   *
+   * @param _db if not null, Fire reads the tasks through it before sending
+   * their reminders
+   */
+  explicit ReminderScheduler(std::shared_ptr<DB> _db = nullptr);
+
+  /**
+   * @brief Set the reminder of a task, replacing the one it had.
+   *
+   * @param due "YYYY-MM-DD", anything else cancels the reminder
+   */
+  void Set(const std::string &user, const std::string &list,
+           const std::string &task, const std::string &due);
+
+  /**
+   * @brief Cancel the reminder of a task, if it has one.
+   *
+   */
+  void Cancel(const std::string &user, const std::string &list,
+              const std::string &task);
+
+  /**
+   * @brief Set or cancel the reminder of a task from its fields: open tasks
+   * with an end date and no recurrence have one.
+   *
+   */
+  void Update(const std::string &user, const std::string &list,
+              const std::string &task,
+              const std::map<std::string, std::string> &task_info);
+
+  /**
+   * @brief Cancel the reminders of all tasks of a task list, or of all task
+   * lists of a user if list is empty.
+   *
+   */
+  void CancelAll(const std::string &user, const std::string &list = "");
+
+  /**
+   * @brief Give copies of tasks the pending reminders of the tasks they copy.
+   *
+   * @param tasks names of the tasks, the same in both task lists
+   */
+  void Copy(const std::string &user, const std::string &list,
+            const std::string &to_user, const std::string &to_list,
+            const std::vector<std::string> &tasks);
+
+  /**
+   * @brief The due day of the pending reminder of a task.
+   *
+   * @return false if the task has none
+   */
+  bool Due(const std::string &user, const std::string &list,
+           const std::string &task, std::string &due);
+
+  size_t Pending();
+
+  /**
+   * @brief Set the reminders of the open tasks of all users due on or after
+   * a day, a page of DB::getOpenDueTasks at a time.
+   *
+   * @param db
+   * @param from "YYYY-MM-DD"
+   * @param page tasks read per query
+   * @return returnCode of the first query that failed
+   */
+  returnCode Load(DB &db, const std::string &from, size_t page = 10000);
+
+  /**
+   * @brief Fire the reminders whose time came by now into the sink, if any.
+   * Called by the thread of Start, public for tests.
+   *
+   * @param now seconds since the epoch
+   */
+  void Fire(uint64_t now);
+
+  /**
+   * @brief Send the reminders to a sink, lead seconds before the due day
+   * starts, checking every interval on a thread of its own.
+   *
+   */
+  void Start(std::shared_ptr<ReminderSink> _sink,
+             std::chrono::seconds _lead = std::chrono::seconds(0),
+             std::chrono::milliseconds interval = std::chrono::seconds(1));
+
+  /**
+   * @brief Seconds since the epoch of the local midnight starting a day.
+   *
+   * @return false if due is not "YYYY-MM-DD"
+   */
+  static bool DayStart(const std::string &due, uint64_t &seconds);
+
+private:
+  /* Keep the reminders whose task is still open and due on their day */
+  void Check(std::vector<Reminder> &reminders);
+
+  std::shared_ptr<DB> db;
+  std::mutex lock;
+  TimerWheel wheel;
+  std::shared_ptr<ReminderSink> sink;
+  std::chrono::seconds lead{0};
+  /* last, so that it stops before the rest goes */
+  std::unique_ptr<Common::PeriodicTask> ticker;
+};
@@ -0,0 +1,99 @@
+#include "timerWheel.h"
+#include <algorithm>
+
+TimerWheel::TimerWheel(uint64_t now) : current(now) {}
+
+void TimerWheel::Schedule(const std::string &key, uint64_t when) {
+  auto it = timers.find(key);
+  if (it == timers.end()) {
+    it = timers.emplace(key, Timer()).first;
+  } else {
+    slots[it->second.level][it->second.slot].erase(it->second.it);
+  }
+  // a timer that is due fires on the next tick
+  const uint64_t last = current + (((uint64_t)1 << (kBits * kLevels)) - 1);
+  it->second.when = when;
+  it->second.tick = when <= current ? current + 1 : std::min(when, last);
+  Place(&it->first, it->second);
+}
+
+bool TimerWheel::Cancel(const std::string &key) {
+  auto it = timers.find(key);
+  if (it == timers.end())
+    return false;
+  slots[it->second.level][it->second.slot].erase(it->second.it);
+  timers.erase(it);
+  return true;
+}
+
+size_t TimerWheel::CancelPrefix(const std::string &prefix) {
+  size_t cancelled = 0;
+  for (auto it = timers.begin(); it != timers.end();) {
+    if (it->first.compare(0, prefix.size(), prefix) != 0) {
+      ++it;
+      continue;
+    }
+    slots[it->second.level][it->second.slot].erase(it->second.it);
+    it = timers.erase(it);
+    cancelled++;
+  }
+  return cancelled;
+}
+
+bool TimerWheel::When(const std::string &key, uint64_t &when) const {
+  auto it = timers.find(key);
+  if (it == timers.end())
+    return false;
+  when = it->second.when;
+  return true;
+}
+
+void TimerWheel::Advance(
+    uint64_t now, std::vector<std::pair<std::string, uint64_t>> &fired) {
+  if (timers.empty() && now > current) {
+    current = now;
+    return;
+  }
+  while (current < now) {
+    current++;
+    // the upper slots the tick enters, top down so that their timers can
+    // land in the slots below before those are spread in turn
+    int top = 0;
+    while (top + 1 < kLevels &&
+           (current & (((uint64_t)1 << (kBits * (top + 1))) - 1)) == 0)
+      top++;
+    for (int level = top; level > 0; level--) {
+      Slot moving;
+      moving.swap(slots[level][(current >> (kBits * level)) & (kSlots - 1)]);
+      for (const std::string *key : moving) {
+        Place(key, timers[*key]);
+      }
+    }
+
+    Slot &slot = slots[0][current & (kSlots - 1)];
+    while (!slot.empty()) {
+      const std::string *key = slot.front();
+      slot.pop_front();
+      auto it = timers.find(*key);
+      fired.emplace_back(*key, it->second.when);
+      timers.erase(it);
+    }
+    if (timers.empty()) {
+      current = std::max(current, now);
+      return;
+    }
+  }
+}
+
+void TimerWheel::Place(const std::string *key, Timer &timer) {
+  // the lowest level whose span holds both the current tick and the timer
+  int level = 0;
+  while (level + 1 < kLevels &&
+         (timer.tick >> (kBits * (level + 1))) !=
+             (current >> (kBits * (level + 1))))
+    level++;
+  timer.level = level;
+  timer.slot = (timer.tick >> (kBits * level)) & (kSlots - 1);
+  Slot &slot = slots[level][timer.slot];
+  timer.it = slot.insert(slot.end(), key);
+}
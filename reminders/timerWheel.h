@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Hierarchical timer wheel of keyed timers, in whole ticks.
+ *
+ * Level l has kSlots slots of kSlots^l ticks each. A timer sits in the
+ * lowest level whose span still covers it from the current tick, in the slot
+ * of its tick; when the current tick enters a slot of an upper level, the
+ * timers of that slot are spread over the levels below. Each timer is thus
+ * moved at most once per level. Scheduling and cancelling are O(1): the slot
+ * lists hold pointers to the keys of the timer map, whose entries remember
+ * where their timer is. Not thread safe.
+ *
+ */
+class TimerWheel {
+public:
+  /**
+   * @brief Construct a new Timer Wheel object
+   *
+   * @param now current tick, timers fire once Advance goes past their tick
+   */
+  explicit TimerWheel(uint64_t now = 0);
+
+  /**
+   * @brief Set the timer of a key, replacing the one it had. A tick that
+   * already passed fires on the next Advance.
+   *
+   */
+  void Schedule(const std::string &key, uint64_t when);
+
+  /**
+   * @brief Remove the timer of a key.
+   *
+   * @return false if the key had none
+   */
+  bool Cancel(const std::string &key);
+
+  /**
+   * @brief Remove the timers of all keys starting with a prefix, a scan of
+   * every timer.
+   *
+   * @return the timers removed
+   */
+  size_t CancelPrefix(const std::string &prefix);
+
+  /**
+   * @brief The tick the timer of a key was scheduled for.
+   *
+   * @return false if the key has none
+   */
+  bool When(const std::string &key, uint64_t &when) const;
+
+  /**
+   * @brief Move the current tick forward to now and append the keys whose
+   * timer fired, with the ticks they were scheduled for, in the order they
+   * fired. Their timers are removed.
+   *
+   */
+  void Advance(uint64_t now,
+               std::vector<std::pair<std::string, uint64_t>> &fired);
+
+  uint64_t Now() const { return current; }
+  size_t Size() const { return timers.size(); }
+
+private:
+  static const int kBits = 8;
+  static const uint64_t kSlots = 1 << kBits;
+  /* 2^40 ticks: past the year 9999 in seconds from now */
+  static const int kLevels = 5;
+
+  using Slot = std::list<const std::string *>;
+
+  struct Timer {
+    /* as scheduled, and where it fires */
+    uint64_t when;
+    uint64_t tick;
+    int level;
+    size_t slot;
+    Slot::iterator it;
+  };
+
+  /* Put a timer in its slot, from the current tick */
+  void Place(const std::string *key, Timer &timer);
+
+  std::unordered_map<std::string, Timer> timers;
+  Slot slots[kLevels][kSlots];
+  uint64_t current;
+};
@@ -0,0 +1,298 @@
+#include "nameTrie.h"
+#include "common/trace.h"
+#include <algorithm>
+
+/* Child of a node whose label starts with c, or the place to insert it */
+template <typename Children>
+static auto ChildAt(Children &children, char c) -> decltype(children.begin()) {
+  return std::lower_bound(children.begin(), children.end(), c,
+                          [](const typename Children::value_type &child,
+                             char c) {
+                            return (unsigned char)child->label[0] <
+                                   (unsigned char)c;
+                          });
+}
+
+/* Length of the common prefix of label and key from pos */
+static size_t Common(const std::string &label, const std::string &key,
+                     size_t pos) {
+  size_t length = 0;
+  while (length < label.size() && pos + length < key.size() &&
+         label[length] == key[pos + length])
+    length++;
+  return length;
+}
+
+NameTrie::NameTrie(size_t _max_users)
+    : max_users(std::max<size_t>(_max_users, 1)) {}
+
+std::string NameTrie::Fold(const std::string &name) {
+  std::string key = name;
+  for (char &c : key) {
+    if (c >= 'A' && c <= 'Z')
+      c = c - 'A' + 'a';
+  }
+  return key;
+}
+
+bool NameTrie::NeedsRefresh(const std::string &user,
+                            std::chrono::milliseconds max_age,
+                            long long &since) {
+  std::lock_guard<std::mutex> guard(lock);
+  UserTrie *trie = Find(user);
+  if (trie == nullptr) {
+    since = 0;
+    return true;
+  }
+  since = trie->version;
+  return std::chrono::steady_clock::now() - trie->refreshed > max_age;
+}
+
+void NameTrie::Apply(const std::string &user, long long since,
+                     long long version, const std::vector<DBChange> &changes) {
+  TRACE_SCOPE("NameTrie", __func__);
+  std::lock_guard<std::mutex> guard(lock);
+  UserTrie *trie = Find(user);
+  if (since == 0) {
+    trie = &users[user];
+    *trie = UserTrie();
+    trie->last_used = ++clock;
+  } else if (trie == nullptr || trie->version != since) {
+    return;
+  }
+
+  for (const DBChange &change : changes) {
+    if (change.deleted) {
+      RemoveName(*trie, change.list, change.task);
+    } else {
+      AddName(*trie, change.list, change.task);
+    }
+  }
+  trie->version = version;
+  trie->refreshed = std::chrono::steady_clock::now();
+
+  // make room for the user just loaded
+  while (users.size() > max_users) {
+    auto oldest = users.end();
+    for (auto it = users.begin(); it != users.end(); ++it) {
+      if (it->first != user &&
+          (oldest == users.end() ||
+           it->second.last_used < oldest->second.last_used)) {
+        oldest = it;
+      }
+    }
+    users.erase(oldest);
+  }
+}
+
+void NameTrie::Add(const std::string &user, const std::string &list,
+                   const std::string &task) {
+  std::lock_guard<std::mutex> guard(lock);
+  UserTrie *trie = Find(user);
+  if (trie == nullptr)
+    return;
+  AddName(*trie, list, task);
+}
+
+void NameTrie::Remove(const std::string &user, const std::string &list,
+                      const std::string &task) {
+  std::lock_guard<std::mutex> guard(lock);
+  UserTrie *trie = Find(user);
+  if (trie == nullptr)
+    return;
+  RemoveName(*trie, list, task);
+}
+
+void NameTrie::Drop(const std::string &user) {
+  std::lock_guard<std::mutex> guard(lock);
+  users.erase(user);
+}
+
+std::vector<NameHit>
+NameTrie::Complete(const std::string &prefix,
+                   const std::map<std::string, std::set<std::string>> &scope,
+                   int kinds, size_t k) {
+  TRACE_SCOPE("NameTrie", __func__);
+  const std::string key = Fold(prefix);
+  std::vector<NameHit> hits;
+  if (k == 0)
+    return hits;
+
+  std::lock_guard<std::mutex> guard(lock);
+  for (const auto &owner : scope) {
+    UserTrie *trie = Find(owner.first);
+    if (trie == nullptr)
+      continue;
+
+    // the prefix may end inside an edge
+    const Node *node = &trie->root;
+    size_t pos = 0;
+    while (node != nullptr && pos < key.size()) {
+      const auto &children = node->children;
+      auto it = ChildAt(children, key[pos]);
+      if (it == children.end() || (*it)->label[0] != key[pos]) {
+        node = nullptr;
+        break;
+      }
+      const size_t length = Common((*it)->label, key, pos);
+      if (pos + length < key.size() && length < (*it)->label.size()) {
+        node = nullptr;
+        break;
+      }
+      pos += length;
+      node = it->get();
+    }
+    if (node == nullptr)
+      continue;
+
+    std::vector<std::pair<std::string, std::string>> names;
+    Collect(*node, owner.second, kinds, k, names);
+    for (auto &name : names) {
+      NameHit hit;
+      hit.user = owner.first;
+      hit.list = std::move(name.first);
+      hit.task = std::move(name.second);
+      hits.push_back(std::move(hit));
+    }
+  }
+
+  // merge the owners, by name and then by where the name is
+  auto name = [](const NameHit &hit) {
+    return Fold(hit.task.empty() ? hit.list : hit.task);
+  };
+  std::sort(hits.begin(), hits.end(),
+            [&](const NameHit &a, const NameHit &b) {
+              const std::string name_a = name(a), name_b = name(b);
+              if (name_a != name_b)
+                return name_a < name_b;
+              if (a.user != b.user)
+                return a.user < b.user;
+              if (a.list != b.list)
+                return a.list < b.list;
+              return a.task < b.task;
+            });
+  if (hits.size() > k)
+    hits.resize(k);
+  return hits;
+}
+
+/* Called with lock held */
+NameTrie::UserTrie *NameTrie::Find(const std::string &user) {
+  auto it = users.find(user);
+  if (it == users.end())
+    return nullptr;
+  it->second.last_used = ++clock;
+  return &it->second;
+}
+
+void NameTrie::AddName(UserTrie &trie, const std::string &list,
+                       const std::string &task) {
+  // the tasks of a task list may come before it in the change feed
+  ListNames &names = trie.lists[list];
+  if (task.empty()) {
+    if (names.added)
+      return;
+    names.added = true;
+    Insert(trie.root, Fold(list), 0, {list, task});
+  } else if (names.tasks.insert(task).second) {
+    Insert(trie.root, Fold(task), 0, {list, task});
+  }
+}
+
+void NameTrie::RemoveName(UserTrie &trie, const std::string &list,
+                          const std::string &task) {
+  auto it = trie.lists.find(list);
+  if (it == trie.lists.end())
+    return;
+  if (!task.empty()) {
+    if (it->second.tasks.erase(task))
+      Erase(trie.root, Fold(task), 0, {list, task});
+    return;
+  }
+  for (const std::string &name : it->second.tasks) {
+    Erase(trie.root, Fold(name), 0, {list, name});
+  }
+  if (it->second.added)
+    Erase(trie.root, Fold(list), 0, {list, ""});
+  trie.lists.erase(it);
+}
+
+void NameTrie::Insert(Node &node, const std::string &key, size_t pos,
+                      const std::pair<std::string, std::string> &name) {
+  (name.second.empty() ? node.lists : node.tasks)++;
+  if (pos == key.size()) {
+    node.names.insert(name);
+    return;
+  }
+
+  auto it = ChildAt(node.children, key[pos]);
+  if (it == node.children.end() || (*it)->label[0] != key[pos]) {
+    std::unique_ptr<Node> child(new Node());
+    child->label = key.substr(pos);
+    it = node.children.insert(it, std::move(child));
+    Insert(**it, key, key.size(), name);
+    return;
+  }
+
+  // split the edge where the key leaves it
+  const size_t length = Common((*it)->label, key, pos);
+  if (length < (*it)->label.size()) {
+    std::unique_ptr<Node> middle(new Node());
+    middle->label = (*it)->label.substr(0, length);
+    middle->lists = (*it)->lists;
+    middle->tasks = (*it)->tasks;
+    (*it)->label.erase(0, length);
+    middle->children.push_back(std::move(*it));
+    *it = std::move(middle);
+  }
+  Insert(**it, key, pos + length, name);
+}
+
+bool NameTrie::Erase(Node &node, const std::string &key, size_t pos,
+                     const std::pair<std::string, std::string> &name) {
+  if (pos == key.size()) {
+    if (!node.names.erase(name))
+      return false;
+  } else {
+    auto it = ChildAt(node.children, key[pos]);
+    if (it == node.children.end() || (*it)->label[0] != key[pos])
+      return false;
+    Node &child = **it;
+    const size_t length = Common(child.label, key, pos);
+    if (length < child.label.size() ||
+        !Erase(child, key, pos + length, name))
+      return false;
+
+    // drop the child once empty, or merge it with its only child
+    if (child.names.empty() && child.children.empty()) {
+      node.children.erase(it);
+    } else if (child.names.empty() && child.children.size() == 1) {
+      std::unique_ptr<Node> only = std::move(child.children[0]);
+      only->label = child.label + only->label;
+      *it = std::move(only);
+    }
+  }
+  (name.second.empty() ? node.lists : node.tasks)--;
+  return true;
+}
+
+void NameTrie::Collect(const Node &node, const std::set<std::string> &lists,
+                       int kinds, size_t k,
+                       std::vector<std::pair<std::string, std::string>> &out) {
+  if (out.size() >= k)
+    return;
+  if (!((kinds & LISTS) && node.lists) && !((kinds & TASKS) && node.tasks))
+    return;
+  for (const auto &name : node.names) {
+    if (!(kinds & (name.second.empty() ? LISTS : TASKS)))
+      continue;
+    if (!lists.empty() && !lists.count(name.first))
+      continue;
+    out.push_back(name);
+    if (out.size() >= k)
+      return;
+  }
+  for (const auto &child : node.children) {
+    Collect(*child, lists, kinds, k, out);
+  }
+}
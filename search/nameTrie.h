@@ -0,0 +1,179 @@
+#pragma once
+
+#include "db/DB.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief A task list or task found by NameTrie::Complete.
+ *
+ */
+struct NameHit {
+  /**
+   * @brief owner of the task list
+   *
+   */
+  std::string user;
+  std::string list;
+  /**
+   * @brief empty for the task list itself
+   *
+   */
+  std::string task;
+};
+
+/**
+ * @brief In-memory prefix index over the task list names and task names of
+ * each user, for autocomplete.
+ *
+ * Each user has a radix tree keyed by the names lowercased: edges carry
+ * whole runs of bytes and a node only exists where names branch or end.
+ * Every node counts the task lists and tasks below it, so completing a
+ * prefix walks the prefix and then only the subtrees holding names of the
+ * wanted kind, in name order, until k are found.
+ *
+ * As for SearchIndex, the names of a user are loaded and kept up to date from
+ * DB::getChangesSince, see Apply, while Add and Remove apply the creations
+ * and deletions of this process right away. Names cannot be revised. Only
+ * the most recently used users are kept.
+ *
+ */
+class NameTrie {
+public:
+  /**
+   * @brief Kinds of names to complete, may be or'ed
+   *
+   */
+  enum Kind { LISTS = 1, TASKS = 2, ALL = LISTS | TASKS };
+
+  /**
+   * @brief Construct a new Name Trie object
+   *
+   * @param _max_users users kept in memory, the least recently used one is
+   * dropped beyond that
+   */
+  explicit NameTrie(size_t _max_users = 1024);
+
+  /**
+   * @brief Key of a name: ASCII letters lowercased, other bytes kept.
+   *
+   */
+  static std::string Fold(const std::string &name);
+
+  /**
+   * @brief Whether the names of a user have to be brought up to date, because
+   * they are not loaded or were last brought up to date more than max_age ago.
+   *
+   * @param [in] user
+   * @param [in] max_age
+   * @param [out] since change version to pass to DB::getChangesSince, 0 to
+   * load the user from scratch
+   */
+  bool NeedsRefresh(const std::string &user, std::chrono::milliseconds max_age,
+                    long long &since);
+
+  /**
+   * @brief Apply the changes of a user read from DB::getChangesSince. Changes
+   * read from a version the trie is no longer at are ignored.
+   *
+   * @param user
+   * @param since version the changes were read from, 0 to replace the names
+   * of the user
+   * @param version version the changes bring the user to
+   * @param changes
+   */
+  void Apply(const std::string &user, long long since, long long version,
+             const std::vector<DBChange> &changes);
+
+  /**
+   * @brief Add a task list, or with a task a task of it, created by this
+   * process. Nothing happens if the user is not loaded.
+   *
+   */
+  void Add(const std::string &user, const std::string &list,
+           const std::string &task = "");
+
+  /**
+   * @brief Remove a task, or with an empty task a task list and its tasks.
+   * Nothing happens if the user is not loaded.
+   *
+   */
+  void Remove(const std::string &user, const std::string &list,
+              const std::string &task = "");
+
+  /**
+   * @brief Forget a user, e.g. one that was deleted.
+   *
+   */
+  void Drop(const std::string &user);
+
+  /**
+   * @brief The first k names starting with a prefix, ignoring ASCII case, in
+   * name order.
+   *
+   * @param prefix
+   * @param scope task lists to look in by owner, an empty set for all of them
+   * @param kinds Kind of the names to return
+   * @param k names to return at most
+   */
+  std::vector<NameHit>
+  Complete(const std::string &prefix,
+           const std::map<std::string, std::set<std::string>> &scope,
+           int kinds, size_t k);
+
+private:
+  struct Node {
+    /* bytes of the edge from the parent */
+    std::string label;
+    /* by first byte of the label */
+    std::vector<std::unique_ptr<Node>> children;
+    /* (list, task) named by the path to this node */
+    std::set<std::pair<std::string, std::string>> names;
+    /* task lists and tasks named here and below */
+    size_t lists = 0;
+    size_t tasks = 0;
+  };
+
+  struct ListNames {
+    /* whether the task list itself was added */
+    bool added = false;
+    std::set<std::string> tasks;
+  };
+
+  struct UserTrie {
+    Node root;
+    /* by task list name */
+    std::map<std::string, ListNames> lists;
+    long long version = 0;
+    std::chrono::steady_clock::time_point refreshed;
+    uint64_t last_used = 0;
+  };
+
+  /* Called with lock held */
+  UserTrie *Find(const std::string &user);
+  static void AddName(UserTrie &trie, const std::string &list,
+                      const std::string &task);
+  static void RemoveName(UserTrie &trie, const std::string &list,
+                         const std::string &task);
+  static void Insert(Node &node, const std::string &key, size_t pos,
+                     const std::pair<std::string, std::string> &name);
+  static bool Erase(Node &node, const std::string &key, size_t pos,
+                    const std::pair<std::string, std::string> &name);
+  static void Collect(const Node &node, const std::set<std::string> &lists,
+                      int kinds, size_t k,
+                      std::vector<std::pair<std::string, std::string>> &out);
+
+  const size_t max_users;
+  std::mutex lock;
+  std::unordered_map<std::string, UserTrie> users;
+  uint64_t clock = 0;
+};
@@ -0,0 +1,372 @@
+#include "searchIndex.h"
+#include "common/trace.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+/* BM25 parameters, and the weight of a term found in the task name on top */
+static const double kK1 = 1.2;
+static const double kB = 0.75;
+static const double kNameBoost = 1.0;
+
+/* Whether a is a better hit than b: higher score, then by key */
+static bool Better(const SearchHit &a, const SearchHit &b) {
+  if (a.score != b.score)
+    return a.score > b.score;
+  if (a.user != b.user)
+    return a.user < b.user;
+  if (a.list != b.list)
+    return a.list < b.list;
+  return a.task < b.task;
+}
+
+static void PutVarint(std::string &bytes, uint32_t value) {
+  while (value >= 0x80) {
+    bytes += (char)((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  bytes += (char)value;
+}
+
+static uint32_t GetVarint(const std::string &bytes, size_t &pos) {
+  uint32_t value = 0;
+  for (int shift = 0; pos < bytes.size(); shift += 7) {
+    unsigned char c = bytes[pos++];
+    value |= (uint32_t)(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      break;
+  }
+  return value;
+}
+
+SearchIndex::SearchIndex(size_t _max_users)
+    : max_users(std::max<size_t>(_max_users, 1)) {}
+
+std::vector<std::string> SearchIndex::Tokenize(const std::string &text) {
+  std::vector<std::string> terms;
+  std::string term;
+  for (unsigned char c : text) {
+    if (isalnum(c) || c >= 0x80) {
+      term += (char)tolower(c);
+    } else if (!term.empty()) {
+      terms.push_back(std::move(term));
+      term.clear();
+    }
+  }
+  if (!term.empty()) {
+    terms.push_back(std::move(term));
+  }
+  return terms;
+}
+
+bool SearchIndex::NeedsRefresh(const std::string &user,
+                               std::chrono::milliseconds max_age,
+                               long long &since) {
+  std::lock_guard<std::mutex> guard(lock);
+  UserIndex *index = Find(user);
+  if (index == nullptr) {
+    since = 0;
+    return true;
+  }
+  since = index->version;
+  return std::chrono::steady_clock::now() - index->refreshed > max_age;
+}
+
+void SearchIndex::Apply(const std::string &user, long long since,
+                        long long version,
+                        const std::vector<DBChange> &changes) {
+  TRACE_SCOPE("SearchIndex", __func__);
+  std::lock_guard<std::mutex> guard(lock);
+  UserIndex *index = Find(user);
+  if (since == 0) {
+    index = &users[user];
+    *index = UserIndex();
+    index->last_used = ++clock;
+  } else if (index == nullptr || index->version != since) {
+    return;
+  }
+
+  // oldest first, a task list deleted and created again keeps its new tasks
+  for (const DBChange &change : changes) {
+    if (change.task.empty()) {
+      if (change.deleted) {
+        RetireList(*index, change.list);
+      }
+    } else if (change.deleted) {
+      Retire(*index, change.list, change.task);
+    } else {
+      auto content = change.info.find("content");
+      Index(*index, change.list, change.task,
+            content == change.info.end() ? "" : content->second);
+    }
+  }
+  Compact(*index);
+  index->version = version;
+  index->refreshed = std::chrono::steady_clock::now();
+
+  // make room for the user just loaded
+  while (users.size() > max_users) {
+    auto oldest = users.end();
+    for (auto it = users.begin(); it != users.end(); ++it) {
+      if (it->first != user &&
+          (oldest == users.end() ||
+           it->second.last_used < oldest->second.last_used)) {
+        oldest = it;
+      }
+    }
+    users.erase(oldest);
+  }
+}
+
+void SearchIndex::Put(const std::string &user, const std::string &list,
+                      const std::string &task, const std::string &content) {
+  std::lock_guard<std::mutex> guard(lock);
+  UserIndex *index = Find(user);
+  if (index == nullptr)
+    return;
+  Index(*index, list, task, content);
+  Compact(*index);
+}
+
+void SearchIndex::Remove(const std::string &user, const std::string &list,
+                         const std::string &task) {
+  std::lock_guard<std::mutex> guard(lock);
+  UserIndex *index = Find(user);
+  if (index == nullptr)
+    return;
+  if (task.empty()) {
+    RetireList(*index, list);
+  } else {
+    Retire(*index, list, task);
+  }
+  Compact(*index);
+}
+
+void SearchIndex::Drop(const std::string &user) {
+  std::lock_guard<std::mutex> guard(lock);
+  users.erase(user);
+}
+
+std::vector<SearchHit>
+SearchIndex::Search(const std::string &query,
+                    const std::map<std::string, std::set<std::string>> &scope,
+                    size_t k) {
+  TRACE_SCOPE("SearchIndex", __func__);
+  std::vector<std::string> terms = Tokenize(query);
+  std::sort(terms.begin(), terms.end());
+  terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+  std::vector<SearchHit> hits;
+  if (terms.empty() || k == 0)
+    return hits;
+
+  std::lock_guard<std::mutex> guard(lock);
+  for (const auto &owner : scope) {
+    UserIndex *index = Find(owner.first);
+    if (index == nullptr || index->live == 0)
+      continue;
+    const std::set<std::string> &lists = owner.second;
+
+    // every term has to be there, the rarest one is walked first
+    std::vector<const Postings *> postings;
+    for (const std::string &term : terms) {
+      auto it = index->terms.find(term);
+      if (it == index->terms.end())
+        break;
+      postings.push_back(&it->second);
+    }
+    if (postings.size() != terms.size())
+      continue;
+    std::sort(postings.begin(), postings.end(),
+              [](const Postings *a, const Postings *b) {
+                return a->count < b->count;
+              });
+
+    const double docs = index->live;
+    const double average = (double)index->total_length / index->live;
+    auto weight = [&](const Postings &term, const Posting &posting) {
+      const double df = std::min<double>(term.count, docs);
+      const double idf = std::log(1 + (docs - df + 0.5) / (df + 0.5));
+      const double length = index->docs[posting.doc].length;
+      const double tf =
+          posting.tf * (kK1 + 1) /
+          (posting.tf + kK1 * (1 - kB + kB * length / std::max(average, 1.0)));
+      return idf * (tf + (posting.in_name ? kNameBoost : 0));
+    };
+
+    std::vector<std::pair<uint32_t, double>> matches;
+    for (const Posting &posting : Decode(*postings[0])) {
+      const Doc &doc = index->docs[posting.doc];
+      if (doc.live && (lists.empty() || lists.count(doc.list))) {
+        matches.emplace_back(posting.doc, weight(*postings[0], posting));
+      }
+    }
+    for (size_t i = 1; i < postings.size() && !matches.empty(); i++) {
+      std::vector<Posting> next = Decode(*postings[i]);
+      size_t kept = 0;
+      auto it = next.begin();
+      for (auto &match : matches) {
+        while (it != next.end() && it->doc < match.first)
+          ++it;
+        if (it != next.end() && it->doc == match.first) {
+          matches[kept++] = {match.first,
+                             match.second + weight(*postings[i], *it)};
+        }
+      }
+      matches.resize(kept);
+    }
+
+    // keep the best k over all owners, worst on top of the heap
+    for (auto &match : matches) {
+      const Doc &doc = index->docs[match.first];
+      SearchHit hit;
+      hit.score = match.second;
+      if (hits.size() == k) {
+        if (hit.score < hits.front().score)
+          continue;
+      }
+      hit.user = owner.first;
+      hit.list = doc.list;
+      hit.task = doc.task;
+      if (hits.size() == k) {
+        if (!Better(hit, hits.front()))
+          continue;
+        std::pop_heap(hits.begin(), hits.end(), Better);
+        hits.pop_back();
+      }
+      hits.push_back(std::move(hit));
+      std::push_heap(hits.begin(), hits.end(), Better);
+    }
+  }
+  std::sort(hits.begin(), hits.end(), Better);
+  return hits;
+}
+
+/* Called with lock held */
+SearchIndex::UserIndex *SearchIndex::Find(const std::string &user) {
+  auto it = users.find(user);
+  if (it == users.end())
+    return nullptr;
+  it->second.last_used = ++clock;
+  return &it->second;
+}
+
+void SearchIndex::Index(UserIndex &index, const std::string &list,
+                        const std::string &task, const std::string &content) {
+  Retire(index, list, task);
+  const uint32_t id = index.docs.size();
+  std::vector<std::string> name = Tokenize(task);
+  std::vector<std::string> words = Tokenize(content);
+
+  // term frequency, and whether the term is in the name
+  std::map<std::string, std::pair<uint32_t, bool>> counts;
+  for (const std::string &term : name) {
+    counts[term].first++;
+    counts[term].second = true;
+  }
+  for (const std::string &term : words) {
+    counts[term].first++;
+  }
+  for (const auto &count : counts) {
+    Append(index.terms[count.first],
+           {id, count.second.first, count.second.second});
+  }
+
+  Doc doc;
+  doc.list = list;
+  doc.task = task;
+  doc.length = name.size() + words.size();
+  doc.live = true;
+  index.docs.push_back(std::move(doc));
+  index.ids[DBCache::Key({list, task})] = id;
+  index.live++;
+  index.total_length += index.docs.back().length;
+}
+
+void SearchIndex::Retire(UserIndex &index, const std::string &list,
+                         const std::string &task) {
+  auto it = index.ids.find(DBCache::Key({list, task}));
+  if (it == index.ids.end())
+    return;
+  Doc &doc = index.docs[it->second];
+  doc.live = false;
+  index.live--;
+  index.total_length -= doc.length;
+  index.ids.erase(it);
+}
+
+void SearchIndex::RetireList(UserIndex &index, const std::string &list) {
+  std::vector<std::string> tasks;
+  for (const auto &id : index.ids) {
+    if (index.docs[id.second].list == list) {
+      tasks.push_back(index.docs[id.second].task);
+    }
+  }
+  for (const std::string &task : tasks) {
+    Retire(index, list, task);
+  }
+}
+
+/* Renumber the live documents and rewrite the postings without the retired
+   ones, once these outnumber the live ones */
+void SearchIndex::Compact(UserIndex &index) {
+  const size_t retired = index.docs.size() - index.live;
+  if (retired <= std::max<size_t>(index.live, 1024))
+    return;
+  TRACE_SCOPE("SearchIndex", __func__);
+
+  std::vector<uint32_t> renumber(index.docs.size());
+  uint32_t next = 0;
+  for (size_t i = 0; i < index.docs.size(); i++) {
+    if (index.docs[i].live) {
+      renumber[i] = next++;
+    }
+  }
+  for (auto it = index.terms.begin(); it != index.terms.end();) {
+    Postings postings;
+    for (const Posting &posting : Decode(it->second)) {
+      if (index.docs[posting.doc].live) {
+        Append(postings, {renumber[posting.doc], posting.tf, posting.in_name});
+      }
+    }
+    if (postings.count == 0) {
+      it = index.terms.erase(it);
+    } else {
+      it->second = std::move(postings);
+      ++it;
+    }
+  }
+  for (auto &id : index.ids) {
+    id.second = renumber[id.second];
+  }
+  std::vector<Doc> docs;
+  docs.reserve(index.live);
+  for (Doc &doc : index.docs) {
+    if (doc.live) {
+      docs.push_back(std::move(doc));
+    }
+  }
+  index.docs = std::move(docs);
+}
+
+/* Documents are appended in increasing order */
+void SearchIndex::Append(Postings &postings, const Posting &posting) {
+  PutVarint(postings.bytes,
+            postings.count == 0 ? posting.doc : posting.doc - postings.last);
+  PutVarint(postings.bytes, posting.tf << 1 | (posting.in_name ? 1 : 0));
+  postings.last = posting.doc;
+  postings.count++;
+}
+
+std::vector<SearchIndex::Posting>
+SearchIndex::Decode(const Postings &postings) {
+  std::vector<Posting> decoded;
+  decoded.reserve(postings.count);
+  size_t pos = 0;
+  uint32_t doc = 0;
+  while (pos < postings.bytes.size()) {
+    doc += GetVarint(postings.bytes, pos);
+    const uint32_t tf = GetVarint(postings.bytes, pos);
+    decoded.push_back({doc, tf >> 1, (tf & 1) != 0});
+  }
+  return decoded;
+}
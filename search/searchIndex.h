@@ -0,0 +1,177 @@
+#pragma once
+
+#include "db/DB.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief A task found by SearchIndex::Search.
+ *
+ */
+struct SearchHit {
+  /**
+   * @brief owner of the task list
+   *
+   */
+  std::string user;
+  std::string list;
+  std::string task;
+  /**
+   * @brief relevance, higher first; only comparable within one search
+   *
+   */
+  double score = 0;
+};
+
+/**
+ * @brief In-memory inverted index over the names and contents of the tasks of
+ * each user, for keyword search.
+ *
+ * Terms are the lowercased runs of letters and digits of a text. Each user
+ * has its own index: the tasks get increasing document numbers, and the
+ * posting list of a term holds the documents containing it in that order,
+ * as varint deltas followed by the term frequency. Changing a task retires
+ * its document and appends a new one, so postings are only ever appended to;
+ * they are rewritten without the retired documents once those outnumber the
+ * live ones.
+ *
+ * The index of a user is loaded and kept up to date from the change feed of
+ * DB::getChangesSince, see Apply, which also brings in the writes of other
+ * processes. Put and Remove apply the writes of this process right away.
+ * Only the most recently used users are kept.
+ *
+ */
+class SearchIndex {
+public:
+  /**
+   * @brief Construct a new Search Index object
+   *
+   * @param _max_users users kept in memory, the least recently used one is
+   * dropped beyond that
+   */
+  explicit SearchIndex(size_t _max_users = 1024);
+
+  /**
+   * @brief Terms of a text, lowercased, in order and with repetitions. Bytes
+   * of multibyte UTF-8 characters are kept as letters.
+   *
+   */
+  static std::vector<std::string> Tokenize(const std::string &text);
+
+  /**
+   * @brief Whether the index of a user has to be brought up to date, because
+   * it is not loaded or was last brought up to date more than max_age ago.
+   *
+   * @param [in] user
+   * @param [in] max_age
+   * @param [out] since change version to pass to DB::getChangesSince, 0 to
+   * load the user from scratch
+   */
+  bool NeedsRefresh(const std::string &user, std::chrono::milliseconds max_age,
+                    long long &since);
+
+  /**
+   * @brief Apply the changes of a user read from DB::getChangesSince. Changes
+   * read from a version the index is no longer at are ignored, a later
+   * refresh reads them again.
+   *
+   * @param user
+   * @param since version the changes were read from, 0 to replace the index
+   * of the user
+   * @param version version the changes bring the user to
+   * @param changes
+   */
+  void Apply(const std::string &user, long long since, long long version,
+             const std::vector<DBChange> &changes);
+
+  /**
+   * @brief Index a task created or revised by this process, replacing what was
+   * indexed for it. Nothing happens if the user is not loaded.
+   *
+   */
+  void Put(const std::string &user, const std::string &list,
+           const std::string &task, const std::string &content);
+
+  /**
+   * @brief Remove a task, or with an empty task every task of a task list.
+   * Nothing happens if the user is not loaded.
+   *
+   */
+  void Remove(const std::string &user, const std::string &list,
+              const std::string &task = "");
+
+  /**
+   * @brief Forget a user, e.g. one that was deleted.
+   *
+   */
+  void Drop(const std::string &user);
+
+  /**
+   * @brief The k tasks matching every term of the query, best first, BM25
+   * ranked with terms in the task name counting more.
+   *
+   * @param query
+   * @param scope task lists to search by owner, an empty set for all of them
+   * @param k hits to return at most
+   */
+  std::vector<SearchHit>
+  Search(const std::string &query,
+         const std::map<std::string, std::set<std::string>> &scope, size_t k);
+
+private:
+  struct Doc {
+    std::string list;
+    std::string task;
+    /* terms in the name and the content */
+    uint32_t length = 0;
+    bool live = false;
+  };
+
+  struct Postings {
+    /* (varint doc delta, varint tf << 1 | in name) per document */
+    std::string bytes;
+    uint32_t last = 0;
+    uint32_t count = 0;
+  };
+
+  struct Posting {
+    uint32_t doc;
+    uint32_t tf;
+    bool in_name;
+  };
+
+  struct UserIndex {
+    std::vector<Doc> docs;
+    /* DBCache::Key({list, task}) to its live document */
+    std::unordered_map<std::string, uint32_t> ids;
+    std::unordered_map<std::string, Postings> terms;
+    size_t live = 0;
+    uint64_t total_length = 0;
+    long long version = 0;
+    std::chrono::steady_clock::time_point refreshed;
+    uint64_t last_used = 0;
+  };
+
+  /* Called with lock held */
+  UserIndex *Find(const std::string &user);
+  static void Index(UserIndex &index, const std::string &list,
+                    const std::string &task, const std::string &content);
+  static void Retire(UserIndex &index, const std::string &list,
+                     const std::string &task);
+  static void RetireList(UserIndex &index, const std::string &list);
+  static void Compact(UserIndex &index);
+  static void Append(Postings &postings, const Posting &posting);
+  static std::vector<Posting> Decode(const Postings &postings);
+
+  const size_t max_users;
+  std::mutex lock;
+  std::unordered_map<std::string, UserIndex> users;
+  uint64_t clock = 0;
+};
@@ -1,11 +1,18 @@
 #include "tasklistsWorker.h"
+#include "common/trace.h"
 #include "common/utils.h"
+#include <chrono>
 #include <iostream>
 #include <map>
+#include <set>
+
+/* How stale the names of a user may get before they are read again */
+static const std::chrono::milliseconds kNamesMaxAge(1000);
 
 TaskListsWorker::TaskListsWorker(std::shared_ptr<DB> _db,
                                  std::shared_ptr<Users> _users)
-    : db(_db), users(_users) {}
+    : db(_db), users(_users), nameTrie(std::make_shared<NameTrie>()),
+      reminders(std::make_shared<ReminderScheduler>(_db)) {}
 
 TaskListsWorker ::~TaskListsWorker() {}
 
@@ -37,6 +44,7 @@ void TaskListsWorker ::Map2Content(
 
 returnCode TaskListsWorker ::Query(const RequestData &data,
                                    TasklistContent &out) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
   // request has empty value
   if (data.RequestTaskListIsEmpty())
     return ERR_RFIELD;
@@ -72,9 +80,38 @@ returnCode TaskListsWorker ::Query(const RequestData &data,
   return ret;
 }
 
+returnCode TaskListsWorker ::QueryWithStats(const RequestData &data,
+                                            TasklistContent &out,
+                                            DBTaskListStats &stats) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
+  // request has empty value
+  if (data.RequestTaskListIsEmpty())
+    return ERR_RFIELD;
+
+  // as Query
+  if (!data.other_user_key.empty()) {
+    bool permission = false;
+    returnCode ret = db->checkAccess(data.other_user_key, data.user_key,
+                                     data.tasklist_key, permission);
+    if (ret != SUCCESS)
+      return ret;
+  }
+
+  std::map<std::string, std::string> task_list_info;
+  returnCode ret = db->getTaskListNodeWithStats(
+      data.other_user_key.empty() ? data.user_key : data.other_user_key,
+      data.tasklist_key, Common::Today(), task_list_info, stats);
+  if (ret != SUCCESS)
+    return ret;
+
+  Map2Content(task_list_info, out);
+  return ret;
+}
+
 returnCode TaskListsWorker ::Create(const RequestData &data,
                                     TasklistContent &in,
                                     std::string &outTasklistName) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
   // request has empty value
   if (data.RequestUserIsEmpty())
     return ERR_RFIELD;
@@ -101,21 +138,74 @@ returnCode TaskListsWorker ::Create(const RequestData &data,
 
   if (ret != SUCCESS)
     outTasklistName = "";
+  else
+    nameTrie->Add(data.user_key, outTasklistName);
 
   return ret;
 }
 
 returnCode TaskListsWorker ::Delete(const RequestData &data) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
   // request has empty value
   if (data.RequestTaskListIsEmpty())
     return ERR_RFIELD;
 
   returnCode ret = db->deleteTaskListNode(data.user_key, data.tasklist_key);
+  if (ret == SUCCESS) {
+    nameTrie->Remove(data.user_key, data.tasklist_key);
+    reminders->CancelAll(data.user_key, data.tasklist_key);
+  }
+  return ret;
+}
+
+returnCode TaskListsWorker ::Clone(const RequestData &data,
+                                   const std::string &name,
+                                   std::string &outTasklistName,
+                                   std::vector<std::string> &outTasks) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
+  outTasklistName = "";
+  outTasks.clear();
+  // request has empty value
+  if (data.RequestTaskListIsEmpty())
+    return ERR_RFIELD;
+
+  // read permission is enough to copy another user's tasklist
+  if (!data.other_user_key.empty()) {
+    bool permission = false;
+    returnCode ret = db->checkAccess(data.other_user_key, data.user_key,
+                                     data.tasklist_key, permission);
+    if (ret != SUCCESS)
+      return ret;
+  }
+
+  // the copy is named in the same statement, a duplicate only means another
+  // tasklist took that name meanwhile
+  returnCode ret;
+  do {
+    ret = db->cloneTaskListNode(
+        data.other_user_key.empty() ? data.user_key : data.other_user_key,
+        data.tasklist_key, data.user_key,
+        name.empty() ? data.tasklist_key : name, outTasklistName, outTasks);
+  } while (ret == ERR_DUP_NODE);
+
+  if (ret != SUCCESS) {
+    outTasklistName = "";
+    outTasks.clear();
+    return ret;
+  }
+  nameTrie->Add(data.user_key, outTasklistName);
+  for (const std::string &task : outTasks)
+    nameTrie->Add(data.user_key, outTasklistName, task);
+  // the copies have the fields of the tasks they copy, end dates included
+  reminders->Copy(
+      data.other_user_key.empty() ? data.user_key : data.other_user_key,
+      data.tasklist_key, data.user_key, outTasklistName, outTasks);
   return ret;
 }
 
 returnCode TaskListsWorker ::Revise(const RequestData &data,
                                     TasklistContent &in) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
   // request has empty value
   if (data.RequestTaskListIsEmpty())
     return ERR_RFIELD;
@@ -162,6 +252,7 @@ returnCode TaskListsWorker ::Revise(const RequestData &data,
 returnCode
 TaskListsWorker ::GetAllTasklist(const RequestData &data,
                                  std::vector<std::string> &outNames) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
   // request has empty value
   if (data.RequestUserIsEmpty())
     return ERR_RFIELD;
@@ -170,9 +261,35 @@ TaskListsWorker ::GetAllTasklist(const RequestData &data,
   return ret;
 }
 
+returnCode
+TaskListsWorker ::Stats(const RequestData &data,
+                        std::map<std::string, DBTaskListStats> &stats) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
+  // request has empty value
+  if (data.RequestUserIsEmpty())
+    return ERR_RFIELD;
+
+  // someone else's tasklist, checkAccess also ensures that it exists
+  if (!data.other_user_key.empty()) {
+    if (data.RequestTaskListIsEmpty())
+      return ERR_RFIELD;
+    bool permission = false;
+    returnCode ret = db->checkAccess(data.other_user_key, data.user_key,
+                                     data.tasklist_key, permission);
+    if (ret != SUCCESS)
+      return ret;
+  }
+
+  returnCode ret = db->getTaskListStats(
+      data.other_user_key.empty() ? data.user_key : data.other_user_key,
+      data.tasklist_key, Common::Today(), stats);
+  return ret;
+}
+
 returnCode
 TaskListsWorker ::GetAllAccessTaskList(const RequestData &data,
                                        std::vector<shareInfo> &out_list) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
   if (data.RequestUserIsEmpty())
     return ERR_RFIELD;
 
@@ -194,6 +311,7 @@ TaskListsWorker ::GetAllAccessTaskList(const RequestData &data,
 
 returnCode TaskListsWorker ::GetVisibility(const RequestData &data,
                                            std::string &visibility) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
   // request has empty value
   if (data.RequestTaskListIsEmpty())
     return ERR_RFIELD;
@@ -215,6 +333,7 @@ returnCode TaskListsWorker ::GetVisibility(const RequestData &data,
 
 returnCode TaskListsWorker ::GetAllGrantTaskList(
     const RequestData &data, std::vector<shareInfo> &out_list, bool &isPublic) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
   // request has empty value
   if (data.RequestTaskListIsEmpty())
     return ERR_RFIELD;
@@ -254,6 +373,7 @@ returnCode
 TaskListsWorker ::ReviseGrantTaskList(const RequestData &data,
                                       std::vector<shareInfo> &in_list,
                                       std::string &errUser) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
 
   if (data.RequestTaskListIsEmpty())
     return ERR_RFIELD;
@@ -288,6 +408,7 @@ TaskListsWorker ::ReviseGrantTaskList(const RequestData &data,
 }
 
 returnCode TaskListsWorker ::RemoveGrantTaskList(const RequestData &data) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
 
   if (data.RequestTaskListIsEmpty())
     return ERR_RFIELD;
@@ -315,6 +436,7 @@ returnCode TaskListsWorker ::RemoveGrantTaskList(const RequestData &data) {
 
 returnCode TaskListsWorker ::GetAllPublicTaskList(
     std::vector<std::pair<std::string, std::string>> &out_list) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
 
   returnCode ret = db->getAllPublic(out_list);
 
@@ -327,10 +449,126 @@ returnCode TaskListsWorker ::GetAllPublicTaskList(
 }
 
 bool TaskListsWorker ::Exists(const RequestData &data) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
   TasklistContent out;
   returnCode ret = Query(data, out);
   if (ret == SUCCESS) {
     return true;
   }
   return false;
-}
\ No newline at end of file
+}
+
+returnCode TaskListsWorker ::Sync(const RequestData &data, long long since,
+                                  long long &version,
+                                  std::vector<DBChange> &changes) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
+  // request has empty value
+  if (data.RequestUserIsEmpty())
+    return ERR_RFIELD;
+
+  // versions start from 1
+  if (since < 0)
+    return ERR_FORMAT;
+
+  returnCode ret = db->getChangesSince(data.user_key, since, version, changes);
+
+  // if request failed, clear the changes
+  if (ret != SUCCESS) {
+    changes = {};
+  }
+
+  return ret;
+}
+
+returnCode TaskListsWorker ::Export(const RequestData &data,
+                                    const DBExportCallback &emit,
+                                    const ExportGrantCallback &grant) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
+  // request has empty value
+  if (data.RequestUserIsEmpty())
+    return ERR_RFIELD;
+
+  // only shared tasklists have grants, their names are kept on the way
+  std::vector<std::string> shared;
+  bool more = true;
+  returnCode ret = db->exportUser(
+      data.user_key,
+      [&emit, &shared, &more](const std::string &list,
+                              const std::string &task,
+                              const std::map<std::string, std::string> &info) {
+        auto visibility = info.find("visibility");
+        if (!list.empty() && task.empty() && visibility != info.end() &&
+            visibility->second == "shared")
+          shared.push_back(list);
+        more = emit(list, task, info);
+        return more;
+      });
+  if (ret != SUCCESS || !more)
+    return ret;
+
+  for (const std::string &list : shared) {
+    std::map<std::string, bool> list_grants;
+    ret = db->allGrant(data.user_key, list, list_grants);
+    // deleted meanwhile
+    if (ret == ERR_NO_NODE)
+      continue;
+    if (ret != SUCCESS)
+      return ret;
+    for (const auto &to : list_grants) {
+      if (!grant(list, to.first, to.second))
+        return SUCCESS;
+    }
+  }
+  return SUCCESS;
+}
+
+returnCode TaskListsWorker ::Autocomplete(const RequestData &data,
+                                          const std::string &prefix,
+                                          int kinds, size_t k,
+                                          std::vector<RequestData> &out) {
+  TRACE_SCOPE("TaskListsWorker", __func__);
+  out.clear();
+  // request has empty value
+  if (data.RequestUserIsEmpty() || prefix.empty())
+    return ERR_RFIELD;
+
+  // all of the user's own tasklists, and the ones shared with it
+  std::map<std::pair<std::string, std::string>, bool> accesses;
+  returnCode ret = db->allAccess(data.user_key, accesses);
+  if (ret != SUCCESS)
+    return ret;
+  std::map<std::string, std::set<std::string>> scope;
+  scope[data.user_key];
+  for (const auto &access : accesses) {
+    if (access.first.first != data.user_key)
+      scope[access.first.first].insert(access.first.second);
+  }
+
+  // bring the owners up to date, a deleted owner is forgotten
+  for (const auto &owner : scope) {
+    long long since = 0;
+    if (!nameTrie->NeedsRefresh(owner.first, kNamesMaxAge, since))
+      continue;
+    long long version = 0;
+    std::vector<DBChange> changes;
+    ret = db->getChangesSince(owner.first, since, version, changes);
+    if (ret == ERR_NO_NODE) {
+      nameTrie->Drop(owner.first);
+      continue;
+    }
+    if (ret != SUCCESS)
+      return ret;
+    nameTrie->Apply(owner.first, since, version, changes);
+  }
+
+  for (NameHit &hit : nameTrie->Complete(prefix, scope, kinds, k)) {
+    RequestData name;
+    name.user_key = data.user_key;
+    if (hit.user != data.user_key)
+      name.other_user_key = std::move(hit.user);
+    name.tasklist_key = std::move(hit.list);
+    name.task_key = std::move(hit.task);
+    out.push_back(std::move(name));
+  }
+  return SUCCESS;
+}
@@ -5,10 +5,23 @@
 #include "common/errorCode.h"
 #include "common/utils.h"
 #include "db/DB.h"
+#include "reminders/reminderScheduler.h"
+#include "search/nameTrie.h"
 #include "users/users.h"
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
+/**
+ * @brief Receives the access grants of the exported tasklists, see
+ * TaskListsWorker::Export: the tasklist, the user it is shared with and
+ * whether that user may write. Returns false to stop the export.
+ *
+ */
+using ExportGrantCallback = std::function<bool(
+    const std::string &list, const std::string &to, bool read_write)>;
+
 /**
  * @brief This class is a worker class for tasklists
  *
@@ -29,24 +42,18 @@ private:
    */
   std::shared_ptr<Users> users;
 
-  /* methods */
   /**
-   * @brief convert tasklist content struct to map
+   * @brief prefix index of the tasklist and task names, see Autocomplete
    *
-   * @param [in] tasklistContent source struct
-   * @param [out] task_info target map to be filled
    */
-  void Content2Map(const TasklistContent &tasklistContent,
-                   std::map<std::string, std::string> &task_info);
+  std::shared_ptr<NameTrie> nameTrie;
 
   /**
-   * @brief convert map to content struct
+   * @brief reminders of the due tasks, shared with the tasks worker, see
+   * Reminders
    *
-   * @param [in] task_info source map
-   * @param [out] tasklistContent target struct to be filled
    */
-  void Map2Content(const std::map<std::string, std::string> &task_info,
-                   TasklistContent &tasklistContent);
+  std::shared_ptr<ReminderScheduler> reminders;
 
 public:
   /**
@@ -63,6 +70,25 @@ public:
    */
   virtual ~TaskListsWorker();
 
+  /* methods */
+  /**
+   * @brief convert tasklist content struct to map
+   *
+   * @param [in] tasklistContent source struct
+   * @param [out] task_info target map to be filled
+   */
+  static void Content2Map(const TasklistContent &tasklistContent,
+                          std::map<std::string, std::string> &task_info);
+
+  /**
+   * @brief convert map to content struct
+   *
+   * @param [in] task_info source map
+   * @param [out] tasklistContent target struct to be filled
+   */
+  static void Map2Content(const std::map<std::string, std::string> &task_info,
+                          TasklistContent &tasklistContent);
+
   /**
    * @brief Query the database to get a tasklist
    *
@@ -72,6 +98,19 @@ public:
    */
   virtual returnCode Query(const RequestData &data, TasklistContent &out);
 
+  /**
+   * @brief Query with the task counts of the tasklist, see Stats, read along
+   * with the tasklist
+   *
+   * @param [in] data target tasklist that we'd want to query for
+   * @param [out] out target tasklist's properties
+   * @param [out] stats target tasklist's task counts
+   * @return returnCode
+   */
+  virtual returnCode QueryWithStats(const RequestData &data,
+                                    TasklistContent &out,
+                                    DBTaskListStats &stats);
+
   /**
    * @brief Create a new tasklist in database
    *
@@ -91,6 +130,21 @@ public:
    */
   virtual returnCode Delete(const RequestData &data);
 
+  /**
+   * @brief Copy a tasklist and all its tasks into a new private tasklist of
+   * the user, who may only be able to read the source
+   *
+   * @param [in] data source tasklist, of other_user_key if set
+   * @param [in] name name of the copy, the source name if empty; a suffix is
+   * added if it is taken
+   * @param [out] outTasklistName name of the copy
+   * @param [out] outTasks names of the tasks copied
+   * @return returnCode
+   */
+  virtual returnCode Clone(const RequestData &data, const std::string &name,
+                           std::string &outTasklistName,
+                           std::vector<std::string> &outTasks);
+
   /**
    * @brief Revise a tasklist in database
    *
@@ -110,6 +164,17 @@ public:
   virtual returnCode GetAllTasklist(const RequestData &data,
                                     std::vector<std::string> &outNames);
 
+  /**
+   * @brief Get the task counts of a tasklist, or of all the tasklists of a
+   * user when no tasklist is given, which lists them all as well
+   *
+   * @param [in] data target tasklist, or target user, we'd want counts for
+   * @param [out] stats counts by tasklist name
+   * @return returnCode
+   */
+  virtual returnCode Stats(const RequestData &data,
+                           std::map<std::string, DBTaskListStats> &stats);
+
   /**
    * @brief Get the all Tasklist info that are shared by others
    *
@@ -189,4 +254,63 @@ public:
    */
   virtual returnCode GetVisibility(const RequestData &data,
                                    std::string &visibility);
+
+  /**
+   * @brief Get the tasklists and tasks of a user created, updated or deleted
+   * after a change version, so that a client only downloads what changed
+   *
+   * @param [in] data target user we'd want to sync
+   * @param [in] since change version the client is up to date with, 0 for
+   * everything
+   * @param [out] version current change version of the user, to pass as since
+   * next time
+   * @param [out] changes changes after since, oldest first
+   * @return returnCode
+   */
+  virtual returnCode Sync(const RequestData &data, long long since,
+                          long long &version, std::vector<DBChange> &changes);
+
+  /**
+   * @brief Stream everything a user owns: the user, its tasklists and their
+   * tasks, one node at a time, then the grants of its shared tasklists
+   *
+   * @param [in] data target user we'd want to export
+   * @param [in] emit receives every node as it is read, see DBExportCallback
+   * @param [in] grant receives every grant, read through allGrant once the
+   * nodes are out
+   * @return returnCode
+   */
+  virtual returnCode Export(const RequestData &data,
+                            const DBExportCallback &emit,
+                            const ExportGrantCallback &grant);
+
+  /**
+   * @brief Get the names of the tasklists and tasks a user can read starting
+   * with a prefix, ignoring case, in name order
+   *
+   * @param [in] data target user we'd want names for
+   * @param [in] prefix start of the names
+   * @param [in] kinds NameTrie::Kind of the names
+   * @param [in] k names to return at most
+   * @param [out] out tasklists, with an empty task_key, and tasks
+   * @return returnCode
+   */
+  virtual returnCode Autocomplete(const RequestData &data,
+                                  const std::string &prefix, int kinds,
+                                  size_t k, std::vector<RequestData> &out);
+
+  /**
+   * @brief Get the name index, for the tasks worker to keep its tasks in it
+   *
+   * @return std::shared_ptr<NameTrie>
+   */
+  std::shared_ptr<NameTrie> Names() const { return nameTrie; }
+
+  /**
+   * @brief Get the reminder scheduler, Delete and Clone keep it up to date
+   * for the tasks of the task lists, the tasks worker for each task
+   *
+   * @return std::shared_ptr<ReminderScheduler>
+   */
+  std::shared_ptr<ReminderScheduler> Reminders() const { return reminders; }
 };
\ No newline at end of file
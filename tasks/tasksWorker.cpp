@@ -1,9 +1,66 @@
 #include "tasksWorker.h"
+#include "common/recurrence.h"
+#include "common/trace.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <iostream>
+#include <iterator>
+#include <set>
+#include <tuple>
+
+/* Opaque pagination cursor of the agenda: sort key of the last task, in hex */
+static std::string EncodeCursor(const DBAgendaTask &task) {
+  static const char digits[] = "0123456789abcdef";
+  const std::string key = DBCache::Key(
+      {task.due, std::to_string(task.rank), task.user, task.list, task.task});
+  std::string cursor;
+  for (unsigned char c : key) {
+    cursor += digits[c >> 4];
+    cursor += digits[c & 0xf];
+  }
+  return cursor;
+}
+
+static bool DecodeCursor(const std::string &cursor, DBAgendaTask &task) {
+  if (cursor.size() % 2)
+    return false;
+  std::string key;
+  for (size_t i = 0; i < cursor.size(); i += 2) {
+    const std::string byte = cursor.substr(i, 2);
+    if (!isxdigit((unsigned char)byte[0]) || !isxdigit((unsigned char)byte[1]))
+      return false;
+    key += (char)std::stoi(byte, nullptr, 16);
+  }
+  std::vector<std::string> parts = DBCache::SplitKey(key);
+  if (parts.size() != 5 || parts[1].empty() ||
+      parts[1].find_first_not_of("0123456789") != std::string::npos ||
+      parts[1].size() > 2)
+    return false;
+  task.due = parts[0];
+  task.rank = std::stoi(parts[1]);
+  task.user = parts[2];
+  task.list = parts[3];
+  task.task = parts[4];
+  return true;
+}
+
+/* Agenda order: due day, priority rank, owner, task list, task name */
+static bool AgendaBefore(const DBAgendaTask &a, const DBAgendaTask &b) {
+  return std::tie(a.due, a.rank, a.user, a.list, a.task) <
+         std::tie(b.due, b.rank, b.user, b.list, b.task);
+}
+
+/* How stale the search index of a user may get, for writes of other
+   processes, before a search reads the changes since */
+static const std::chrono::milliseconds kSearchMaxAge(1000);
 
 TasksWorker::TasksWorker(std::shared_ptr<DB> _db,
                          std::shared_ptr<TaskListsWorker> _taskListsWorker)
-    : db(_db), taskListsWorker(_taskListsWorker) {}
+    : db(_db), taskListsWorker(_taskListsWorker),
+      searchIndex(std::make_shared<SearchIndex>()),
+      reminders(_taskListsWorker ? _taskListsWorker->Reminders()
+                                 : std::make_shared<ReminderScheduler>(_db)) {}
 
 TasksWorker::~TasksWorker() {}
 
@@ -24,6 +81,11 @@ void TasksWorker::TaskStruct2Map(
   if (!taskContent.endDate.empty())
     task_info["endDate"] = taskContent.endDate;
 
+  /* end date in a sortable form, for the agenda */
+  const std::string due = Common::DateKey(taskContent.endDate);
+  if (!due.empty())
+    task_info["due"] = due;
+
   /* deprecated, only for test purpose */
   if (!taskContent.date.empty())
     task_info["date"] = taskContent.date;
@@ -33,6 +95,9 @@ void TasksWorker::TaskStruct2Map(
 
   if (!taskContent.status.empty())
     task_info["status"] = taskContent.status;
+
+  if (!taskContent.recurrence.empty())
+    task_info["recurrence"] = taskContent.recurrence;
 }
 
 void TasksWorker::Map2TaskStruct(
@@ -59,9 +124,13 @@ void TasksWorker::Map2TaskStruct(
 
   if (task_info.count("status"))
     taskContent.status = task_info.at("status");
+
+  if (task_info.count("recurrence"))
+    taskContent.recurrence = task_info.at("recurrence");
 }
 
 returnCode TasksWorker::Query(const RequestData &data, TaskContent &out) {
+  TRACE_SCOPE("TasksWorker", __func__);
   // request has empty value
   if (data.RequestIsEmpty())
     return ERR_RFIELD;
@@ -104,8 +173,242 @@ returnCode TasksWorker::Query(const RequestData &data, TaskContent &out) {
   return ret;
 }
 
+returnCode TasksWorker::QueryMany(const std::vector<RequestData> &data,
+                                  std::vector<returnCode> &results,
+                                  std::vector<TaskContent> &out) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  if (data.empty() || data[0].user_key.empty())
+    return ERR_RFIELD;
+
+  // the incomplete requests are answered here, the others in one statement
+  results.assign(data.size(), ERR_RFIELD);
+  out.assign(data.size(), TaskContent());
+  std::vector<DBTaskKey> keys;
+  std::vector<size_t> positions;
+  for (size_t i = 0; i < data.size(); i++) {
+    if (data[i].user_key != data[0].user_key)
+      return ERR_RFIELD;
+    if (data[i].RequestIsEmpty())
+      continue;
+    keys.emplace_back(data[i].other_user_key.empty() ? data[i].user_key
+                                                     : data[i].other_user_key,
+                      data[i].tasklist_key, data[i].task_key);
+    positions.push_back(i);
+  }
+  if (keys.empty())
+    return SUCCESS;
+
+  std::vector<returnCode> key_results;
+  std::vector<std::map<std::string, std::string>> task_infos;
+  returnCode ret =
+      db->getTaskNodes(data[0].user_key, keys, key_results, task_infos);
+  if (ret != SUCCESS)
+    return ret;
+  if (key_results.size() != keys.size() || task_infos.size() != keys.size())
+    return ERR_UNKNOWN;
+
+  // assign value to out objects
+  for (size_t j = 0; j < keys.size(); j++) {
+    results[positions[j]] = key_results[j];
+    if (key_results[j] == SUCCESS)
+      Map2TaskStruct(task_infos[j], out[positions[j]]);
+  }
+  return SUCCESS;
+}
+
+returnCode
+TasksWorker::Agenda(const RequestData &data, const std::string &from,
+                    const std::string &to, size_t limit, std::string &cursor,
+                    std::vector<std::pair<RequestData, TaskContent>> &out) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  out.clear();
+  if (data.RequestUserIsEmpty() || from.empty() || to.empty())
+    return ERR_RFIELD;
+
+  // dates are compared in their sortable form
+  const std::string first = Common::DateKey(from);
+  const std::string last = Common::DateKey(to);
+  DBAgendaTask after;
+  if (first.empty() || last.empty() || first > last || limit == 0 ||
+      (!cursor.empty() && !DecodeCursor(cursor, after)))
+    return ERR_FORMAT;
+
+  // one task more than a page tells whether there is a next page
+  std::vector<DBAgendaTask> tasks;
+  std::vector<DBRecurringTask> repeating;
+  returnCode ret = db->getAgenda(data.user_key, first, last,
+                                 cursor.empty() ? nullptr : &after, limit + 1,
+                                 tasks, repeating);
+  if (ret != SUCCESS)
+    return ret;
+
+  // repeating tasks are stored once, their occurrences are merged in: no
+  // more of each than fits in the page, and none that was completed, as
+  // it is a task of its own
+  for (const DBRecurringTask &task : repeating) {
+    Common::Recurrence rule;
+    auto recurrence = task.info.find("recurrence");
+    long due;
+    if (recurrence == task.info.end() || !rule.Parse(recurrence->second) ||
+        !Common::DaysFromKey(task.due, due))
+      continue;
+    // the start date keeps its distance to the end date
+    long start = due;
+    auto startDate = task.info.find("startDate");
+    if (startDate != task.info.end())
+      Common::DaysFromKey(Common::DateKey(startDate->second), start);
+    const std::string from =
+        cursor.empty() ? first : std::max(first, after.due);
+    for (const std::string &day : rule.Occurrences(
+             task.due, from, last, limit + 2 + task.done.size())) {
+      if (std::find(task.done.begin(), task.done.end(), day) !=
+          task.done.end())
+        continue;
+      DBAgendaTask occurrence = task;
+      occurrence.due = day;
+      if (!cursor.empty() && !AgendaBefore(after, occurrence))
+        continue;
+      long days;
+      Common::DaysFromKey(day, days);
+      occurrence.info["due"] = day;
+      occurrence.info["endDate"] = Common::DateFromKey(day);
+      if (startDate != task.info.end())
+        occurrence.info["startDate"] =
+            Common::DateFromKey(Common::KeyFromDays(days - due + start));
+      tasks.push_back(std::move(occurrence));
+    }
+  }
+  std::sort(tasks.begin(), tasks.end(), AgendaBefore);
+  if (tasks.size() > limit + 1)
+    tasks.resize(limit + 1);
+
+  cursor.clear();
+  if (tasks.size() > limit) {
+    tasks.resize(limit);
+    cursor = EncodeCursor(tasks.back());
+  }
+
+  // assign value to out objects
+  for (const DBAgendaTask &task : tasks) {
+    TaskContent content;
+    Map2TaskStruct(task.info, content);
+    out.emplace_back(RequestData(data.user_key, task.list, task.task,
+                                 task.user == data.user_key ? ""
+                                                            : task.user),
+                     content);
+  }
+  return SUCCESS;
+}
+
+returnCode TasksWorker::Board(const RequestData &data,
+                              const std::string &status, size_t offset,
+                              size_t limit, std::vector<BoardColumn> &out) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  static const char *const statuses[] = {"To Do", "Doing", "Done"};
+  out.clear();
+  // request has empty value
+  if (data.RequestTaskListIsEmpty())
+    return ERR_RFIELD;
+  if (limit == 0 ||
+      (!status.empty() && std::find(std::begin(statuses), std::end(statuses),
+                                    status) == std::end(statuses)))
+    return ERR_FORMAT;
+
+  // same checks as GetAllTasksName
+  if (!data.other_user_key.empty()) {
+    bool permission = false;
+    returnCode ret = db->checkAccess(data.other_user_key, data.user_key,
+                                     data.tasklist_key, permission);
+    if (ret != SUCCESS)
+      // no permission
+      return ret;
+  } else {
+    // tasklist itself does not exist
+    if (!taskListsWorker->Exists(data)) {
+      return ERR_NO_NODE;
+    }
+  }
+
+  std::vector<DBBoardColumn> columns;
+  returnCode ret = db->getBoard(
+      data.other_user_key.empty() ? data.user_key : data.other_user_key,
+      data.tasklist_key, status, offset, limit, columns);
+  if (ret != SUCCESS)
+    return ret;
+
+  // every requested column, also the empty ones, in board order
+  for (const char *column_status : statuses) {
+    if (!status.empty() && status != column_status)
+      continue;
+    BoardColumn column;
+    column.status = column_status;
+    for (const DBBoardColumn &db_column : columns) {
+      if (db_column.status != column_status)
+        continue;
+      column.total = db_column.total;
+      for (const auto &task_info : db_column.tasks) {
+        column.tasks.emplace_back();
+        Map2TaskStruct(task_info, column.tasks.back());
+      }
+    }
+    out.push_back(std::move(column));
+  }
+  return SUCCESS;
+}
+
+returnCode
+TasksWorker::Search(const RequestData &data, const std::string &query, size_t k,
+                    std::vector<std::pair<RequestData, double>> &out) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  out.clear();
+  // request has empty value
+  if (data.RequestUserIsEmpty() || SearchIndex::Tokenize(query).empty())
+    return ERR_RFIELD;
+
+  // all of the user's own task lists, and the ones shared with it
+  std::map<std::pair<std::string, std::string>, bool> accesses;
+  returnCode ret = db->allAccess(data.user_key, accesses);
+  if (ret != SUCCESS)
+    return ret;
+  std::map<std::string, std::set<std::string>> scope;
+  scope[data.user_key];
+  for (const auto &access : accesses) {
+    if (access.first.first != data.user_key)
+      scope[access.first.first].insert(access.first.second);
+  }
+
+  // bring the owners up to date, a deleted owner is forgotten
+  for (const auto &owner : scope) {
+    long long since = 0;
+    if (!searchIndex->NeedsRefresh(owner.first, kSearchMaxAge, since))
+      continue;
+    long long version = 0;
+    std::vector<DBChange> changes;
+    ret = db->getChangesSince(owner.first, since, version, changes);
+    if (ret == ERR_NO_NODE) {
+      searchIndex->Drop(owner.first);
+      continue;
+    }
+    if (ret != SUCCESS)
+      return ret;
+    searchIndex->Apply(owner.first, since, version, changes);
+  }
+
+  for (SearchHit &hit : searchIndex->Search(query, scope, k)) {
+    RequestData task;
+    task.user_key = data.user_key;
+    if (hit.user != data.user_key)
+      task.other_user_key = std::move(hit.user);
+    task.tasklist_key = std::move(hit.list);
+    task.task_key = std::move(hit.task);
+    out.emplace_back(std::move(task), hit.score);
+  }
+  return SUCCESS;
+}
+
 returnCode TasksWorker::Create(const RequestData &data, TaskContent &in,
                                std::string &outTaskName) {
+  TRACE_SCOPE("TasksWorker", __func__);
   // request has empty value
   if (data.RequestTaskListIsEmpty())
     return ERR_RFIELD;
@@ -114,8 +417,8 @@ returnCode TasksWorker::Create(const RequestData &data, TaskContent &in,
   if (in.MissingKey())
     return ERR_KEY;
 
-  // check if in is valid
-  if (!in.IsValid())
+  // check if in is valid, a repeating task repeats from its end date
+  if (!in.IsValid() || (!in.recurrence.empty() && in.endDate.empty()))
     return ERR_FORMAT;
 
   // if other_user_key is not empty, "chekcAccess" has already checked the src
@@ -157,10 +460,93 @@ returnCode TasksWorker::Create(const RequestData &data, TaskContent &in,
                              data.tasklist_key, task_info);
   } while (ret == ERR_DUP_NODE);
 
+  if (ret == SUCCESS) {
+    const std::string &owner =
+        data.other_user_key.empty() ? data.user_key : data.other_user_key;
+    searchIndex->Put(owner, data.tasklist_key, outTaskName, in.content);
+    taskListsWorker->Names()->Add(owner, data.tasklist_key, outTaskName);
+    reminders->Update(owner, data.tasklist_key, outTaskName, task_info);
+  }
   return ret;
 }
 
+returnCode TasksWorker::Complete(const RequestData &data,
+                                 const std::string &date,
+                                 std::string &outTaskName) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  outTaskName = "";
+  // request has empty value
+  if (data.RequestIsEmpty() || date.empty())
+    return ERR_RFIELD;
+  const std::string day = Common::DateKey(date);
+  if (day.empty())
+    return ERR_FORMAT;
+
+  // same checks as Create
+  if (!data.other_user_key.empty()) {
+    bool permission = false;
+    returnCode ret = db->checkAccess(data.other_user_key, data.user_key,
+                                     data.tasklist_key, permission);
+    if (ret != SUCCESS)
+      // no permission
+      return ret;
+    if (!permission) {
+      // read only permission cannot complete
+      return ERR_ACCESS;
+    }
+  } else {
+    // tasklist itself does not exist
+    if (!taskListsWorker->Exists(data)) {
+      return ERR_NO_NODE;
+    }
+  }
+
+  const std::string &owner =
+      data.other_user_key.empty() ? data.user_key : data.other_user_key;
+  std::map<std::string, std::string> task_info;
+  returnCode ret =
+      db->getTaskNode(owner, data.tasklist_key, data.task_key, task_info);
+  if (ret != SUCCESS)
+    return ret;
+  Common::Recurrence rule;
+  long due, days, start;
+  if (!rule.Parse(task_info["recurrence"]) ||
+      rule.Occurrences(task_info["due"], day, day, 1).empty() ||
+      !Common::DaysFromKey(task_info["due"], due) ||
+      !Common::DaysFromKey(day, days))
+    return ERR_FORMAT;
+
+  // the occurrence becomes a task of its own, done, that Agenda shows
+  // instead of computing it
+  std::map<std::string, std::string> occurrence;
+  for (const char *field : {"content", "priority"}) {
+    if (!task_info[field].empty())
+      occurrence[field] = task_info[field];
+  }
+  occurrence["name"] = data.task_key + "@" + day;
+  occurrence["occurrence_of"] = data.task_key;
+  occurrence["status"] = "Done";
+  occurrence["due"] = day;
+  occurrence["endDate"] = Common::DateFromKey(day);
+  if (Common::DaysFromKey(Common::DateKey(task_info["startDate"]), start))
+    occurrence["startDate"] =
+        Common::DateFromKey(Common::KeyFromDays(days - due + start));
+  ret = db->createTaskNode(owner, data.tasklist_key, occurrence);
+  if (ret == SUCCESS) {
+    searchIndex->Put(owner, data.tasklist_key, occurrence["name"],
+                     occurrence["content"]);
+    taskListsWorker->Names()->Add(owner, data.tasklist_key,
+                                  occurrence["name"]);
+  } else if (ret != ERR_DUP_NODE) {
+    return ret;
+  }
+  // completing it again changes nothing
+  outTaskName = occurrence["name"];
+  return SUCCESS;
+}
+
 returnCode TasksWorker::Delete(const RequestData &data) {
+  TRACE_SCOPE("TasksWorker", __func__);
   // request has empty value
   if (data.RequestIsEmpty())
     return ERR_RFIELD;
@@ -191,10 +577,289 @@ returnCode TasksWorker::Delete(const RequestData &data) {
   returnCode ret = db->deleteTaskNode(
       data.other_user_key.empty() ? data.user_key : data.other_user_key,
       data.tasklist_key, data.task_key);
+  if (ret == SUCCESS) {
+    const std::string &owner =
+        data.other_user_key.empty() ? data.user_key : data.other_user_key;
+    searchIndex->Remove(owner, data.tasklist_key, data.task_key);
+    taskListsWorker->Names()->Remove(owner, data.tasklist_key, data.task_key);
+    reminders->Cancel(owner, data.tasklist_key, data.task_key);
+  }
   return ret;
 }
 
+returnCode TasksWorker::Move(const RequestData &data, const RequestData &to,
+                             std::string &outTaskName) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  outTaskName = "";
+  // request has empty value
+  if (data.RequestIsEmpty() || to.tasklist_key.empty())
+    return ERR_RFIELD;
+
+  // write access to the task lists of other users; the move itself checks
+  // that the task and the target task list exist
+  for (const RequestData *list : {&data, &to}) {
+    if (list->other_user_key.empty())
+      continue;
+    bool permission = false;
+    returnCode ret = db->checkAccess(list->other_user_key, data.user_key,
+                                     list->tasklist_key, permission);
+    if (ret != SUCCESS)
+      // no permission
+      return ret;
+    if (!permission) {
+      // read only permission cannot move
+      return ERR_ACCESS;
+    }
+  }
+
+  const std::string &owner =
+      data.other_user_key.empty() ? data.user_key : data.other_user_key;
+  const std::string &dst_owner =
+      to.other_user_key.empty() ? data.user_key : to.other_user_key;
+  if (owner == dst_owner && data.tasklist_key == to.tasklist_key) {
+    // already there
+    outTaskName = data.task_key;
+    return SUCCESS;
+  }
+
+  int suffix = 0;
+  returnCode ret;
+  std::map<std::string, std::string> task_info;
+  do {
+    outTaskName = Common::Rename(data.task_key, suffix++);
+    ret = db->moveTaskNode(owner, data.tasklist_key, data.task_key, dst_owner,
+                           to.tasklist_key, outTaskName, task_info);
+  } while (ret == ERR_DUP_NODE);
+
+  if (ret != SUCCESS) {
+    outTaskName = "";
+    return ret;
+  }
+  searchIndex->Remove(owner, data.tasklist_key, data.task_key);
+  searchIndex->Put(dst_owner, to.tasklist_key, outTaskName,
+                   task_info["content"]);
+  taskListsWorker->Names()->Remove(owner, data.tasklist_key, data.task_key);
+  taskListsWorker->Names()->Add(dst_owner, to.tasklist_key, outTaskName);
+  reminders->Cancel(owner, data.tasklist_key, data.task_key);
+  reminders->Update(dst_owner, to.tasklist_key, outTaskName, task_info);
+  return SUCCESS;
+}
+
+returnCode TasksWorker::Reorder(const RequestData &data,
+                                const std::string &anchor, bool after,
+                                std::string &outPosition) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  outPosition = "";
+  // request has empty value
+  if (data.RequestIsEmpty() || anchor.empty())
+    return ERR_RFIELD;
+
+  // the order is shared by everyone who sees the task list
+  if (!data.other_user_key.empty()) {
+    bool permission = false;
+    returnCode ret = db->checkAccess(data.other_user_key, data.user_key,
+                                     data.tasklist_key, permission);
+    if (ret != SUCCESS)
+      // no permission
+      return ret;
+    if (!permission) {
+      // read only permission cannot reorder
+      return ERR_ACCESS;
+    }
+  }
+
+  return db->reorderTaskNode(
+      data.other_user_key.empty() ? data.user_key : data.other_user_key,
+      data.tasklist_key, data.task_key, anchor, after, outPosition);
+}
+
+returnCode TasksWorker::AddDependency(const RequestData &data,
+                                      const std::string &on) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  // request has empty value
+  if (data.RequestIsEmpty() || on.empty())
+    return ERR_RFIELD;
+
+  // same checks as Reorder
+  if (!data.other_user_key.empty()) {
+    bool permission = false;
+    returnCode ret = db->checkAccess(data.other_user_key, data.user_key,
+                                     data.tasklist_key, permission);
+    if (ret != SUCCESS)
+      // no permission
+      return ret;
+    if (!permission) {
+      // read only permission cannot add dependencies
+      return ERR_ACCESS;
+    }
+  }
+
+  return db->addDependency(
+      data.other_user_key.empty() ? data.user_key : data.other_user_key,
+      data.tasklist_key, data.task_key, on);
+}
+
+returnCode TasksWorker::RemoveDependency(const RequestData &data,
+                                         const std::string &on) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  // request has empty value
+  if (data.RequestIsEmpty() || on.empty())
+    return ERR_RFIELD;
+
+  // same checks as Reorder
+  if (!data.other_user_key.empty()) {
+    bool permission = false;
+    returnCode ret = db->checkAccess(data.other_user_key, data.user_key,
+                                     data.tasklist_key, permission);
+    if (ret != SUCCESS)
+      // no permission
+      return ret;
+    if (!permission) {
+      // read only permission cannot remove dependencies
+      return ERR_ACCESS;
+    }
+  }
+
+  return db->removeDependency(
+      data.other_user_key.empty() ? data.user_key : data.other_user_key,
+      data.tasklist_key, data.task_key, on);
+}
+
+returnCode TasksWorker::Graph(const RequestData &data,
+                              std::vector<DBGraphTask> &outTasks,
+                              std::vector<size_t> &outOrder) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  outTasks.clear();
+  outOrder.clear();
+  // request has empty value
+  if (data.RequestTaskListIsEmpty())
+    return ERR_RFIELD;
+
+  // same checks as GetAllTasksName
+  if (!data.other_user_key.empty()) {
+    bool permission = false;
+    returnCode ret = db->checkAccess(data.other_user_key, data.user_key,
+                                     data.tasklist_key, permission);
+    if (ret != SUCCESS)
+      // no permission
+      return ret;
+  } else {
+    // tasklist itself does not exist
+    if (!taskListsWorker->Exists(data)) {
+      return ERR_NO_NODE;
+    }
+  }
+
+  returnCode ret = db->getTaskGraph(
+      data.other_user_key.empty() ? data.user_key : data.other_user_key,
+      data.tasklist_key, outTasks);
+  if (ret != SUCCESS)
+    return ret;
+
+  // Kahn's algorithm, taking the ready task that comes first in the list
+  std::map<std::string, size_t> index;
+  for (size_t i = 0; i < outTasks.size(); i++) {
+    index[outTasks[i].task] = i;
+  }
+  std::vector<size_t> waiting(outTasks.size(), 0);
+  std::vector<std::vector<size_t>> dependents(outTasks.size());
+  for (size_t i = 0; i < outTasks.size(); i++) {
+    for (const std::string &on : outTasks[i].depends_on) {
+      auto it = index.find(on);
+      if (it == index.end())
+        continue;
+      waiting[i]++;
+      dependents[it->second].push_back(i);
+    }
+  }
+  std::set<size_t> ready;
+  for (size_t i = 0; i < outTasks.size(); i++) {
+    if (waiting[i] == 0)
+      ready.insert(i);
+  }
+  while (!ready.empty()) {
+    const size_t i = *ready.begin();
+    ready.erase(ready.begin());
+    outOrder.push_back(i);
+    for (size_t dependent : dependents[i]) {
+      if (--waiting[dependent] == 0)
+        ready.insert(dependent);
+    }
+  }
+  // addDependency keeps cycles out, a task left over is one written around
+  // it; it is put last rather than lost
+  for (size_t i = 0; i < outTasks.size(); i++) {
+    if (waiting[i] != 0)
+      outOrder.push_back(i);
+  }
+  return SUCCESS;
+}
+
+returnCode TasksWorker::Order(const RequestData &data,
+                              std::vector<std::string> &outTaskNameList) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  outTaskNameList.clear();
+  std::vector<DBGraphTask> tasks;
+  std::vector<size_t> order;
+  returnCode ret = Graph(data, tasks, order);
+  if (ret != SUCCESS)
+    return ret;
+  for (size_t i : order) {
+    outTaskNameList.push_back(tasks[i].task);
+  }
+  return SUCCESS;
+}
+
+returnCode TasksWorker::CriticalPath(const RequestData &data,
+                                     std::vector<std::string> &outTaskNameList,
+                                     long &outDays) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  outTaskNameList.clear();
+  outDays = 0;
+  std::vector<DBGraphTask> tasks;
+  std::vector<size_t> order;
+  returnCode ret = Graph(data, tasks, order);
+  if (ret != SUCCESS || tasks.empty())
+    return ret;
+
+  std::map<std::string, size_t> index;
+  for (size_t i = 0; i < tasks.size(); i++) {
+    index[tasks[i].task] = i;
+  }
+  // longest chain ending at each task, in topological order
+  std::vector<long> days(tasks.size(), 0);
+  std::vector<size_t> previous(tasks.size(), tasks.size());
+  std::vector<bool> done(tasks.size(), false);
+  size_t last = order.front();
+  for (size_t i : order) {
+    long start = 0, end = 0, duration = 0;
+    if (Common::DaysFromKey(Common::DateKey(tasks[i].startDate), start) &&
+        Common::DaysFromKey(Common::DateKey(tasks[i].endDate), end) &&
+        end >= start)
+      duration = end - start + 1;
+    for (const std::string &on : tasks[i].depends_on) {
+      auto it = index.find(on);
+      if (it == index.end() || !done[it->second])
+        continue;
+      if (previous[i] == tasks.size() || days[it->second] > days[previous[i]])
+        previous[i] = it->second;
+    }
+    days[i] = duration + (previous[i] == tasks.size() ? 0 : days[previous[i]]);
+    done[i] = true;
+    if (days[i] > days[last])
+      last = i;
+  }
+
+  outDays = days[last];
+  for (size_t i = last; i != tasks.size(); i = previous[i]) {
+    outTaskNameList.push_back(tasks[i].task);
+  }
+  std::reverse(outTaskNameList.begin(), outTaskNameList.end());
+  return SUCCESS;
+}
+
 returnCode TasksWorker::Revise(const RequestData &data, TaskContent &in) {
+  TRACE_SCOPE("TasksWorker", __func__);
   // request has empty value
   if (data.RequestIsEmpty())
     return ERR_RFIELD;
@@ -231,19 +896,42 @@ returnCode TasksWorker::Revise(const RequestData &data, TaskContent &in) {
     }
   }
 
+  const std::string &owner =
+      data.other_user_key.empty() ? data.user_key : data.other_user_key;
+
+  // as in Create, a repeating task repeats from its end date, here the one
+  // it already has unless the revision sets one
+  if (!in.recurrence.empty() && in.endDate.empty()) {
+    std::map<std::string, std::string> current;
+    returnCode found =
+        db->getTaskNode(owner, data.tasklist_key, data.task_key, current);
+    if (found != SUCCESS)
+      return found;
+    if (current.find("endDate") == current.end())
+      return ERR_FORMAT;
+  }
+
   // can access
   std::map<std::string, std::string> task_info;
   TaskStruct2Map(in, task_info);
 
-  returnCode ret = db->reviseTaskNode(
-      data.other_user_key.empty() ? data.user_key : data.other_user_key,
-      data.tasklist_key, data.task_key, task_info);
+  std::map<std::string, std::string> revised;
+  returnCode ret = db->reviseTaskNode(owner, data.tasklist_key, data.task_key,
+                                      task_info, &revised);
+  // only the content is indexed besides the name, which cannot change
+  if (ret == SUCCESS && !in.content.empty())
+    searchIndex->Put(owner, data.tasklist_key, data.task_key, in.content);
+  // from the task as it now is, not from the fields revised: a reopened
+  // task gets its reminder back, a new end date of a done one gets none
+  if (ret == SUCCESS)
+    reminders->Update(owner, data.tasklist_key, data.task_key, revised);
   return ret;
 }
 
 returnCode
 TasksWorker::GetAllTasksName(const RequestData &data,
                              std::vector<std::string> &outTaskNameList) {
+  TRACE_SCOPE("TasksWorker", __func__);
   // request has empty value
   if (data.RequestTaskListIsEmpty())
     return ERR_RFIELD;
@@ -271,4 +959,115 @@ TasksWorker::GetAllTasksName(const RequestData &data,
       data.other_user_key.empty() ? data.user_key : data.other_user_key,
       data.tasklist_key, outTaskNameList);
   return ret;
-}
\ No newline at end of file
+}
+
+returnCode TasksWorker::Archived(const RequestData &data,
+                                 std::vector<TaskContent> &out) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  out.clear();
+  // request has empty value
+  if (data.RequestTaskListIsEmpty())
+    return ERR_RFIELD;
+
+  // same checks as GetAllTasksName
+  if (!data.other_user_key.empty()) {
+    bool permission = false;
+    returnCode ret = db->checkAccess(data.other_user_key, data.user_key,
+                                     data.tasklist_key, permission);
+    if (ret != SUCCESS)
+      // no permission
+      return ret;
+  } else {
+    // tasklist itself does not exist
+    if (!taskListsWorker->Exists(data)) {
+      return ERR_NO_NODE;
+    }
+  }
+
+  std::vector<std::map<std::string, std::string>> task_infos;
+  returnCode ret = db->getArchivedTaskNodes(
+      data.other_user_key.empty() ? data.user_key : data.other_user_key,
+      data.tasklist_key, data.task_key, task_infos);
+  if (ret != SUCCESS)
+    return ret;
+  for (const auto &task_info : task_infos) {
+    out.emplace_back();
+    Map2TaskStruct(task_info, out.back());
+  }
+  return SUCCESS;
+}
+
+returnCode TasksWorker::History(const RequestData &data, long long before,
+                                size_t limit,
+                                std::vector<DBTaskRevision> &out) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  out.clear();
+  // request has empty value
+  if (data.RequestIsEmpty())
+    return ERR_RFIELD;
+  if (limit == 0)
+    return ERR_FORMAT;
+
+  // same checks as GetAllTasksName
+  if (!data.other_user_key.empty()) {
+    bool permission = false;
+    returnCode ret = db->checkAccess(data.other_user_key, data.user_key,
+                                     data.tasklist_key, permission);
+    if (ret != SUCCESS)
+      // no permission
+      return ret;
+  } else {
+    // tasklist itself does not exist
+    if (!taskListsWorker->Exists(data)) {
+      return ERR_NO_NODE;
+    }
+  }
+
+  std::map<std::string, std::string> task_info;
+  return db->getTaskRevisions(
+      data.other_user_key.empty() ? data.user_key : data.other_user_key,
+      data.tasklist_key, data.task_key, 0, before, limit, task_info, out);
+}
+
+returnCode TasksWorker::AtVersion(const RequestData &data, long long version,
+                                  TaskContent &out) {
+  TRACE_SCOPE("TasksWorker", __func__);
+  // request has empty value
+  if (data.RequestIsEmpty())
+    return ERR_RFIELD;
+
+  // same checks as GetAllTasksName
+  if (!data.other_user_key.empty()) {
+    bool permission = false;
+    returnCode ret = db->checkAccess(data.other_user_key, data.user_key,
+                                     data.tasklist_key, permission);
+    if (ret != SUCCESS)
+      // no permission
+      return ret;
+  } else {
+    // tasklist itself does not exist
+    if (!taskListsWorker->Exists(data)) {
+      return ERR_NO_NODE;
+    }
+  }
+
+  std::map<std::string, std::string> task_info;
+  std::vector<DBTaskRevision> revisions;
+  returnCode ret = db->getTaskRevisions(
+      data.other_user_key.empty() ? data.user_key : data.other_user_key,
+      data.tasklist_key, data.task_key, version, 0, 0, task_info, revisions);
+  if (ret != SUCCESS)
+    return ret;
+  // undo the revisions, the last first
+  for (const DBTaskRevision &revision : revisions) {
+    for (const auto &field : revision.before) {
+      if (field.second.empty())
+        task_info.erase(field.first);
+      else
+        task_info[field.first] = field.second;
+    }
+  }
+  out = TaskContent();
+  Map2TaskStruct(task_info, out);
+  return SUCCESS;
+}
@@ -4,9 +4,13 @@
 #include "api/taskContent.h"
 #include "common/utils.h"
 #include "db/DB.h"
+#include "reminders/reminderScheduler.h"
+#include "search/searchIndex.h"
 #include "tasklists/tasklistsWorker.h"
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 class TaskListsWorker; // forward definition
 
@@ -30,21 +34,29 @@ protected:
   std::shared_ptr<TaskListsWorker> taskListsWorker;
 
   /**
-   * @brief Construct a new Tasks Worker object
+   * @brief keyword index of the tasks, see Search
    *
-   * @param taskContent
-   * @param task_info
    */
-  void TaskStruct2Map(const TaskContent &taskContent,
-                      std::map<std::string, std::string> &task_info);
+  std::shared_ptr<SearchIndex> searchIndex;
+
   /**
-   * @brief Convert map to TaskContent object
+   * @brief reminders of the open tasks with an end date, those of the task
+   * lists worker, kept up to date by Create, Revise, Delete and Move
    *
-   * @param task_info
-   * @param taskContent
    */
-  void Map2TaskStruct(const std::map<std::string, std::string> &task_info,
-                      TaskContent &taskContent);
+  std::shared_ptr<ReminderScheduler> reminders;
+
+  /**
+   * @brief Read the tasks of the task list with their dependencies and sort
+   * them for Order and CriticalPath.
+   *
+   * @param data the task list, with read access checked as GetAllTasksName
+   * @param outTasks as DB::getTaskGraph returns them
+   * @param outOrder indices of outTasks, each after the ones it depends on
+   * @return returnCode
+   */
+  returnCode Graph(const RequestData &data, std::vector<DBGraphTask> &outTasks,
+                   std::vector<size_t> &outOrder);
 
 public:
   /* method */
@@ -63,6 +75,25 @@ public:
    */
   virtual ~TasksWorker();
 
+  /**
+   * @brief Convert TaskContent object to the map stored in the DB, with the
+   * sortable end date of the agenda
+   *
+   * @param taskContent
+   * @param task_info
+   */
+  static void TaskStruct2Map(const TaskContent &taskContent,
+                             std::map<std::string, std::string> &task_info);
+  /**
+   * @brief Convert map to TaskContent object
+   *
+   * @param task_info
+   * @param taskContent
+   */
+  static void
+  Map2TaskStruct(const std::map<std::string, std::string> &task_info,
+                 TaskContent &taskContent);
+
   /**
    * @brief Query the task and return the task content in out.
    *
@@ -72,6 +103,74 @@ public:
    */
   virtual returnCode Query(const RequestData &data, TaskContent &out);
 
+  /**
+   * @brief Query many tasks, each named the way Query takes it, in a single
+   * DB round trip. All of them must be requested by the same user.
+   *
+   * @param data
+   * @param results one per element of data, what Query would return
+   * @param out one per element of data
+   * @return returnCode ERR_RFIELD if data is empty or the users differ
+   */
+  virtual returnCode QueryMany(const std::vector<RequestData> &data,
+                               std::vector<returnCode> &results,
+                               std::vector<TaskContent> &out);
+
+  /**
+   * @brief Tasks due between two dates, of the task lists the user owns and
+   * of the ones shared with it, by due date and priority, a page at a time.
+   * A repeating task comes once per occurrence in the window, with the dates
+   * of the occurrence, unless the occurrence was completed, see Complete.
+   * other_user_key of each RequestData in out is the owner, empty for the
+   * user itself.
+   *
+   * @param data
+   * @param from first day, in the format of TaskContent dates
+   * @param to last day, in the format of TaskContent dates
+   * @param limit tasks per page
+   * @param cursor in: empty for the first page, otherwise the cursor returned
+   * with the previous page; out: cursor of the next page, empty after the last
+   * @param out
+   * @return returnCode ERR_FORMAT for bad dates, limit or cursor
+   */
+  virtual returnCode
+  Agenda(const RequestData &data, const std::string &from,
+         const std::string &to, size_t limit, std::string &cursor,
+         std::vector<std::pair<RequestData, TaskContent>> &out);
+
+  /**
+   * @brief Tasks of the task list grouped by status, To Do, Doing and Done in
+   * this order, each with its total and a page of its tasks.
+   *
+   * @param data
+   * @param status only this column, empty for all three
+   * @param offset tasks to skip in each column
+   * @param limit tasks per column
+   * @param out
+   * @return returnCode ERR_FORMAT for an unknown status or a zero limit
+   */
+  virtual returnCode Board(const RequestData &data, const std::string &status,
+                           size_t offset, size_t limit,
+                           std::vector<BoardColumn> &out);
+
+  /**
+   * @brief Tasks of the task lists the user owns and of the ones shared with
+   * it whose name and content contain every word of the query, best first.
+   * Served from an in-memory index that is brought up to date from the DB
+   * change feed at most once per second per owner, writes through this
+   * worker show up right away. other_user_key of each RequestData in out is
+   * the owner, empty for the user itself.
+   *
+   * @param data
+   * @param query words to look for
+   * @param k tasks to return at most
+   * @param out tasks and their scores
+   * @return returnCode ERR_RFIELD if the query has no words
+   */
+  virtual returnCode Search(const RequestData &data, const std::string &query,
+                            size_t k,
+                            std::vector<std::pair<RequestData, double>> &out);
+
   /**
    * @brief Create a Task object and return the task name in outTaskName.
    *
@@ -83,6 +182,20 @@ public:
   virtual returnCode Create(const RequestData &data, TaskContent &in,
                             std::string &outTaskName);
 
+  /**
+   * @brief Complete one occurrence of a repeating task. The occurrence
+   * becomes a task of its own, done, named after the task and the day, e.g.
+   * "standup@2022-11-29"; the repeating task is left as it is. Completing
+   * an occurrence twice succeeds and changes nothing.
+   *
+   * @param data the repeating task
+   * @param date day of the occurrence, in the format of TaskContent dates
+   * @param outTaskName name of the task of the occurrence
+   * @return returnCode ERR_FORMAT if the task does not repeat on that day
+   */
+  virtual returnCode Complete(const RequestData &data, const std::string &date,
+                              std::string &outTaskName);
+
   /**
    * @brief Delete the task.
    *
@@ -91,6 +204,79 @@ public:
    */
   virtual returnCode Delete(const RequestData &data);
 
+  /**
+   * @brief Move the task to another task list in one DB statement, renamed
+   * like Create if the target has a task of that name.
+   *
+   * @param data the task
+   * @param to tasklist_key and other_user_key of the target task list
+   * @param outTaskName name of the task in the target task list
+   * @return returnCode ERR_ACCESS without write access to both task lists
+   */
+  virtual returnCode Move(const RequestData &data, const RequestData &to,
+                          std::string &outTaskName);
+
+  /**
+   * @brief Put the task right after, or right before, another task of its
+   * task list, see GetAllTasksName. Only the task is written.
+   *
+   * @param data the task
+   * @param anchor name of the task to put it next to
+   * @param after after the anchor, otherwise before it
+   * @param outPosition new position of the task
+   * @return returnCode ERR_ACCESS without write access to the task list
+   */
+  virtual returnCode Reorder(const RequestData &data, const std::string &anchor,
+                             bool after, std::string &outPosition);
+
+  /**
+   * @brief Make the task depend on another task of its task list. The
+   * dependencies of a task list form a DAG, see Order.
+   *
+   * @param data the task
+   * @param on name of the task it depends on
+   * @return returnCode ERR_FORMAT if the dependency would close a cycle,
+   * ERR_ACCESS without write access to the task list
+   */
+  virtual returnCode AddDependency(const RequestData &data,
+                                   const std::string &on);
+
+  /**
+   * @brief Remove the dependency of the task on another task.
+   *
+   * @param data the task
+   * @param on name of the task it depends on
+   * @return returnCode ERR_NO_NODE if there is no such dependency
+   */
+  virtual returnCode RemoveDependency(const RequestData &data,
+                                      const std::string &on);
+
+  /**
+   * @brief All tasks of the task list in an order where each task comes
+   * after the tasks it depends on, otherwise in the order of
+   * GetAllTasksName. Read in one DB query.
+   *
+   * @param data the task list
+   * @param outTaskNameList
+   * @return returnCode
+   */
+  virtual returnCode Order(const RequestData &data,
+                           std::vector<std::string> &outTaskNameList);
+
+  /**
+   * @brief The chain of dependent tasks of the task list that takes the
+   * longest, first task first. A task takes the days from its start date to
+   * its end date, both included, and none without both dates.
+   *
+   * @param data the task list
+   * @param outTaskNameList the chain, empty if the task list has no tasks
+   * @param outDays days the chain takes
+   * @return returnCode
+   */
+  virtual returnCode CriticalPath(const RequestData &data,
+                                  std::vector<std::string> &outTaskNameList,
+                                  long &outDays);
+
   /**
    * @brief Update the task with the TaskContent object in.
    *
@@ -102,7 +288,7 @@ public:
 
   /**
    * @brief Get all tasks in the tasklist and return the task name list in
-   * outTaskNameList.
+   * outTaskNameList, in the order set by Reorder, new tasks last.
    *
    * @param data
    * @param out
@@ -110,4 +296,52 @@ public:
    */
   virtual returnCode GetAllTasksName(const RequestData &data,
                                      std::vector<std::string> &outTaskNameList);
+
+  /**
+   * @brief Get the archived tasks of the tasklist, the last archived first,
+   * see DB::archiveDoneTasks. Active tasks are not among them.
+   *
+   * @param data the task list, and the task if only the archived tasks of
+   * that name are wanted
+   * @param out
+   * @return returnCode
+   */
+  virtual returnCode Archived(const RequestData &data,
+                              std::vector<TaskContent> &out);
+
+  /**
+   * @brief The revisions of the task, the last first, a page at a time. Each
+   * holds the fields one Revise changed, with their values before and after,
+   * see DB::getTaskRevisions.
+   *
+   * @param data the task
+   * @param before only the revisions before this version, 0 for the last
+   * ones: the version of the last revision of a page gets the next page
+   * @param limit revisions per page
+   * @param out
+   * @return returnCode ERR_FORMAT for a zero limit
+   */
+  virtual returnCode History(const RequestData &data, long long before,
+                             size_t limit, std::vector<DBTaskRevision> &out);
+
+  /**
+   * @brief The task as it was at a change version of its owner: the task as
+   * it is now with the revisions after that version undone, read in one DB
+   * query. A version older than its first revision gives the task as it was
+   * before that revision.
+   *
+   * @param data the task
+   * @param version
+   * @param out
+   * @return returnCode
+   */
+  virtual returnCode AtVersion(const RequestData &data, long long version,
+                               TaskContent &out);
+
+  /**
+   * @brief Get the reminder scheduler, for main to load and start it
+   *
+   * @return std::shared_ptr<ReminderScheduler>
+   */
+  std::shared_ptr<ReminderScheduler> Reminders() const { return reminders; }
 };
\ No newline at end of file
@@ -0,0 +1,448 @@
+/**
+ * @file loadgen.cpp
+ * @brief HTTP load generator for the lqxx service.
+ *
+ * Drives the REST interface with the same httplib::Client calls the system
+ * tests use, but from many threads and with a weighted mix of operations:
+ * register, login, list, create, update and shared-list access.
+ *
+ * Two arrival models are supported:
+ *  - closed: every worker issues its next request as soon as the previous one
+ *    returns, which measures the maximum throughput for a concurrency level.
+ *  - open: requests are scheduled at a constant arrival rate. Latency is
+ *    measured from the intended send time, not the actual one, so requests
+ *    delayed behind a slow response are charged for the wait (coordinated
+ *    omission correction).
+ *
+ * The service is either started in-process on top of MemoryDB (--inproc=mock,
+ * the default) or a Neo4j instance (--inproc=neo4j://...), or an already
+ * running server is targeted with --target=host:port.
+ *
+ * Example:
+ *   ./loadgen --mode=open --rate=500 --concurrency=32 --duration=30
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "api/api.h"
+#include "common/utils.h"
+#include "db/DB.h"
+#include "memoryDB.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum Op { OP_REGISTER, OP_LOGIN, OP_LIST, OP_CREATE, OP_UPDATE, OP_SHARE };
+constexpr size_t kOps = 6;
+const char *const kOpNames[kOps] = {"register", "login",  "list",
+                                    "create",   "update", "share"};
+
+/* Name of the list every load user owns and shares with its neighbour */
+const std::string kListName = "load";
+const std::string kSeedTask = "seed";
+const std::string kPassword = "loadgen";
+
+struct Options {
+  std::string target;
+  std::string inproc = "mock";
+  std::string mode = "closed";
+  uint32_t concurrency = 8;
+  double rate = 100.0;
+  double duration = 10.0;
+  double warmup = 2.0;
+  uint32_t users = 16;
+  uint32_t port = 3311;
+  uint64_t seed = 4156;
+  std::array<uint32_t, kOps> mix = {1, 2, 4, 2, 2, 2};
+};
+
+struct Account {
+  std::string email;
+  std::string token;
+  /* owner of the list shared with this account */
+  std::string shared_owner;
+};
+
+struct WorkerStats {
+  std::array<std::vector<uint64_t>, kOps> latencies_us;
+  std::array<uint64_t, kOps> errors{};
+};
+
+void Usage() {
+  std::cout
+      << "Usage: loadgen [options]\n"
+         "  --target=HOST:PORT   run against an existing server\n"
+         "  --inproc=mock|URI    start Api in-process on MemoryDB or Neo4j "
+         "(default mock)\n"
+         "  --port=N             port of the in-process server (default 3311)\n"
+         "  --mode=closed|open   arrival model (default closed)\n"
+         "  --rate=R             open loop: requests per second (default 100)\n"
+         "  --concurrency=N      worker threads (default 8)\n"
+         "  --duration=S         measured seconds (default 10)\n"
+         "  --warmup=S           unmeasured seconds first (default 2)\n"
+         "  --users=N            pre-registered users (default 16)\n"
+         "  --seed=N             random seed (default 4156)\n"
+         "  --mix=op:w,...       weights of register,login,list,create,update,"
+         "share\n";
+}
+
+bool ParseMix(const std::string &value, std::array<uint32_t, kOps> &mix) {
+  mix.fill(0);
+  for (const auto &entry : Common::Split(value, ",")) {
+    const auto kv = Common::Split(entry, ":");
+    if (kv.size() != 2) {
+      return false;
+    }
+    const auto it = std::find(std::begin(kOpNames), std::end(kOpNames), kv[0]);
+    if (it == std::end(kOpNames)) {
+      return false;
+    }
+    mix[it - std::begin(kOpNames)] = std::stoul(kv[1]);
+  }
+  return std::any_of(mix.begin(), mix.end(), [](uint32_t w) { return w > 0; });
+}
+
+bool ParseOptions(int argc, char **argv, Options &opts) {
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      const auto eq = arg.find('=');
+      if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+        return false;
+      }
+      const std::string key = arg.substr(2, eq - 2);
+      const std::string value = arg.substr(eq + 1);
+      if (key == "target") {
+        opts.target = value;
+      } else if (key == "inproc") {
+        opts.inproc = value;
+      } else if (key == "mode") {
+        opts.mode = value;
+      } else if (key == "rate") {
+        opts.rate = std::stod(value);
+      } else if (key == "concurrency") {
+        opts.concurrency = std::stoul(value);
+      } else if (key == "duration") {
+        opts.duration = std::stod(value);
+      } else if (key == "warmup") {
+        opts.warmup = std::stod(value);
+      } else if (key == "users") {
+        opts.users = std::stoul(value);
+      } else if (key == "port") {
+        opts.port = std::stoul(value);
+      } else if (key == "seed") {
+        opts.seed = std::stoull(value);
+      } else if (key == "mix") {
+        if (!ParseMix(value, opts.mix)) {
+          return false;
+        }
+      } else {
+        return false;
+      }
+    }
+  } catch (std::exception &e) {
+    return false;
+  }
+  return (opts.mode == "open" || opts.mode == "closed") &&
+         opts.concurrency > 0 && opts.users > 1 && opts.rate > 0 &&
+         opts.duration > 0;
+}
+
+bool Succeeded(const httplib::Result &result) {
+  return result && result->status == 200;
+}
+
+std::string Json(const nlohmann::json &fields) { return fields.dump(); }
+
+/* Register, log in and give every user a shared list with one task, then
+   grant each user write access to its neighbour's list. */
+bool Setup(const std::string &host, uint32_t port, const std::string &run_id,
+           std::vector<Account> &accounts) {
+  httplib::Client client(host, port);
+  for (size_t i = 0; i < accounts.size(); ++i) {
+    Account &acc = accounts[i];
+    acc.email = "loadgen_" + run_id + "_" + std::to_string(i) + "@example.com";
+
+    client.set_basic_auth(acc.email, kPassword);
+    if (!Succeeded(client.Post("/v1/users/register", Json({{"name", "load"}}),
+                               "text/plain"))) {
+      return false;
+    }
+    auto login = client.Post("/v1/users/login");
+    if (!Succeeded(login)) {
+      return false;
+    }
+    acc.token = nlohmann::json::parse(login->body).at("token");
+
+    client.set_basic_auth(acc.token, "");
+    if (!Succeeded(client.Post(
+            "/v1/task_lists/create",
+            Json({{"name", kListName}, {"visibility", "shared"}}),
+            "text/plain")) ||
+        !Succeeded(client.Post("/v1/task_lists/" + kListName + "/tasks/create",
+                               Json({{"name", kSeedTask}}), "text/plain"))) {
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < accounts.size(); ++i) {
+    Account &next = accounts[(i + 1) % accounts.size()];
+    nlohmann::json grant;
+    grant["user_permission"].push_back(
+        {{"user", next.email}, {"permission", true}});
+    client.set_basic_auth(accounts[i].token, "");
+    if (!Succeeded(client.Post("/v1/share/" + kListName, grant.dump(),
+                               "text/plain"))) {
+      return false;
+    }
+    next.shared_owner = accounts[i].email;
+  }
+  return true;
+}
+
+bool Issue(httplib::Client &client, Op op, const Account &acc,
+           const std::string &unique) {
+  switch (op) {
+  case OP_REGISTER:
+    client.set_basic_auth("loadgen_" + unique + "@example.com", kPassword);
+    return Succeeded(client.Post("/v1/users/register", Json({{"name", "new"}}),
+                                 "text/plain"));
+  case OP_LOGIN:
+    client.set_basic_auth(acc.email, kPassword);
+    return Succeeded(client.Post("/v1/users/login"));
+  case OP_LIST:
+    client.set_basic_auth(acc.token, "");
+    return Succeeded(client.Get("/v1/task_lists"));
+  case OP_CREATE:
+    client.set_basic_auth(acc.token, "");
+    return Succeeded(client.Post(
+        "/v1/task_lists/" + kListName + "/tasks/create",
+        Json({{"name", "task_" + unique}, {"content", "load"}}),
+        "text/plain"));
+  case OP_UPDATE:
+    client.set_basic_auth(acc.token, "");
+    return Succeeded(
+        client.Put("/v1/task_lists/" + kListName + "/tasks/" + kSeedTask,
+                   Json({{"content", unique}}), "text/plain"));
+  case OP_SHARE:
+    client.set_basic_auth(acc.token, "");
+    return Succeeded(client.Get("/v1/task_lists/" + kListName +
+                                "/tasks?other=" + acc.shared_owner));
+  }
+  return false;
+}
+
+struct Schedule {
+  bool open;
+  Clock::time_point start;
+  Clock::time_point measure_from;
+  Clock::time_point end;
+  Clock::duration interval;
+  std::atomic<uint64_t> next_slot{0};
+};
+
+void Worker(const Options &opts, const std::string &host, uint32_t port,
+            const std::string &run_id, const std::vector<Account> &accounts,
+            Schedule &schedule, size_t index, WorkerStats &stats) {
+  httplib::Client client(host, port);
+  client.set_keep_alive(true);
+  std::mt19937_64 rng(opts.seed + index);
+  std::discrete_distribution<size_t> pick_op(opts.mix.begin(), opts.mix.end());
+  std::uniform_int_distribution<size_t> pick_user(0, accounts.size() - 1);
+  uint64_t counter = 0;
+
+  while (true) {
+    Clock::time_point intended;
+    if (schedule.open) {
+      /* The request belongs to a fixed slot on the timeline; if we are late
+         the lateness is part of its latency. */
+      const uint64_t slot = schedule.next_slot.fetch_add(1);
+      intended = schedule.start + slot * schedule.interval;
+      if (intended >= schedule.end) {
+        break;
+      }
+      std::this_thread::sleep_until(intended);
+    } else {
+      intended = Clock::now();
+      if (intended >= schedule.end) {
+        break;
+      }
+    }
+
+    const Op op = static_cast<Op>(pick_op(rng));
+    const Account &acc = accounts[pick_user(rng)];
+    const std::string unique =
+        run_id + "_w" + std::to_string(index) + "_" + std::to_string(counter++);
+    const bool ok = Issue(client, op, acc, unique);
+    const auto latency = Clock::now() - intended;
+
+    if (intended < schedule.measure_from) {
+      continue;
+    }
+    stats.latencies_us[op].push_back(
+        std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+    if (!ok) {
+      ++stats.errors[op];
+    }
+  }
+}
+
+double Percentile(const std::vector<uint64_t> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+  rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+  return sorted[rank - 1] / 1000.0;
+}
+
+void PrintRow(const char *name, std::vector<uint64_t> &latencies,
+              uint64_t errors, double seconds) {
+  std::sort(latencies.begin(), latencies.end());
+  std::printf("%-10s %9zu %8lu %10.1f %9.2f %9.2f %9.2f %9.2f\n", name,
+              latencies.size(), static_cast<unsigned long>(errors),
+              latencies.size() / seconds, Percentile(latencies, 0.50),
+              Percentile(latencies, 0.99), Percentile(latencies, 0.999),
+              latencies.empty() ? 0.0 : latencies.back() / 1000.0);
+}
+
+void Report(const Options &opts, std::vector<WorkerStats> &all) {
+  std::array<std::vector<uint64_t>, kOps> per_op;
+  std::array<uint64_t, kOps> errors{};
+  for (auto &stats : all) {
+    for (size_t op = 0; op < kOps; ++op) {
+      per_op[op].insert(per_op[op].end(), stats.latencies_us[op].begin(),
+                        stats.latencies_us[op].end());
+      errors[op] += stats.errors[op];
+    }
+  }
+
+  std::printf("mode=%s concurrency=%u duration=%.1fs", opts.mode.c_str(),
+              opts.concurrency, opts.duration);
+  if (opts.mode == "open") {
+    std::printf(" rate=%.1f/s", opts.rate);
+  }
+  std::printf(" target=%s\n", opts.target.empty()
+                                  ? ("inproc:" + opts.inproc).c_str()
+                                  : opts.target.c_str());
+  std::printf("%-10s %9s %8s %10s %9s %9s %9s %9s\n", "op", "count", "errors",
+              "rps", "p50(ms)", "p99(ms)", "p999(ms)", "max(ms)");
+
+  std::vector<uint64_t> total;
+  uint64_t total_errors = 0;
+  for (size_t op = 0; op < kOps; ++op) {
+    if (per_op[op].empty()) {
+      continue;
+    }
+    total.insert(total.end(), per_op[op].begin(), per_op[op].end());
+    total_errors += errors[op];
+    PrintRow(kOpNames[op], per_op[op], errors[op], opts.duration);
+  }
+  PrintRow("total", total, total_errors, opts.duration);
+
+  if (opts.mode == "open" && total.size() < 0.95 * opts.rate * opts.duration) {
+    std::printf("warning: achieved rate is below the target, the server is "
+                "saturated or --concurrency is too low\n");
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opts;
+  if (!ParseOptions(argc, argv, opts)) {
+    Usage();
+    return 1;
+  }
+
+  std::string host = "127.0.0.1";
+  uint32_t port = opts.port;
+  std::shared_ptr<Api> api;
+  std::shared_ptr<std::thread> running_server;
+
+  if (!opts.target.empty()) {
+    const auto host_port = Common::Split(opts.target, ":");
+    if (host_port.size() != 2) {
+      Usage();
+      return 1;
+    }
+    host = host_port[0];
+    port = std::stoul(host_port[1]);
+  } else {
+    std::shared_ptr<DB> db;
+    if (opts.inproc == "mock") {
+      db = std::make_shared<MemoryDB>();
+    } else {
+      db = std::make_shared<DB>(opts.inproc);
+    }
+    api = std::make_shared<Api>(nullptr, nullptr, nullptr, db, nullptr);
+    running_server = std::make_shared<std::thread>(
+        [&]() { api->Run(host, port); });
+
+    /* wait for the service to be set up */
+    httplib::Client probe(host, port);
+    for (int i = 0; i < 100 && !Succeeded(probe.Get("/health/1")); ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+  }
+
+  /* Unique per run so repeated runs against the same database do not
+     collide. */
+  const std::string run_id = std::to_string(
+      std::chrono::system_clock::now().time_since_epoch().count() % 1000000007);
+  std::vector<Account> accounts(opts.users);
+  if (!Setup(host, port, run_id, accounts)) {
+    std::cerr << "failed to set up load users on " << host << ":" << port
+              << std::endl;
+    if (api) {
+      api->Stop();
+      running_server->join();
+    }
+    return 1;
+  }
+
+  Schedule schedule;
+  schedule.open = opts.mode == "open";
+  schedule.start = Clock::now();
+  schedule.measure_from =
+      schedule.start + std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double>(opts.warmup));
+  schedule.end =
+      schedule.measure_from + std::chrono::duration_cast<Clock::duration>(
+                                  std::chrono::duration<double>(opts.duration));
+  schedule.interval = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / opts.rate));
+
+  std::vector<WorkerStats> stats(opts.concurrency);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < opts.concurrency; ++i) {
+    workers.emplace_back(Worker, std::cref(opts), std::cref(host), port,
+                         std::cref(run_id), std::cref(accounts),
+                         std::ref(schedule), i, std::ref(stats[i]));
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  Report(opts, stats);
+
+  if (api) {
+    api->Stop();
+    running_server->join();
+  }
+  return 0;
+}
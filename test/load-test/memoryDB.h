@@ -0,0 +1,1262 @@
+/**
+ * @file memoryDB.h
+ * @brief In-memory stand-in for DB, used to drive Api without Neo4j.
+ *
+ * MemoryDB keeps users, task lists, tasks and access grants in ordinary maps
+ * and mirrors the return codes of the Neo4j-backed DB, so the load generator
+ * can measure the service itself, separated from the database.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include "common/utils.h"
+#include "db/DB.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+class MemoryDB : public DB {
+public:
+  MemoryDB() : DB() {}
+
+  returnCode
+  createUserNode(const std::map<std::string, std::string> &user_info) override {
+    if (user_info.find("email") == user_info.end()) {
+      return ERR_KEY;
+    }
+    if (user_info.find("passwd") == user_info.end()) {
+      return ERR_RFIELD;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    if (!users.emplace(user_info.at("email"), user_info).second) {
+      return ERR_DUP_NODE;
+    }
+    return SUCCESS;
+  }
+
+  returnCode createTaskListNode(
+      const std::string &user_pkey,
+      const std::map<std::string, std::string> &task_list_info) override {
+    if (task_list_info.find("name") == task_list_info.end()) {
+      return ERR_KEY;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    if (users.find(user_pkey) == users.end()) {
+      return ERR_NO_NODE;
+    }
+    auto info = task_list_info;
+    info["user"] = user_pkey;
+    if (info.find("visibility") == info.end()) {
+      info["visibility"] = "private";
+    }
+    info["version"] = std::to_string(versions[user_pkey] + 1);
+    if (!lists.emplace(ListKey(user_pkey, info["name"]), info).second) {
+      return ERR_DUP_NODE;
+    }
+    versions[user_pkey]++;
+    return SUCCESS;
+  }
+
+  returnCode
+  createTaskNode(const std::string &user_pkey,
+                 const std::string &task_list_pkey,
+                 const std::map<std::string, std::string> &task_info) override {
+    if (task_info.find("name") == task_info.end()) {
+      return ERR_KEY;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    if (users.find(user_pkey) == users.end() ||
+        lists.find(ListKey(user_pkey, task_list_pkey)) == lists.end()) {
+      return ERR_NO_NODE;
+    }
+    auto info = task_info;
+    info["user"] = user_pkey;
+    info["list"] = task_list_pkey;
+    info["version"] = std::to_string(versions[user_pkey] + 1);
+    info["position"] = Common::PositionBetween(
+        LastPosition(user_pkey, task_list_pkey), "");
+    StampDone(info);
+    if (!tasks.emplace(TaskKey(user_pkey, task_list_pkey, info["name"]), info)
+             .second) {
+      return ERR_DUP_NODE;
+    }
+    versions[user_pkey]++;
+    return SUCCESS;
+  }
+
+  returnCode
+  reviseUserNode(const std::string &user_pkey,
+                 const std::map<std::string, std::string> &user_info) override {
+    if (user_info.find("email") != user_info.end()) {
+      return ERR_KEY;
+    }
+    if (user_info.empty()) {
+      return ERR_RFIELD;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = users.find(user_pkey);
+    if (it == users.end()) {
+      return ERR_NO_NODE;
+    }
+    Merge(it->second, user_info);
+    return SUCCESS;
+  }
+
+  returnCode reviseTaskListNode(
+      const std::string &user_pkey, const std::string &task_list_pkey,
+      const std::map<std::string, std::string> &task_list_info) override {
+    if (task_list_info.find("name") != task_list_info.end()) {
+      return ERR_KEY;
+    }
+    if (task_list_info.empty()) {
+      return ERR_RFIELD;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = lists.find(ListKey(user_pkey, task_list_pkey));
+    if (it == lists.end()) {
+      return ERR_NO_NODE;
+    }
+    Merge(it->second, task_list_info);
+    it->second["version"] = std::to_string(++versions[user_pkey]);
+    return SUCCESS;
+  }
+
+  returnCode
+  reviseTaskNode(const std::string &user_pkey,
+                 const std::string &task_list_pkey,
+                 const std::string &task_pkey,
+                 const std::map<std::string, std::string> &task_info,
+                 std::map<std::string, std::string> *revised) override {
+    if (task_info.find("name") != task_info.end()) {
+      return ERR_KEY;
+    }
+    if (task_info.empty()) {
+      return ERR_RFIELD;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = tasks.find(TaskKey(user_pkey, task_list_pkey, task_pkey));
+    if (it == tasks.end()) {
+      return ERR_NO_NODE;
+    }
+    DBTaskRevision revision;
+    for (const auto &field : task_info) {
+      auto value = it->second.find(field.first);
+      const std::string before =
+          value == it->second.end() ? "" : value->second;
+      if (before != field.second) {
+        revision.before[field.first] = before;
+        revision.after[field.first] = field.second;
+      }
+    }
+    Merge(it->second, task_info);
+    if (task_info.count("status")) {
+      StampDone(it->second);
+    }
+    revision.version = ++versions[user_pkey];
+    it->second["version"] = std::to_string(revision.version);
+    if (!revision.after.empty()) {
+      revisions[it->first].push_back(std::move(revision));
+    }
+    if (revised != nullptr) {
+      *revised = it->second;
+      revised->erase("user");
+      revised->erase("list");
+      revised->erase("version");
+    }
+    return SUCCESS;
+  }
+
+  returnCode deleteUserNode(const std::string &user_pkey) override {
+    std::lock_guard<std::mutex> guard(lock);
+    EraseIf(tasks, [&](const TaskKeyType &key) {
+      return std::get<0>(key) == user_pkey;
+    });
+    EraseIf(dependencies, [&](const TaskKeyType &key) {
+      return std::get<0>(key) == user_pkey;
+    });
+    EraseIf(revisions, [&](const TaskKeyType &key) {
+      return std::get<0>(key) == user_pkey;
+    });
+    EraseIf(archived, [&](const ListKeyType &key) {
+      return key.first == user_pkey;
+    });
+    EraseIf(lists, [&](const ListKeyType &key) {
+      return key.first == user_pkey;
+    });
+    EraseIf(access, [&](const AccessKeyType &key) {
+      return std::get<0>(key) == user_pkey || std::get<1>(key) == user_pkey;
+    });
+    users.erase(user_pkey);
+    versions.erase(user_pkey);
+    tombstones.erase(user_pkey);
+    return SUCCESS;
+  }
+
+  returnCode deleteTaskListNode(const std::string &user_pkey,
+                                const std::string &task_list_pkey) override {
+    std::lock_guard<std::mutex> guard(lock);
+    EraseIf(tasks, [&](const TaskKeyType &key) {
+      return std::get<0>(key) == user_pkey &&
+             std::get<1>(key) == task_list_pkey;
+    });
+    EraseIf(dependencies, [&](const TaskKeyType &key) {
+      return std::get<0>(key) == user_pkey &&
+             std::get<1>(key) == task_list_pkey;
+    });
+    EraseIf(revisions, [&](const TaskKeyType &key) {
+      return std::get<0>(key) == user_pkey &&
+             std::get<1>(key) == task_list_pkey;
+    });
+    archived.erase(ListKey(user_pkey, task_list_pkey));
+    EraseIf(access, [&](const AccessKeyType &key) {
+      return std::get<0>(key) == user_pkey &&
+             std::get<2>(key) == task_list_pkey;
+    });
+    if (lists.erase(ListKey(user_pkey, task_list_pkey))) {
+      DBChange tombstone;
+      tombstone.list = task_list_pkey;
+      tombstone.deleted = true;
+      tombstone.version = ++versions[user_pkey];
+      tombstones[user_pkey].push_back(tombstone);
+    }
+    return SUCCESS;
+  }
+
+  returnCode deleteTaskNode(const std::string &user_pkey,
+                            const std::string &task_list_pkey,
+                            const std::string &task_pkey) override {
+    std::lock_guard<std::mutex> guard(lock);
+    if (tasks.erase(TaskKey(user_pkey, task_list_pkey, task_pkey))) {
+      DropDependencies(user_pkey, task_list_pkey, task_pkey);
+      revisions.erase(TaskKey(user_pkey, task_list_pkey, task_pkey));
+      DBChange tombstone;
+      tombstone.list = task_list_pkey;
+      tombstone.task = task_pkey;
+      tombstone.deleted = true;
+      tombstone.version = ++versions[user_pkey];
+      tombstones[user_pkey].push_back(tombstone);
+    }
+    return SUCCESS;
+  }
+
+  returnCode
+  moveTaskNode(const std::string &user_pkey, const std::string &task_list_pkey,
+               const std::string &task_pkey, const std::string &dst_user_pkey,
+               const std::string &dst_task_list_pkey,
+               const std::string &dst_task_pkey,
+               std::map<std::string, std::string> &task_info) override {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = tasks.find(TaskKey(user_pkey, task_list_pkey, task_pkey));
+    if (it == tasks.end() ||
+        lists.find(ListKey(dst_user_pkey, dst_task_list_pkey)) == lists.end()) {
+      return ERR_NO_NODE;
+    }
+    auto info = it->second;
+    info["name"] = dst_task_pkey;
+    info["list"] = dst_task_list_pkey;
+    info["user"] = dst_user_pkey;
+    info["position"] = Common::PositionBetween(
+        LastPosition(dst_user_pkey, dst_task_list_pkey), "");
+    if (!tasks
+             .emplace(TaskKey(dst_user_pkey, dst_task_list_pkey, dst_task_pkey),
+                      info)
+             .second) {
+      return ERR_DUP_NODE;
+    }
+    tasks.erase(it);
+    DropDependencies(user_pkey, task_list_pkey, task_pkey);
+    // the revisions go with the task
+    auto history =
+        revisions.find(TaskKey(user_pkey, task_list_pkey, task_pkey));
+    if (history != revisions.end()) {
+      revisions[TaskKey(dst_user_pkey, dst_task_list_pkey, dst_task_pkey)] =
+          std::move(history->second);
+      revisions.erase(history);
+    }
+    DBChange tombstone;
+    tombstone.list = task_list_pkey;
+    tombstone.task = task_pkey;
+    tombstone.deleted = true;
+    tombstone.version = ++versions[user_pkey];
+    tombstones[user_pkey].push_back(tombstone);
+    info["version"] = std::to_string(++versions[dst_user_pkey]);
+    tasks[TaskKey(dst_user_pkey, dst_task_list_pkey, dst_task_pkey)] = info;
+    task_info = info;
+    task_info.erase("user");
+    task_info.erase("list");
+    task_info.erase("version");
+    return SUCCESS;
+  }
+
+  returnCode
+  cloneTaskListNode(const std::string &user_pkey,
+                    const std::string &task_list_pkey,
+                    const std::string &dst_user_pkey,
+                    const std::string &dst_task_list_pkey,
+                    std::string &out_task_list_pkey,
+                    std::vector<std::string> &task_pkeys) override {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = lists.find(ListKey(user_pkey, task_list_pkey));
+    if (it == lists.end() || users.find(dst_user_pkey) == users.end()) {
+      return ERR_NO_NODE;
+    }
+    std::string name = dst_task_list_pkey;
+    for (int i = 1; lists.find(ListKey(dst_user_pkey, name)) != lists.end();
+         i++) {
+      name = dst_task_list_pkey + "(" + std::to_string(i) + ")";
+    }
+    const std::string version = std::to_string(++versions[dst_user_pkey]);
+    auto info = it->second;
+    info["name"] = name;
+    info["user"] = dst_user_pkey;
+    info["visibility"] = "private";
+    info["version"] = version;
+    lists[ListKey(dst_user_pkey, name)] = info;
+    task_pkeys.clear();
+    std::vector<std::pair<TaskKeyType, Fields>> copies;
+    for (const auto &task : tasks) {
+      if (std::get<0>(task.first) != user_pkey ||
+          std::get<1>(task.first) != task_list_pkey) {
+        continue;
+      }
+      auto copy = task.second;
+      copy["list"] = name;
+      copy["user"] = dst_user_pkey;
+      copy["version"] = version;
+      copies.emplace_back(
+          TaskKey(dst_user_pkey, name, std::get<2>(task.first)), copy);
+      task_pkeys.push_back(std::get<2>(task.first));
+    }
+    tasks.insert(copies.begin(), copies.end());
+    for (auto dependency = dependencies.lower_bound(
+             TaskKey(user_pkey, task_list_pkey, ""));
+         dependency != dependencies.end() &&
+         std::get<0>(dependency->first) == user_pkey &&
+         std::get<1>(dependency->first) == task_list_pkey;
+         ++dependency) {
+      dependencies[TaskKey(dst_user_pkey, name,
+                           std::get<2>(dependency->first))] =
+          dependency->second;
+    }
+    out_task_list_pkey = name;
+    return SUCCESS;
+  }
+
+  returnCode
+  getUserNode(const std::string &user_pkey,
+              std::map<std::string, std::string> &user_info) override {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = users.find(user_pkey);
+    if (it == users.end()) {
+      return ERR_NO_NODE;
+    }
+    Fill(it->second, user_info);
+    return SUCCESS;
+  }
+
+  returnCode
+  getTaskListNode(const std::string &user_pkey,
+                  const std::string &task_list_pkey,
+                  std::map<std::string, std::string> &task_list_info) override {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = lists.find(ListKey(user_pkey, task_list_pkey));
+    if (it == lists.end()) {
+      return ERR_NO_NODE;
+    }
+    Fill(it->second, task_list_info);
+    task_list_info.erase("user");
+    task_list_info.erase("version");
+    return SUCCESS;
+  }
+
+  returnCode
+  getTaskNode(const std::string &user_pkey, const std::string &task_list_pkey,
+              const std::string &task_pkey,
+              std::map<std::string, std::string> &task_info) override {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = tasks.find(TaskKey(user_pkey, task_list_pkey, task_pkey));
+    if (it == tasks.end()) {
+      return ERR_NO_NODE;
+    }
+    Fill(it->second, task_info);
+    task_info.erase("user");
+    task_info.erase("list");
+    task_info.erase("version");
+    return SUCCESS;
+  }
+
+  returnCode getTaskNodes(
+      const std::string &dst_user_pkey, const std::vector<DBTaskKey> &keys,
+      std::vector<returnCode> &results,
+      std::vector<std::map<std::string, std::string>> &task_infos) override {
+    results.assign(keys.size(), ERR_NO_NODE);
+    task_infos.assign(keys.size(), std::map<std::string, std::string>());
+    for (size_t i = 0; i < keys.size(); i++) {
+      bool read_write = false;
+      results[i] = checkAccess(std::get<0>(keys[i]), dst_user_pkey,
+                               std::get<1>(keys[i]), read_write);
+      if (results[i] == SUCCESS) {
+        results[i] = getTaskNode(std::get<0>(keys[i]), std::get<1>(keys[i]),
+                                 std::get<2>(keys[i]), task_infos[i]);
+      }
+    }
+    return SUCCESS;
+  }
+
+  returnCode getAgenda(const std::string &user_pkey, const std::string &from,
+                       const std::string &to, const DBAgendaTask *after,
+                       size_t limit, std::vector<DBAgendaTask> &out_tasks,
+                       std::vector<DBRecurringTask> &repeating) override {
+    auto sort_key = [](const DBAgendaTask &task) {
+      return std::tie(task.due, task.rank, task.user, task.list, task.task);
+    };
+    std::lock_guard<std::mutex> guard(lock);
+    out_tasks.clear();
+    repeating.clear();
+    if (limit == 0) {
+      return SUCCESS;
+    }
+    for (const auto &it : tasks) {
+      DBRecurringTask task;
+      if (!AgendaTask(user_pkey, it.first, it.second, task)) {
+        continue;
+      }
+      if (task.info.count("recurrence")) {
+        if (task.due > to) {
+          continue;
+        }
+        for (const auto &done : tasks) {
+          auto of = done.second.find("occurrence_of");
+          auto due = done.second.find("due");
+          if (std::get<0>(done.first) == task.user &&
+              std::get<1>(done.first) == task.list &&
+              of != done.second.end() && of->second == task.task &&
+              due != done.second.end() && due->second >= from &&
+              due->second <= to) {
+            task.done.push_back(due->second);
+          }
+        }
+        repeating.push_back(std::move(task));
+        continue;
+      }
+      if (task.due < from || task.due > to ||
+          (after != nullptr && sort_key(task) <= sort_key(*after))) {
+        continue;
+      }
+      out_tasks.push_back(std::move(task));
+    }
+    std::sort(out_tasks.begin(), out_tasks.end(),
+              [&](const DBAgendaTask &a, const DBAgendaTask &b) {
+                return sort_key(a) < sort_key(b);
+              });
+    if (out_tasks.size() > limit) {
+      out_tasks.resize(limit);
+    }
+    return SUCCESS;
+  }
+
+  returnCode getOpenDueTasks(const std::string &from,
+                             const DBAgendaTask *after, size_t limit,
+                             std::vector<DBAgendaTask> &out_tasks) override {
+    std::lock_guard<std::mutex> guard(lock);
+    out_tasks.clear();
+    // (due, user, list, name) of every open task due from then on
+    std::vector<std::tuple<std::string, std::string, std::string,
+                           std::string>>
+        order;
+    for (const auto &it : tasks) {
+      auto due = it.second.find("due");
+      auto status = it.second.find("status");
+      if (due == it.second.end() || due->second < from ||
+          it.second.count("recurrence") ||
+          (status != it.second.end() && status->second == "Done")) {
+        continue;
+      }
+      order.emplace_back(due->second, std::get<0>(it.first),
+                         std::get<1>(it.first), std::get<2>(it.first));
+    }
+    std::sort(order.begin(), order.end());
+    for (const auto &key : order) {
+      if (out_tasks.size() >= limit) {
+        break;
+      }
+      if (after != nullptr &&
+          key <= std::make_tuple(after->due, after->user, after->list,
+                                 after->task)) {
+        continue;
+      }
+      DBAgendaTask task;
+      std::tie(task.due, task.user, task.list, task.task) = key;
+      out_tasks.push_back(std::move(task));
+    }
+    return SUCCESS;
+  }
+
+  returnCode getBoard(const std::string &user_pkey,
+                      const std::string &task_list_pkey,
+                      const std::string &status, size_t offset, size_t limit,
+                      std::vector<DBBoardColumn> &columns) override {
+    std::lock_guard<std::mutex> guard(lock);
+    columns.clear();
+    // (status, rank, name) of every task of the list
+    std::vector<std::tuple<std::string, int, std::string>> order;
+    for (const auto &it : tasks) {
+      if (std::get<0>(it.first) != user_pkey ||
+          std::get<1>(it.first) != task_list_pkey) {
+        continue;
+      }
+      auto field = it.second.find("status");
+      std::string task_status =
+          field == it.second.end() ? "To Do" : field->second;
+      if (task_status != "Doing" && task_status != "Done") {
+        task_status = "To Do";
+      }
+      if (!status.empty() && task_status != status) {
+        continue;
+      }
+      field = it.second.find("priority");
+      int rank = field == it.second.end() ? 0 : atoi(field->second.c_str());
+      order.emplace_back(task_status, rank > 0 ? rank : 4,
+                         std::get<2>(it.first));
+    }
+    std::sort(order.begin(), order.end());
+    for (const auto &task : order) {
+      if (columns.empty() || columns.back().status != std::get<0>(task)) {
+        columns.emplace_back();
+        columns.back().status = std::get<0>(task);
+      }
+      DBBoardColumn &column = columns.back();
+      if ((size_t)column.total >= offset &&
+          (size_t)column.total < offset + limit) {
+        Fields info = tasks[TaskKey(user_pkey, task_list_pkey,
+                                    std::get<2>(task))];
+        info.erase("user");
+        info.erase("list");
+        info.erase("version");
+        column.tasks.push_back(std::move(info));
+      }
+      column.total++;
+    }
+    return SUCCESS;
+  }
+
+  returnCode
+  getTaskListStats(const std::string &user_pkey,
+                   const std::string &task_list_pkey, const std::string &today,
+                   std::map<std::string, DBTaskListStats> &stats) override {
+    std::lock_guard<std::mutex> guard(lock);
+    stats.clear();
+    for (const auto &it : lists) {
+      if (it.first.first == user_pkey &&
+          (task_list_pkey.empty() || it.first.second == task_list_pkey)) {
+        stats[it.first.second];
+      }
+    }
+    for (const auto &it : tasks) {
+      auto list = stats.find(std::get<1>(it.first));
+      if (std::get<0>(it.first) != user_pkey || list == stats.end()) {
+        continue;
+      }
+      auto field = it.second.find("status");
+      const std::string status = field == it.second.end() ? "" : field->second;
+      field = it.second.find("priority");
+      int priority = field == it.second.end() ? 0 : atoi(field->second.c_str());
+      field = it.second.find("due");
+      list->second.total++;
+      list->second.status[status == "Doing" ? 1 : status == "Done" ? 2 : 0]++;
+      list->second.priority[priority >= 1 && priority <= 3 ? priority : 0]++;
+      if (status != "Done" && field != it.second.end() &&
+          field->second < today && !it.second.count("recurrence")) {
+        list->second.overdue++;
+      }
+    }
+    return stats.empty() && !task_list_pkey.empty() ? ERR_NO_NODE : SUCCESS;
+  }
+
+  returnCode
+  getTaskListNodeWithStats(const std::string &user_pkey,
+                           const std::string &task_list_pkey,
+                           const std::string &today,
+                           std::map<std::string, std::string> &task_list_info,
+                           DBTaskListStats &stats) override {
+    std::map<std::string, DBTaskListStats> all;
+    returnCode ret = getTaskListNode(user_pkey, task_list_pkey, task_list_info);
+    if (ret == SUCCESS) {
+      ret = getTaskListStats(user_pkey, task_list_pkey, today, all);
+    }
+    stats = all[task_list_pkey];
+    return ret;
+  }
+
+  returnCode getAllUserNodes(std::vector<std::string> &user_info) override {
+    std::lock_guard<std::mutex> guard(lock);
+    user_info.clear();
+    for (const auto &it : users) {
+      user_info.push_back(it.first);
+    }
+    return SUCCESS;
+  }
+
+  returnCode
+  getAllTaskListNodes(const std::string &user_pkey,
+                      std::vector<std::string> &task_list_info) override {
+    std::lock_guard<std::mutex> guard(lock);
+    task_list_info.clear();
+    if (users.find(user_pkey) == users.end()) {
+      return ERR_NO_NODE;
+    }
+    for (auto it = lists.lower_bound(ListKey(user_pkey, ""));
+         it != lists.end() && it->first.first == user_pkey; ++it) {
+      task_list_info.push_back(it->first.second);
+    }
+    return SUCCESS;
+  }
+
+  returnCode getAllTaskNodes(const std::string &user_pkey,
+                             const std::string &task_list_pkey,
+                             std::vector<std::string> &task_info) override {
+    std::lock_guard<std::mutex> guard(lock);
+    task_info.clear();
+    if (users.find(user_pkey) == users.end() ||
+        lists.find(ListKey(user_pkey, task_list_pkey)) == lists.end()) {
+      return ERR_NO_NODE;
+    }
+    for (const auto &task : Ordered(user_pkey, task_list_pkey)) {
+      task_info.push_back(task.second);
+    }
+    return SUCCESS;
+  }
+
+  returnCode addDependency(const std::string &user_pkey,
+                           const std::string &task_list_pkey,
+                           const std::string &task_pkey,
+                           const std::string &on_task_pkey) override {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!tasks.count(TaskKey(user_pkey, task_list_pkey, task_pkey)) ||
+        !tasks.count(TaskKey(user_pkey, task_list_pkey, on_task_pkey))) {
+      return ERR_NO_NODE;
+    }
+    // a path from the other task back to this one would become a cycle
+    std::set<std::string> seen;
+    std::vector<std::string> stack(1, on_task_pkey);
+    while (!stack.empty()) {
+      const std::string task = stack.back();
+      stack.pop_back();
+      if (task == task_pkey) {
+        return ERR_FORMAT;
+      }
+      if (!seen.insert(task).second) {
+        continue;
+      }
+      auto it = dependencies.find(TaskKey(user_pkey, task_list_pkey, task));
+      if (it != dependencies.end()) {
+        stack.insert(stack.end(), it->second.begin(), it->second.end());
+      }
+    }
+    dependencies[TaskKey(user_pkey, task_list_pkey, task_pkey)].insert(
+        on_task_pkey);
+    return SUCCESS;
+  }
+
+  returnCode removeDependency(const std::string &user_pkey,
+                              const std::string &task_list_pkey,
+                              const std::string &task_pkey,
+                              const std::string &on_task_pkey) override {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = dependencies.find(TaskKey(user_pkey, task_list_pkey, task_pkey));
+    if (it == dependencies.end() || !it->second.erase(on_task_pkey)) {
+      return ERR_NO_NODE;
+    }
+    return SUCCESS;
+  }
+
+  returnCode getTaskGraph(const std::string &user_pkey,
+                          const std::string &task_list_pkey,
+                          std::vector<DBGraphTask> &graph) override {
+    std::lock_guard<std::mutex> guard(lock);
+    graph.clear();
+    for (const auto &task : Ordered(user_pkey, task_list_pkey)) {
+      const TaskKeyType key = TaskKey(user_pkey, task_list_pkey, task.second);
+      Fields &info = tasks[key];
+      DBGraphTask node;
+      node.task = task.second;
+      node.startDate = info["startDate"];
+      node.endDate = info["endDate"];
+      auto it = dependencies.find(key);
+      if (it != dependencies.end()) {
+        node.depends_on.assign(it->second.begin(), it->second.end());
+      }
+      graph.push_back(std::move(node));
+    }
+    return SUCCESS;
+  }
+
+  returnCode reorderTaskNode(const std::string &user_pkey,
+                             const std::string &task_list_pkey,
+                             const std::string &task_pkey,
+                             const std::string &anchor_pkey, bool after,
+                             std::string &position) override {
+    std::lock_guard<std::mutex> guard(lock);
+    position = "";
+    auto it = tasks.find(TaskKey(user_pkey, task_list_pkey, task_pkey));
+    if (it == tasks.end() ||
+        !tasks.count(TaskKey(user_pkey, task_list_pkey, anchor_pkey))) {
+      return ERR_NO_NODE;
+    }
+    for (int attempt = 0; position.empty(); attempt++) {
+      if (attempt > 1) {
+        return ERR_UNKNOWN;
+      }
+      if (attempt > 0) {
+        Rebalance(user_pkey, task_list_pkey);
+      }
+      auto order = Ordered(user_pkey, task_list_pkey);
+      order.erase(std::remove_if(order.begin(), order.end(),
+                                 [&](const std::pair<std::string,
+                                                     std::string> &task) {
+                                   return task.second == task_pkey &&
+                                          task_pkey != anchor_pkey;
+                                 }),
+                  order.end());
+      size_t i = 0;
+      while (order[i].second != anchor_pkey) {
+        i++;
+      }
+      std::string lo = after ? order[i].first : "";
+      std::string hi = after ? "" : order[i].first;
+      if (after && i + 1 < order.size()) {
+        hi = order[i + 1].first;
+      } else if (!after && i > 0) {
+        lo = order[i - 1].first;
+      }
+      if (!order[i].first.empty()) {
+        position = Common::PositionBetween(lo, hi);
+      }
+    }
+    it->second["position"] = position;
+    it->second["version"] = std::to_string(++versions[user_pkey]);
+    return SUCCESS;
+  }
+
+  returnCode rebalanceTaskPositions(size_t max_length, size_t limit,
+                                    size_t &rebalanced) override {
+    std::lock_guard<std::mutex> guard(lock);
+    rebalanced = 0;
+    for (const auto &list : lists) {
+      if (rebalanced == limit) {
+        break;
+      }
+      for (const auto &task : Ordered(list.first.first, list.first.second)) {
+        if (task.first.empty() || task.first.size() > max_length) {
+          Rebalance(list.first.first, list.first.second);
+          rebalanced++;
+          break;
+        }
+      }
+    }
+    return SUCCESS;
+  }
+
+  returnCode archiveDoneTasks(const std::string &before, size_t limit,
+                              size_t &count) override {
+    std::lock_guard<std::mutex> guard(lock);
+    count = 0;
+    for (auto it = tasks.begin(); it != tasks.end() && count < limit;) {
+      auto done = it->second.find("doneAt");
+      if (it->second["status"] != "Done" || done == it->second.end() ||
+          done->second > before || it->second.count("occurrence_of")) {
+        ++it;
+        continue;
+      }
+      const std::string user = std::get<0>(it->first);
+      const std::string list = std::get<1>(it->first);
+      const std::string task = std::get<2>(it->first);
+      Fields info = it->second;
+      info["archivedAt"] = Common::Today();
+      archived[ListKey(user, list)].push_back(info);
+      it = tasks.erase(it);
+      DropDependencies(user, list, task);
+      revisions.erase(TaskKey(user, list, task));
+      DBChange tombstone;
+      tombstone.list = list;
+      tombstone.task = task;
+      tombstone.deleted = true;
+      tombstone.version = ++versions[user];
+      tombstones[user].push_back(tombstone);
+      count++;
+    }
+    return SUCCESS;
+  }
+
+  returnCode getArchivedTaskNodes(
+      const std::string &user_pkey, const std::string &task_list_pkey,
+      const std::string &task_pkey,
+      std::vector<std::map<std::string, std::string>> &task_infos) override {
+    std::lock_guard<std::mutex> guard(lock);
+    task_infos.clear();
+    const auto &list = archived[ListKey(user_pkey, task_list_pkey)];
+    for (auto it = list.rbegin(); it != list.rend(); ++it) {
+      auto name = it->find("name");
+      if (!task_pkey.empty() &&
+          (name == it->end() || name->second != task_pkey)) {
+        continue;
+      }
+      task_infos.push_back(*it);
+      task_infos.back().erase("user");
+      task_infos.back().erase("list");
+      task_infos.back().erase("version");
+    }
+    return SUCCESS;
+  }
+
+  returnCode
+  getTaskRevisions(const std::string &user_pkey,
+                   const std::string &task_list_pkey,
+                   const std::string &task_pkey, long long after,
+                   long long before, size_t limit,
+                   std::map<std::string, std::string> &task_info,
+                   std::vector<DBTaskRevision> &task_revisions) override {
+    std::lock_guard<std::mutex> guard(lock);
+    task_revisions.clear();
+    const TaskKeyType key = TaskKey(user_pkey, task_list_pkey, task_pkey);
+    auto it = tasks.find(key);
+    if (it == tasks.end()) {
+      return ERR_NO_NODE;
+    }
+    task_info = it->second;
+    task_info.erase("user");
+    task_info.erase("list");
+    task_info.erase("version");
+    const auto &history = revisions[key];
+    for (auto revision = history.rbegin();
+         revision != history.rend() &&
+         (limit == 0 || task_revisions.size() < limit);
+         ++revision) {
+      if (revision->version > after &&
+          (before == 0 || revision->version < before)) {
+        task_revisions.push_back(*revision);
+      }
+    }
+    return SUCCESS;
+  }
+
+  returnCode getChangesSince(const std::string &user_pkey, long long since,
+                             long long &version,
+                             std::vector<DBChange> &changes) override {
+    std::lock_guard<std::mutex> guard(lock);
+    changes.clear();
+    if (users.find(user_pkey) == users.end()) {
+      return ERR_NO_NODE;
+    }
+    version = versions[user_pkey];
+    for (auto it = lists.lower_bound(ListKey(user_pkey, ""));
+         it != lists.end() && it->first.first == user_pkey; ++it) {
+      DBChange change;
+      change.list = it->first.second;
+      change.version = std::stoll(it->second["version"]);
+      change.info = it->second;
+      changes.push_back(change);
+    }
+    for (auto it = tasks.lower_bound(TaskKey(user_pkey, "", ""));
+         it != tasks.end() && std::get<0>(it->first) == user_pkey; ++it) {
+      DBChange change;
+      change.list = std::get<1>(it->first);
+      change.task = std::get<2>(it->first);
+      change.version = std::stoll(it->second["version"]);
+      change.info = it->second;
+      changes.push_back(change);
+    }
+    changes.insert(changes.end(), tombstones[user_pkey].begin(),
+                   tombstones[user_pkey].end());
+    DropUpTo(changes, since);
+    std::sort(changes.begin(), changes.end(),
+              [](const DBChange &a, const DBChange &b) {
+                return a.version < b.version;
+              });
+    for (DBChange &change : changes) {
+      change.info.erase("user");
+      change.info.erase("list");
+      change.info.erase("version");
+    }
+    return SUCCESS;
+  }
+
+  returnCode exportUser(const std::string &user_pkey,
+                        const DBExportCallback &emit) override {
+    // copy first, the callback must not run under the lock
+    std::vector<DBChange> nodes;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      auto user = users.find(user_pkey);
+      if (user == users.end()) {
+        return ERR_NO_NODE;
+      }
+      nodes.push_back({"", "", false, 0, user->second});
+      nodes.back().info.erase("passwd");
+      for (auto it = lists.lower_bound(ListKey(user_pkey, ""));
+           it != lists.end() && it->first.first == user_pkey; ++it) {
+        nodes.push_back({it->first.second, "", false, 0, it->second});
+        for (auto task = tasks.lower_bound(
+                 TaskKey(user_pkey, it->first.second, ""));
+             task != tasks.end() && std::get<0>(task->first) == user_pkey &&
+             std::get<1>(task->first) == it->first.second;
+             ++task) {
+          nodes.push_back(
+              {it->first.second, std::get<2>(task->first), false, 0,
+               task->second});
+        }
+      }
+    }
+    for (DBChange &node : nodes) {
+      node.info.erase("user");
+      node.info.erase("list");
+      node.info.erase("version");
+      if (!emit(node.list, node.task, node.info)) {
+        break;
+      }
+    }
+    return SUCCESS;
+  }
+
+  returnCode importBatch(std::vector<DBImportRecord> &records) override {
+    for (DBImportRecord &record : records) {
+      if (record.kind != records.front().kind) {
+        return ERR_FORMAT;
+      }
+    }
+    for (DBImportRecord &record : records) {
+      switch (record.kind) {
+      case DBImportRecord::USER:
+        record.result = createUserNode(record.info);
+        break;
+      case DBImportRecord::TASKLIST:
+        record.result = createTaskListNode(record.user, record.info);
+        break;
+      case DBImportRecord::TASK:
+        record.result = createTaskNode(record.user, record.list, record.info);
+        break;
+      case DBImportRecord::ACCESS:
+        record.result = addAccess(record.user, record.dst_user, record.list,
+                                  record.read_write);
+        break;
+      }
+    }
+    return SUCCESS;
+  }
+
+  returnCode addAccess(const std::string &src_user_pkey,
+                       const std::string &dst_user_pkey,
+                       const std::string &task_list_pkey,
+                       const bool read_write) override {
+    std::lock_guard<std::mutex> guard(lock);
+    if (users.find(src_user_pkey) == users.end() ||
+        users.find(dst_user_pkey) == users.end()) {
+      return ERR_NO_NODE;
+    }
+    auto list = lists.find(ListKey(src_user_pkey, task_list_pkey));
+    if (list == lists.end()) {
+      return ERR_NO_NODE;
+    }
+    if (list->second["visibility"] == "private") {
+      return ERR_ACCESS;
+    }
+    access[AccessKey(src_user_pkey, dst_user_pkey, task_list_pkey)] =
+        read_write;
+    return SUCCESS;
+  }
+
+  returnCode checkAccess(const std::string &src_user_pkey,
+                         const std::string &dst_user_pkey,
+                         const std::string &task_list_pkey,
+                         bool &read_write) override {
+    if (src_user_pkey == dst_user_pkey) {
+      read_write = true;
+      return SUCCESS;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    if (users.find(src_user_pkey) == users.end() ||
+        users.find(dst_user_pkey) == users.end()) {
+      return ERR_NO_NODE;
+    }
+    auto list = lists.find(ListKey(src_user_pkey, task_list_pkey));
+    if (list == lists.end()) {
+      return ERR_NO_NODE;
+    }
+    const std::string &visibility = list->second["visibility"];
+    if (visibility == "private") {
+      return ERR_ACCESS;
+    } else if (visibility == "public") {
+      read_write = true;
+      return SUCCESS;
+    }
+    auto it = access.find(AccessKey(src_user_pkey, dst_user_pkey,
+                                    task_list_pkey));
+    if (it == access.end()) {
+      return ERR_ACCESS;
+    }
+    read_write = it->second;
+    return SUCCESS;
+  }
+
+  returnCode removeAccess(const std::string &src_user_pkey,
+                          const std::string &dst_user_pkey,
+                          const std::string &task_list_pkey) override {
+    std::lock_guard<std::mutex> guard(lock);
+    access.erase(AccessKey(src_user_pkey, dst_user_pkey, task_list_pkey));
+    return SUCCESS;
+  }
+
+  returnCode allAccess(const std::string &dst_user_pkey,
+                       std::map<std::pair<std::string, std::string>, bool>
+                           &list_accesses) override {
+    std::lock_guard<std::mutex> guard(lock);
+    list_accesses.clear();
+    if (users.find(dst_user_pkey) == users.end()) {
+      return ERR_NO_NODE;
+    }
+    for (const auto &it : access) {
+      if (std::get<1>(it.first) != dst_user_pkey) {
+        continue;
+      }
+      auto list = lists.find(
+          ListKey(std::get<0>(it.first), std::get<2>(it.first)));
+      if (list == lists.end() || list->second["visibility"] == "private") {
+        continue;
+      }
+      list_accesses[{std::get<0>(it.first), std::get<2>(it.first)}] =
+          list->second["visibility"] == "public" ? true : it.second;
+    }
+    return SUCCESS;
+  }
+
+  returnCode allGrant(const std::string &src_user_pkey,
+                      const std::string &task_list_pkey,
+                      std::map<std::string, bool> &list_grants) override {
+    std::lock_guard<std::mutex> guard(lock);
+    list_grants.clear();
+    if (users.find(src_user_pkey) == users.end()) {
+      return ERR_NO_NODE;
+    }
+    auto list = lists.find(ListKey(src_user_pkey, task_list_pkey));
+    if (list == lists.end()) {
+      return ERR_NO_NODE;
+    }
+    if (list->second["visibility"] != "shared") {
+      return SUCCESS;
+    }
+    for (const auto &it : access) {
+      if (std::get<0>(it.first) == src_user_pkey &&
+          std::get<2>(it.first) == task_list_pkey) {
+        list_grants[std::get<1>(it.first)] = it.second;
+      }
+    }
+    return SUCCESS;
+  }
+
+  returnCode getAllPublic(
+      std::vector<std::pair<std::string, std::string>> &user_list) override {
+    std::lock_guard<std::mutex> guard(lock);
+    user_list.clear();
+    for (auto &it : lists) {
+      if (it.second["visibility"] == "public") {
+        user_list.push_back(it.first);
+      }
+    }
+    return SUCCESS;
+  }
+
+  returnCode deleteEverything(void) override {
+    std::lock_guard<std::mutex> guard(lock);
+    users.clear();
+    lists.clear();
+    tasks.clear();
+    dependencies.clear();
+    revisions.clear();
+    archived.clear();
+    access.clear();
+    versions.clear();
+    tombstones.clear();
+    return SUCCESS;
+  }
+
+private:
+  using Fields = std::map<std::string, std::string>;
+  using ListKeyType = std::pair<std::string, std::string>;
+  using TaskKeyType = std::tuple<std::string, std::string, std::string>;
+  /* (src user, dst user, task list) */
+  using AccessKeyType = std::tuple<std::string, std::string, std::string>;
+
+  static ListKeyType ListKey(const std::string &user, const std::string &list) {
+    return {user, list};
+  }
+
+  static TaskKeyType TaskKey(const std::string &user, const std::string &list,
+                             const std::string &task) {
+    return TaskKeyType{user, list, task};
+  }
+
+  static AccessKeyType AccessKey(const std::string &src, const std::string &dst,
+                                 const std::string &list) {
+    return AccessKeyType{src, dst, list};
+  }
+
+  static void Merge(Fields &target, const Fields &source) {
+    for (const auto &it : source) {
+      target[it.first] = it.second;
+    }
+  }
+
+  /* Same contract as DB: empty request returns all fields, otherwise only the
+     requested ones. */
+  static void Fill(const Fields &stored, Fields &requested) {
+    if (requested.empty()) {
+      requested = stored;
+      return;
+    }
+    for (auto &it : requested) {
+      auto field = stored.find(it.first);
+      it.second = field == stored.end() ? "" : field->second;
+    }
+  }
+
+  /* The task as getAgenda returns it, false if it has no end date or the
+     user cannot see it. Called with lock held */
+  bool AgendaTask(const std::string &user_pkey, const TaskKeyType &key,
+                  const Fields &info, DBAgendaTask &task) {
+    const std::string &owner = std::get<0>(key);
+    const std::string &list = std::get<1>(key);
+    if (owner != user_pkey) {
+      auto shared = lists.find(ListKey(owner, list));
+      if (shared == lists.end() || shared->second["visibility"] == "private" ||
+          access.find(AccessKey(owner, user_pkey, list)) == access.end()) {
+        return false;
+      }
+    }
+    auto due = info.find("due");
+    if (due == info.end()) {
+      return false;
+    }
+    task.user = owner;
+    task.list = list;
+    task.task = std::get<2>(key);
+    task.due = due->second;
+    auto priority = info.find("priority");
+    task.rank = priority == info.end() ? 0 : atoi(priority->second.c_str());
+    task.rank = task.rank > 0 ? task.rank : 4;
+    task.info = info;
+    task.info.erase("user");
+    task.info.erase("list");
+    task.info.erase("version");
+    return true;
+  }
+
+  template <typename Map, typename Pred>
+  static void EraseIf(Map &map, Pred &&pred) {
+    for (auto it = map.begin(); it != map.end();) {
+      if (pred(it->first)) {
+        it = map.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  /* (position, name) of the tasks of a task list, in order, tasks without a
+     position last. Called with lock held */
+  std::vector<std::pair<std::string, std::string>>
+  Ordered(const std::string &user, const std::string &list) {
+    std::vector<std::pair<std::string, std::string>> order;
+    for (auto it = tasks.lower_bound(TaskKey(user, list, ""));
+         it != tasks.end() && std::get<0>(it->first) == user &&
+         std::get<1>(it->first) == list;
+         ++it) {
+      auto position = it->second.find("position");
+      order.emplace_back(
+          position == it->second.end() ? "" : position->second,
+          std::get<2>(it->first));
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [](const std::pair<std::string, std::string> &a,
+                        const std::pair<std::string, std::string> &b) {
+                       if (a.first.empty() != b.first.empty()) {
+                         return b.first.empty();
+                       }
+                       return a < b;
+                     });
+    return order;
+  }
+
+  std::string LastPosition(const std::string &user, const std::string &list) {
+    std::string last;
+    for (const auto &task : Ordered(user, list)) {
+      last = std::max(last, task.first);
+    }
+    return last;
+  }
+
+  void Rebalance(const std::string &user, const std::string &list) {
+    const std::string version = std::to_string(++versions[user]);
+    int i = 0;
+    for (const auto &task : Ordered(user, list)) {
+      std::string position = std::to_string(++i);
+      position = std::string(7 - std::min<size_t>(position.size(), 7), '0') +
+                 position + "V";
+      Fields &info = tasks[TaskKey(user, list, task.second)];
+      info["position"] = position;
+      info["version"] = version;
+    }
+  }
+
+  /* Keep the day a task became Done, as DB does */
+  static void StampDone(Fields &info) {
+    auto status = info.find("status");
+    if (status == info.end() || status->second != "Done") {
+      info.erase("doneAt");
+    } else if (!info.count("doneAt")) {
+      info["doneAt"] = Common::Today();
+    }
+  }
+
+  /* Drop the dependencies of a task, both ways. Called with lock held */
+  void DropDependencies(const std::string &user, const std::string &list,
+                        const std::string &task) {
+    dependencies.erase(TaskKey(user, list, task));
+    for (auto it = dependencies.lower_bound(TaskKey(user, list, ""));
+         it != dependencies.end() && std::get<0>(it->first) == user &&
+         std::get<1>(it->first) == list;
+         ++it) {
+      it->second.erase(task);
+    }
+  }
+
+  /* drop the changes a client already has */
+  static void DropUpTo(std::vector<DBChange> &changes, long long since) {
+    changes.erase(std::remove_if(changes.begin(), changes.end(),
+                                 [since](const DBChange &change) {
+                                   return change.version <= since;
+                                 }),
+                  changes.end());
+  }
+
+  std::mutex lock;
+  std::map<std::string, Fields> users;
+  std::map<ListKeyType, Fields> lists;
+  std::map<TaskKeyType, Fields> tasks;
+  /* names of the tasks of the same task list each task depends on */
+  std::map<TaskKeyType, std::set<std::string>> dependencies;
+  /* revisions of each task, oldest first */
+  std::map<TaskKeyType, std::vector<DBTaskRevision>> revisions;
+  /* archived tasks of each task list, in the order they were archived */
+  std::map<ListKeyType, std::vector<Fields>> archived;
+  std::map<AccessKeyType, bool> access;
+  /* change version of each user, see DB::getChangesSince */
+  std::map<std::string, long long> versions;
+  std::map<std::string, std::vector<DBChange>> tombstones;
+};
@@ -5,11 +5,14 @@
 #include "tasks/tasksWorker.h"
 #include "users/users.h"
 #include <algorithm>
+#include <atomic>
 #include <gtest/gtest.h>
 #include <iterator>
 #include <memory>
 #include <nlohmann/json.hpp>
+#include <set>
 #include <string>
+#include <tuple>
 
 class MockedUsers : public Users {
 public:
@@ -71,6 +74,12 @@ public:
     return returnCode::SUCCESS;
   };
 
+  returnCode QueryWithStats(const RequestData &data, TasklistContent &out,
+                            DBTaskListStats &stats) override {
+    stats = DBTaskListStats();
+    return Query(data, out);
+  }
+
   returnCode GetAllTasklist(const RequestData &data,
                             std::vector<std::string> &outNames) override {
     const auto it = mocked_data.find(data.user_key);
@@ -83,6 +92,39 @@ public:
     return returnCode::SUCCESS;
   }
 
+  returnCode Stats(const RequestData &data,
+                   std::map<std::string, DBTaskListStats> &stats) override {
+    const std::string &owner =
+        data.other_user_key.empty() ? data.user_key : data.other_user_key;
+    for (const auto &it : mocked_data[owner]) {
+      if (data.tasklist_key.empty() || it.first == data.tasklist_key) {
+        stats[it.first];
+      }
+    }
+    return returnCode::SUCCESS;
+  }
+
+  /* Own tasklists starting with the prefix, in name order */
+  returnCode Autocomplete(const RequestData &data, const std::string &prefix,
+                          int kinds, size_t k,
+                          std::vector<RequestData> &out) override {
+    out.clear();
+    if (data.user_key.empty() || prefix.empty()) {
+      return returnCode::ERR_RFIELD;
+    }
+    if (!(kinds & NameTrie::LISTS)) {
+      return returnCode::SUCCESS;
+    }
+    for (const auto &it : mocked_data[data.user_key]) {
+      if (NameTrie::Fold(it.first).compare(0, prefix.size(),
+                                           NameTrie::Fold(prefix)) == 0 &&
+          out.size() < k) {
+        out.emplace_back(data.user_key, it.first, "", "");
+      }
+    }
+    return returnCode::SUCCESS;
+  }
+
   returnCode GetAllAccessTaskList(const RequestData &data,
                                   std::vector<shareInfo> &out_list) override {
     if (data.RequestUserIsEmpty()) {
@@ -128,6 +170,31 @@ public:
     return returnCode::SUCCESS;
   }
 
+  /* Own tasklists only, named as Create does */
+  returnCode Clone(const RequestData &data, const std::string &name,
+                   std::string &outTasklistName,
+                   std::vector<std::string> &outTasks) override {
+    outTasks.clear();
+    if (data.RequestTaskListIsEmpty()) {
+      return returnCode::ERR_RFIELD;
+    }
+    if (!data.other_user_key.empty()) {
+      return returnCode::ERR_ACCESS;
+    }
+    const auto it = mocked_data[data.user_key].find(data.tasklist_key);
+    if (it == mocked_data[data.user_key].cend()) {
+      return returnCode::ERR_NO_NODE;
+    }
+    TasklistContent copy = it->second;
+    copy.visibility = "private";
+    RequestData target(data.user_key, name.empty() ? data.tasklist_key : name,
+                       "", "");
+    copy.name = target.tasklist_key;
+    Create(target, copy, outTasklistName);
+    outTasklistName = copy.name;
+    return returnCode::SUCCESS;
+  }
+
   returnCode Revise(const RequestData &data, TasklistContent &in) override {
     std::string query_user_key = data.user_key;
     if (!data.other_user_key.empty()) {
@@ -304,6 +371,45 @@ public:
     return returnCode::SUCCESS;
   };
 
+  returnCode QueryMany(const std::vector<RequestData> &data,
+                       std::vector<returnCode> &results,
+                       std::vector<TaskContent> &out) override {
+    results.assign(data.size(), returnCode::ERR_NO_NODE);
+    out.assign(data.size(), TaskContent());
+    for (size_t i = 0; i < data.size(); i++) {
+      results[i] = Query(data[i], out[i]);
+    }
+    return returnCode::SUCCESS;
+  }
+
+  /* Own tasks containing every word, in list and task order */
+  returnCode Search(const RequestData &data, const std::string &query,
+                    size_t k,
+                    std::vector<std::pair<RequestData, double>> &out) override {
+    out.clear();
+    const std::vector<std::string> words = SearchIndex::Tokenize(query);
+    if (data.user_key.empty() || words.empty()) {
+      return returnCode::ERR_RFIELD;
+    }
+    for (const auto &list : mocked_data[data.user_key]) {
+      for (const auto &task : list.second) {
+        std::vector<std::string> terms =
+            SearchIndex::Tokenize(task.first + " " + task.second.content);
+        bool found = true;
+        for (const std::string &word : words) {
+          if (std::find(terms.begin(), terms.end(), word) == terms.end()) {
+            found = false;
+          }
+        }
+        if (found && out.size() < k) {
+          out.emplace_back(
+              RequestData(data.user_key, list.first, task.first, ""), 1.0);
+        }
+      }
+    }
+    return returnCode::SUCCESS;
+  }
+
   returnCode GetAllTasksName(const RequestData &data,
                              std::vector<std::string> &outNames) override {
     std::string query_user_key = data.user_key;
@@ -367,6 +473,16 @@ public:
     if (it == mocked_tasks.end()) {
       return returnCode::ERR_NO_NODE;
     }
+    DBTaskRevision revision;
+    if (!in.content.empty() && in.content != it->second.content) {
+      revision.before["content"] = it->second.content;
+      revision.after["content"] = in.content;
+    }
+    if (!revision.after.empty()) {
+      revision.version = ++mocked_version;
+      mocked_history[query_user_key][data.tasklist_key][data.task_key]
+          .push_back(revision);
+    }
     if (!in.content.empty()) {
       it->second.content = in.content;
     }
@@ -398,6 +514,231 @@ public:
     return returnCode::SUCCESS;
   }
 
+  /* Own tasks only, renamed like Create */
+  returnCode Move(const RequestData &data, const RequestData &to,
+                  std::string &outTaskName) override {
+    if (data.RequestIsEmpty() || to.tasklist_key.empty()) {
+      return returnCode::ERR_RFIELD;
+    }
+    auto &from_tasks = mocked_data[data.user_key][data.tasklist_key];
+    auto it = from_tasks.find(data.task_key);
+    if (it == from_tasks.end() ||
+        mocked_data[data.user_key].find(to.tasklist_key) ==
+            mocked_data[data.user_key].end()) {
+      return returnCode::ERR_NO_NODE;
+    }
+    auto &to_tasks = mocked_data[data.user_key][to.tasklist_key];
+    int suffix = 0;
+    do {
+      outTaskName = Common::Rename(data.task_key, suffix++);
+    } while (to_tasks.find(outTaskName) != to_tasks.end());
+    TaskContent task = it->second;
+    from_tasks.erase(it);
+    task.name = outTaskName;
+    to_tasks[outTaskName] = task;
+    return returnCode::SUCCESS;
+  }
+
+  /* Own tasks only, the order is not kept */
+  returnCode Reorder(const RequestData &data, const std::string &anchor,
+                     bool after, std::string &outPosition) override {
+    if (data.RequestIsEmpty() || anchor.empty()) {
+      return returnCode::ERR_RFIELD;
+    }
+    const auto &tasks = mocked_data[data.user_key][data.tasklist_key];
+    if (tasks.find(data.task_key) == tasks.end() ||
+        tasks.find(anchor) == tasks.end()) {
+      return returnCode::ERR_NO_NODE;
+    }
+    outPosition = after ? Common::PositionBetween("V", "")
+                        : Common::PositionBetween("", "V");
+    return returnCode::SUCCESS;
+  }
+
+  /* Own tasks only, any day of a repeating task is an occurrence */
+  returnCode Complete(const RequestData &data, const std::string &date,
+                      std::string &outTaskName) override {
+    outTaskName = "";
+    if (data.RequestIsEmpty() || date.empty()) {
+      return returnCode::ERR_RFIELD;
+    }
+    auto &tasks = mocked_data[data.user_key][data.tasklist_key];
+    auto it = tasks.find(data.task_key);
+    if (it == tasks.end()) {
+      return returnCode::ERR_NO_NODE;
+    }
+    const std::string day = Common::DateKey(date);
+    if (it->second.recurrence.empty() || day.empty()) {
+      return returnCode::ERR_FORMAT;
+    }
+    outTaskName = data.task_key + "@" + day;
+    TaskContent occurrence = it->second;
+    occurrence.name = outTaskName;
+    occurrence.recurrence = "";
+    tasks[outTaskName] = occurrence;
+    return returnCode::SUCCESS;
+  }
+
+  /* Own tasks only, cycles of one or two tasks are rejected */
+  returnCode AddDependency(const RequestData &data,
+                           const std::string &on) override {
+    if (data.RequestIsEmpty() || on.empty()) {
+      return returnCode::ERR_RFIELD;
+    }
+    const auto &tasks = mocked_data[data.user_key][data.tasklist_key];
+    if (tasks.find(data.task_key) == tasks.end() ||
+        tasks.find(on) == tasks.end()) {
+      return returnCode::ERR_NO_NODE;
+    }
+    if (on == data.task_key ||
+        mocked_dependencies.count(std::make_tuple(
+            data.user_key, data.tasklist_key, on, data.task_key))) {
+      return returnCode::ERR_FORMAT;
+    }
+    mocked_dependencies.insert(
+        std::make_tuple(data.user_key, data.tasklist_key, data.task_key, on));
+    return returnCode::SUCCESS;
+  }
+
+  returnCode RemoveDependency(const RequestData &data,
+                              const std::string &on) override {
+    if (data.RequestIsEmpty() || on.empty()) {
+      return returnCode::ERR_RFIELD;
+    }
+    if (!mocked_dependencies.erase(std::make_tuple(
+            data.user_key, data.tasklist_key, data.task_key, on))) {
+      return returnCode::ERR_NO_NODE;
+    }
+    return returnCode::SUCCESS;
+  }
+
+  /* Own tasks only, in passes over the tasks by name */
+  returnCode Order(const RequestData &data,
+                   std::vector<std::string> &outNames) override {
+    outNames.clear();
+    const auto it = mocked_data[data.user_key].find(data.tasklist_key);
+    if (it == mocked_data[data.user_key].end()) {
+      return returnCode::ERR_NO_NODE;
+    }
+    std::set<std::string> placed;
+    while (placed.size() < it->second.size()) {
+      for (const auto &task : it->second) {
+        bool ready = !placed.count(task.first);
+        for (const auto &dependency : mocked_dependencies) {
+          if (std::get<0>(dependency) == data.user_key &&
+              std::get<1>(dependency) == data.tasklist_key &&
+              std::get<2>(dependency) == task.first &&
+              !placed.count(std::get<3>(dependency))) {
+            ready = false;
+          }
+        }
+        if (ready) {
+          placed.insert(task.first);
+          outNames.push_back(task.first);
+        }
+      }
+    }
+    return returnCode::SUCCESS;
+  }
+
+  /* Own tasks only, the last task of Order and the first task it depends
+     on, and so on, a day each */
+  returnCode CriticalPath(const RequestData &data,
+                          std::vector<std::string> &outNames,
+                          long &outDays) override {
+    std::vector<std::string> order;
+    returnCode ret = Order(data, order);
+    outNames.clear();
+    outDays = 0;
+    if (ret != returnCode::SUCCESS || order.empty()) {
+      return ret;
+    }
+    std::string task = order.back();
+    while (!task.empty()) {
+      outNames.insert(outNames.begin(), task);
+      const std::string current = task;
+      task = "";
+      for (const auto &dependency : mocked_dependencies) {
+        if (std::get<0>(dependency) == data.user_key &&
+            std::get<1>(dependency) == data.tasklist_key &&
+            std::get<2>(dependency) == current) {
+          task = std::get<3>(dependency);
+          break;
+        }
+      }
+    }
+    outDays = (long)outNames.size();
+    return returnCode::SUCCESS;
+  }
+
+  /* Own tasks only, see Archive */
+  returnCode Archived(const RequestData &data,
+                      std::vector<TaskContent> &out) override {
+    out.clear();
+    if (data.RequestTaskListIsEmpty()) {
+      return returnCode::ERR_RFIELD;
+    }
+    if (mocked_data[data.user_key].find(data.tasklist_key) ==
+        mocked_data[data.user_key].end()) {
+      return returnCode::ERR_NO_NODE;
+    }
+    const auto &archived = mocked_archived[data.user_key][data.tasklist_key];
+    for (auto it = archived.rbegin(); it != archived.rend(); ++it) {
+      if (data.task_key.empty() || it->name == data.task_key) {
+        out.push_back(*it);
+      }
+    }
+    return returnCode::SUCCESS;
+  }
+
+  /* Own tasks only, the revisions of their content */
+  returnCode History(const RequestData &data, long long before, size_t limit,
+                     std::vector<DBTaskRevision> &out) override {
+    out.clear();
+    if (mocked_data[data.user_key][data.tasklist_key].count(data.task_key) ==
+        0) {
+      return returnCode::ERR_NO_NODE;
+    }
+    const auto &history =
+        mocked_history[data.user_key][data.tasklist_key][data.task_key];
+    for (auto it = history.rbegin();
+         it != history.rend() && out.size() < limit; ++it) {
+      if (before == 0 || it->version < before) {
+        out.push_back(*it);
+      }
+    }
+    return returnCode::SUCCESS;
+  }
+
+  returnCode AtVersion(const RequestData &data, long long version,
+                       TaskContent &out) override {
+    auto &tasks = mocked_data[data.user_key][data.tasklist_key];
+    auto it = tasks.find(data.task_key);
+    if (it == tasks.end()) {
+      return returnCode::ERR_NO_NODE;
+    }
+    out = it->second;
+    const auto &history =
+        mocked_history[data.user_key][data.tasklist_key][data.task_key];
+    for (auto revision = history.rbegin();
+         revision != history.rend() && revision->version > version;
+         ++revision) {
+      out.content = revision->before.at("content");
+    }
+    return returnCode::SUCCESS;
+  }
+
+  /* Move a task out of its task list as the archiving job does */
+  void Archive(const std::string &user, const std::string &tasklist,
+               const std::string &task) {
+    auto &tasks = mocked_data[user][tasklist];
+    auto it = tasks.find(task);
+    if (it != tasks.end()) {
+      mocked_archived[user][tasklist].push_back(it->second);
+      tasks.erase(it);
+    }
+  }
+
   bool CheckWritePerm(const std::string &user, const std::string &other_user,
                       const std::string &tasklist) {
     std::shared_ptr<MockedTasklistsWorker> mocked_tasklists_worker =
@@ -422,9 +763,26 @@ public:
     return shareinfo_it != sharelist_it->second.end();
   }
 
-  void Clear() { mocked_data.clear(); }
+  void Clear() {
+    mocked_data.clear();
+    mocked_dependencies.clear();
+    mocked_archived.clear();
+    mocked_history.clear();
+  }
 
 private:
+  /* (user_key, tasklist_key, task_key) -> revisions, oldest first */
+  std::map<std::string,
+           std::map<std::string,
+                    std::map<std::string, std::vector<DBTaskRevision>>>>
+      mocked_history;
+  long long mocked_version = 0;
+  /* (user_key, tasklist_key) -> archived tasks, in the order archived */
+  std::map<std::string, std::map<std::string, std::vector<TaskContent>>>
+      mocked_archived;
+  /* (user_key, tasklist_key, task_key, task_key it depends on) */
+  std::set<std::tuple<std::string, std::string, std::string, std::string>>
+      mocked_dependencies;
   /* (user_key, tasklist_key, task_key) -> TasklistContent */
   std::map<std::string,
            std::map<std::string, std::map<std::string, TaskContent>>>
@@ -763,6 +1121,8 @@ TEST_F(APITest, TaskLists) {
     EXPECT_NE(result->body.find("success"), std::string::npos);
     EXPECT_NE(result->body.find("tasklists_test_name_1"), std::string::npos);
     EXPECT_NE(result->body.find("tasklists_test_name_2"), std::string::npos);
+    auto body = nlohmann::json::parse(result->body);
+    EXPECT_EQ(body["stats"]["tasklists_test_name_2"]["total"], 0);
   }
 
   {
@@ -774,6 +1134,8 @@ TEST_F(APITest, TaskLists) {
     EXPECT_NE(result->body.find("tasklists_test_name_1"), std::string::npos);
     EXPECT_NE(result->body.find("some_content_1"), std::string::npos);
     EXPECT_EQ(result->body.find("some_content_2"), std::string::npos);
+    auto body = nlohmann::json::parse(result->body);
+    EXPECT_EQ(body["data"]["stats"]["status"]["To Do"], 0);
   }
 
   {
@@ -788,6 +1150,101 @@ TEST_F(APITest, TaskLists) {
     EXPECT_NE(result->body.find("failed"), std::string::npos);
   }
 
+  {
+    httplib::Client client(test_host, test_port);
+    client.set_basic_auth(token, "");
+    nlohmann::json request_body;
+    request_body["tasks"] = {
+        {{"list", "tasklists_test_name_1"}, {"task", "tasks_test_name_2"}},
+        {{"list", "tasklists_test_name_1"}, {"task", "no_such_task"}},
+        {{"list", "tasklists_test_name_1"}, {"task", "tasks_test_name_1"}}};
+    auto result =
+        client.Post("/v1/tasks/multi_get", request_body.dump(), "text/plain");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    nlohmann::json data = nlohmann::json::parse(result->body).at("data");
+    ASSERT_EQ(data.size(), 3);
+    EXPECT_EQ(data[0].at("msg"), "success");
+    EXPECT_EQ(data[0].at("content"), "some_content_2");
+    EXPECT_EQ(data[1].at("task"), "no_such_task");
+    EXPECT_NE(data[1].at("msg").get<std::string>().find("failed"),
+              std::string::npos);
+    EXPECT_EQ(data[2].at("content"), "some_content_1");
+
+    request_body["tasks"] = "tasks_test_name_1";
+    result =
+        client.Post("/v1/tasks/multi_get", request_body.dump(), "text/plain");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    EXPECT_EQ(result->status, 400);
+  }
+
+  {
+    httplib::Client client(test_host, test_port);
+    client.set_basic_auth(token, "");
+    auto result = client.Get("/v1/search?q=Some_Content_2");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    nlohmann::json data = nlohmann::json::parse(result->body).at("data");
+    ASSERT_EQ(data.size(), 1);
+    EXPECT_EQ(data[0].at("list"), "tasklists_test_name_1");
+    EXPECT_EQ(data[0].at("task"), "tasks_test_name_2");
+
+    result = client.Get("/v1/search?q=%20");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    EXPECT_EQ(result->status, 400);
+    result = client.Get("/v1/search?q=some&k=0");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    EXPECT_EQ(result->status, 400);
+  }
+
+  {
+    httplib::Client client(test_host, test_port);
+    client.set_basic_auth(token, "");
+    auto result = client.Get("/v1/autocomplete?prefix=TaskLists_&kind=list");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    nlohmann::json data = nlohmann::json::parse(result->body).at("data");
+    ASSERT_FALSE(data.empty());
+    EXPECT_EQ(data[0].at("list"), "tasklists_test_name_1");
+    EXPECT_EQ(data[0].at("task"), "");
+
+    result = client.Get("/v1/autocomplete?prefix=tasklists_&kind=task");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    EXPECT_TRUE(nlohmann::json::parse(result->body).at("data").empty());
+    result = client.Get("/v1/autocomplete?prefix=t&kind=user");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    EXPECT_EQ(result->status, 400);
+    result = client.Get("/v1/autocomplete");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    EXPECT_EQ(result->status, 400);
+  }
+
+  {
+    httplib::Client client(test_host, test_port);
+    client.set_basic_auth(token, "");
+    auto result = client.Post("/v1/task_lists/tasklists_test_name_1/clone", "",
+                              "text/plain");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    auto body = nlohmann::json::parse(result->body);
+    EXPECT_EQ(body.at("msg"), "success");
+    EXPECT_EQ(body.at("name"), "tasklists_test_name_1(1)");
+
+    nlohmann::json request_body;
+    request_body["name"] = "tasklists_test_clone";
+    result = client.Post("/v1/task_lists/tasklists_test_name_1/clone",
+                         request_body.dump(), "text/plain");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    EXPECT_EQ(nlohmann::json::parse(result->body).at("name"),
+              "tasklists_test_clone");
+    result = client.Get("/v1/task_lists/tasklists_test_clone");
+    EXPECT_NE(result->body.find("some_content_1"), std::string::npos);
+
+    result = client.Post("/v1/task_lists/no_such_tasklist/clone", "",
+                         "text/plain");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    EXPECT_EQ(result->status, 500);
+
+    client.Delete("/v1/task_lists/tasklists_test_name_1(1)");
+    client.Delete("/v1/task_lists/tasklists_test_clone");
+  }
+
   {
     httplib::Client client(test_host, test_port);
     client.set_basic_auth(token, "");
@@ -1054,6 +1511,280 @@ TEST_F(APITest, Tasks) {
     EXPECT_NE(result->body.find("tasks_test_name_2"), std::string::npos);
   }
 
+  {
+    httplib::Client client(test_host, test_port);
+    client.set_basic_auth(token, "");
+    nlohmann::json request_body;
+    request_body["name"] = "tasks_test_name_3";
+    auto result =
+        client.Post("/v1/task_lists/tasklists_test_name_1/tasks/create",
+                    request_body.dump(), "text/plain");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+
+    request_body.clear();
+    request_body["after"] = "tasks_test_name_3";
+    result = client.Post(
+        "/v1/task_lists/tasklists_test_name_1/tasks/tasks_test_name_2/reorder",
+        request_body.dump(), "text/plain");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    auto body = nlohmann::json::parse(result->body);
+    EXPECT_EQ(body["msg"], "success");
+    EXPECT_FALSE(body["position"].get<std::string>().empty());
+
+    // exactly one of after and before
+    request_body["before"] = "tasks_test_name_3";
+    result = client.Post(
+        "/v1/task_lists/tasklists_test_name_1/tasks/tasks_test_name_2/reorder",
+        request_body.dump(), "text/plain");
+    EXPECT_EQ(result->status, 400);
+    result = client.Post(
+        "/v1/task_lists/tasklists_test_name_1/tasks/tasks_test_name_2/reorder",
+        "{}", "text/plain");
+    EXPECT_EQ(result->status, 400);
+
+    request_body.clear();
+    request_body["before"] = "no_such_task";
+    result = client.Post(
+        "/v1/task_lists/tasklists_test_name_1/tasks/tasks_test_name_2/reorder",
+        request_body.dump(), "text/plain");
+    EXPECT_EQ(result->status, 500);
+
+    client.Delete(
+        "/v1/task_lists/tasklists_test_name_1/tasks/tasks_test_name_3");
+  }
+
+  {
+    httplib::Client client(test_host, test_port);
+    client.set_basic_auth(token, "");
+    nlohmann::json request_body;
+    request_body["name"] = "tasklists_test_name_2";
+    auto result =
+        client.Post("/v1/task_lists/create", request_body.dump(), "text/plain");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+
+    request_body.clear();
+    request_body["list"] = "tasklists_test_name_2";
+    result = client.Post(
+        "/v1/task_lists/tasklists_test_name_1/tasks/tasks_test_name_2/move",
+        request_body.dump(), "text/plain");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    auto body = nlohmann::json::parse(result->body);
+    EXPECT_EQ(body["msg"], "success");
+    EXPECT_EQ(body["name"], "tasks_test_name_2");
+
+    result = client.Get(
+        "/v1/task_lists/tasklists_test_name_2/tasks/tasks_test_name_2");
+    EXPECT_NE(result->body.find("some_content_2"), std::string::npos);
+    result = client.Get(
+        "/v1/task_lists/tasklists_test_name_1/tasks/tasks_test_name_2");
+    EXPECT_NE(result->body.find("failed"), std::string::npos);
+
+    // the task is gone from where it was
+    result = client.Post(
+        "/v1/task_lists/tasklists_test_name_1/tasks/tasks_test_name_2/move",
+        request_body.dump(), "text/plain");
+    EXPECT_NE(result->body.find("failed"), std::string::npos);
+  }
+
+  {
+    httplib::Client client(test_host, test_port);
+    client.set_basic_auth(token, "");
+    nlohmann::json request_body;
+    request_body["name"] = "standup";
+    request_body["recurrence"] = "FREQ=WEEKLY;BYDAY=MO,WE";
+    auto result =
+        client.Post("/v1/task_lists/tasklists_test_name_1/tasks/create",
+                    request_body.dump(), "text/plain");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+
+    request_body.clear();
+    request_body["date"] = "11/07/2022";
+    result =
+        client.Post("/v1/task_lists/tasklists_test_name_1/tasks/standup/"
+                    "complete",
+                    request_body.dump(), "text/plain");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    auto body = nlohmann::json::parse(result->body);
+    EXPECT_EQ(body["msg"], "success");
+    EXPECT_EQ(body["name"], "standup@2022-11-07");
+
+    // a date is needed, in the form of task dates
+    result =
+        client.Post("/v1/task_lists/tasklists_test_name_1/tasks/standup/"
+                    "complete",
+                    "{}", "text/plain");
+    EXPECT_EQ(result->status, 400);
+    request_body["date"] = "2022-11-07";
+    result =
+        client.Post("/v1/task_lists/tasklists_test_name_1/tasks/standup/"
+                    "complete",
+                    request_body.dump(), "text/plain");
+    EXPECT_EQ(result->status, 400);
+    request_body["date"] = "11/07/2022";
+    result = client.Post(
+        "/v1/task_lists/tasklists_test_name_1/tasks/no_such_task/complete",
+        request_body.dump(), "text/plain");
+    EXPECT_EQ(result->status, 500);
+  }
+
+  {
+    httplib::Client client(test_host, test_port);
+    client.set_basic_auth(token, "");
+    nlohmann::json request_body;
+    for (const char *name : {"design", "build", "ship"}) {
+      request_body["name"] = name;
+      client.Post("/v1/task_lists/tasklists_test_name_1/tasks/create",
+                  request_body.dump(), "text/plain");
+    }
+
+    // ship after build after design
+    request_body.clear();
+    request_body["task"] = "design";
+    auto result = client.Post(
+        "/v1/task_lists/tasklists_test_name_1/tasks/build/depends_on",
+        request_body.dump(), "text/plain");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    auto body = nlohmann::json::parse(result->body);
+    EXPECT_EQ(body["msg"], "success");
+    request_body["task"] = "build";
+    result = client.Post(
+        "/v1/task_lists/tasklists_test_name_1/tasks/ship/depends_on",
+        request_body.dump(), "text/plain");
+    EXPECT_EQ(nlohmann::json::parse(result->body)["msg"], "success");
+
+    // a cycle is refused
+    request_body["task"] = "ship";
+    result = client.Post(
+        "/v1/task_lists/tasklists_test_name_1/tasks/build/depends_on",
+        request_body.dump(), "text/plain");
+    EXPECT_EQ(result->status, 400);
+    EXPECT_NE(result->body.find("cycle"), std::string::npos);
+    result = client.Post(
+        "/v1/task_lists/tasklists_test_name_1/tasks/build/depends_on", "{}",
+        "text/plain");
+    EXPECT_EQ(result->status, 400);
+
+    result = client.Get("/v1/task_lists/tasklists_test_name_1/order");
+    body = nlohmann::json::parse(result->body);
+    EXPECT_EQ(body["msg"], "success");
+    std::vector<std::string> order = body["tasks"];
+    auto at = [&order](const std::string &name) {
+      return std::find(order.begin(), order.end(), name) - order.begin();
+    };
+    EXPECT_LT(at("design"), at("build"));
+    EXPECT_LT(at("build"), at("ship"));
+
+    result = client.Get("/v1/task_lists/tasklists_test_name_1/critical_path");
+    body = nlohmann::json::parse(result->body);
+    EXPECT_EQ(body["msg"], "success");
+    EXPECT_EQ(body["tasks"], nlohmann::json({"design", "build", "ship"}));
+    EXPECT_EQ(body["days"], 3);
+
+    result = client.Delete(
+        "/v1/task_lists/tasklists_test_name_1/tasks/ship/depends_on",
+        request_body.dump(), "text/plain");
+    EXPECT_EQ(result->status, 500);
+    request_body["task"] = "build";
+    result = client.Delete(
+        "/v1/task_lists/tasklists_test_name_1/tasks/ship/depends_on",
+        request_body.dump(), "text/plain");
+    EXPECT_EQ(nlohmann::json::parse(result->body)["msg"], "success");
+
+    result = client.Get("/v1/task_lists/no_such_list/order");
+    EXPECT_EQ(result->status, 500);
+  }
+
+  {
+    httplib::Client client(test_host, test_port);
+    client.set_basic_auth(token, "");
+    nlohmann::json request_body;
+    request_body["name"] = "old";
+    request_body["content"] = "done long ago";
+    request_body["status"] = "Done";
+    client.Post("/v1/task_lists/tasklists_test_name_1/tasks/create",
+                request_body.dump(), "text/plain");
+    mocked_tasks_worker->Archive("Alice", "tasklists_test_name_1", "old");
+
+    // gone from the task list, there with ?archived=true
+    auto result = client.Get("/v1/task_lists/tasklists_test_name_1/tasks");
+    EXPECT_EQ(result->body.find("\"old\""), std::string::npos);
+    result = client.Get(
+        "/v1/task_lists/tasklists_test_name_1/tasks?archived=true");
+    auto body = nlohmann::json::parse(result->body);
+    EXPECT_EQ(body["msg"], "success");
+    EXPECT_EQ(body["data"], nlohmann::json({"old"}));
+    result = client.Get("/v1/task_lists/tasklists_test_name_1/tasks/old");
+    EXPECT_EQ(result->status, 500);
+    result = client.Get(
+        "/v1/task_lists/tasklists_test_name_1/tasks/old?archived=true");
+    body = nlohmann::json::parse(result->body);
+    EXPECT_EQ(body["msg"], "success");
+    EXPECT_EQ(body["data"]["content"], "done long ago");
+    result = client.Get(
+        "/v1/task_lists/tasklists_test_name_1/tasks/new?archived=true");
+    EXPECT_EQ(result->status, 500);
+  }
+
+  {
+    httplib::Client client(test_host, test_port);
+    client.set_basic_auth(token, "");
+    nlohmann::json request_body;
+    request_body["name"] = "notes";
+    request_body["content"] = "v1";
+    client.Post("/v1/task_lists/tasklists_test_name_1/tasks/create",
+                request_body.dump(), "text/plain");
+    request_body.erase("name");
+    request_body["content"] = "v2";
+    client.Put("/v1/task_lists/tasklists_test_name_1/tasks/notes",
+               request_body.dump(), "text/plain");
+    request_body["content"] = "v3";
+    client.Put("/v1/task_lists/tasklists_test_name_1/tasks/notes",
+               request_body.dump(), "text/plain");
+
+    // the last revision first, a page at a time
+    auto result = client.Get(
+        "/v1/task_lists/tasklists_test_name_1/tasks/notes/history?limit=1");
+    auto body = nlohmann::json::parse(result->body);
+    EXPECT_EQ(body["msg"], "success");
+    ASSERT_EQ(body["data"].size(), 1);
+    EXPECT_EQ(body["data"][0]["before"]["content"], "v2");
+    EXPECT_EQ(body["data"][0]["after"]["content"], "v3");
+    const long long last = body["data"][0]["version"];
+    const std::string cursor = body["cursor"];
+    EXPECT_EQ(cursor, std::to_string(last));
+    result = client.Get(
+        ("/v1/task_lists/tasklists_test_name_1/tasks/notes/history?cursor=" +
+         cursor)
+            .c_str());
+    body = nlohmann::json::parse(result->body);
+    ASSERT_EQ(body["data"].size(), 1);
+    EXPECT_EQ(body["data"][0]["before"]["content"], "v1");
+    EXPECT_EQ(body["cursor"], "");
+
+    // the task at a version
+    result = client.Get(
+        ("/v1/task_lists/tasklists_test_name_1/tasks/notes/history?version=" +
+         std::to_string(last - 1))
+            .c_str());
+    body = nlohmann::json::parse(result->body);
+    EXPECT_EQ(body["msg"], "success");
+    EXPECT_EQ(body["data"]["name"], "notes");
+    EXPECT_EQ(body["data"]["content"], "v2");
+    result = client.Get(
+        "/v1/task_lists/tasklists_test_name_1/tasks/notes/history?version=0");
+    EXPECT_EQ(nlohmann::json::parse(result->body)["data"]["content"], "v1");
+
+    result = client.Get(
+        "/v1/task_lists/tasklists_test_name_1/tasks/notes/history?version=x");
+    EXPECT_EQ(result->status, 400);
+    result = client.Get(
+        "/v1/task_lists/tasklists_test_name_1/tasks/notes/history?limit=0");
+    EXPECT_EQ(result->status, 400);
+    result = client.Get(
+        "/v1/task_lists/tasklists_test_name_1/tasks/none/history");
+    EXPECT_EQ(result->status, 500);
+  }
+
   mocked_tasklists_worker->Clear();
   mocked_tasks_worker->Clear();
 }
@@ -1570,6 +2301,59 @@ TEST_F(APITest, Share) {
   mocked_tasks_worker->Clear();
 }
 
+TEST(APIStartupTest, LivenessAndReadiness) {
+  const std::string test_host = "0.0.0.0";
+  const uint32_t test_port = 3303;
+  auto mocked_users = std::make_shared<MockedUsers>();
+  auto mocked_db = std::make_shared<DB>();
+  auto api = std::make_shared<Api>(mocked_users, nullptr, nullptr, mocked_db);
+
+  // fails twice, then succeeds once allowed to
+  std::atomic<int> attempts{0};
+  std::atomic<bool> can_start{false};
+  api->AddStartupTask([&]() {
+    attempts++;
+    if (attempts == 1) {
+      throw std::runtime_error("neo4j down");
+    }
+    return can_start.load();
+  });
+  std::thread running_server([&]() { api->Run(test_host, test_port); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+  {
+    // listening, but not ready yet
+    httplib::Client client(test_host, test_port);
+    auto result = client.Get("/health/live");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    EXPECT_EQ(result->status, 200);
+    result = client.Get("/health/ready");
+    EXPECT_EQ(result->status, 503);
+    result = client.Get("/health/42");
+    EXPECT_EQ(result->status, 200);
+    result = client.Post("/v1/users/login");
+    EXPECT_EQ(result->status, 503);
+    EXPECT_GE(attempts, 2);
+  }
+
+  can_start = true;
+  std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+  {
+    httplib::Client client(test_host, test_port);
+    auto result = client.Get("/health/ready");
+    EXPECT_EQ(result.error(), httplib::Error::Success);
+    EXPECT_EQ(result->status, 200);
+    mocked_users->SetValidateResult(false);
+    client.set_basic_auth("alice@columbia.edu", "123456");
+    result = client.Post("/v1/users/login");
+    EXPECT_NE(result->status, 503);
+  }
+
+  api->Stop();
+  running_server.join();
+}
+
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
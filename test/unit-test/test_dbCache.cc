@@ -0,0 +1,146 @@
+#include "db/dbCache.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+
+class DBCacheTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    path = "/tmp/test_dbCache_" + std::to_string(getpid()) + ".snap";
+  }
+  void TearDown() override { remove(path.c_str()); }
+
+  std::string path;
+};
+
+TEST_F(DBCacheTest, KeysAndValues) {
+  std::string key = DBCache::Key({"user@a.com", "list", ""});
+  EXPECT_EQ(DBCache::SplitKey(key),
+            std::vector<std::string>({"user@a.com", "list", ""}));
+
+  std::vector<std::pair<std::string, std::string>> pairs = {
+      {"email", "user@a.com"}, {"name", ""}, {"", std::string("a\0b", 3)}};
+  EXPECT_EQ(DBCache::Decode(DBCache::Encode(pairs)), pairs);
+  EXPECT_TRUE(DBCache::Decode("").empty());
+}
+
+TEST_F(DBCacheTest, EvictsLeastRecentlyUsed) {
+  DBCache cache(2, "host");
+  cache.Put(DBCache::USER, "a", "1", cache.Generation());
+  cache.Put(DBCache::USER, "b", "2", cache.Generation());
+  std::string value;
+  EXPECT_TRUE(cache.Get(DBCache::USER, "a", value));
+  cache.Put(DBCache::USER, "c", "3", cache.Generation());
+
+  EXPECT_EQ(cache.Size(), 2);
+  EXPECT_TRUE(cache.Get(DBCache::USER, "a", value));
+  EXPECT_EQ(value, "1");
+  EXPECT_FALSE(cache.Get(DBCache::USER, "b", value));
+  EXPECT_TRUE(cache.Get(DBCache::USER, "c", value));
+}
+
+TEST_F(DBCacheTest, Invalidation) {
+  DBCache cache(10, "host");
+  cache.Put(DBCache::ACCESS, DBCache::Key({"o", "l", "u1"}), "x", 0);
+  cache.Put(DBCache::ACCESS, DBCache::Key({"o", "l", "u2"}), "x", 0);
+  cache.Put(DBCache::ACCESS, DBCache::Key({"o", "l2", "u1"}), "x", 0);
+  cache.Put(DBCache::TASKLIST, DBCache::Key({"o", "l"}), "x", 0);
+
+  cache.ErasePrefix(DBCache::ACCESS, DBCache::Key({"o", "l"}));
+  std::string value;
+  EXPECT_FALSE(
+      cache.Get(DBCache::ACCESS, DBCache::Key({"o", "l", "u1"}), value));
+  EXPECT_FALSE(
+      cache.Get(DBCache::ACCESS, DBCache::Key({"o", "l", "u2"}), value));
+  EXPECT_TRUE(
+      cache.Get(DBCache::ACCESS, DBCache::Key({"o", "l2", "u1"}), value));
+  EXPECT_TRUE(cache.Get(DBCache::TASKLIST, DBCache::Key({"o", "l"}), value));
+
+  // a value read before an invalidation is not cached
+  uint64_t generation = cache.Generation();
+  cache.Erase(DBCache::TASKLIST, DBCache::Key({"o", "l"}));
+  cache.Put(DBCache::TASKLIST, DBCache::Key({"o", "l"}), "stale", generation);
+  EXPECT_FALSE(cache.Get(DBCache::TASKLIST, DBCache::Key({"o", "l"}), value));
+
+  cache.Clear();
+  EXPECT_EQ(cache.Size(), 0);
+}
+
+TEST_F(DBCacheTest, SnapshotRoundTrip) {
+  DBCache cache(10, "host");
+  cache.Put(DBCache::USER, DBCache::Key({"a"}), "1", 0);
+  cache.Put(DBCache::PUBLIC, "", DBCache::Encode({{"a", "l"}}), 0);
+  cache.Put(DBCache::USER, DBCache::Key({"b"}), "2", 0);
+  ASSERT_EQ(cache.Save(path), SUCCESS);
+
+  DBCache loaded(10, "host");
+  loaded.Put(DBCache::USER, DBCache::Key({"a"}), "fresh", 0);
+  ASSERT_EQ(loaded.Load(path), SUCCESS);
+  EXPECT_EQ(loaded.Size(), 3);
+  std::string value;
+
+  EXPECT_TRUE(loaded.Get(DBCache::USER, DBCache::Key({"a"}), value));
+  EXPECT_EQ(value, "fresh");
+  EXPECT_TRUE(loaded.Get(DBCache::PUBLIC, "", value));
+  EXPECT_EQ(DBCache::Decode(value).size(), 1);
+
+  // the entries already present are not revalidated, most recent first
+  auto unverified = loaded.TakeUnverified();
+  ASSERT_EQ(unverified.size(), 2);
+  EXPECT_EQ(unverified[0].first, DBCache::USER);
+  EXPECT_EQ(unverified[0].second, DBCache::Key({"b"}));
+  EXPECT_EQ(unverified[1].first, DBCache::PUBLIC);
+  EXPECT_TRUE(loaded.TakeUnverified().empty());
+}
+
+TEST_F(DBCacheTest, SnapshotLeavesSecretsOut) {
+  DBCache cache(10, "host");
+  cache.Put(DBCache::USER, DBCache::Key({"a"}),
+            DBCache::Encode({{"email", "a"}, {"passwd", "secret"}}), 0);
+  cache.Put(DBCache::ACCESS, DBCache::Key({"b", "l", "a"}), "x", 0);
+  ASSERT_EQ(cache.Save(path), SUCCESS);
+
+  std::ifstream file(path, std::ios::binary);
+  std::string contents((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+  EXPECT_EQ(contents.find("secret"), std::string::npos);
+
+  DBCache loaded(10, "host");
+  ASSERT_EQ(loaded.Load(path), SUCCESS);
+  EXPECT_EQ(loaded.Size(), 1);
+  std::string value;
+  EXPECT_FALSE(
+      loaded.Get(DBCache::ACCESS, DBCache::Key({"b", "l", "a"}), value));
+  ASSERT_TRUE(loaded.Get(DBCache::USER, DBCache::Key({"a"}), value));
+  EXPECT_EQ(DBCache::Decode(value),
+            (std::vector<std::pair<std::string, std::string>>{{"email", "a"}}));
+}
+
+TEST_F(DBCacheTest, RejectsBadSnapshots) {
+  DBCache cache(10, "host");
+  EXPECT_EQ(cache.Load(path), ERR_NO_NODE);
+
+  cache.Put(DBCache::USER, DBCache::Key({"a"}), "1", 0);
+  ASSERT_EQ(cache.Save(path), SUCCESS);
+  DBCache other(10, "other host");
+  EXPECT_EQ(other.Load(path), ERR_FORMAT);
+
+  // flip the last byte of the payload
+  std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+  file.seekg(-1, std::ios::end);
+  char last = file.get();
+  file.seekp(-1, std::ios::end);
+  file.put(last ^ 1);
+  file.close();
+  DBCache corrupt(10, "host");
+  EXPECT_EQ(corrupt.Load(path), ERR_FORMAT);
+  EXPECT_EQ(corrupt.Size(), 0);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
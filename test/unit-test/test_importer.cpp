@@ -0,0 +1,261 @@
+#include <db/DB.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <import/importer.h>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+class MockedDB : public DB {
+public:
+  MOCK_METHOD(returnCode, importBatch, (std::vector<DBImportRecord> & records),
+              (override));
+  MOCK_METHOD(returnCode, createTaskNode,
+              (const std::string &user_pkey, const std::string &task_list_pkey,
+               (const std::map<std::string, std::string> &)task_info),
+              (override));
+
+  MOCK_METHOD(returnCode, getUserNode,
+              (const std::string &user_pkey,
+               (std::map<std::string, std::string> &)user_info),
+              (override));
+
+  MockedDB() : DB("testhost") {}
+};
+
+using namespace ::testing;
+
+class ImporterTest : public ::testing::Test {
+protected:
+  void SetUp() override { mockedDB = std::make_shared<MockedDB>(); }
+
+  /* Records every batch and writes all of them successfully */
+  void RecordBatches() {
+    EXPECT_CALL(*mockedDB, importBatch(_))
+        .WillRepeatedly([this](std::vector<DBImportRecord> &records) {
+          std::lock_guard<std::mutex> guard(lock);
+          batches.push_back(records);
+          for (auto &record : records) {
+            record.result = SUCCESS;
+          }
+          return SUCCESS;
+        });
+  }
+
+  std::shared_ptr<MockedDB> mockedDB;
+  std::mutex lock;
+  std::vector<std::vector<DBImportRecord>> batches;
+  ImportStats stats;
+};
+
+TEST_F(ImporterTest, ParsesLines) {
+  RecordBatches();
+  std::istringstream in(
+      R"({"type": "user", "data": {"email": "a@test.com", "passwd": "p"}})"
+      "\n"
+      R"({"type": "list", "data": {"name": "l0", "version": "3"}})"
+      "\n\n"
+      R"({"type": "task", "list": "l0", "data": {"name": "t0", "priority": 2}})"
+      "\n"
+      R"({"type": "grant", "list": "l0", "to": "b@test.com", )"
+      R"("read_write": true})"
+      "\n"
+      R"({"type": "list", "user": "b@test.com", "data": {"name": "l1"}})"
+      "\n"
+      "not json\n"
+      R"({"type": "unknown"})"
+      "\n");
+  Importer importer(mockedDB, 10, 2);
+  EXPECT_EQ(importer.Run(in, stats), SUCCESS);
+
+  EXPECT_EQ(stats.lines, 7);
+  EXPECT_EQ(stats.created, 5);
+  EXPECT_EQ(stats.failed, 2);
+  EXPECT_EQ(stats.duplicates, 0);
+  ASSERT_EQ(stats.errors.size(), 2);
+  EXPECT_EQ(stats.errors[0], "line 7: not a json object");
+
+  // one batch per kind, in dependency order
+  ASSERT_EQ(batches.size(), 4);
+  EXPECT_EQ(batches[0][0].kind, DBImportRecord::USER);
+  EXPECT_EQ(batches[0][0].info.at("email"), "a@test.com");
+  ASSERT_EQ(batches[1].size(), 2);
+  EXPECT_EQ(batches[1][0].user, "a@test.com");
+  EXPECT_EQ(batches[1][0].info.count("version"), 0);
+  EXPECT_EQ(batches[1][1].user, "b@test.com");
+  EXPECT_EQ(batches[2][0].kind, DBImportRecord::TASK);
+  EXPECT_EQ(batches[2][0].list, "l0");
+  EXPECT_EQ(batches[2][0].info.at("priority"), "2");
+  EXPECT_EQ(batches[3][0].kind, DBImportRecord::ACCESS);
+  EXPECT_EQ(batches[3][0].dst_user, "b@test.com");
+  EXPECT_TRUE(batches[3][0].read_write);
+}
+
+TEST_F(ImporterTest, BatchesInDependencyOrder) {
+  RecordBatches();
+  std::string input =
+      R"({"type": "user", "data": {"email": "a@test.com", "passwd": "p"}})"
+      "\n";
+  for (int list = 0; list < 5; list++) {
+    input += R"({"type": "list", "data": {"name": "l)" +
+             std::to_string(list) + "\"}}\n";
+    for (int task = 0; task < 7; task++) {
+      input += R"({"type": "task", "list": "l)" + std::to_string(list) +
+               R"(", "data": {"name": "t)" + std::to_string(task) + "\"}}\n";
+    }
+  }
+  std::istringstream in(input);
+  Importer importer(mockedDB, 3, 4);
+  EXPECT_EQ(importer.Run(in, stats), SUCCESS);
+  EXPECT_EQ(stats.created, 41);
+
+  // no task is written before its task list
+  std::set<std::string> lists;
+  size_t records = 0;
+  for (auto &batch : batches) {
+    EXPECT_LE(batch.size(), 3);
+    for (auto &record : batch) {
+      records++;
+      if (record.kind == DBImportRecord::TASKLIST) {
+        lists.insert(record.info.at("name"));
+      } else if (record.kind == DBImportRecord::TASK) {
+        EXPECT_EQ(lists.count(record.list), 1);
+      }
+    }
+  }
+  EXPECT_EQ(records, 41);
+}
+
+TEST_F(ImporterTest, ReportsDuplicates) {
+  // the batch fails as a whole, the records are written one by one
+  EXPECT_CALL(*mockedDB, importBatch(_)).WillOnce(Return(ERR_UNKNOWN));
+  EXPECT_CALL(*mockedDB, createTaskNode("a@test.com", "l0", _))
+      .WillOnce(Return(SUCCESS))
+      .WillOnce(Return(ERR_DUP_NODE));
+  std::istringstream in(
+      R"({"type": "task", "user": "a@test.com", "list": "l0", )"
+      R"("data": {"name": "t0"}})"
+      "\n"
+      R"({"type": "task", "user": "a@test.com", "list": "l0", )"
+      R"("data": {"name": "t1"}})"
+      "\n");
+  Importer importer(mockedDB);
+  // only the tasks written are handed on
+  std::vector<std::string> written;
+  importer.SetOnTask([this, &written](const DBImportRecord &task) {
+    std::lock_guard<std::mutex> guard(lock);
+    written.push_back(task.info.at("name"));
+  });
+  EXPECT_EQ(importer.Run(in, stats), SUCCESS);
+  EXPECT_EQ(stats.created, 1);
+  EXPECT_EQ(stats.duplicates, 1);
+  ASSERT_EQ(stats.errors.size(), 1);
+  EXPECT_EQ(stats.errors[0], "line 2: duplicate");
+  EXPECT_EQ(written, std::vector<std::string>({"t0"}));
+
+  // a record the DB cannot write makes the import fail
+  EXPECT_CALL(*mockedDB, importBatch(_)).WillOnce(Return(ERR_UNKNOWN));
+  EXPECT_CALL(*mockedDB, createTaskNode(_, _, _))
+      .WillOnce(Return(ERR_UNKNOWN));
+  std::istringstream again(
+      R"({"type": "task", "user": "a@test.com", "list": "l0", )"
+      R"("data": {"name": "t2"}})"
+      "\n");
+  EXPECT_EQ(importer.Run(again, stats), ERR_UNKNOWN);
+  EXPECT_EQ(stats.failed, 1);
+}
+
+TEST_F(ImporterTest, OwnerOnly) {
+  RecordBatches();
+  std::istringstream in(
+      R"({"type": "user", "data": {"email": "a@test.com", "passwd": "p"}})"
+      "\n"
+      R"({"type": "list", "user": "b@test.com", "data": {"name": "l0"}})"
+      "\n");
+  Importer importer(mockedDB);
+  importer.SetOwner("owner@test.com");
+  EXPECT_EQ(importer.Run(in, stats), SUCCESS);
+  EXPECT_EQ(stats.skipped, 1);
+  EXPECT_EQ(stats.created, 1);
+  ASSERT_EQ(batches.size(), 1);
+  EXPECT_EQ(batches[0][0].user, "owner@test.com");
+}
+
+TEST_F(ImporterTest, UserWithoutPassword) {
+  RecordBatches();
+  // as exported: an existing user is left as it is, any other one is up to
+  // the DB, which refuses it
+  EXPECT_CALL(*mockedDB, getUserNode("a@test.com", _))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_CALL(*mockedDB, getUserNode("b@test.com", _))
+      .WillOnce(Return(ERR_NO_NODE));
+  std::istringstream in(
+      R"({"type": "user", "data": {"email": "a@test.com"}})"
+      "\n"
+      R"({"type": "list", "data": {"name": "l0"}})"
+      "\n"
+      R"({"type": "user", "data": {"email": "b@test.com"}})"
+      "\n");
+  Importer importer(mockedDB);
+  EXPECT_EQ(importer.Run(in, stats), SUCCESS);
+  EXPECT_EQ(stats.skipped, 1);
+  EXPECT_EQ(stats.created, 2);
+  ASSERT_EQ(batches.size(), 2);
+  EXPECT_EQ(batches[0][0].kind, DBImportRecord::USER);
+  EXPECT_EQ(batches[0][0].info.at("email"), "b@test.com");
+  EXPECT_EQ(batches[1][0].user, "a@test.com");
+}
+
+TEST_F(ImporterTest, ChecksTasksAsCreate) {
+  RecordBatches();
+  std::istringstream in(
+      R"({"type": "list", "user": "a@test.com", "data": {"name": "l0", )"
+      R"("id": 4, "counts": [1, 0, 0, 0, 0, 0, 0, 0]}})"
+      "\n"
+      R"({"type": "list", "user": "a@test.com", "data": {"name": "l1", )"
+      R"("visibility": "everyone"}})"
+      "\n"
+      R"({"type": "task", "user": "a@test.com", "list": "l0", "data": )"
+      R"({"name": "t0", "startDate": "1/2/2024", "endDate": "1/5/2024", )"
+      R"("recurrence": "FREQ=WEEKLY", "id": 7, "position": "V", )"
+      R"("due": "1999-01-01", "doneAt": "2024-01-01", )"
+      R"("occurrence_of": "x"}})"
+      "\n"
+      R"({"type": "task", "user": "a@test.com", "list": "l0", )"
+      R"("data": {"name": "t1", "priority": "abc"}})"
+      "\n"
+      R"({"type": "task", "user": "a@test.com", "list": "l0", )"
+      R"("data": {"name": "t2", "recurrence": "FREQ=DAILY"}})"
+      "\n"
+      R"({"type": "task", "user": "a@test.com", "list": "l0", )"
+      R"("data": {"name": "t3", "startDate": "1/5/2024", )"
+      R"("endDate": "1/2/2024"}})"
+      "\n"
+      R"({"type": "task", "user": "a@test.com", "list": "l0", )"
+      R"("data": {"name": "t4", "priority": 7}})"
+      "\n");
+  Importer importer(mockedDB);
+  EXPECT_EQ(importer.Run(in, stats), SUCCESS);
+  EXPECT_EQ(stats.created, 2);
+  EXPECT_EQ(stats.failed, 5);
+  ASSERT_EQ(stats.errors.size(), 5);
+  EXPECT_EQ(stats.errors[0], "line 2: invalid task list");
+  EXPECT_EQ(stats.errors[1], "line 4: invalid task");
+
+  // only what the workers write, with the sortable end date
+  ASSERT_EQ(batches.size(), 2);
+  EXPECT_EQ(batches[0][0].info,
+            (std::map<std::string, std::string>{{"name", "l0"}}));
+  EXPECT_EQ(batches[1][0].info,
+            (std::map<std::string, std::string>{{"name", "t0"},
+                                                {"startDate", "1/2/2024"},
+                                                {"endDate", "1/5/2024"},
+                                                {"due", "2024-01-05"},
+                                                {"recurrence", "FREQ=WEEKLY"}}));
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,61 @@
+#include "common/profiler.h"
+#include <chrono>
+#include <gtest/gtest.h>
+#include <string>
+
+/* Exported and not inlined so that the profile can name it */
+__attribute__((noinline)) uint64_t ProfilerTestSpin(int milliseconds) {
+  const auto end = std::chrono::steady_clock::now() +
+                   std::chrono::milliseconds(milliseconds);
+  volatile uint64_t sum = 0;
+  while (std::chrono::steady_clock::now() < end) {
+    sum = sum + 1;
+  }
+  return sum;
+}
+
+TEST(ProfilerTest, StopWithoutStart) {
+  EXPECT_FALSE(Profiler::Running());
+  EXPECT_EQ(Profiler::Stop(), "");
+}
+
+TEST(ProfilerTest, InvalidRate) {
+  EXPECT_FALSE(Profiler::Start(0));
+  EXPECT_FALSE(Profiler::Start(100000));
+  EXPECT_FALSE(Profiler::Running());
+}
+
+TEST(ProfilerTest, OneProfileAtATime) {
+  ASSERT_TRUE(Profiler::Start(99));
+  EXPECT_TRUE(Profiler::Running());
+  EXPECT_FALSE(Profiler::Start(99));
+  Profiler::Stop();
+  EXPECT_FALSE(Profiler::Running());
+}
+
+TEST(ProfilerTest, CollapsedStacks) {
+  ASSERT_TRUE(Profiler::Start(1000));
+  ProfilerTestSpin(300);
+  const std::string collapsed = Profiler::Stop();
+
+  EXPECT_NE(collapsed.find("ProfilerTestSpin"), std::string::npos);
+  // every line is "frame;frame;... count"
+  size_t begin = 0;
+  while (begin < collapsed.size()) {
+    size_t end = collapsed.find('\n', begin);
+    ASSERT_NE(end, std::string::npos);
+    const std::string line = collapsed.substr(begin, end - begin);
+    const size_t space = line.find_last_of(' ');
+    ASSERT_NE(space, std::string::npos);
+    EXPECT_GT(std::stoi(line.substr(space + 1)), 0);
+    begin = end + 1;
+  }
+
+  // the timer is disarmed, burning more CPU must not raise SIGPROF
+  ProfilerTestSpin(50);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,121 @@
+#include "common/recurrence.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using Days = std::vector<std::string>;
+
+TEST(RecurrenceTest, Days) {
+  long days = -1;
+  EXPECT_TRUE(Common::DaysFromKey("1970-01-01", days));
+  EXPECT_EQ(days, 0);
+  EXPECT_TRUE(Common::DaysFromKey("2000-03-01", days));
+  EXPECT_EQ(Common::KeyFromDays(days - 1), "2000-02-29");
+  // from 0001-01-01 on
+  for (long day = -719162; day < 800000; day += 997) {
+    long back = 0;
+    ASSERT_TRUE(Common::DaysFromKey(Common::KeyFromDays(day), back));
+    EXPECT_EQ(back, day);
+  }
+  EXPECT_FALSE(Common::DaysFromKey("2022-02-29", days));
+  EXPECT_FALSE(Common::DaysFromKey("2022-13-01", days));
+  EXPECT_FALSE(Common::DaysFromKey("11/29/2022", days));
+  EXPECT_EQ(Common::DateFromKey("2022-11-29"), "11/29/2022");
+}
+
+TEST(RecurrenceTest, Parse) {
+  Common::Recurrence rule;
+  EXPECT_TRUE(rule.Parse("FREQ=DAILY"));
+  EXPECT_EQ(rule.freq, Common::Recurrence::DAILY);
+  EXPECT_EQ(rule.interval, 1);
+  EXPECT_TRUE(rule.Parse("RRULE:FREQ=WEEKLY;INTERVAL=2;BYDAY=MO,TH"));
+  EXPECT_EQ(rule.freq, Common::Recurrence::WEEKLY);
+  EXPECT_EQ(rule.interval, 2);
+  EXPECT_EQ(rule.byday, 1 | 8);
+  EXPECT_TRUE(rule.Parse("FREQ=MONTHLY;UNTIL=20231231T235959Z"));
+  EXPECT_EQ(rule.until, "2023-12-31");
+  EXPECT_TRUE(rule.Parse("FREQ=YEARLY;COUNT=3"));
+  EXPECT_EQ(rule.count, 3);
+
+  EXPECT_FALSE(rule.Parse(""));
+  EXPECT_FALSE(rule.Parse("INTERVAL=2"));
+  EXPECT_FALSE(rule.Parse("FREQ=HOURLY"));
+  EXPECT_FALSE(rule.Parse("FREQ=DAILY;INTERVAL=0"));
+  EXPECT_FALSE(rule.Parse("FREQ=DAILY;INTERVAL=-1"));
+  EXPECT_FALSE(rule.Parse("FREQ=DAILY;FREQ=WEEKLY"));
+  EXPECT_FALSE(rule.Parse("FREQ=DAILY;COUNT=2;UNTIL=20231231"));
+  EXPECT_FALSE(rule.Parse("FREQ=DAILY;UNTIL=20230230"));
+  EXPECT_FALSE(rule.Parse("FREQ=DAILY;BYDAY=MO"));
+  EXPECT_FALSE(rule.Parse("FREQ=WEEKLY;BYDAY=1MO"));
+  EXPECT_FALSE(rule.Parse("FREQ=MONTHLY;BYMONTHDAY=1"));
+  EXPECT_FALSE(rule.Parse("FREQ=DAILY;"));
+}
+
+TEST(RecurrenceTest, Daily) {
+  Common::Recurrence rule;
+  ASSERT_TRUE(rule.Parse("FREQ=DAILY;INTERVAL=3"));
+  EXPECT_EQ(rule.Occurrences("2022-11-01", "2022-11-05", "2022-11-12", 10),
+            Days({"2022-11-07", "2022-11-10"}));
+  // nothing before the first occurrence
+  EXPECT_EQ(rule.Occurrences("2022-11-01", "2022-10-01", "2022-11-04", 10),
+            Days({"2022-11-01", "2022-11-04"}));
+  EXPECT_EQ(rule.Occurrences("2022-11-01", "2022-11-01", "2022-12-31", 2),
+            Days({"2022-11-01", "2022-11-04"}));
+  // far windows are not walked to
+  EXPECT_EQ(rule.Occurrences("2022-11-01", "9999-12-25", "9999-12-31", 10),
+            Days({"9999-12-26", "9999-12-29"}));
+
+  ASSERT_TRUE(rule.Parse("FREQ=DAILY;COUNT=4"));
+  EXPECT_EQ(rule.Occurrences("2022-11-01", "2022-11-03", "2022-11-30", 10),
+            Days({"2022-11-03", "2022-11-04"}));
+  ASSERT_TRUE(rule.Parse("FREQ=DAILY;UNTIL=20221102"));
+  EXPECT_EQ(rule.Occurrences("2022-11-01", "2022-11-01", "2022-11-30", 10),
+            Days({"2022-11-01", "2022-11-02"}));
+}
+
+TEST(RecurrenceTest, Weekly) {
+  Common::Recurrence rule;
+  // 2022-11-02 is a Wednesday
+  ASSERT_TRUE(rule.Parse("FREQ=WEEKLY"));
+  EXPECT_EQ(rule.Occurrences("2022-11-02", "2022-11-03", "2022-11-20", 10),
+            Days({"2022-11-09", "2022-11-16"}));
+
+  ASSERT_TRUE(rule.Parse("FREQ=WEEKLY;INTERVAL=2;BYDAY=MO,WE,FR"));
+  EXPECT_EQ(rule.Occurrences("2022-11-02", "2022-10-01", "2022-11-30", 10),
+            Days({"2022-11-02", "2022-11-04", "2022-11-14", "2022-11-16",
+                  "2022-11-18", "2022-11-28", "2022-11-30"}));
+
+  // the count starts at the first occurrence, also from a later window
+  ASSERT_TRUE(rule.Parse("FREQ=WEEKLY;BYDAY=MO,WE,FR;COUNT=5"));
+  EXPECT_EQ(rule.Occurrences("2022-11-02", "2022-11-02", "2022-12-31", 10),
+            Days({"2022-11-02", "2022-11-04", "2022-11-07", "2022-11-09",
+                  "2022-11-11"}));
+  EXPECT_EQ(rule.Occurrences("2022-11-02", "2022-11-08", "2022-12-31", 10),
+            Days({"2022-11-09", "2022-11-11"}));
+  EXPECT_EQ(rule.Occurrences("2022-11-02", "2022-11-14", "2022-12-31", 10),
+            Days());
+}
+
+TEST(RecurrenceTest, MonthlyAndYearly) {
+  Common::Recurrence rule;
+  // months without the day are skipped
+  ASSERT_TRUE(rule.Parse("FREQ=MONTHLY"));
+  EXPECT_EQ(rule.Occurrences("2023-01-31", "2023-01-01", "2023-05-31", 10),
+            Days({"2023-01-31", "2023-03-31", "2023-05-31"}));
+  ASSERT_TRUE(rule.Parse("FREQ=MONTHLY;INTERVAL=12"));
+  EXPECT_EQ(rule.Occurrences("2023-02-28", "2023-01-01", "2025-12-31", 10),
+            Days({"2023-02-28", "2024-02-28", "2025-02-28"}));
+
+  ASSERT_TRUE(rule.Parse("FREQ=YEARLY"));
+  EXPECT_EQ(rule.Occurrences("2020-02-29", "2020-01-01", "2028-12-31", 10),
+            Days({"2020-02-29", "2024-02-29", "2028-02-29"}));
+  // up to the limit
+  ASSERT_TRUE(rule.Parse("FREQ=MONTHLY;INTERVAL=12"));
+  EXPECT_EQ(rule.Occurrences("2021-03-31", "2021-01-01", "2099-12-31", 2),
+            Days({"2021-03-31", "2022-03-31"}));
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
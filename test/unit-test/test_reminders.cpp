@@ -0,0 +1,303 @@
+#include <common/recurrence.h>
+#include <common/utils.h>
+#include <db/DB.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <reminders/reminderScheduler.h>
+#include <reminders/timerWheel.h>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::Field;
+using ::testing::Pointee;
+using ::testing::Return;
+using ::testing::SetArgReferee;
+
+using Fired = std::vector<std::pair<std::string, uint64_t>>;
+
+TEST(TimerWheelTest, FiresInOrder) {
+  TimerWheel wheel(1000);
+  Fired fired;
+  wheel.Schedule("c", 1000 + 70000);
+  wheel.Schedule("a", 1005);
+  wheel.Schedule("b", 1300);
+  EXPECT_EQ(wheel.Size(), 3);
+
+  wheel.Advance(1004, fired);
+  EXPECT_TRUE(fired.empty());
+  wheel.Advance(1005, fired);
+  EXPECT_EQ(fired, Fired({{"a", 1005}}));
+  fired.clear();
+  wheel.Advance(1000 + 70000, fired);
+  EXPECT_EQ(fired, Fired({{"b", 1300}, {"c", 71000}}));
+  EXPECT_EQ(wheel.Size(), 0);
+  EXPECT_EQ(wheel.Now(), 71000);
+}
+
+TEST(TimerWheelTest, ScheduleAndCancel) {
+  TimerWheel wheel(0);
+  Fired fired;
+  uint64_t when = 0;
+  wheel.Schedule("x", 10);
+  wheel.Schedule("y", 10);
+  // a key has one timer, the last one set
+  wheel.Schedule("x", 20);
+  EXPECT_TRUE(wheel.When("x", when));
+  EXPECT_EQ(when, 20);
+  EXPECT_TRUE(wheel.Cancel("y"));
+  EXPECT_FALSE(wheel.Cancel("y"));
+  EXPECT_FALSE(wheel.When("y", when));
+
+  wheel.Advance(15, fired);
+  EXPECT_TRUE(fired.empty());
+  // a tick that passed fires on the next advance, as scheduled
+  wheel.Schedule("z", 3);
+  wheel.Advance(20, fired);
+  EXPECT_EQ(fired, Fired({{"z", 3}, {"x", 20}}));
+
+  // far timers are kept too
+  wheel.Schedule("far", 20 + ((uint64_t)1 << 38));
+  EXPECT_TRUE(wheel.When("far", when));
+  EXPECT_EQ(when, 20 + ((uint64_t)1 << 38));
+  EXPECT_TRUE(wheel.Cancel("far"));
+}
+
+TEST(TimerWheelTest, CancelPrefix) {
+  TimerWheel wheel(0);
+  Fired fired;
+  wheel.Schedule("a/1", 10);
+  wheel.Schedule("a/2", 1000);
+  wheel.Schedule("ab", 10);
+  wheel.Schedule("b/1", 10);
+  EXPECT_EQ(wheel.CancelPrefix("a/"), 2);
+  EXPECT_EQ(wheel.CancelPrefix("a/"), 0);
+  EXPECT_EQ(wheel.Size(), 2);
+
+  wheel.Advance(1000, fired);
+  EXPECT_EQ(fired, Fired({{"ab", 10}, {"b/1", 10}}));
+}
+
+TEST(TimerWheelTest, CascadesAcrossLevels) {
+  // start right before the upper levels roll over
+  const uint64_t start = ((uint64_t)1 << 32) - 300000;
+  TimerWheel wheel(start);
+  std::vector<uint64_t> ticks;
+  uint64_t seed = 12345;
+  for (int i = 0; i < 5000; i++) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    const uint64_t when = start + 1 + (seed >> 33) % 600000;
+    ticks.push_back(when);
+    wheel.Schedule("t" + std::to_string(i), when);
+  }
+  // cancel every tenth
+  for (int i = 0; i < 5000; i += 10) {
+    EXPECT_TRUE(wheel.Cancel("t" + std::to_string(i)));
+  }
+
+  Fired fired;
+  uint64_t last = start;
+  size_t count = 0;
+  for (uint64_t now = start; now < start + 600000 + 997; now += 997) {
+    fired.clear();
+    wheel.Advance(now, fired);
+    for (const auto &timer : fired) {
+      const int i = std::stoi(timer.first.substr(1));
+      EXPECT_NE(i % 10, 0);
+      EXPECT_EQ(timer.second, ticks[i]);
+      // in order, and by the advance that reached them
+      EXPECT_GE(timer.second, last);
+      EXPECT_LE(timer.second, now);
+      EXPECT_GT(timer.second, now - 997);
+      last = timer.second;
+      count++;
+    }
+  }
+  EXPECT_EQ(count, 4500);
+  EXPECT_EQ(wheel.Size(), 0);
+}
+
+class MockedDB : public DB {
+public:
+  MOCK_METHOD(returnCode, getOpenDueTasks,
+              (const std::string &from, const DBAgendaTask *after,
+               size_t limit, std::vector<DBAgendaTask> &tasks),
+              (override));
+  MOCK_METHOD(returnCode, getTaskNodes,
+              (const std::string &dst_user_pkey,
+               const std::vector<DBTaskKey> &keys,
+               std::vector<returnCode> &results,
+               (std::vector<std::map<std::string, std::string>> &)task_infos),
+              (override));
+};
+
+/* Keeps what it is sent */
+class RecordingSink : public ReminderSink {
+public:
+  void Send(const std::vector<Reminder> &reminders) override {
+    sent.insert(sent.end(), reminders.begin(), reminders.end());
+  }
+  std::vector<Reminder> sent;
+};
+
+static std::string Tomorrow() {
+  long today = 0;
+  Common::DaysFromKey(Common::Today(), today);
+  return Common::KeyFromDays(today + 1);
+}
+
+TEST(ReminderSchedulerTest, FiresOnTheDueDay) {
+  const std::string tomorrow = Tomorrow();
+  uint64_t start = 0;
+  ASSERT_TRUE(ReminderScheduler::DayStart(tomorrow, start));
+  EXPECT_FALSE(ReminderScheduler::DayStart("11/29/2022", start));
+  EXPECT_FALSE(ReminderScheduler::DayStart("2022-02-30", start));
+
+  ReminderScheduler reminders;
+  auto sink = std::make_shared<RecordingSink>();
+  // ticked by hand
+  reminders.Start(sink, std::chrono::hours(1), std::chrono::hours(24));
+  std::string due;
+  reminders.Set("user0", "list0", "done", tomorrow);
+  reminders.Set("user0", "list0", "report", tomorrow);
+  reminders.Set("user0", "list0", "undated", "");
+  EXPECT_EQ(reminders.Pending(), 2);
+  EXPECT_TRUE(reminders.Due("user0", "list0", "report", due));
+  EXPECT_EQ(due, tomorrow);
+  EXPECT_FALSE(reminders.Due("user0", "list0", "undated", due));
+  reminders.Cancel("user0", "list0", "done");
+  EXPECT_EQ(reminders.Pending(), 1);
+
+  // an hour ahead of the day
+  reminders.Fire(start - 3601);
+  EXPECT_TRUE(sink->sent.empty());
+  reminders.Fire(start - 3600);
+  ASSERT_EQ(sink->sent.size(), 1);
+  EXPECT_EQ(sink->sent[0].user, "user0");
+  EXPECT_EQ(sink->sent[0].list, "list0");
+  EXPECT_EQ(sink->sent[0].task, "report");
+  EXPECT_EQ(sink->sent[0].due, tomorrow);
+  EXPECT_EQ(reminders.Pending(), 0);
+}
+
+TEST(ReminderSchedulerTest, TaskLists) {
+  const std::string tomorrow = Tomorrow();
+  ReminderScheduler reminders;
+  std::string due;
+
+  // from the fields of a task
+  reminders.Update("user0", "list0", "a", {{"due", tomorrow}});
+  reminders.Update("user0", "list0", "b",
+                   {{"due", tomorrow}, {"status", "Done"}});
+  reminders.Update("user0", "list0", "c",
+                   {{"due", tomorrow}, {"recurrence", "FREQ=DAILY"}});
+  reminders.Update("user0", "list1", "a", {{"due", tomorrow}});
+  reminders.Update("user1", "list0", "a", {{"due", tomorrow}});
+  EXPECT_EQ(reminders.Pending(), 3);
+
+  // copies keep the end date of the tasks they copy
+  reminders.Copy("user0", "list0", "user1", "copy", {"a", "b"});
+  EXPECT_TRUE(reminders.Due("user1", "copy", "a", due));
+  EXPECT_EQ(due, tomorrow);
+  EXPECT_FALSE(reminders.Due("user1", "copy", "b", due));
+
+  // a task list, then a user
+  reminders.CancelAll("user0", "list0");
+  EXPECT_FALSE(reminders.Due("user0", "list0", "a", due));
+  EXPECT_TRUE(reminders.Due("user0", "list1", "a", due));
+  reminders.CancelAll("user1");
+  EXPECT_EQ(reminders.Pending(), 1);
+}
+
+TEST(ReminderSchedulerTest, FiresTasksAsStored) {
+  const std::string tomorrow = Tomorrow();
+  uint64_t start = 0;
+  ASSERT_TRUE(ReminderScheduler::DayStart(tomorrow, start));
+  long today = 0;
+  Common::DaysFromKey(Common::Today(), today);
+  const std::string later = Common::KeyFromDays(today + 2);
+
+  auto db = std::make_shared<MockedDB>();
+  ReminderScheduler reminders(db);
+  auto sink = std::make_shared<RecordingSink>();
+  reminders.Start(sink, std::chrono::seconds(0), std::chrono::hours(24));
+  for (const char *task : {"open", "gone", "done", "moved"})
+    reminders.Set("user0", "list0", task, tomorrow);
+  reminders.Set("user1", "list0", "open", tomorrow);
+
+  std::map<std::string, std::map<std::string, std::string>> stored = {
+      {"open", {{"due", tomorrow}}},
+      {"done", {{"due", tomorrow}, {"status", "Done"}}},
+      {"moved", {{"due", later}}}};
+  // one statement per owner, of its own tasks
+  EXPECT_CALL(*db, getTaskNodes("user0", _, _, _))
+      .WillOnce([&stored](const std::string &,
+                          const std::vector<DBTaskKey> &keys,
+                          std::vector<returnCode> &results,
+                          std::vector<std::map<std::string, std::string>>
+                              &task_infos) {
+        results.clear();
+        task_infos.clear();
+        for (const DBTaskKey &key : keys) {
+          auto task = stored.find(std::get<2>(key));
+          results.push_back(task == stored.end() ? ERR_NO_NODE : SUCCESS);
+          task_infos.push_back(task == stored.end()
+                                   ? std::map<std::string, std::string>()
+                                   : task->second);
+        }
+        return SUCCESS;
+      });
+  // not held back by a DB that cannot be read
+  EXPECT_CALL(*db, getTaskNodes("user1", _, _, _))
+      .WillOnce(Return(ERR_UNKNOWN));
+  reminders.Fire(start);
+
+  ASSERT_EQ(sink->sent.size(), 2);
+  std::set<std::string> sent;
+  for (const Reminder &reminder : sink->sent)
+    sent.insert(reminder.user + "/" + reminder.task);
+  EXPECT_EQ(sent, std::set<std::string>({"user0/open", "user1/open"}));
+  // the task due later is reminded of then
+  std::string due;
+  EXPECT_TRUE(reminders.Due("user0", "list0", "moved", due));
+  EXPECT_EQ(due, later);
+  EXPECT_EQ(reminders.Pending(), 1);
+}
+
+TEST(ReminderSchedulerTest, Load) {
+  const std::string tomorrow = Tomorrow();
+  MockedDB db;
+  ReminderScheduler reminders;
+  std::vector<DBAgendaTask> page(2);
+  page[0].user = "user0";
+  page[0].list = "list0";
+  page[0].task = "a";
+  page[0].due = tomorrow;
+  page[1] = page[0];
+  page[1].task = "b";
+  std::vector<DBAgendaTask> last(1, page[0]);
+  last[0].task = "c";
+
+  // pages go on after the last task of the previous one
+  EXPECT_CALL(db, getOpenDueTasks("2022-11-01", nullptr, 2, _))
+      .WillOnce(DoAll(SetArgReferee<3>(page), Return(SUCCESS)));
+  EXPECT_CALL(db, getOpenDueTasks("2022-11-01",
+                                  Pointee(Field(&DBAgendaTask::task, "b")), 2,
+                                  _))
+      .WillOnce(DoAll(SetArgReferee<3>(last), Return(SUCCESS)));
+  EXPECT_EQ(reminders.Load(db, "2022-11-01", 2), SUCCESS);
+  EXPECT_EQ(reminders.Pending(), 3);
+
+  EXPECT_CALL(db, getOpenDueTasks(_, nullptr, _, _))
+      .WillOnce(Return(ERR_UNKNOWN));
+  EXPECT_EQ(reminders.Load(db, "2022-11-01", 2), ERR_UNKNOWN);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,248 @@
+#include <chrono>
+#include <gtest/gtest.h>
+#include <search/nameTrie.h>
+#include <search/searchIndex.h>
+#include <string>
+#include <vector>
+
+/* A change of the feed of DB::getChangesSince */
+static DBChange Change(const std::string &list, const std::string &task,
+                       const std::string &content, bool deleted = false) {
+  DBChange change;
+  change.list = list;
+  change.task = task;
+  change.deleted = deleted;
+  if (!deleted) {
+    change.info = {{"name", task}, {"content", content}};
+  }
+  return change;
+}
+
+static std::vector<std::string> Tasks(const std::vector<SearchHit> &hits) {
+  std::vector<std::string> tasks;
+  for (const SearchHit &hit : hits) {
+    tasks.push_back(hit.task);
+  }
+  return tasks;
+}
+
+class SearchIndexTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    index.Apply("a", 0, 3,
+                {Change("work", "Write report", "quarterly numbers for Bob"),
+                 Change("work", "Call Bob", "about the report"),
+                 Change("home", "Groceries", "milk, eggs; report-card day")});
+  }
+
+  SearchIndex index;
+  const std::map<std::string, std::set<std::string>> all = {{"a", {}}};
+};
+
+TEST_F(SearchIndexTest, Tokenize) {
+  EXPECT_EQ(SearchIndex::Tokenize("Call BOB, re: Q3-report!"),
+            std::vector<std::string>({"call", "bob", "re", "q3", "report"}));
+  EXPECT_EQ(SearchIndex::Tokenize("café ok"),
+            std::vector<std::string>({"café", "ok"}));
+  EXPECT_TRUE(SearchIndex::Tokenize(" ,.- ").empty());
+}
+
+TEST_F(SearchIndexTest, MatchesEveryTerm) {
+  // a term in the name counts more than one in the content
+  EXPECT_EQ(
+      Tasks(index.Search("report", all, 10)),
+      std::vector<std::string>({"Write report", "Call Bob", "Groceries"}));
+  EXPECT_EQ(Tasks(index.Search("BOB report", all, 10)),
+            std::vector<std::string>({"Call Bob", "Write report"}));
+  EXPECT_TRUE(index.Search("report dentist", all, 10).empty());
+  EXPECT_TRUE(index.Search("", all, 10).empty());
+
+  // the best k only
+  EXPECT_EQ(Tasks(index.Search("report", all, 1)),
+            std::vector<std::string>({"Write report"}));
+}
+
+TEST_F(SearchIndexTest, Scope) {
+  EXPECT_EQ(Tasks(index.Search("report", {{"a", {"home"}}}, 10)),
+            std::vector<std::string>({"Groceries"}));
+  EXPECT_TRUE(index.Search("report", {{"b", {}}}, 10).empty());
+}
+
+TEST_F(SearchIndexTest, Updates) {
+  // writes of this process
+  index.Put("a", "work", "Call Bob", "about the budget");
+  index.Remove("a", "home", "Groceries");
+  EXPECT_EQ(Tasks(index.Search("report", all, 10)),
+            std::vector<std::string>({"Write report"}));
+  EXPECT_EQ(Tasks(index.Search("budget", all, 10)),
+            std::vector<std::string>({"Call Bob"}));
+
+  // a user that is not loaded is left to the next refresh
+  index.Put("b", "work", "Other report", "");
+  EXPECT_TRUE(index.Search("report", {{"b", {}}}, 10).empty());
+
+  // the change feed, a deleted task list takes its tasks along
+  long long since = -1;
+  EXPECT_FALSE(
+      index.NeedsRefresh("a", std::chrono::milliseconds(60000), since));
+  EXPECT_EQ(since, 3);
+  EXPECT_TRUE(index.NeedsRefresh("a", std::chrono::milliseconds(-1), since));
+  index.Apply("a", 3, 5,
+              {Change("work", "", "", true),
+               Change("work", "Write report", "again")});
+  EXPECT_EQ(Tasks(index.Search("report", all, 10)),
+            std::vector<std::string>({"Write report"}));
+  EXPECT_TRUE(index.Search("budget", all, 10).empty());
+
+  // changes read from an older version are ignored
+  index.Apply("a", 3, 6, {Change("work", "Stale", "report")});
+  EXPECT_EQ(index.Search("report", all, 10).size(), 1);
+  EXPECT_TRUE(index.NeedsRefresh("b", std::chrono::milliseconds(60000), since));
+  EXPECT_EQ(since, 0);
+
+  index.Drop("a");
+  EXPECT_TRUE(index.Search("report", all, 10).empty());
+}
+
+TEST_F(SearchIndexTest, CompactsRetiredDocuments) {
+  // every revision retires a document, the postings are rewritten on the way
+  for (int i = 0; i < 5000; i++) {
+    index.Put("a", "work", "Write report",
+              "draft " + std::to_string(i % 7 == 0 ? 0 : i));
+  }
+  std::vector<SearchHit> hits = index.Search("draft", all, 10);
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].task, "Write report");
+  EXPECT_EQ(Tasks(index.Search("draft 4999", all, 10)),
+            std::vector<std::string>({"Write report"}));
+  EXPECT_TRUE(index.Search("draft 0", all, 10).empty());
+  EXPECT_EQ(index.Search("report", all, 10).size(), 3);
+}
+
+TEST_F(SearchIndexTest, EvictsLeastRecentlyUsed) {
+  SearchIndex small(2);
+  small.Apply("a", 0, 1, {Change("l", "a task", "")});
+  small.Apply("b", 0, 1, {Change("l", "b task", "")});
+  // a is used, b is the least recently used
+  EXPECT_EQ(small.Search("task", {{"a", {}}}, 10).size(), 1);
+  small.Apply("c", 0, 1, {Change("l", "c task", "")});
+  long long since = 0;
+  const std::chrono::milliseconds minute(60000);
+  EXPECT_FALSE(small.NeedsRefresh("a", minute, since));
+  EXPECT_TRUE(small.NeedsRefresh("b", minute, since));
+  EXPECT_FALSE(small.NeedsRefresh("c", minute, since));
+}
+
+static std::vector<std::string> Names(const std::vector<NameHit> &hits) {
+  std::vector<std::string> names;
+  for (const NameHit &hit : hits) {
+    names.push_back(hit.task.empty() ? hit.list : hit.list + "/" + hit.task);
+  }
+  return names;
+}
+
+class NameTrieTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    // a task may come before its task list in the change feed
+    trie.Apply("a", 0, 5,
+               {Change("Work", "Report", ""), Change("Work", "", ""),
+                Change("Work", "repair bike", ""), Change("home", "", ""),
+                Change("home", "Rent", "")});
+  }
+
+  NameTrie trie;
+  const std::map<std::string, std::set<std::string>> all = {{"a", {}}};
+};
+
+TEST_F(NameTrieTest, CompletesPrefix) {
+  EXPECT_EQ(Names(trie.Complete("re", all, NameTrie::ALL, 10)),
+            std::vector<std::string>(
+                {"home/Rent", "Work/repair bike", "Work/Report"}));
+  // the prefix ends inside an edge, and case does not matter
+  EXPECT_EQ(Names(trie.Complete("REP", all, NameTrie::ALL, 10)),
+            std::vector<std::string>({"Work/repair bike", "Work/Report"}));
+  EXPECT_EQ(Names(trie.Complete("repo", all, NameTrie::ALL, 10)),
+            std::vector<std::string>({"Work/Report"}));
+  EXPECT_TRUE(trie.Complete("rex", all, NameTrie::ALL, 10).empty());
+  EXPECT_TRUE(trie.Complete("report card", all, NameTrie::ALL, 10).empty());
+  EXPECT_EQ(Names(trie.Complete("", all, NameTrie::LISTS, 10)),
+            std::vector<std::string>({"home", "Work"}));
+  EXPECT_EQ(Names(trie.Complete("w", all, NameTrie::TASKS, 10)),
+            std::vector<std::string>());
+  EXPECT_EQ(Names(trie.Complete("", all, NameTrie::ALL, 2)),
+            std::vector<std::string>({"home", "home/Rent"}));
+}
+
+TEST_F(NameTrieTest, Scope) {
+  trie.Apply("b", 0, 2, {Change("shared", "", ""), Change("shared", "Rest", ""),
+                         Change("private", "Resume", "")});
+  std::map<std::string, std::set<std::string>> scope = {{"a", {}},
+                                                        {"b", {"shared"}}};
+  std::vector<NameHit> hits = trie.Complete("res", scope, NameTrie::ALL, 10);
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].user, "b");
+  EXPECT_EQ(hits[0].task, "Rest");
+  // names of several owners are merged in name order
+  EXPECT_EQ(Names(trie.Complete("re", scope, NameTrie::TASKS, 10)),
+            std::vector<std::string>({"home/Rent", "Work/repair bike",
+                                      "Work/Report", "shared/Rest"}));
+}
+
+TEST_F(NameTrieTest, Updates) {
+  trie.Add("a", "Work", "Rent");
+  trie.Remove("a", "Work", "Report");
+  EXPECT_EQ(Names(trie.Complete("re", all, NameTrie::ALL, 10)),
+            std::vector<std::string>(
+                {"Work/Rent", "home/Rent", "Work/repair bike"}));
+
+  // deleting a task list deletes its tasks
+  trie.Remove("a", "Work");
+  EXPECT_EQ(Names(trie.Complete("", all, NameTrie::ALL, 10)),
+            std::vector<std::string>({"home", "home/Rent"}));
+  trie.Apply("a", 5, 7,
+             {Change("home", "Rent", "", true), Change("Work", "", "")});
+  EXPECT_EQ(Names(trie.Complete("", all, NameTrie::ALL, 10)),
+            std::vector<std::string>({"home", "Work"}));
+
+  // changes read from another version are ignored, users not loaded too
+  trie.Apply("a", 5, 8, {Change("home", "Rent", "")});
+  trie.Add("b", "home");
+  EXPECT_EQ(trie.Complete("", all, NameTrie::ALL, 10).size(), 2);
+  EXPECT_TRUE(trie.Complete("", {{"b", {}}}, NameTrie::ALL, 10).empty());
+
+  long long since = 0;
+  EXPECT_FALSE(trie.NeedsRefresh("a", std::chrono::milliseconds(60000), since));
+  EXPECT_EQ(since, 7);
+  trie.Drop("a");
+  EXPECT_TRUE(trie.NeedsRefresh("a", std::chrono::milliseconds(60000), since));
+  EXPECT_EQ(since, 0);
+}
+
+TEST_F(NameTrieTest, SplitsAndMergesEdges) {
+  NameTrie names;
+  names.Apply("a", 0, 1, {});
+  std::vector<std::string> added;
+  for (int i = 0; i < 200; i++) {
+    added.push_back("task " + std::to_string(i * 7919 % 1000));
+    names.Add("a", "l", added.back());
+  }
+  EXPECT_EQ(names.Complete("task 1", all, NameTrie::TASKS, 1000).size(), 22);
+  for (size_t i = 0; i < added.size(); i += 2) {
+    names.Remove("a", "l", added[i]);
+  }
+  std::vector<NameHit> hits = names.Complete("t", all, NameTrie::TASKS, 1000);
+  ASSERT_EQ(hits.size(), 100);
+  for (size_t i = 1; i < hits.size(); i++) {
+    EXPECT_LT(hits[i - 1].task, hits[i].task);
+  }
+  for (size_t i = 0; i < added.size(); i++) {
+    hits = names.Complete(added[i], all, NameTrie::TASKS, 1);
+    EXPECT_EQ(!hits.empty() && hits[0].task == added[i], i % 2 == 1);
+  }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
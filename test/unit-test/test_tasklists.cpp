@@ -16,6 +16,12 @@ public:
               (const std::string &user_pkey, const std::string &task_list_pkey,
                (std::map<std::string, std::string> &)task_list_info),
               (override));
+  MOCK_METHOD(returnCode, getTaskListNodeWithStats,
+              (const std::string &user_pkey, const std::string &task_list_pkey,
+               const std::string &today,
+               (std::map<std::string, std::string> &)task_list_info,
+               DBTaskListStats &stats),
+              (override));
   MOCK_METHOD(returnCode, deleteTaskListNode,
               (const std::string &user_pkey, const std::string &task_list_pkey),
               (override));
@@ -23,10 +29,22 @@ public:
               (const std::string &user_pkey, const std::string &task_list_pkey,
                (const std::map<std::string, std::string> &)task_list_info),
               (override));
+  MOCK_METHOD(returnCode, cloneTaskListNode,
+              (const std::string &user_pkey, const std::string &task_list_pkey,
+               const std::string &dst_user_pkey,
+               const std::string &dst_task_list_pkey,
+               std::string &out_task_list_pkey,
+               std::vector<std::string> &task_pkeys),
+              (override));
   MOCK_METHOD(returnCode, getAllTaskListNodes,
               (const std::string &user_pkey,
                std::vector<std::string> &outNames),
               (override));
+  MOCK_METHOD(returnCode, getTaskListStats,
+              (const std::string &user_pkey, const std::string &task_list_pkey,
+               const std::string &today,
+               (std::map<std::string, DBTaskListStats> &)stats),
+              (override));
   MOCK_METHOD(returnCode, addAccess,
               (const std::string &src_user_pkey,
                const std::string &dst_user_pkey,
@@ -52,6 +70,13 @@ public:
                const std::string &task_list_pkey,
                (std::map<std::string, bool> &)list_grants),
               (override));
+  MOCK_METHOD(returnCode, getChangesSince,
+              (const std::string &user_pkey, long long since,
+               long long &version, std::vector<DBChange> &changes),
+              (override));
+  MOCK_METHOD(returnCode, exportUser,
+              (const std::string &user_pkey, const DBExportCallback &emit),
+              (override));
   MOCK_METHOD(returnCode, getAllPublic,
               ((std::vector<std::pair<std::string, std::string>> &)user_list),
               (override));
@@ -253,9 +278,16 @@ TEST_F(TaskListTest, Delete) {
   data.tasklist_key = "tasklist0";
 
   // normal delete, should be successful
+  std::shared_ptr<ReminderScheduler> reminders = tasklistsWorker->Reminders();
+  reminders->Set("user0", "tasklist0", "task0", "2099-01-01");
+  reminders->Set("user0", "tasklist1", "task0", "2099-01-01");
   EXPECT_CALL(*mockedDB, deleteTaskListNode(data.user_key, data.tasklist_key))
       .WillOnce(Return(SUCCESS));
   EXPECT_EQ(tasklistsWorker->Delete(data), SUCCESS);
+  // the reminders of its tasks go with it
+  std::string due;
+  EXPECT_FALSE(reminders->Due("user0", "tasklist0", "task0", due));
+  EXPECT_TRUE(reminders->Due("user0", "tasklist1", "task0", due));
 
   // request tasklist_key is empty
   data.user_key = "user0";
@@ -353,6 +385,69 @@ TEST_F(TaskListTest, ReviseAccess) {
   EXPECT_EQ(tasklistsWorker->Revise(data, in), ERR_ACCESS);
 }
 
+TEST_F(TaskListTest, Clone) {
+  // setup input
+  data = RequestData("user0", "template0", "", "");
+  std::string outTasklistName;
+  std::vector<std::string> outTasks;
+  std::vector<std::string> tasks = {"task0", "task1"};
+  std::shared_ptr<ReminderScheduler> reminders = tasklistsWorker->Reminders();
+  std::string due;
+  reminders->Set("user0", "template0", "task0", "2099-01-01");
+  reminders->Set("user1", "template0", "task1", "2099-01-02");
+
+  // own tasklist, keeps the source name when no name is given
+  EXPECT_CALL(*mockedDB, cloneTaskListNode("user0", "template0", "user0",
+                                           "template0", _, _))
+      .WillOnce(DoAll(SetArgReferee<4>("template0(1)"),
+                      SetArgReferee<5>(tasks), Return(SUCCESS)));
+  EXPECT_EQ(tasklistsWorker->Clone(data, "", outTasklistName, outTasks),
+            SUCCESS);
+  EXPECT_EQ(outTasklistName, "template0(1)");
+  EXPECT_EQ(outTasks, tasks);
+  // the copies are reminded of like the tasks they copy
+  EXPECT_TRUE(reminders->Due("user0", "template0(1)", "task0", due));
+  EXPECT_EQ(due, "2099-01-01");
+  EXPECT_FALSE(reminders->Due("user0", "template0(1)", "task1", due));
+
+  // another user's tasklist with read permission, retried on a race for
+  // the name
+  data.other_user_key = "user1";
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "template0", _))
+      .WillOnce(DoAll(SetArgReferee<3>(false), Return(SUCCESS)));
+  EXPECT_CALL(*mockedDB, cloneTaskListNode("user1", "template0", "user0",
+                                           "week", _, _))
+      .WillOnce(Return(ERR_DUP_NODE))
+      .WillOnce(DoAll(SetArgReferee<4>("week"), SetArgReferee<5>(tasks),
+                      Return(SUCCESS)));
+  EXPECT_EQ(tasklistsWorker->Clone(data, "week", outTasklistName, outTasks),
+            SUCCESS);
+  EXPECT_EQ(outTasklistName, "week");
+  EXPECT_TRUE(reminders->Due("user0", "week", "task1", due));
+  EXPECT_EQ(due, "2099-01-02");
+
+  // no access
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "template0", _))
+      .WillOnce(Return(ERR_ACCESS));
+  EXPECT_EQ(tasklistsWorker->Clone(data, "week", outTasklistName, outTasks),
+            ERR_ACCESS);
+  EXPECT_EQ(outTasklistName, "");
+  EXPECT_TRUE(outTasks.empty());
+
+  // no such tasklist
+  data.other_user_key = "";
+  EXPECT_CALL(*mockedDB, cloneTaskListNode("user0", "template0", "user0",
+                                           "template0", _, _))
+      .WillOnce(Return(ERR_NO_NODE));
+  EXPECT_EQ(tasklistsWorker->Clone(data, "", outTasklistName, outTasks),
+            ERR_NO_NODE);
+
+  // request tasklist_key is empty
+  data.tasklist_key = "";
+  EXPECT_EQ(tasklistsWorker->Clone(data, "", outTasklistName, outTasks),
+            ERR_RFIELD);
+}
+
 TEST_F(TaskListTest, GetAllTasklist) {
   // setup input
   data.user_key = "user0";
@@ -372,6 +467,78 @@ TEST_F(TaskListTest, GetAllTasklist) {
   EXPECT_EQ(tasklistsWorker->GetAllTasklist(data, outNames), ERR_RFIELD);
 }
 
+TEST_F(TaskListTest, Stats) {
+  // setup input
+  data.user_key = "user0";
+  std::map<std::string, DBTaskListStats> stats;
+  std::map<std::string, DBTaskListStats> newStats;
+  newStats["tasklist0"].total = 3;
+  newStats["tasklist0"].status[2] = 1;
+  newStats["tasklist1"].overdue = 2;
+
+  // all tasklists of the user, counted as of today
+  EXPECT_CALL(*mockedDB,
+              getTaskListStats(data.user_key, "", Common::Today(), _))
+      .WillOnce(DoAll(SetArgReferee<3>(newStats), Return(SUCCESS)));
+  EXPECT_EQ(tasklistsWorker->Stats(data, stats), SUCCESS);
+  ASSERT_EQ(stats.size(), 2);
+  EXPECT_EQ(stats["tasklist0"].total, 3);
+  EXPECT_EQ(stats["tasklist0"].status[2], 1);
+  EXPECT_EQ(stats["tasklist1"].overdue, 2);
+
+  // someone else's tasklist needs access to it
+  data.other_user_key = "user1";
+  data.tasklist_key = "tasklist0";
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist0", _))
+      .WillOnce(Return(ERR_ACCESS))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasklistsWorker->Stats(data, stats), ERR_ACCESS);
+  EXPECT_CALL(*mockedDB, getTaskListStats("user1", "tasklist0", _, _))
+      .WillOnce(Return(ERR_NO_NODE));
+  EXPECT_EQ(tasklistsWorker->Stats(data, stats), ERR_NO_NODE);
+
+  // someone else's tasklists are only counted one at a time
+  data.tasklist_key = "";
+  EXPECT_EQ(tasklistsWorker->Stats(data, stats), ERR_RFIELD);
+
+  // request user_key empty
+  data.user_key = "";
+  EXPECT_EQ(tasklistsWorker->Stats(data, stats), ERR_RFIELD);
+}
+
+TEST_F(TaskListTest, QueryWithStats) {
+  // setup input
+  data.user_key = "user0";
+  data.tasklist_key = "tasklist0";
+  TasklistContent out;
+  DBTaskListStats stats;
+  std::map<std::string, std::string> info = {{"name", "tasklist0"},
+                                             {"content", "content0"}};
+  DBTaskListStats newStats;
+  newStats.total = 3;
+  newStats.overdue = 1;
+
+  // the tasklist and its counts, as of today, in one read
+  EXPECT_CALL(*mockedDB, getTaskListNodeWithStats("user0", "tasklist0",
+                                                  Common::Today(), _, _))
+      .WillOnce(DoAll(SetArgReferee<3>(info), SetArgReferee<4>(newStats),
+                      Return(SUCCESS)));
+  EXPECT_EQ(tasklistsWorker->QueryWithStats(data, out, stats), SUCCESS);
+  EXPECT_EQ(out.content, "content0");
+  EXPECT_EQ(stats.total, 3);
+  EXPECT_EQ(stats.overdue, 1);
+
+  // someone else's tasklist needs access to it
+  data.other_user_key = "user1";
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist0", _))
+      .WillOnce(Return(ERR_ACCESS));
+  EXPECT_EQ(tasklistsWorker->QueryWithStats(data, out, stats), ERR_ACCESS);
+
+  // request tasklist_key empty
+  data.tasklist_key = "";
+  EXPECT_EQ(tasklistsWorker->QueryWithStats(data, out, stats), ERR_RFIELD);
+}
+
 TEST_F(TaskListTest, GetAllAccessTaskList) {
   // setup input
   data.user_key = "user";
@@ -678,6 +845,150 @@ TEST_F(TaskListTest, GetAllPublicTaskList) {
   EXPECT_EQ(out_list, new_out_list);
 }
 
+TEST_F(TaskListTest, Sync) {
+  // setup input
+  data.user_key = "user0";
+  long long version = 0;
+  std::vector<DBChange> changes;
+  std::vector<DBChange> new_changes(2);
+  new_changes[0].list = "tasklist0";
+  new_changes[0].version = 4;
+  new_changes[1].list = "tasklist0";
+  new_changes[1].task = "task0";
+  new_changes[1].deleted = true;
+  new_changes[1].version = 5;
+
+  // normal call, should be successful
+  EXPECT_CALL(*mockedDB, getChangesSince(data.user_key, 3, _, _))
+      .WillOnce(DoAll(SetArgReferee<2>(5), SetArgReferee<3>(new_changes),
+                      Return(SUCCESS)));
+  EXPECT_EQ(tasklistsWorker->Sync(data, 3, version, changes), SUCCESS);
+  EXPECT_EQ(version, 5);
+  ASSERT_EQ(changes.size(), 2);
+  EXPECT_TRUE(changes[1].deleted);
+
+  // unknown user
+  EXPECT_CALL(*mockedDB, getChangesSince(data.user_key, 0, _, _))
+      .WillOnce(DoAll(SetArgReferee<3>(new_changes), Return(ERR_NO_NODE)));
+  EXPECT_EQ(tasklistsWorker->Sync(data, 0, version, changes), ERR_NO_NODE);
+  EXPECT_TRUE(changes.empty());
+
+  // negative version
+  EXPECT_EQ(tasklistsWorker->Sync(data, -1, version, changes), ERR_FORMAT);
+
+  // no user key
+  data.user_key = "";
+  EXPECT_EQ(tasklistsWorker->Sync(data, 0, version, changes), ERR_RFIELD);
+}
+
+TEST_F(TaskListTest, Export) {
+  // setup input
+  data.user_key = "user0";
+  int count = 0;
+  DBExportCallback emit = [&count](const std::string &, const std::string &,
+                                   const std::map<std::string, std::string> &) {
+    count++;
+    return true;
+  };
+  std::vector<std::string> grants;
+  ExportGrantCallback grant = [&grants](const std::string &list,
+                                        const std::string &to,
+                                        bool read_write) {
+    grants.push_back(list + " " + to + (read_write ? " rw" : " r"));
+    return true;
+  };
+  std::map<std::string, bool> list_grants = {{"user1", true},
+                                             {"user2", false}};
+
+  // normal call, every node reaches the callback, then the grants of the
+  // shared tasklists
+  EXPECT_CALL(*mockedDB, exportUser(data.user_key, _))
+      .WillOnce([](const std::string &, const DBExportCallback &emit) {
+        emit("", "", {{"email", "user0"}});
+        emit("tasklist0", "", {{"name", "tasklist0"}});
+        emit("tasklist0", "task0", {{"name", "task0"}});
+        emit("tasklist1", "",
+             {{"name", "tasklist1"}, {"visibility", "shared"}});
+        return SUCCESS;
+      });
+  EXPECT_CALL(*mockedDB, allGrant(data.user_key, "tasklist1", _))
+      .WillOnce(DoAll(SetArgReferee<2>(list_grants), Return(SUCCESS)));
+  EXPECT_EQ(tasklistsWorker->Export(data, emit, grant), SUCCESS);
+  EXPECT_EQ(count, 4);
+  EXPECT_EQ(grants, std::vector<std::string>(
+                        {"tasklist1 user1 rw", "tasklist1 user2 r"}));
+
+  // unknown user
+  EXPECT_CALL(*mockedDB, exportUser(data.user_key, _))
+      .WillOnce(Return(ERR_NO_NODE));
+  EXPECT_EQ(tasklistsWorker->Export(data, emit, grant), ERR_NO_NODE);
+
+  // no user key
+  data.user_key = "";
+  EXPECT_EQ(tasklistsWorker->Export(data, emit, grant), ERR_RFIELD);
+}
+
+TEST_F(TaskListTest, Autocomplete) {
+  // setup input
+  data.user_key = "user0";
+  std::vector<RequestData> out_names;
+  std::map<std::pair<std::string, std::string>, bool> accesses = {
+      {{"user1", "shared0"}, false}};
+  std::vector<DBChange> own_changes(2), other_changes(3);
+  own_changes[0].list = "Groceries";
+  own_changes[1].list = "Groceries";
+  own_changes[1].task = "grapes";
+  other_changes[0].list = "shared0";
+  other_changes[1].list = "shared0";
+  other_changes[1].task = "Gift";
+  other_changes[2].list = "private0";
+  other_changes[2].task = "gym";
+
+  // first call loads the owners, tasklists of other users only if shared
+  EXPECT_CALL(*mockedDB, allAccess(data.user_key, _))
+      .WillRepeatedly(DoAll(SetArgReferee<1>(accesses), Return(SUCCESS)));
+  EXPECT_CALL(*mockedDB, getChangesSince("user0", 0, _, _))
+      .WillOnce(DoAll(SetArgReferee<2>(2), SetArgReferee<3>(own_changes),
+                      Return(SUCCESS)));
+  EXPECT_CALL(*mockedDB, getChangesSince("user1", 0, _, _))
+      .WillOnce(DoAll(SetArgReferee<2>(3), SetArgReferee<3>(other_changes),
+                      Return(SUCCESS)));
+  EXPECT_EQ(tasklistsWorker->Autocomplete(data, "g", NameTrie::ALL, 10,
+                                          out_names),
+            SUCCESS);
+  ASSERT_EQ(out_names.size(), 3);
+  EXPECT_EQ(out_names[0].other_user_key, "user1");
+  EXPECT_EQ(out_names[0].task_key, "Gift");
+  EXPECT_EQ(out_names[1].tasklist_key, "Groceries");
+  EXPECT_EQ(out_names[1].task_key, "grapes");
+  EXPECT_EQ(out_names[2].task_key, "");
+
+  // creations and deletions of this process show up right away
+  EXPECT_CALL(*mockedDB, createTaskListNode(data.user_key, _))
+      .WillOnce(Return(SUCCESS));
+  std::string outTasklistName;
+  in.name = "Garden";
+  EXPECT_EQ(tasklistsWorker->Create(data, in, outTasklistName), SUCCESS);
+  data.tasklist_key = "Groceries";
+  EXPECT_CALL(*mockedDB, deleteTaskListNode(data.user_key, "Groceries"))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasklistsWorker->Delete(data), SUCCESS);
+  EXPECT_EQ(tasklistsWorker->Autocomplete(data, "G", NameTrie::LISTS, 10,
+                                          out_names),
+            SUCCESS);
+  ASSERT_EQ(out_names.size(), 1);
+  EXPECT_EQ(out_names[0].tasklist_key, "Garden");
+
+  // no prefix, or no user key
+  EXPECT_EQ(
+      tasklistsWorker->Autocomplete(data, "", NameTrie::ALL, 10, out_names),
+      ERR_RFIELD);
+  data.user_key = "";
+  EXPECT_EQ(
+      tasklistsWorker->Autocomplete(data, "g", NameTrie::ALL, 10, out_names),
+      ERR_RFIELD);
+}
+
 TEST_F(TaskListTest, Exists) {
   // setup input
   data.user_key = "user0";
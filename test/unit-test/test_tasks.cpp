@@ -22,20 +22,86 @@ public:
               (const std::string &user_pkey, const std::string &task_list_pkey,
                const std::string &task_pkey),
               (override));
+  MOCK_METHOD(returnCode, moveTaskNode,
+              (const std::string &user_pkey, const std::string &task_list_pkey,
+               const std::string &task_pkey, const std::string &dst_user_pkey,
+               const std::string &dst_task_list_pkey,
+               const std::string &dst_task_pkey,
+               (std::map<std::string, std::string> &)task_info),
+              (override));
+  MOCK_METHOD(returnCode, reorderTaskNode,
+              (const std::string &user_pkey, const std::string &task_list_pkey,
+               const std::string &task_pkey, const std::string &anchor_pkey,
+               bool after, std::string &position),
+              (override));
+  MOCK_METHOD(returnCode, addDependency,
+              (const std::string &user_pkey, const std::string &task_list_pkey,
+               const std::string &task_pkey, const std::string &on_task_pkey),
+              (override));
+  MOCK_METHOD(returnCode, removeDependency,
+              (const std::string &user_pkey, const std::string &task_list_pkey,
+               const std::string &task_pkey, const std::string &on_task_pkey),
+              (override));
+  MOCK_METHOD(returnCode, getTaskGraph,
+              (const std::string &user_pkey, const std::string &task_list_pkey,
+               std::vector<DBGraphTask> &tasks),
+              (override));
   MOCK_METHOD(returnCode, reviseTaskNode,
               (const std::string &user_pkey, const std::string &task_list_pkey,
                const std::string &task_pkey,
-               (const std::map<std::string, std::string>)&task_info),
+               (const std::map<std::string, std::string>)&task_info,
+               (std::map<std::string, std::string> *)revised),
               (override));
   MOCK_METHOD(returnCode, getAllTaskNodes,
               (const std::string &user_pkey, const std::string &task_list_pkey,
                std::vector<std::string> &task_info),
               (override));
+  MOCK_METHOD(returnCode, getArchivedTaskNodes,
+              (const std::string &user_pkey, const std::string &task_list_pkey,
+               const std::string &task_pkey,
+               (std::vector<std::map<std::string, std::string>> &)task_infos),
+              (override));
+  MOCK_METHOD(returnCode, getTaskRevisions,
+              (const std::string &user_pkey, const std::string &task_list_pkey,
+               const std::string &task_pkey, long long after, long long before,
+               size_t limit, (std::map<std::string, std::string> &)task_info,
+               std::vector<DBTaskRevision> &revisions),
+              (override));
   MOCK_METHOD(returnCode, checkAccess,
               (const std::string &src_user_pkey,
                const std::string &dst_user_pkey,
                const std::string &task_list_pkey, bool &read_write),
               (override));
+  MOCK_METHOD(returnCode, getTaskNodes,
+              (const std::string &dst_user_pkey,
+               const std::vector<DBTaskKey> &keys,
+               std::vector<returnCode> &results,
+               (std::vector<std::map<std::string, std::string>> &)task_infos),
+              (override));
+  MOCK_METHOD(returnCode, getAgenda,
+              (const std::string &user_pkey, const std::string &from,
+               const std::string &to, const DBAgendaTask *after, size_t limit,
+               std::vector<DBAgendaTask> &tasks,
+               std::vector<DBRecurringTask> &repeating),
+              (override));
+  MOCK_METHOD(returnCode, getOpenDueTasks,
+              (const std::string &from, const DBAgendaTask *after,
+               size_t limit, std::vector<DBAgendaTask> &tasks),
+              (override));
+  MOCK_METHOD(returnCode, getBoard,
+              (const std::string &user_pkey, const std::string &task_list_pkey,
+               const std::string &status, size_t offset, size_t limit,
+               std::vector<DBBoardColumn> &columns),
+              (override));
+  MOCK_METHOD(
+      returnCode, allAccess,
+      (const std::string &dst_user_pkey,
+       (std::map<std::pair<std::string, std::string>, bool> &)list_accesses),
+      (override));
+  MOCK_METHOD(returnCode, getChangesSince,
+              (const std::string &user_pkey, long long since,
+               long long &version, std::vector<DBChange> &changes),
+              (override));
   MockedDB() : DB("testhost") {}
 };
 
@@ -204,6 +270,348 @@ TEST_F(TasksWorkerTest, Query) {
   EXPECT_EQ(out.status, "");
 }
 
+// QueryMany Function
+TEST_F(TasksWorkerTest, QueryMany) {
+  std::vector<RequestData> reqs = {
+      RequestData("user0", "tasklist0", "task0", ""),
+      RequestData("user0", "tasklist1", "task1", "user1"),
+      RequestData("user0", "tasklist1", "", "user1"),
+      RequestData("user0", "tasklist2", "task2", "user1"),
+  };
+  std::vector<returnCode> results;
+  std::vector<TaskContent> outs;
+  std::vector<std::map<std::string, std::string>> task_infos = {
+      {{"name", "task0"}, {"priority", "1"}},
+      {{"name", "task1"}, {"status", "To Do"}},
+      {}};
+
+  // one DB call for the complete requests, the owner as the key
+  std::vector<DBTaskKey> keys = {DBTaskKey("user0", "tasklist0", "task0"),
+                                 DBTaskKey("user1", "tasklist1", "task1"),
+                                 DBTaskKey("user1", "tasklist2", "task2")};
+  EXPECT_CALL(*mockedDB, getTaskNodes("user0", keys, _, _))
+      .WillOnce(DoAll(SetArgReferee<2>(std::vector<returnCode>(
+                          {SUCCESS, SUCCESS, ERR_ACCESS})),
+                      SetArgReferee<3>(task_infos), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->QueryMany(reqs, results, outs), SUCCESS);
+  EXPECT_EQ(results, std::vector<returnCode>(
+                         {SUCCESS, SUCCESS, ERR_RFIELD, ERR_ACCESS}));
+  ASSERT_EQ(outs.size(), 4);
+  EXPECT_EQ(outs[0].name, "task0");
+  EXPECT_EQ(outs[0].priority, VERY_URGENT);
+  EXPECT_EQ(outs[1].name, "task1");
+  EXPECT_EQ(outs[1].status, "To Do");
+  EXPECT_EQ(outs[2].name, "");
+  EXPECT_EQ(outs[3].name, "");
+
+  // DB failure
+  EXPECT_CALL(*mockedDB, getTaskNodes(_, _, _, _))
+      .WillOnce(Return(ERR_UNKNOWN));
+  EXPECT_EQ(tasksWorker->QueryMany(reqs, results, outs), ERR_UNKNOWN);
+
+  // nothing complete to ask the DB for
+  EXPECT_EQ(tasksWorker->QueryMany({reqs[2]}, results, outs), SUCCESS);
+  EXPECT_EQ(results, std::vector<returnCode>({ERR_RFIELD}));
+
+  // requests of different users, or no request at all
+  reqs[1].user_key = "user1";
+  EXPECT_EQ(tasksWorker->QueryMany(reqs, results, outs), ERR_RFIELD);
+  EXPECT_EQ(tasksWorker->QueryMany({}, results, outs), ERR_RFIELD);
+}
+
+// Agenda Function
+TEST_F(TasksWorkerTest, Agenda) {
+  data = RequestData("user0", "", "", "");
+  std::string cursor;
+  std::vector<std::pair<RequestData, TaskContent>> tasks;
+  std::vector<DBAgendaTask> page(3);
+  for (int i = 0; i < 3; i++) {
+    page[i].user = i == 1 ? "user1" : "user0";
+    page[i].list = "tasklist" + std::to_string(i);
+    page[i].task = "task" + std::to_string(i);
+    page[i].due = "2022-11-0" + std::to_string(i + 1);
+    page[i].rank = 1;
+    page[i].info = {{"name", page[i].task},
+                    {"endDate", "11/0" + std::to_string(i + 1) + "/2022"}};
+  }
+
+  // dates reach the DB in their sortable form, one task more than a page
+  EXPECT_CALL(*mockedDB,
+              getAgenda("user0", "2022-11-01", "2022-11-30", nullptr, 3, _, _))
+      .WillOnce(DoAll(SetArgReferee<5>(page), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->Agenda(data, "11/1/2022", "11/30/2022", 2, cursor,
+                                tasks),
+            SUCCESS);
+  ASSERT_EQ(tasks.size(), 2);
+  EXPECT_EQ(tasks[0].first.tasklist_key, "tasklist0");
+  EXPECT_EQ(tasks[0].first.other_user_key, "");
+  EXPECT_EQ(tasks[0].second.endDate, "11/01/2022");
+  EXPECT_EQ(tasks[1].first.task_key, "task1");
+  EXPECT_EQ(tasks[1].first.other_user_key, "user1");
+  EXPECT_FALSE(cursor.empty());
+
+  // the cursor resumes after the last task of the page
+  EXPECT_CALL(*mockedDB, getAgenda("user0", _, _, NotNull(), 3, _, _))
+      .WillOnce([&](const std::string &, const std::string &,
+                    const std::string &, const DBAgendaTask *after, size_t,
+                    std::vector<DBAgendaTask> &out,
+                    std::vector<DBRecurringTask> &) {
+        EXPECT_EQ(after->user, "user1");
+        EXPECT_EQ(after->list, "tasklist1");
+        EXPECT_EQ(after->task, "task1");
+        EXPECT_EQ(after->due, "2022-11-02");
+        EXPECT_EQ(after->rank, 1);
+        out.assign(page.begin() + 2, page.end());
+        return SUCCESS;
+      });
+  EXPECT_EQ(tasksWorker->Agenda(data, "11/1/2022", "11/30/2022", 2, cursor,
+                                tasks),
+            SUCCESS);
+  ASSERT_EQ(tasks.size(), 1);
+  EXPECT_TRUE(cursor.empty());
+
+  // bad input never reaches the DB
+  EXPECT_EQ(tasksWorker->Agenda(data, "", "11/30/2022", 2, cursor, tasks),
+            ERR_RFIELD);
+  EXPECT_EQ(tasksWorker->Agenda(data, "2022-11-01", "11/30/2022", 2, cursor,
+                                tasks),
+            ERR_FORMAT);
+  EXPECT_EQ(tasksWorker->Agenda(data, "12/1/2022", "11/30/2022", 2, cursor,
+                                tasks),
+            ERR_FORMAT);
+  EXPECT_EQ(tasksWorker->Agenda(data, "11/1/2022", "11/30/2022", 0, cursor,
+                                tasks),
+            ERR_FORMAT);
+  cursor = "zz";
+  EXPECT_EQ(tasksWorker->Agenda(data, "11/1/2022", "11/30/2022", 2, cursor,
+                                tasks),
+            ERR_FORMAT);
+  data.user_key = "";
+  cursor.clear();
+  EXPECT_EQ(tasksWorker->Agenda(data, "11/1/2022", "11/30/2022", 2, cursor,
+                                tasks),
+            ERR_RFIELD);
+}
+
+// Agenda of repeating tasks
+TEST_F(TasksWorkerTest, AgendaRecurring) {
+  data = RequestData("user0", "", "", "");
+  std::string cursor;
+  std::vector<std::pair<RequestData, TaskContent>> tasks;
+  std::vector<DBAgendaTask> page(1);
+  page[0].user = "user0";
+  page[0].list = "tasklist0";
+  page[0].task = "report";
+  page[0].due = "2022-11-03";
+  page[0].rank = 1;
+  page[0].info = {{"name", "report"}, {"endDate", "11/03/2022"}};
+  std::vector<DBRecurringTask> repeating(1);
+  repeating[0].user = "user0";
+  repeating[0].list = "tasklist0";
+  repeating[0].task = "standup";
+  repeating[0].due = "2022-11-01";
+  repeating[0].rank = 4;
+  repeating[0].info = {{"name", "standup"},
+                       {"recurrence", "FREQ=DAILY"},
+                       {"startDate", "10/31/2022"},
+                       {"endDate", "11/01/2022"},
+                       {"due", "2022-11-01"}};
+  repeating[0].done = {"2022-11-02"};
+
+  // occurrences are merged in order, but for the completed one
+  EXPECT_CALL(*mockedDB, getAgenda("user0", "2022-11-01", "2022-11-04",
+                                   nullptr, 4, _, _))
+      .WillOnce(DoAll(SetArgReferee<5>(page), SetArgReferee<6>(repeating),
+                      Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->Agenda(data, "11/1/2022", "11/4/2022", 3, cursor,
+                                tasks),
+            SUCCESS);
+  ASSERT_EQ(tasks.size(), 3);
+  EXPECT_EQ(tasks[0].first.task_key, "standup");
+  EXPECT_EQ(tasks[0].second.endDate, "11/01/2022");
+  EXPECT_EQ(tasks[1].first.task_key, "report");
+  EXPECT_EQ(tasks[2].first.task_key, "standup");
+  EXPECT_EQ(tasks[2].second.startDate, "11/02/2022");
+  EXPECT_EQ(tasks[2].second.endDate, "11/03/2022");
+  EXPECT_EQ(tasks[2].second.recurrence, "FREQ=DAILY");
+  EXPECT_FALSE(cursor.empty());
+
+  // the next page starts after the occurrence the last one ended with
+  EXPECT_CALL(*mockedDB, getAgenda("user0", _, _, NotNull(), 4, _, _))
+      .WillOnce(DoAll(SetArgReferee<6>(repeating), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->Agenda(data, "11/1/2022", "11/4/2022", 3, cursor,
+                                tasks),
+            SUCCESS);
+  ASSERT_EQ(tasks.size(), 1);
+  EXPECT_EQ(tasks[0].second.endDate, "11/04/2022");
+  EXPECT_TRUE(cursor.empty());
+}
+
+// Complete Function
+TEST_F(TasksWorkerTest, Complete) {
+  data = RequestData("user0", "tasklist0", "standup", "");
+  std::string name;
+  std::map<std::string, std::string> task_info;
+  std::map<std::string, std::string> template_info = {
+      {"name", "standup"},       {"content", "what I did"},
+      {"recurrence", "FREQ=WEEKLY"}, {"startDate", "10/31/2022"},
+      {"endDate", "11/01/2022"}, {"due", "2022-11-01"}};
+  std::map<std::string, std::string> occurrence = {
+      {"name", "standup@2022-11-08"}, {"occurrence_of", "standup"},
+      {"content", "what I did"},      {"status", "Done"},
+      {"startDate", "11/07/2022"},    {"endDate", "11/08/2022"},
+      {"due", "2022-11-08"}};
+
+  // the occurrence becomes a task, completing it again changes nothing
+  EXPECT_CALL(*mockedTaskLists, Exists(_)).WillRepeatedly(Return(true));
+  EXPECT_CALL(*mockedDB, getTaskNode(data.user_key, data.tasklist_key,
+                                     data.task_key, task_info))
+      .WillRepeatedly(DoAll(SetArgReferee<3>(template_info), Return(SUCCESS)));
+  EXPECT_CALL(*mockedDB,
+              createTaskNode(data.user_key, data.tasklist_key, occurrence))
+      .WillOnce(Return(SUCCESS))
+      .WillOnce(Return(ERR_DUP_NODE));
+  EXPECT_EQ(tasksWorker->Complete(data, "11/8/2022", name), SUCCESS);
+  EXPECT_EQ(name, "standup@2022-11-08");
+  EXPECT_EQ(tasksWorker->Complete(data, "11/8/2022", name), SUCCESS);
+  EXPECT_EQ(name, "standup@2022-11-08");
+
+  // not a day of the task, or not a date
+  EXPECT_EQ(tasksWorker->Complete(data, "11/9/2022", name), ERR_FORMAT);
+  EXPECT_EQ(name, "");
+  EXPECT_EQ(tasksWorker->Complete(data, "10/25/2022", name), ERR_FORMAT);
+  EXPECT_EQ(tasksWorker->Complete(data, "2022-11-08", name), ERR_FORMAT);
+  EXPECT_EQ(tasksWorker->Complete(data, "", name), ERR_RFIELD);
+
+  // the task does not repeat
+  data.task_key = "report";
+  template_info.erase("recurrence");
+  EXPECT_CALL(*mockedDB, getTaskNode(data.user_key, data.tasklist_key,
+                                     data.task_key, task_info))
+      .WillOnce(DoAll(SetArgReferee<3>(template_info), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->Complete(data, "11/8/2022", name), ERR_FORMAT);
+
+  // read only permission cannot complete
+  data.other_user_key = "user1";
+  bool permission = false;
+  EXPECT_CALL(*mockedDB, checkAccess(data.other_user_key, data.user_key,
+                                     data.tasklist_key, permission))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->Complete(data, "11/8/2022", name), ERR_ACCESS);
+}
+
+// Board Function
+TEST_F(TasksWorkerTest, Board) {
+  data = RequestData("user0", "tasklist0", "", "");
+  std::vector<BoardColumn> columns;
+  std::vector<DBBoardColumn> db_columns(2);
+  db_columns[0].status = "Done";
+  db_columns[0].total = 7;
+  db_columns[0].tasks = {{{"name", "task0"}, {"status", "Done"}}};
+  db_columns[1].status = "To Do";
+  db_columns[1].total = 1;
+  db_columns[1].tasks = {{{"name", "task1"}}};
+
+  // all three columns in board order, also the empty one
+  EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(true));
+  EXPECT_CALL(*mockedDB, getBoard("user0", "tasklist0", "", 5, 10, _))
+      .WillOnce(DoAll(SetArgReferee<5>(db_columns), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->Board(data, "", 5, 10, columns), SUCCESS);
+  ASSERT_EQ(columns.size(), 3);
+  EXPECT_EQ(columns[0].status, "To Do");
+  EXPECT_EQ(columns[0].total, 1);
+  ASSERT_EQ(columns[0].tasks.size(), 1);
+  EXPECT_EQ(columns[0].tasks[0].name, "task1");
+  EXPECT_EQ(columns[1].status, "Doing");
+  EXPECT_EQ(columns[1].total, 0);
+  EXPECT_TRUE(columns[1].tasks.empty());
+  EXPECT_EQ(columns[2].status, "Done");
+  EXPECT_EQ(columns[2].total, 7);
+  EXPECT_EQ(columns[2].tasks[0].status, "Done");
+
+  // one column of others' task list
+  data.other_user_key = "user1";
+  bool permission = false;
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist0", permission))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_CALL(*mockedDB, getBoard("user1", "tasklist0", "Doing", 0, 10, _))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->Board(data, "Doing", 0, 10, columns), SUCCESS);
+  ASSERT_EQ(columns.size(), 1);
+  EXPECT_EQ(columns[0].status, "Doing");
+
+  // no access
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist0", permission))
+      .WillOnce(Return(ERR_ACCESS));
+  EXPECT_EQ(tasksWorker->Board(data, "", 0, 10, columns), ERR_ACCESS);
+  EXPECT_TRUE(columns.empty());
+
+  // bad input
+  EXPECT_EQ(tasksWorker->Board(data, "Later", 0, 10, columns), ERR_FORMAT);
+  EXPECT_EQ(tasksWorker->Board(data, "", 0, 0, columns), ERR_FORMAT);
+  data.tasklist_key = "";
+  EXPECT_EQ(tasksWorker->Board(data, "", 0, 10, columns), ERR_RFIELD);
+
+  // tasklist does not exist
+  data = RequestData("user0", "tasklist0", "", "");
+  EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(false));
+  EXPECT_EQ(tasksWorker->Board(data, "", 0, 10, columns), ERR_NO_NODE);
+}
+
+TEST_F(TasksWorkerTest, Search) {
+  data.user_key = "user0";
+  std::vector<std::pair<RequestData, double>> hits;
+  std::map<std::pair<std::string, std::string>, bool> accesses = {
+      {{"user1", "shared"}, false}};
+  DBChange own;
+  own.list = "tasklist0";
+  own.task = "own report";
+  own.version = 2;
+  own.info = {{"name", "own report"}, {"content", "numbers"}};
+  DBChange other = own;
+  other.list = "shared";
+  other.task = "shared report";
+  DBChange hidden = own;
+  hidden.list = "private";
+  hidden.task = "private report";
+
+  // the owners are loaded from their change feed on the first search
+  EXPECT_CALL(*mockedDB, allAccess("user0", _))
+      .Times(2)
+      .WillRepeatedly(DoAll(SetArgReferee<1>(accesses), Return(SUCCESS)));
+  EXPECT_CALL(*mockedDB, getChangesSince("user0", 0, _, _))
+      .WillOnce(DoAll(SetArgReferee<2>(2),
+                      SetArgReferee<3>(std::vector<DBChange>({own})),
+                      Return(SUCCESS)));
+  EXPECT_CALL(*mockedDB, getChangesSince("user1", 0, _, _))
+      .WillOnce(DoAll(SetArgReferee<2>(2),
+                      SetArgReferee<3>(std::vector<DBChange>({other, hidden})),
+                      Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->Search(data, "Report", 10, hits), SUCCESS);
+  ASSERT_EQ(hits.size(), 2);
+  std::map<std::string, std::string> owners;
+  for (auto &hit : hits) {
+    owners[hit.first.task_key] = hit.first.other_user_key;
+  }
+  EXPECT_EQ(owners["own report"], "");
+  EXPECT_EQ(owners["shared report"], "user1");
+
+  // writes through the worker are searchable right away, without a refresh
+  EXPECT_CALL(*mockedTaskLists, Exists(_)).WillOnce(Return(true));
+  EXPECT_CALL(*mockedDB, createTaskNode("user0", "tasklist0", _))
+      .WillOnce(Return(SUCCESS));
+  RequestData create_data("user0", "tasklist0", "", "");
+  std::string name;
+  in = TaskContent("budget", "report draft", "", "", NULL_PRIORITY, "");
+  EXPECT_EQ(tasksWorker->Create(create_data, in, name), SUCCESS);
+  EXPECT_EQ(tasksWorker->Search(data, "draft", 10, hits), SUCCESS);
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].first.task_key, "budget");
+
+  // no words to search for
+  EXPECT_EQ(tasksWorker->Search(data, " ?! ", 10, hits), ERR_RFIELD);
+}
+
 TEST_F(TasksWorkerTest, Create) {
   // setup input
   data = RequestData("user0", "tasklist0", "", "");
@@ -215,6 +623,7 @@ TEST_F(TasksWorkerTest, Create) {
   task_info["content"] = in.content;
   task_info["startDate"] = in.startDate;
   task_info["endDate"] = in.endDate;
+  task_info["due"] = "2022-11-29";
   task_info["priority"] = std::to_string(in.priority);
   task_info["status"] = in.status;
 
@@ -350,6 +759,114 @@ TEST_F(TasksWorkerTest, Create) {
   EXPECT_EQ(outTaskName, "");
 }
 
+// Reminders kept up to date by the writes
+TEST_F(TasksWorkerTest, Reminders) {
+  data = RequestData("user0", "tasklist0", "", "");
+  std::string name, due;
+  std::shared_ptr<ReminderScheduler> reminders = tasksWorker->Reminders();
+  EXPECT_CALL(*mockedTaskLists, Exists(_)).WillRepeatedly(Return(true));
+  EXPECT_CALL(*mockedDB, createTaskNode("user0", "tasklist0", _))
+      .WillRepeatedly(Return(SUCCESS));
+
+  // only open tasks with an end date have one
+  in = TaskContent();
+  in.name = "report";
+  in.startDate = "11/01/2099";
+  in.endDate = "11/29/2099";
+  EXPECT_EQ(tasksWorker->Create(data, in, name), SUCCESS);
+  EXPECT_TRUE(reminders->Due("user0", "tasklist0", "report", due));
+  EXPECT_EQ(due, "2099-11-29");
+  in.name = "done";
+  in.status = "Done";
+  EXPECT_EQ(tasksWorker->Create(data, in, name), SUCCESS);
+  in.name = "undated";
+  in.status = "";
+  in.startDate = "";
+  in.endDate = "";
+  EXPECT_EQ(tasksWorker->Create(data, in, name), SUCCESS);
+  EXPECT_EQ(reminders->Pending(), 1);
+
+  // a new end date moves it, done drops it, as the task is once revised
+  data.task_key = "report";
+  in = TaskContent();
+  in.startDate = "11/01/2099";
+  in.endDate = "12/01/2099";
+  std::map<std::string, std::string> revised = {{"name", "report"},
+                                                {"due", "2099-12-01"}};
+  EXPECT_CALL(*mockedDB, reviseTaskNode("user0", "tasklist0", "report", _, _))
+      .WillOnce(DoAll(SetArgPointee<4>(revised), Return(SUCCESS)))
+      .WillOnce(DoAll(SetArgPointee<4>(revised), Return(SUCCESS)))
+      .RetiresOnSaturation();
+  EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
+  EXPECT_TRUE(reminders->Due("user0", "tasklist0", "report", due));
+  EXPECT_EQ(due, "2099-12-01");
+  in = TaskContent();
+  in.content = "numbers";
+  EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
+  EXPECT_EQ(reminders->Pending(), 1);
+  revised["status"] = "Done";
+  EXPECT_CALL(*mockedDB, reviseTaskNode("user0", "tasklist0", "report", _, _))
+      .WillOnce(DoAll(SetArgPointee<4>(revised), Return(SUCCESS)))
+      .RetiresOnSaturation();
+  in.status = "Done";
+  EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
+  EXPECT_EQ(reminders->Pending(), 0);
+
+  // a new end date of a done task sets none
+  revised["due"] = "2099-12-05";
+  EXPECT_CALL(*mockedDB, reviseTaskNode("user0", "tasklist0", "report", _, _))
+      .WillOnce(DoAll(SetArgPointee<4>(revised), Return(SUCCESS)))
+      .RetiresOnSaturation();
+  in = TaskContent();
+  in.startDate = "11/01/2099";
+  in.endDate = "12/05/2099";
+  EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
+  EXPECT_EQ(reminders->Pending(), 0);
+
+  // reopening it brings it back, on the end date it has
+  revised["status"] = "Doing";
+  EXPECT_CALL(*mockedDB, reviseTaskNode("user0", "tasklist0", "report", _, _))
+      .WillOnce(DoAll(SetArgPointee<4>(revised), Return(SUCCESS)))
+      .RetiresOnSaturation();
+  in = TaskContent();
+  in.status = "Doing";
+  EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
+  EXPECT_TRUE(reminders->Due("user0", "tasklist0", "report", due));
+  EXPECT_EQ(due, "2099-12-05");
+
+  // a repeating one has none, until it no longer repeats
+  revised["recurrence"] = "FREQ=DAILY";
+  EXPECT_CALL(*mockedDB, reviseTaskNode("user0", "tasklist0", "report", _, _))
+      .WillOnce(DoAll(SetArgPointee<4>(revised), Return(SUCCESS)))
+      .RetiresOnSaturation();
+  in = TaskContent();
+  in.content = "every day";
+  EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
+  EXPECT_EQ(reminders->Pending(), 0);
+  revised.erase("recurrence");
+  EXPECT_CALL(*mockedDB, reviseTaskNode("user0", "tasklist0", "report", _, _))
+      .WillOnce(DoAll(SetArgPointee<4>(revised), Return(SUCCESS)))
+      .RetiresOnSaturation();
+  EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
+  EXPECT_EQ(reminders->Pending(), 1);
+
+  // it follows a moved task, and goes with a deleted one
+  std::map<std::string, std::string> moved = {{"name", "report"},
+                                              {"due", "2099-12-02"}};
+  RequestData to("user0", "tasklist1", "", "");
+  EXPECT_CALL(*mockedDB, moveTaskNode("user0", "tasklist0", "report", "user0",
+                                      "tasklist1", "report", _))
+      .WillOnce(DoAll(SetArgReferee<6>(moved), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->Move(data, to, name), SUCCESS);
+  EXPECT_TRUE(reminders->Due("user0", "tasklist1", "report", due));
+  EXPECT_EQ(due, "2099-12-02");
+  data.tasklist_key = "tasklist1";
+  EXPECT_CALL(*mockedDB, deleteTaskNode("user0", "tasklist1", "report"))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->Delete(data), SUCCESS);
+  EXPECT_EQ(reminders->Pending(), 0);
+}
+
 TEST_F(TasksWorkerTest, Delete) {
   // setup input
   data = RequestData("user0", "tasklist0", "task0", "");
@@ -416,6 +933,201 @@ TEST_F(TasksWorkerTest, Delete) {
   EXPECT_EQ(tasksWorker->Delete(data), ERR_NO_NODE);
 }
 
+TEST_F(TasksWorkerTest, Move) {
+  // setup input
+  data = RequestData("user0", "tasklist0", "task0", "");
+  RequestData to("user0", "tasklist1", "", "");
+  std::string name;
+  std::map<std::string, std::string> moved = {{"name", "task0"},
+                                              {"content", "some content"}};
+
+  // should be successful, one statement and no existence checks
+  EXPECT_CALL(*mockedDB, moveTaskNode("user0", "tasklist0", "task0", "user0",
+                                      "tasklist1", "task0", _))
+      .WillOnce(DoAll(SetArgReferee<6>(moved), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->Move(data, to, name), SUCCESS);
+  EXPECT_EQ(name, "task0");
+
+  // renamed when the target has a task of that name
+  EXPECT_CALL(*mockedDB, moveTaskNode("user0", "tasklist0", "task0", "user0",
+                                      "tasklist1", "task0", _))
+      .WillOnce(Return(ERR_DUP_NODE));
+  EXPECT_CALL(*mockedDB, moveTaskNode("user0", "tasklist0", "task0", "user0",
+                                      "tasklist1", "task0(1)", _))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->Move(data, to, name), SUCCESS);
+  EXPECT_EQ(name, "task0(1)");
+
+  // into a task list of another user, write access needed
+  to.other_user_key = "user1";
+  bool permission = false;
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist1", permission))
+      .WillOnce(DoAll(SetArgReferee<3>(true), Return(SUCCESS)));
+  EXPECT_CALL(*mockedDB, moveTaskNode("user0", "tasklist0", "task0", "user1",
+                                      "tasklist1", "task0", _))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->Move(data, to, name), SUCCESS);
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist1", permission))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->Move(data, to, name), ERR_ACCESS);
+  EXPECT_EQ(name, "");
+
+  // out of a task list of another user
+  data.other_user_key = "user2";
+  to.other_user_key = "";
+  EXPECT_CALL(*mockedDB, checkAccess("user2", "user0", "tasklist0", permission))
+      .WillOnce(Return(ERR_NO_NODE));
+  EXPECT_EQ(tasksWorker->Move(data, to, name), ERR_NO_NODE);
+  data.other_user_key = "";
+
+  // task or target task list does not exist
+  EXPECT_CALL(*mockedDB, moveTaskNode("user0", "tasklist0", "task0", "user0",
+                                      "tasklist1", "task0", _))
+      .WillOnce(Return(ERR_NO_NODE));
+  EXPECT_EQ(tasksWorker->Move(data, to, name), ERR_NO_NODE);
+
+  // same task list, nothing to do
+  to.tasklist_key = "tasklist0";
+  EXPECT_EQ(tasksWorker->Move(data, to, name), SUCCESS);
+  EXPECT_EQ(name, "task0");
+
+  // request is empty
+  to.tasklist_key = "";
+  EXPECT_EQ(tasksWorker->Move(data, to, name), ERR_RFIELD);
+  to.tasklist_key = "tasklist1";
+  data.task_key = "";
+  EXPECT_EQ(tasksWorker->Move(data, to, name), ERR_RFIELD);
+}
+
+TEST_F(TasksWorkerTest, Reorder) {
+  // setup input
+  data = RequestData("user0", "tasklist0", "task0", "");
+  std::string position;
+
+  // should be successful, the DB finds the neighbour
+  EXPECT_CALL(*mockedDB,
+              reorderTaskNode("user0", "tasklist0", "task0", "task1", true, _))
+      .WillOnce(DoAll(SetArgReferee<5>("2V"), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->Reorder(data, "task1", true, position), SUCCESS);
+  EXPECT_EQ(position, "2V");
+
+  // in a task list of another user, write access needed
+  data.other_user_key = "user1";
+  bool permission = false;
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist0", permission))
+      .WillOnce(DoAll(SetArgReferee<3>(true), Return(SUCCESS)));
+  EXPECT_CALL(*mockedDB,
+              reorderTaskNode("user1", "tasklist0", "task0", "task1", false, _))
+      .WillOnce(DoAll(SetArgReferee<5>("0V"), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->Reorder(data, "task1", false, position), SUCCESS);
+  EXPECT_EQ(position, "0V");
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist0", permission))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->Reorder(data, "task1", false, position), ERR_ACCESS);
+  EXPECT_EQ(position, "");
+  data.other_user_key = "";
+
+  // either task does not exist
+  EXPECT_CALL(*mockedDB, reorderTaskNode("user0", "tasklist0", "task0",
+                                         "nothing", true, _))
+      .WillOnce(Return(ERR_NO_NODE));
+  EXPECT_EQ(tasksWorker->Reorder(data, "nothing", true, position),
+            ERR_NO_NODE);
+
+  // request is empty
+  EXPECT_EQ(tasksWorker->Reorder(data, "", true, position), ERR_RFIELD);
+  data.task_key = "";
+  EXPECT_EQ(tasksWorker->Reorder(data, "task1", true, position), ERR_RFIELD);
+}
+
+TEST_F(TasksWorkerTest, Dependencies) {
+  data = RequestData("user0", "tasklist0", "task0", "");
+
+  // the DB rejects cycles and unknown tasks
+  EXPECT_CALL(*mockedDB, addDependency("user0", "tasklist0", "task0", "task1"))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->AddDependency(data, "task1"), SUCCESS);
+  EXPECT_CALL(*mockedDB, addDependency("user0", "tasklist0", "task0", "task0"))
+      .WillOnce(Return(ERR_FORMAT));
+  EXPECT_EQ(tasksWorker->AddDependency(data, "task0"), ERR_FORMAT);
+  EXPECT_CALL(*mockedDB,
+              removeDependency("user0", "tasklist0", "task0", "task1"))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->RemoveDependency(data, "task1"), SUCCESS);
+  EXPECT_CALL(*mockedDB,
+              removeDependency("user0", "tasklist0", "task0", "task1"))
+      .WillOnce(Return(ERR_NO_NODE));
+  EXPECT_EQ(tasksWorker->RemoveDependency(data, "task1"), ERR_NO_NODE);
+
+  // in a task list of another user, write access needed
+  data.other_user_key = "user1";
+  bool permission = false;
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist0", permission))
+      .WillOnce(DoAll(SetArgReferee<3>(true), Return(SUCCESS)));
+  EXPECT_CALL(*mockedDB, addDependency("user1", "tasklist0", "task0", "task1"))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->AddDependency(data, "task1"), SUCCESS);
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist0", permission))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->RemoveDependency(data, "task1"), ERR_ACCESS);
+
+  // request is empty
+  EXPECT_EQ(tasksWorker->AddDependency(data, ""), ERR_RFIELD);
+  data.task_key = "";
+  EXPECT_EQ(tasksWorker->RemoveDependency(data, "task1"), ERR_RFIELD);
+}
+
+TEST_F(TasksWorkerTest, OrderAndCriticalPath) {
+  data = RequestData("user0", "tasklist0", "", "");
+  std::vector<std::string> names;
+  long days = -1;
+  // a after c, d after a and b, in list order a, b, c, d, e
+  std::vector<DBGraphTask> graph(5);
+  graph[0] = {"a", "11/09/2099", "11/11/2099", {"c"}};
+  graph[1] = {"b", "11/01/2099", "11/10/2099", {}};
+  graph[2] = {"c", "11/01/2099", "11/08/2099", {}};
+  graph[3] = {"d", "11/12/2099", "11/13/2099", {"a", "b"}};
+  graph[4] = {"e", "", "", {"gone"}};
+
+  // the ready task first in the list goes first
+  EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(true));
+  EXPECT_CALL(*mockedDB, getTaskGraph("user0", "tasklist0", _))
+      .WillOnce(DoAll(SetArgReferee<2>(graph), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->Order(data, names), SUCCESS);
+  EXPECT_EQ(names, std::vector<std::string>({"b", "c", "a", "d", "e"}));
+
+  // c, a, d take 8 + 3 + 2 days, more than the 10 + 2 of b, d
+  EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(true));
+  EXPECT_CALL(*mockedDB, getTaskGraph("user0", "tasklist0", _))
+      .WillOnce(DoAll(SetArgReferee<2>(graph), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->CriticalPath(data, names, days), SUCCESS);
+  EXPECT_EQ(names, std::vector<std::string>({"c", "a", "d"}));
+  EXPECT_EQ(days, 13);
+
+  // an empty task list of another user
+  data.other_user_key = "user1";
+  bool permission = false;
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist0", permission))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_CALL(*mockedDB, getTaskGraph("user1", "tasklist0", _))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->CriticalPath(data, names, days), SUCCESS);
+  EXPECT_TRUE(names.empty());
+  EXPECT_EQ(days, 0);
+
+  // no access
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist0", permission))
+      .WillOnce(Return(ERR_ACCESS));
+  EXPECT_EQ(tasksWorker->Order(data, names), ERR_ACCESS);
+
+  // tasklist does not exist
+  data = RequestData("user0", "tasklist0", "", "");
+  EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(false));
+  EXPECT_EQ(tasksWorker->Order(data, names), ERR_NO_NODE);
+  data.tasklist_key = "";
+  EXPECT_EQ(tasksWorker->CriticalPath(data, names, days), ERR_RFIELD);
+}
+
 TEST_F(TasksWorkerTest, Revise) {
   // setup input
   data = RequestData("user0", "tasklist0", "task0", "");
@@ -428,7 +1140,7 @@ TEST_F(TasksWorkerTest, Revise) {
   task_info["content"] = in.content;
   EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(true));
   EXPECT_CALL(*mockedDB, reviseTaskNode(data.user_key, data.tasklist_key,
-                                        data.task_key, task_info))
+                                        data.task_key, task_info, _))
       .WillOnce(Return(SUCCESS));
   EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
 
@@ -436,9 +1148,10 @@ TEST_F(TasksWorkerTest, Revise) {
   in.startDate = "10/31/2022", in.endDate = "11/29/2022";
   ;
   task_info["startDate"] = in.startDate, task_info["endDate"] = in.endDate;
+  task_info["due"] = "2022-11-29";
   EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(true));
   EXPECT_CALL(*mockedDB, reviseTaskNode(data.user_key, data.tasklist_key,
-                                        data.task_key, task_info))
+                                        data.task_key, task_info, _))
       .WillOnce(Return(SUCCESS));
   EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
 
@@ -447,7 +1160,7 @@ TEST_F(TasksWorkerTest, Revise) {
   task_info["priority"] = std::to_string(in.priority);
   EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(true));
   EXPECT_CALL(*mockedDB, reviseTaskNode(data.user_key, data.tasklist_key,
-                                        data.task_key, task_info))
+                                        data.task_key, task_info, _))
       .WillOnce(Return(SUCCESS));
   EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
 
@@ -456,7 +1169,7 @@ TEST_F(TasksWorkerTest, Revise) {
   task_info["status"] = in.status;
   EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(true));
   EXPECT_CALL(*mockedDB, reviseTaskNode(data.user_key, data.tasklist_key,
-                                        data.task_key, task_info))
+                                        data.task_key, task_info, _))
       .WillOnce(Return(SUCCESS));
   EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
 
@@ -468,7 +1181,7 @@ TEST_F(TasksWorkerTest, Revise) {
                                      data.tasklist_key, permission))
       .WillOnce(DoAll(SetArgReferee<3>(true), Return(SUCCESS)));
   EXPECT_CALL(*mockedDB, reviseTaskNode(data.other_user_key, data.tasklist_key,
-                                        data.task_key, task_info))
+                                        data.task_key, task_info, _))
       .WillOnce(Return(SUCCESS));
   EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
 
@@ -534,6 +1247,32 @@ TEST_F(TasksWorkerTest, Revise) {
   in.status = "2/3 Done";
   EXPECT_EQ(tasksWorker->Revise(data, in), ERR_FORMAT);
   in.status = "Done";
+
+  // a recurrence needs an end date, the one the task has if none is given
+  in = TaskContent();
+  in.recurrence = "FREQ=DAILY";
+  std::map<std::string, std::string> current = {{"name", "task0"}};
+  EXPECT_CALL(*mockedTaskLists, Exists(data)).WillRepeatedly(Return(true));
+  EXPECT_CALL(*mockedDB, getTaskNode(data.user_key, data.tasklist_key,
+                                     data.task_key, _))
+      .WillOnce(DoAll(SetArgReferee<3>(current), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->Revise(data, in), ERR_FORMAT);
+  current["endDate"] = "11/29/2022";
+  task_info = {{"recurrence", in.recurrence}};
+  EXPECT_CALL(*mockedDB, getTaskNode(data.user_key, data.tasklist_key,
+                                     data.task_key, _))
+      .WillOnce(DoAll(SetArgReferee<3>(current), Return(SUCCESS)));
+  EXPECT_CALL(*mockedDB, reviseTaskNode(data.user_key, data.tasklist_key,
+                                        data.task_key, task_info, _))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
+  in.startDate = "10/31/2022", in.endDate = "11/30/2022";
+  task_info["startDate"] = in.startDate, task_info["endDate"] = in.endDate;
+  task_info["due"] = "2022-11-30";
+  EXPECT_CALL(*mockedDB, reviseTaskNode(data.user_key, data.tasklist_key,
+                                        data.task_key, task_info, _))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->Revise(data, in), SUCCESS);
 }
 
 // Create Function
@@ -612,6 +1351,101 @@ TEST_F(TasksWorkerTest, GetAllTasksName) {
   EXPECT_EQ(task_names.size(), 0);
 }
 
+TEST_F(TasksWorkerTest, Archived) {
+  data = RequestData("user0", "tasklist0", "", "");
+  std::vector<TaskContent> tasks;
+  std::vector<std::map<std::string, std::string>> task_infos = {
+      {{"name", "task1"}, {"status", "Done"}, {"archivedAt", "2022-12-01"}},
+      {{"name", "task0"}, {"status", "Done"}, {"archivedAt", "2022-11-01"}}};
+
+  // in the order of the DB, the last archived first
+  EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(true));
+  EXPECT_CALL(*mockedDB, getArchivedTaskNodes("user0", "tasklist0", "", _))
+      .WillOnce(DoAll(SetArgReferee<3>(task_infos), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->Archived(data, tasks), SUCCESS);
+  ASSERT_EQ(tasks.size(), 2);
+  EXPECT_EQ(tasks[0].name, "task1");
+  EXPECT_EQ(tasks[0].status, "Done");
+  EXPECT_EQ(tasks[1].name, "task0");
+
+  // of one name, in a task list of another user
+  data = RequestData("user0", "tasklist0", "task0", "user1");
+  bool permission = false;
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist0", permission))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_CALL(*mockedDB,
+              getArchivedTaskNodes("user1", "tasklist0", "task0", _))
+      .WillOnce(Return(SUCCESS));
+  EXPECT_EQ(tasksWorker->Archived(data, tasks), SUCCESS);
+  EXPECT_TRUE(tasks.empty());
+
+  // no access
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist0", permission))
+      .WillOnce(Return(ERR_ACCESS));
+  EXPECT_EQ(tasksWorker->Archived(data, tasks), ERR_ACCESS);
+
+  // tasklist does not exist
+  data = RequestData("user0", "tasklist0", "", "");
+  EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(false));
+  EXPECT_EQ(tasksWorker->Archived(data, tasks), ERR_NO_NODE);
+  data.tasklist_key = "";
+  EXPECT_EQ(tasksWorker->Archived(data, tasks), ERR_RFIELD);
+}
+
+TEST_F(TasksWorkerTest, History) {
+  data = RequestData("user0", "tasklist0", "task0", "");
+  std::vector<DBTaskRevision> revisions(2);
+  revisions[0].version = 7;
+  revisions[0].before = {{"status", "Doing"}};
+  revisions[0].after = {{"status", "Done"}};
+  revisions[1].version = 4;
+  revisions[1].before = {{"status", ""}, {"content", "draft"}};
+  revisions[1].after = {{"status", "Doing"}, {"content", "final"}};
+  std::vector<DBTaskRevision> out;
+
+  // a page, the last first
+  EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(true));
+  EXPECT_CALL(*mockedDB,
+              getTaskRevisions("user0", "tasklist0", "task0", 0, 9, 2, _, _))
+      .WillOnce(DoAll(SetArgReferee<7>(revisions), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->History(data, 9, 2, out), SUCCESS);
+  ASSERT_EQ(out.size(), 2);
+  EXPECT_EQ(out[0].version, 7);
+  EXPECT_EQ(out[1].after.at("content"), "final");
+  EXPECT_EQ(tasksWorker->History(data, 9, 0, out), ERR_FORMAT);
+
+  // the task before both revisions: the fields not set then are left out
+  std::map<std::string, std::string> task_info = {
+      {"name", "task0"}, {"content", "final"}, {"status", "Done"}};
+  TaskContent task;
+  EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(true));
+  EXPECT_CALL(*mockedDB,
+              getTaskRevisions("user0", "tasklist0", "task0", 3, 0, 0, _, _))
+      .WillOnce(DoAll(SetArgReferee<6>(task_info),
+                      SetArgReferee<7>(revisions), Return(SUCCESS)));
+  EXPECT_EQ(tasksWorker->AtVersion(data, 3, task), SUCCESS);
+  EXPECT_EQ(task.name, "task0");
+  EXPECT_EQ(task.content, "draft");
+  EXPECT_EQ(task.status, "");
+
+  // no access
+  data = RequestData("user0", "tasklist0", "task0", "user1");
+  bool permission = false;
+  EXPECT_CALL(*mockedDB, checkAccess("user1", "user0", "tasklist0", permission))
+      .WillOnce(Return(ERR_ACCESS));
+  EXPECT_EQ(tasksWorker->AtVersion(data, 3, task), ERR_ACCESS);
+
+  // no such task
+  data = RequestData("user0", "tasklist0", "task9", "");
+  EXPECT_CALL(*mockedTaskLists, Exists(data)).WillOnce(Return(true));
+  EXPECT_CALL(*mockedDB,
+              getTaskRevisions("user0", "tasklist0", "task9", 0, 0, 50, _, _))
+      .WillOnce(Return(ERR_NO_NODE));
+  EXPECT_EQ(tasksWorker->History(data, 0, 50, out), ERR_NO_NODE);
+  data.task_key = "";
+  EXPECT_EQ(tasksWorker->History(data, 0, 2, out), ERR_RFIELD);
+}
+
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
 
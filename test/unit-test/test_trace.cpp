@@ -0,0 +1,79 @@
+#include "common/trace.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(TraceTest, DisabledRecordsNothing) {
+  const uint64_t since_us = Trace::NowUs();
+  Trace::Enable(false);
+  { TRACE_SCOPE("test", "disabled"); }
+  EXPECT_TRUE(Trace::Collect(since_us).empty());
+}
+
+TEST(TraceTest, NestedSpans) {
+  const uint64_t since_us = Trace::NowUs();
+  Trace::Enable(true);
+  {
+    TRACE_SCOPE("test", "outer");
+    { TRACE_SCOPE("test", "inner"); }
+  }
+  Trace::Enable(false);
+
+  auto events = Trace::Collect(since_us);
+  ASSERT_EQ(events.size(), 2);
+  // spans are recorded when they end
+  EXPECT_EQ(std::string(events[0].name), "inner");
+  EXPECT_EQ(std::string(events[1].name), "outer");
+  EXPECT_EQ(std::string(events[1].cat), "test");
+  EXPECT_EQ(events[0].tid, events[1].tid);
+  EXPECT_LE(events[1].start_us, events[0].start_us);
+  EXPECT_GE(events[1].start_us + events[1].dur_us,
+            events[0].start_us + events[0].dur_us);
+}
+
+TEST(TraceTest, RingKeepsLatestSpans) {
+  const uint64_t since_us = Trace::NowUs();
+  Trace::Enable(true);
+  std::thread writer([]() {
+    for (uint64_t i = 0; i < 3 * Trace::__Ring::kCapacity; i++) {
+      TRACE_SCOPE("test", "loop");
+    }
+  });
+  // read while the writer laps the ring
+  while (Trace::Collect(since_us).size() < Trace::__Ring::kCapacity / 2) {
+    std::this_thread::yield();
+  }
+  writer.join();
+  Trace::Enable(false);
+
+  auto events = Trace::Collect(since_us);
+  EXPECT_EQ(events.size(), Trace::__Ring::kCapacity);
+  for (size_t i = 1; i < events.size(); i++) {
+    EXPECT_LE(events[i - 1].start_us, events[i].start_us);
+  }
+}
+
+TEST(TraceTest, ThreadsHaveTheirOwnRing) {
+  const uint64_t since_us = Trace::NowUs();
+  Trace::Enable(true);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([]() { TRACE_SCOPE("test", "thread"); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  Trace::Enable(false);
+
+  auto events = Trace::Collect(since_us);
+  ASSERT_EQ(events.size(), 4);
+  for (size_t i = 1; i < events.size(); i++) {
+    EXPECT_NE(events[i - 1].tid, events[i].tid);
+  }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}